@@ -0,0 +1,296 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "benchmark.h"
+#include "Core/job-system.h"
+#include "Core/file-system.h"
+#include "Renderer/gpu-culling.h"
+#include "Renderer/vertex-array.h"
+#include "Renderer/shader.h"
+
+//The GPU culling checks need a GL 4.5 context, which the GL-free Benchmark does not have. This one opens a hidden
+//GLFW window like the app does and skips, without failing, where there is no such context. On a machine without
+//a GPU, Mesa's llvmpipe provides 4.5: LIBGL_ALWAYS_SOFTWARE=1 xvfb-run GpuBenchmark
+
+static const uint32_t s_width = 256, s_height = 192;
+
+struct Test_Mesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+	glm::vec3 bounds_min, bounds_max;
+};
+
+static Test_Mesh make_box(const glm::vec3& size)
+{
+	static const unsigned int faces[] = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+	Test_Mesh mesh;
+	for (int corner = 0; corner < 8; corner++)
+		mesh.positions.push_back(glm::vec3(corner & 1 ? 0.5f : -0.5f, corner & 2 ? 0.5f : -0.5f, corner & 4 ? 0.5f : -0.5f) * size);
+	mesh.indices.assign(faces, faces + 36);
+	mesh.bounds_min = -0.5f * size;
+	mesh.bounds_max = 0.5f * size;
+	return mesh;
+}
+
+//the plane test gpu-cull-comp.glsl runs, on the CPU
+static bool in_frustum(const glm::mat4& view_projection, const glm::mat4& model, const Test_Mesh& mesh)
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+	const glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+	glm::vec3 center = glm::vec3(model * glm::vec4((mesh.bounds_min + mesh.bounds_max) * 0.5f, 1.0f));
+	glm::vec3 extents = (mesh.bounds_max - mesh.bounds_min) * 0.5f;
+	glm::mat3 basis(model);
+	glm::vec3 world_extents = glm::abs(basis[0]) * extents.x + glm::abs(basis[1]) * extents.y + glm::abs(basis[2]) * extents.z;
+	for (const glm::vec4& plane : planes)
+		if (glm::dot(glm::vec3(plane), center) + plane.w + glm::dot(glm::abs(glm::vec3(plane)), world_extents) < 0.0f)
+			return false;
+	return true;
+}
+
+static GLuint create_program(const std::string& vertex_source, const std::string& fragment_source)
+{
+	GLuint vertex_shader = Shader::create_stage(GL_VERTEX_SHADER, vertex_source);
+	GLuint fragment_shader = Shader::create_stage(GL_FRAGMENT_SHADER, fragment_source);
+	GLuint program = Shader::create_program(vertex_shader, fragment_shader);
+	return Shader::check_program(program, vertex_shader, fragment_shader) ? program : 0;
+}
+
+static void set_camera(GLuint program, const glm::mat4& view, const glm::mat4& projection)
+{
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+}
+
+static std::vector<unsigned char> read_pixels()
+{
+	std::vector<unsigned char> pixels(s_width * s_height * 4);
+	glReadPixels(0, 0, s_width, s_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	return pixels;
+}
+
+static uint32_t count_differences(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b)
+{
+	uint32_t different = 0;
+	for (size_t i = 0; i < a.size(); i += 4)
+		different += a[i] != b[i] || a[i + 1] != b[i + 1] || a[i + 2] != b[i + 2] || a[i + 3] != b[i + 3];
+	return different;
+}
+
+//A grid of rotated boxes and slabs, partly outside the frustum. The GPU must keep exactly the instances the CPU
+//plane test keeps, the indirect draw must look like drawing every instance one by one, and behind a wall the Hi-Z
+//test must drop instances without changing a single pixel.
+static bool check_gpu_culling(Benchmark_Suite& suite)
+{
+	const Test_Mesh meshes[2] = { make_box(glm::vec3(1.0f)), make_box(glm::vec3(2.0f, 0.2f, 2.0f)) };
+	Gpu_Culler culler;
+	if (!culler.init("Asset/Shader/"))
+		return false;
+	for (const Test_Mesh& mesh : meshes)
+		culler.add_mesh(mesh.positions, {}, mesh.indices);
+
+	std::vector<glm::mat4> models;
+	std::vector<uint32_t> instance_meshes;
+	for (int x = 0; x < 12; x++)
+		for (int y = 0; y < 6; y++)
+			for (int z = 0; z < 12; z++)
+			{
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x * 6.0f - 33.0f, y * 4.0f - 10.0f, 10.0f - z * 8.0f));
+				model = glm::rotate(model, 0.3f * (x + y + z), glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+				uint32_t mesh = (x + z) & 1;
+				models.push_back(model);
+				instance_meshes.push_back(mesh);
+				culler.add_instance(mesh, model);
+			}
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)s_width / s_height, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 15.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 view_projection = projection * view;
+
+	suite.run("gpu/cull_864", [&]()
+	{
+		culler.cull(view_projection);
+		glFinish();
+	}, models.size());
+	culler.cull(view_projection);
+	uint32_t gpu_visible = culler.read_visible_count(), cpu_visible = 0;
+	for (size_t i = 0; i < models.size(); i++)
+		cpu_visible += in_frustum(view_projection, models[i], meshes[instance_meshes[i]]);
+
+	//offscreen target, the depth is also what the pyramid is built from
+	GLuint framebuffer, textures[2];
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenTextures(2, textures);
+	glBindTexture(GL_TEXTURE_2D, textures[0]);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, s_width, s_height);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[0], 0);
+	glBindTexture(GL_TEXTURE_2D, textures[1]);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, s_width, s_height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[1], 0);
+	glViewport(0, 0, s_width, s_height);
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+	//the model shader with and without INDIRECT_INSTANCES, coloured by world position so every box looks different
+	std::string vertex_source = Shader::read_file("Asset/Shader/model-vert.glsl");
+	std::string fragment_source = "#version 330 core\nin vec3 v_world_pos;\nout vec4 color;\nvoid main() { color = vec4(fract(v_world_pos * 0.1), 1.0); }\n";
+	GLuint indirect_program = create_program(Shader::inject_defines(vertex_source, SHADER_FEATURE_INDIRECT_INSTANCES), fragment_source);
+	GLuint direct_program = create_program(vertex_source, fragment_source);
+	if (!indirect_program || !direct_program)
+		return false;
+
+	//reference: every instance, culled or not, with its own draw call
+	GLuint vertex_array, buffers[2];
+	glGenVertexArrays(1, &vertex_array);
+	glGenBuffers(2, buffers);
+	glBindVertexArray(vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(glm::vec3), nullptr, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, 8 * sizeof(glm::vec3), meshes[0].positions.data());
+	glBufferSubData(GL_ARRAY_BUFFER, 8 * sizeof(glm::vec3), 8 * sizeof(glm::vec3), meshes[1].positions.data());
+	apply_vertex_layout(vertex_layout_of<Vertex_Position>(), 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshes[0].indices.size() * sizeof(unsigned int), meshes[0].indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	auto draw_reference = [&]()
+	{
+		set_camera(direct_program, view, projection);
+		glBindVertexArray(vertex_array);
+		for (size_t i = 0; i < models.size(); i++)
+		{
+			glUniformMatrix4fv(glGetUniformLocation(direct_program, "model"), 1, GL_FALSE, glm::value_ptr(models[i]));
+			glDrawElementsBaseVertex(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr, instance_meshes[i] * 8);
+		}
+		glBindVertexArray(0);
+	};
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	set_camera(indirect_program, view, projection);
+	culler.draw();
+	std::vector<unsigned char> indirect = read_pixels();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	draw_reference();
+	uint32_t draw_differences = count_differences(indirect, read_pixels());
+
+	//a wall right in front of the camera hides most of the grid
+	Gpu_Culler wall;
+	wall.init("Asset/Shader/");
+	wall.add_instance(wall.add_mesh(meshes[0].positions, {}, meshes[0].indices), glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(-4.0f, 0.0f, 8.0f)), glm::vec3(10.0f, 10.0f, 0.5f)));
+	wall.cull(view_projection);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	set_camera(indirect_program, view, projection);
+	wall.draw();
+	Depth_Pyramid pyramid;
+	if (!pyramid.init("Asset/Shader/"))
+		return false;
+	suite.run("gpu/depth_pyramid", [&]()
+	{
+		pyramid.build(textures[1], s_width, s_height, view_projection);
+		glFinish();
+	}, s_width * s_height);
+
+	culler.set_depth_pyramid(&pyramid);
+	culler.cull(view_projection);
+	uint32_t occlusion_visible = culler.read_visible_count();
+	glClear(GL_COLOR_BUFFER_BIT);
+	set_camera(indirect_program, view, projection);
+	culler.draw();
+	std::vector<unsigned char> occluded = read_pixels();
+
+	culler.set_depth_pyramid(nullptr);
+	culler.cull(view_projection);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	set_camera(indirect_program, view, projection);
+	wall.draw();
+	glClear(GL_COLOR_BUFFER_BIT);
+	culler.draw();
+	uint32_t occlusion_differences = count_differences(occluded, read_pixels());
+	bool gl_valid = glGetError() == GL_NO_ERROR;
+
+	bool valid = gl_valid && gpu_visible == cpu_visible && draw_differences == 0 && occlusion_differences == 0 && occlusion_visible < gpu_visible;
+	std::cout << "gpu culling (" << (culler.has_draw_count() ? "indirect count" : "indirect") << "): " << gpu_visible << " of " << models.size()
+		<< " instances in the frustum (cpu " << cpu_visible << "), " << draw_differences << " pixels differ from per instance draws, "
+		<< occlusion_visible << " left behind the wall with " << occlusion_differences << " pixels changed, " << (valid ? "valid" : "INVALID") << std::endl;
+	suite.add_check("gpu_cull_visible_mismatch", (double)gpu_visible - cpu_visible);
+	suite.add_check("gpu_cull_pixel_differences", draw_differences);
+	suite.add_check("gpu_cull_occlusion_pixel_differences", occlusion_differences);
+	suite.add_check("gpu_cull_occlusion_visible", occlusion_visible);
+
+	pyramid.shutdown();
+	wall.shutdown();
+	culler.shutdown();
+	glDeleteProgram(indirect_program);
+	glDeleteProgram(direct_program);
+	glDeleteVertexArrays(1, &vertex_array);
+	glDeleteBuffers(2, buffers);
+	glDeleteTextures(2, textures);
+	glDeleteFramebuffers(1, &framebuffer);
+	return valid;
+}
+
+//GpuBenchmark [--json results.json] [--filter name]
+//Runs from LearnOpenGL/ like the app for the shader paths.
+int main(int argc, char** argv)
+{
+	std::string json_path = "gpu-benchmark-results.json";
+	Benchmark_Options options;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string argument = argv[i];
+		if (argument == "--json") json_path = argv[i + 1];
+		else if (argument == "--filter") options.filter = argv[i + 1];
+		else std::cout << "Unknown argument : " << argument << std::endl;
+	}
+
+	//no display or no 4.5 driver is a skip, not a failure
+	if (!glfwInit())
+	{
+		std::cout << "gpu checks skipped: GLFW could not initialize (no display?)" << std::endl;
+		return 0;
+	}
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(s_width, s_height, "GpuBenchmark", nullptr, nullptr);
+	if (!window)
+	{
+		std::cout << "gpu checks skipped: no GL 4.5 context" << std::endl;
+		glfwTerminate();
+		return 0;
+	}
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) || !Gpu_Culler::is_supported())
+	{
+		std::cout << "gpu checks skipped: no GL 4.3 compute and indirect draws" << std::endl;
+		glfwTerminate();
+		return 0;
+	}
+	std::cout << "gpu checks on " << glGetString(GL_RENDERER) << ", GL " << glGetString(GL_VERSION) << std::endl;
+
+	Benchmark_Suite suite(options);
+	Job_System::init();
+	File_System::init();
+	std::cout << std::endl << "name                                          median ns  stddev  throughput" << std::endl;
+	bool valid = !suite.is_selected("gpu/") || check_gpu_culling(suite);
+	File_System::shutdown();
+	Job_System::shutdown();
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	if (!suite.write_json(json_path))
+		valid = false;
+	else
+		std::cout << "results written to " << json_path << std::endl;
+	return valid ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+#include "benchmark.h"
+#include "Core/file-system.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <ctime>
+#include <cstdlib>
+
+static const void* volatile s_sink = nullptr;
+
+void benchmark_keep(const void* value)
+{
+	s_sink = value;
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Benchmark_Suite::is_selected(const std::string& name) const
+{
+	return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+}
+
+void Benchmark_Suite::run(const std::string& name, const Body& body, uint64_t items)
+{
+	if (!is_selected(name))
+		return;
+
+	//double the iterations until a sample is long enough to time, this also warms caches and pools
+	double target_ns = m_options.sample_ms * 1e6;
+	uint64_t iterations = 1;
+	while (true)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; i++)
+			body();
+		double ns = elapsed_ns(start);
+		if (ns >= target_ns * 0.25 || iterations >= (1ull << 30))
+		{
+			iterations = std::max<uint64_t>(1, (uint64_t)(iterations * target_ns / std::max(ns, 1.0)));
+			break;
+		}
+		iterations *= 2;
+	}
+	Benchmark_Result result = measure(name, body, iterations, m_options.samples, items);
+	m_results.push_back(result);
+	print(result);
+}
+
+void Benchmark_Suite::run_fixed(const std::string& name, uint32_t samples, const Body& body, uint64_t items)
+{
+	if (!is_selected(name))
+		return;
+	Benchmark_Result result = measure(name, body, 1, samples, items);
+	m_results.push_back(result);
+	print(result);
+}
+
+void Benchmark_Suite::add(const std::string& name, double ms, uint64_t items)
+{
+	Benchmark_Result result;
+	result.name = name;
+	result.iterations = 1;
+	result.samples = 1;
+	result.min_ns = result.median_ns = result.mean_ns = ms * 1e6;
+	result.items = items;
+	result.items_per_second = items && ms > 0.0 ? items / (ms * 1e-3) : 0.0;
+	m_results.push_back(result);
+}
+
+void Benchmark_Suite::add_check(const std::string& name, double value)
+{
+	m_checks.push_back({ name, value });
+}
+
+Benchmark_Result Benchmark_Suite::measure(const std::string& name, const Body& body, uint64_t iterations, uint32_t samples, uint64_t items)
+{
+	std::vector<double> times(std::max(samples, 1u));
+	for (double& time : times)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; i++)
+			body();
+		time = elapsed_ns(start) / iterations;
+	}
+
+	Benchmark_Result result;
+	result.name = name;
+	result.iterations = iterations;
+	result.samples = (uint32_t)times.size();
+	for (double time : times)
+		result.mean_ns += time;
+	result.mean_ns /= times.size();
+	for (double time : times)
+		result.stddev_ns += (time - result.mean_ns) * (time - result.mean_ns);
+	result.stddev_ns = std::sqrt(result.stddev_ns / times.size());
+	std::sort(times.begin(), times.end());
+	result.min_ns = times.front();
+	result.median_ns = times[times.size() / 2];
+	result.items = items;
+	result.items_per_second = items ? items / (result.median_ns * 1e-9) : 0.0;
+	return result;
+}
+
+void Benchmark_Suite::print(const Benchmark_Result& result) const
+{
+	std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(14) << result.median_ns << " ns" << std::setw(8) << std::setprecision(1)
+		<< (result.mean_ns > 0.0 ? result.stddev_ns / result.mean_ns * 100.0 : 0.0) << "%";
+	if (result.items && result.items_per_second >= 1e6)
+		std::cout << std::setw(10) << std::setprecision(2) << result.items_per_second / 1e6 << " M items/s";
+	else if (result.items)
+		std::cout << std::setw(10) << std::setprecision(2) << result.items_per_second / 1e3 << " k items/s";
+	std::cout << std::endl;
+}
+
+static std::string escape_json(const std::string& text)
+{
+	std::string escaped;
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+bool Benchmark_Suite::write_json(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cout << "Failed to write benchmark results to : " << path << std::endl;
+		return false;
+	}
+
+	char timestamp[32] = "";
+	std::time_t now = std::time(nullptr);
+	std::tm utc;
+#ifdef _WIN32
+	gmtime_s(&utc, &now);
+#else
+	gmtime_r(&now, &utc);
+#endif
+	std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+#if defined(_MSC_VER)
+	std::string compiler = "msvc " + std::to_string(_MSC_VER);
+#elif defined(__clang__)
+	std::string compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+	std::string compiler = "gcc " __VERSION__;
+#else
+	std::string compiler = "unknown";
+#endif
+#ifdef _DEBUG
+	const char* configuration = "debug";
+#else
+	const char* configuration = "release";
+#endif
+
+	file << std::setprecision(6) << std::fixed;
+	file << "{\n";
+	file << "\t\"timestamp\": \"" << timestamp << "\",\n";
+	file << "\t\"compiler\": \"" << escape_json(compiler) << "\",\n";
+	file << "\t\"configuration\": \"" << configuration << "\",\n";
+	file << "\t\"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+	file << "\t\"results\": [";
+	for (size_t i = 0; i < m_results.size(); i++)
+	{
+		const Benchmark_Result& result = m_results[i];
+		file << (i ? ",\n" : "\n") << "\t\t{ \"name\": \"" << escape_json(result.name) << "\""
+			<< ", \"iterations\": " << result.iterations
+			<< ", \"samples\": " << result.samples
+			<< ", \"min_ns\": " << result.min_ns
+			<< ", \"median_ns\": " << result.median_ns
+			<< ", \"mean_ns\": " << result.mean_ns
+			<< ", \"stddev_ns\": " << result.stddev_ns
+			<< ", \"items\": " << result.items
+			<< ", \"items_per_second\": " << result.items_per_second << " }";
+	}
+	file << "\n\t],\n";
+	file << "\t\"checks\": {";
+	for (size_t i = 0; i < m_checks.size(); i++)
+		file << (i ? ",\n" : "\n") << "\t\t\"" << escape_json(m_checks[i].first) << "\": " << m_checks[i].second;
+	file << "\n\t}\n}\n";
+	return (bool)file;
+}
+
+//only understands what write_json() produces: one result object per line
+bool Benchmark_Suite::compare(const std::string& baseline_path) const
+{
+	std::string text = File_System::read_text(baseline_path);
+	if (text.empty())
+	{
+		std::cout << "Failed to read benchmark baseline : " << baseline_path << std::endl;
+		return false;
+	}
+
+	std::cout << "against " << baseline_path << std::endl;
+	size_t position = 0;
+	while ((position = text.find("{ \"name\": \"", position)) != std::string::npos)
+	{
+		position += 11;
+		size_t name_end = text.find('"', position);
+		size_t median = text.find("\"median_ns\": ", name_end);
+		size_t line_end = text.find('\n', name_end);
+		if (name_end == std::string::npos || median == std::string::npos || median > line_end)
+			continue;
+		std::string name = text.substr(position, name_end - position);
+		double baseline_ns = std::strtod(text.c_str() + median + 13, nullptr);
+		for (const Benchmark_Result& result : m_results)
+		{
+			if (result.name != name || baseline_ns <= 0.0)
+				continue;
+			double change = (result.median_ns / baseline_ns - 1.0) * 100.0;
+			std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(14) << baseline_ns << " ns ->" << std::setw(14) << result.median_ns << " ns"
+				<< std::setw(8) << std::showpos << change << "%" << std::noshowpos << std::endl;
+		}
+	}
+	return true;
+}
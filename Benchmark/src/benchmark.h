@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+//per iteration timings of one benchmark, in nanoseconds
+struct Benchmark_Result
+{
+	std::string name;
+	uint64_t iterations = 0;			//per sample
+	uint32_t samples = 0;
+	double min_ns = 0.0;
+	double median_ns = 0.0;
+	double mean_ns = 0.0;
+	double stddev_ns = 0.0;
+	uint64_t items = 0;					//vertices, pixels, lights... handled by one iteration, 0 if not meaningful
+	double items_per_second = 0.0;
+};
+
+struct Benchmark_Options
+{
+	std::string filter;					//only run benchmarks whose name contains it
+	double sample_ms = 10.0;			//iterations per sample are calibrated to last about this long
+	uint32_t samples = 15;
+};
+
+//Runs benchmarks as repeated samples of calibrated iteration counts and records the per iteration
+//statistics. The results, plus any pass/fail checks, go to a JSON file so runs can be compared later.
+class Benchmark_Suite
+{
+public:
+	typedef std::function<void()> Body;
+
+	explicit Benchmark_Suite(const Benchmark_Options& options = Benchmark_Options()) : m_options(options) {}
+
+	//body is one iteration; items is what one iteration processes, for throughput
+	void run(const std::string& name, const Body& body, uint64_t items = 0);
+	//for expensive bodies: exactly this many samples of one iteration, no calibration
+	void run_fixed(const std::string& name, uint32_t samples, const Body& body, uint64_t items = 0);
+	//a timing measured elsewhere, one sample
+	void add(const std::string& name, double ms, uint64_t items = 0);
+	void add_check(const std::string& name, double value);
+
+	bool is_selected(const std::string& name) const;
+	const std::vector<Benchmark_Result>& get_results() const { return m_results; }
+
+	bool write_json(const std::string& path) const;
+	//prints the median of every result against the same name in an earlier JSON file
+	bool compare(const std::string& baseline_path) const;
+
+private:
+	Benchmark_Result measure(const std::string& name, const Body& body, uint64_t iterations, uint32_t samples, uint64_t items);
+	void print(const Benchmark_Result& result) const;
+
+private:
+	Benchmark_Options m_options;
+	std::vector<Benchmark_Result> m_results;
+	std::vector<std::pair<std::string, double>> m_checks;
+};
+
+//keeps the compiler from removing work whose result is otherwise unused
+void benchmark_keep(const void* value);
@@ -0,0 +1,926 @@
+#include "hot-paths.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include "Core/file-system.h"
+#include "Core/job-system.h"
+#include "Renderer/buffer.h"
+#include "Renderer/mesh-import.h"
+#include "Renderer/tangent-space.h"
+#include "Renderer/vertex-weld.h"
+#include "Renderer/image-decoder.h"
+#include "Renderer/camera.h"
+#include "Renderer/light-clusters.h"
+#include "Renderer/shadow-cascades.h"
+#include "Renderer/meshlets.h"
+#include "Renderer/occlusion-culler.h"
+#include "Renderer/particle-system.h"
+
+//deterministic inputs, the same every run
+static uint32_t s_random_state = 12345;
+static float random_float(float low, float high)
+{
+	s_random_state = s_random_state * 1664525u + 1013904223u;
+	return low + (high - low) * ((s_random_state >> 8) / 16777216.0f);
+}
+
+//welding only merges what is closer than the epsilon: every corner of every welded triangle has the values of the
+//original corner, and vertices far from the origin, where the steps get large, stay apart
+static bool check_weld(Benchmark_Suite& suite, const aiScene* scene)
+{
+	const float epsilon = Mesh_Import_Options().weld_epsilon;
+	auto close = [epsilon](const float* a, const float* b, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			if (!(std::abs(a[i] - b[i]) <= epsilon * 1.01f))
+				return false;
+		return true;
+	};
+	Mesh_Import_Options unwelded;
+	unwelded.weld = false;
+	std::vector<Vertex> original, welded;
+	std::vector<unsigned int> original_indices, welded_indices;
+	std::vector<uint32_t> remap;
+	uint64_t corners = 0, corner_mismatches = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+	{
+		import_mesh_geometry(scene->mMeshes[i], original, original_indices, unwelded);
+		welded = original;
+		welded_indices = original_indices;
+		Weld_Stream stream = { welded.data(), vertex_layout_of<Vertex>() };
+		uint32_t welded_count = build_weld_remap(&stream, 1, welded.size(), epsilon, remap);
+		apply_weld_remap(welded, remap, welded_count);
+		remap_indices(welded_indices, remap);
+		for (size_t c = 0; c < original_indices.size(); c++)
+		{
+			const Vertex& a = original[original_indices[c]];
+			const Vertex& b = welded[welded_indices[c]];
+			bool same = close(&a.Position.x, &b.Position.x, 3) && close(&a.Normal.x, &b.Normal.x, 3) && close(&a.TexCoords.x, &b.TexCoords.x, 2)
+				&& close(&a.Tangent.x, &b.Tangent.x, 3) && close(&a.Bitangent.x, &b.Bitangent.x, 3) && close(a.m_Weights, b.m_Weights, MAX_BONE_INFLUENCE)
+				&& std::equal(a.m_BoneIDs, a.m_BoneIDs + MAX_BONE_INFLUENCE, b.m_BoneIDs);
+			corners++;
+			if (!same)
+				corner_mismatches++;
+		}
+	}
+
+	//two far apart, a repeat of the first, the float extremes and the mirror of the first
+	const glm::vec3 far_positions[] = { glm::vec3(3000.0f, 0.0f, 0.0f), glm::vec3(5000.0f, 0.0f, 0.0f), glm::vec3(3000.0f, 0.0f, 0.0f),
+		glm::vec3(1e30f, 0.0f, 0.0f), glm::vec3(-1e30f, 0.0f, 0.0f), glm::vec3(-3000.0f, 0.0f, 0.0f) };
+	Weld_Stream far_stream = { far_positions, vertex_layout_of<Vertex_Position>() };
+	uint32_t far_groups = build_weld_remap(&far_stream, 1, sizeof(far_positions) / sizeof(far_positions[0]), epsilon, remap);
+	bool far_valid = far_groups == 5 && remap[2] == remap[0];
+
+	bool valid = corner_mismatches == 0 && far_valid;
+	std::cout << "weld: " << corners << " triangle corners, " << corner_mismatches << " changed, far coordinates "
+		<< (far_valid ? "kept apart" : "MERGED") << std::endl;
+	suite.add_check("weld_corner_mismatches", (double)corner_mismatches);
+	suite.add_check("weld_far_coordinates_valid", far_valid ? 1.0 : 0.0);
+	return valid;
+}
+
+//tangent-space.h promises the same bits for the same mesh on any thread: every mesh is imported and its
+//normals and tangents regenerated twice in order and once on the job system, and all three must memcmp equal
+static bool check_tangent_space_determinism(Benchmark_Suite& suite, const aiScene* scene)
+{
+	struct Generated
+	{
+		std::vector<Vertex> imported, regenerated;
+		std::vector<unsigned int> indices;
+	};
+	auto generate = [scene](uint32_t i, Generated& out)
+	{
+		import_mesh_geometry(scene->mMeshes[i], out.imported, out.indices);
+		//nanosuit comes with normals, so they are also made from the positions alone
+		out.regenerated = out.imported;
+		if (out.regenerated.empty())
+			return;
+		Vertex* v = out.regenerated.data();
+		generate_smooth_normals(&v[0].Position, sizeof(Vertex), &v[0].Normal, sizeof(Vertex), out.regenerated.size(), out.indices);
+		generate_tangents(&v[0].Position, sizeof(Vertex), &v[0].Normal, &v[0].TexCoords, &v[0].Tangent, &v[0].Bitangent,
+			sizeof(Vertex), out.regenerated.size(), out.indices);
+	};
+	auto same = [](const Generated& a, const Generated& b)
+	{
+		return a.imported.size() == b.imported.size() && a.indices == b.indices
+			&& std::memcmp(a.imported.data(), b.imported.data(), a.imported.size() * sizeof(Vertex)) == 0
+			&& std::memcmp(a.regenerated.data(), b.regenerated.data(), a.regenerated.size() * sizeof(Vertex)) == 0;
+	};
+	std::vector<Generated> first(scene->mNumMeshes), second(scene->mNumMeshes), parallel(scene->mNumMeshes);
+	for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+	{
+		generate(i, first[i]);
+		generate(i, second[i]);
+	}
+	Job_System::parallel_for(scene->mNumMeshes, [&generate, &parallel](uint32_t i) { generate(i, parallel[i]); });
+	uint32_t differing = 0;
+	for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+		if (!same(first[i], second[i]) || !same(first[i], parallel[i]))
+			differing++;
+	std::cout << "tangent space: " << scene->mNumMeshes << " meshes generated twice and in parallel, " << differing << " differing" << std::endl;
+	suite.add_check("tangent_space_nondeterministic_meshes", (double)differing);
+	return differing == 0;
+}
+
+//Model::processMesh without the materials, one fresh pair of arrays per mesh like the loader
+static bool benchmark_mesh_import(Benchmark_Suite& suite, const std::string& asset_root)
+{
+	std::string path = asset_root + "/model/nanosuit.obj";
+	Assimp::Importer importer;
+	suite.run_fixed("mesh/assimp_read_nanosuit", 5, [&importer, &path]()
+	{
+		benchmark_keep(importer.ReadFile(path, MODEL_IMPORT_FLAGS));
+		importer.FreeScene();
+	});
+	//what the import cost while Assimp still made the normals and tangents
+	suite.run_fixed("mesh/assimp_read_nanosuit_tangents", 5, [&importer, &path]()
+	{
+		benchmark_keep(importer.ReadFile(path, MODEL_IMPORT_FLAGS | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace));
+		importer.FreeScene();
+	});
+
+	if (!suite.is_selected("mesh/convert") && !suite.is_selected("mesh/bounds") && !suite.is_selected("mesh/generate"))
+		return true;
+	const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+	if (!scene)
+	{
+		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+	uint64_t vertex_count = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+		vertex_count += scene->mMeshes[i]->mNumVertices;
+	suite.run("mesh/convert_nanosuit", [scene]()
+	{
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices;
+			import_mesh_geometry(scene->mMeshes[i], vertices, indices);
+			benchmark_keep(vertices.data());
+		}
+	}, vertex_count);
+	Mesh_Import_Options unwelded;
+	unwelded.weld = false;
+	suite.run("mesh/convert_nanosuit_unwelded", [scene, unwelded]()
+	{
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices;
+			import_mesh_geometry(scene->mMeshes[i], vertices, indices, unwelded);
+			benchmark_keep(vertices.data());
+		}
+	}, vertex_count);
+	suite.run("mesh/convert_nanosuit_streams", [scene]()
+	{
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+		{
+			std::vector<glm::vec3> positions;
+			std::vector<Vertex_Attributes> attributes;
+			std::vector<unsigned int> indices;
+			import_mesh_streams(scene->mMeshes[i], positions, attributes, indices);
+			benchmark_keep(positions.data());
+		}
+	}, vertex_count);
+	//Model::loadModel converts every mesh on its own job
+	suite.run("mesh/convert_nanosuit_parallel", [scene]()
+	{
+		Job_System::parallel_for(scene->mNumMeshes, [scene](uint32_t i)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices;
+			import_mesh_geometry(scene->mMeshes[i], vertices, indices);
+			benchmark_keep(vertices.data());
+		});
+	}, vertex_count);
+
+	//a CPU pass that only needs positions, over the 88 byte vertices and over the packed stream
+	std::vector<Vertex> vertices, all_vertices;
+	std::vector<glm::vec3> positions, all_positions;
+	std::vector<Vertex_Attributes> attributes;
+	std::vector<unsigned int> indices;
+	Weld_Stats weld_stats;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+	{
+		Weld_Stats mesh_weld_stats;
+		import_mesh_geometry(scene->mMeshes[i], vertices, indices, Mesh_Import_Options(), &mesh_weld_stats);
+		weld_stats.add(mesh_weld_stats);
+		all_vertices.insert(all_vertices.end(), vertices.begin(), vertices.end());
+		import_mesh_streams(scene->mMeshes[i], positions, attributes, indices);
+		all_positions.insert(all_positions.end(), positions.begin(), positions.end());
+	}
+	std::cout << "welded nanosuit: " << weld_stats.vertices_before << " -> " << weld_stats.vertices_after << " vertices, "
+		<< weld_stats.bytes_before / 1024 << " -> " << weld_stats.bytes_after / 1024 << " KB" << std::endl;
+	bool valid = check_weld(suite, scene);
+	valid = check_tangent_space_determinism(suite, scene) && valid;
+	std::vector<unsigned int> all_indices;
+	for (unsigned int i = 0, base = 0; i < scene->mNumMeshes; i++)
+	{
+		import_mesh_geometry(scene->mMeshes[i], vertices, indices);
+		for (unsigned int index : indices)
+			all_indices.push_back(base + index);
+		base += (unsigned int)vertices.size();
+	}
+	suite.run("mesh/generate_smooth_normals", [&all_vertices, &all_indices]()
+	{
+		generate_smooth_normals(&all_vertices[0].Position, sizeof(Vertex), &all_vertices[0].Normal, sizeof(Vertex), all_vertices.size(), all_indices);
+		benchmark_keep(all_vertices.data());
+	}, all_vertices.size());
+	suite.run("mesh/generate_tangents", [&all_vertices, &all_indices]()
+	{
+		generate_tangents(&all_vertices[0].Position, sizeof(Vertex), &all_vertices[0].Normal, &all_vertices[0].TexCoords,
+			&all_vertices[0].Tangent, &all_vertices[0].Bitangent, sizeof(Vertex), all_vertices.size(), all_indices);
+		benchmark_keep(all_vertices.data());
+	}, all_vertices.size());
+	suite.run("mesh/bounds_interleaved", [&all_vertices]()
+	{
+		glm::vec3 low(1e30f), high(-1e30f);
+		for (const Vertex& vertex : all_vertices)
+		{
+			low = glm::min(low, vertex.Position);
+			high = glm::max(high, vertex.Position);
+		}
+		benchmark_keep(&low);
+		benchmark_keep(&high);
+	}, all_vertices.size());
+	suite.run("mesh/bounds_position_stream", [&all_positions]()
+	{
+		glm::vec3 low(1e30f), high(-1e30f);
+		for (const glm::vec3& position : all_positions)
+		{
+			low = glm::min(low, position);
+			high = glm::max(high, position);
+		}
+		benchmark_keep(&low);
+		benchmark_keep(&high);
+	}, all_positions.size());
+	return valid;
+}
+
+//clusters nanosuit and checks them on the CPU: limits, every triangle kept once, and no cone ever rejecting
+//a meshlet with a triangle that faces a camera from all around the model
+static bool benchmark_meshlets(Benchmark_Suite& suite, const std::string& asset_root)
+{
+	if (!suite.is_selected("mesh/build_meshlets") && !suite.is_selected("culling/meshlets"))
+		return true;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(asset_root + "/model/nanosuit.obj", MODEL_IMPORT_FLAGS);
+	if (!scene)
+	{
+		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+	std::vector<std::vector<glm::vec3>> positions(scene->mNumMeshes);
+	std::vector<std::vector<unsigned int>> indices(scene->mNumMeshes);
+	std::vector<Vertex_Attributes> attributes;
+	uint64_t triangle_count = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+	{
+		import_mesh_streams(scene->mMeshes[i], positions[i], attributes, indices[i]);
+		triangle_count += indices[i].size() / 3;
+	}
+
+	std::vector<unsigned int> scratch;
+	suite.run("mesh/build_meshlets_nanosuit", [&]()
+	{
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			scratch = indices[i];
+			benchmark_keep(build_meshlets(positions[i].data(), positions[i].size(), sizeof(glm::vec3), scratch).data());
+		}
+	}, triangle_count);
+
+	std::vector<std::vector<Meshlet>> meshlets(positions.size());
+	uint32_t meshlet_count = 0, limit_violations = 0, lost_triangles = 0;
+	glm::vec3 low(1e30f), high(-1e30f);
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		std::vector<unsigned int> original = indices[i];
+		meshlets[i] = build_meshlets(positions[i].data(), positions[i].size(), sizeof(glm::vec3), indices[i]);
+		meshlet_count += (uint32_t)meshlets[i].size();
+		uint32_t next_index = 0;
+		for (const Meshlet& meshlet : meshlets[i])
+		{
+			if (meshlet.vertex_count > MESHLET_MAX_VERTICES || meshlet.index_count > MESHLET_MAX_TRIANGLES * 3 || meshlet.first_index != next_index)
+				limit_violations++;
+			next_index = meshlet.first_index + meshlet.index_count;
+		}
+		//the same triangles with the same winding, only in another order
+		auto sorted_triangles = [](const std::vector<unsigned int>& list)
+		{
+			std::vector<glm::uvec3> triangles;
+			for (size_t t = 0; t + 2 < list.size(); t += 3)
+				triangles.push_back(glm::uvec3(list[t], list[t + 1], list[t + 2]));
+			std::sort(triangles.begin(), triangles.end(), [](const glm::uvec3& a, const glm::uvec3& b)
+			{
+				return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+			});
+			return triangles;
+		};
+		if (next_index != indices[i].size() || sorted_triangles(original) != sorted_triangles(indices[i]))
+			lost_triangles++;
+		for (const glm::vec3& position : positions[i])
+		{
+			low = glm::min(low, position);
+			high = glm::max(high, position);
+		}
+	}
+
+	//cameras on rings around the model, from close up to far away
+	std::vector<glm::vec3> cameras;
+	glm::vec3 center = (low + high) * 0.5f;
+	float size = glm::length(high - low);
+	for (float distance : { 0.75f, 1.5f, 4.0f })
+		for (int ring = -2; ring <= 2; ring++)
+			for (int step = 0; step < 16; step++)
+			{
+				float yaw = step * 6.2831853f / 16.0f, pitch = ring * 0.6f;
+				cameras.push_back(center + size * distance * glm::vec3(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw)));
+			}
+	uint64_t tested = 0, rejected = 0, false_rejections = 0;
+	for (const glm::vec3& camera : cameras)
+		for (size_t i = 0; i < meshlets.size(); i++)
+			for (const Meshlet& meshlet : meshlets[i])
+			{
+				tested++;
+				if (!meshlet_is_backfacing(meshlet, camera))
+					continue;
+				rejected++;
+				for (uint32_t t = meshlet.first_index; t < meshlet.first_index + meshlet.index_count; t += 3)
+				{
+					const glm::vec3& a = positions[i][indices[i][t]];
+					glm::vec3 normal = glm::cross(positions[i][indices[i][t + 1]] - a, positions[i][indices[i][t + 2]] - a);
+					if (glm::dot(normal, camera - a) > 0.0f)
+					{
+						false_rejections++;
+						break;
+					}
+				}
+			}
+
+	bool valid = limit_violations == 0 && lost_triangles == 0 && false_rejections == 0;
+	std::cout << "meshlets: " << meshlet_count << " for " << triangle_count << " triangles, "
+		<< (double)triangle_count / std::max(meshlet_count, 1u) << " per meshlet, "
+		<< (double)rejected / std::max<uint64_t>(tested, 1) * 100.0 << "% backfacing over " << cameras.size() << " cameras, "
+		<< (valid ? "valid" : "INVALID") << std::endl;
+	suite.add_check("meshlet_count", meshlet_count);
+	suite.add_check("meshlet_limit_violations", limit_violations);
+	suite.add_check("meshlet_lost_triangles", lost_triangles);
+	suite.add_check("meshlet_cone_false_rejections", (double)false_rejections);
+	suite.add_check("meshlet_backfacing_ratio", (double)rejected / std::max<uint64_t>(tested, 1));
+
+	//the per frame pass over the whole model, looking at it from the front
+	Meshlet_Culler culler;
+	std::vector<Meshlet_Range> ranges;
+	glm::vec3 eye = center + glm::vec3(0.0f, 0.0f, size * 1.5f);
+	glm::mat4 view_projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) * glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+	suite.run("culling/meshlets_nanosuit", [&]()
+	{
+		culler.begin_frame(view_projection, eye);
+		ranges.clear();
+		for (const std::vector<Meshlet>& mesh_meshlets : meshlets)
+			culler.cull(mesh_meshlets, glm::mat4(1.0f), ranges);
+		benchmark_keep(ranges.data());
+	}, meshlet_count);
+	return valid;
+}
+
+//the maps nanosuit.mtl references, what loading the model decodes
+static std::vector<std::string> material_textures(const std::string& asset_root)
+{
+	std::vector<std::string> paths;
+	std::istringstream material(File_System::read_text(asset_root + "/model/nanosuit.mtl"));
+	std::string line;
+	while (std::getline(material, line))
+	{
+		std::istringstream words(line);
+		std::string key, file;
+		words >> key >> file;
+		std::string path = asset_root + "/model/" + file;
+		if (key.compare(0, 4, "map_") == 0 && std::find(paths.begin(), paths.end(), path) == paths.end())
+			paths.push_back(path);
+	}
+	return paths;
+}
+
+static void benchmark_texture_decode(Benchmark_Suite& suite, const std::string& asset_root)
+{
+	//decode only, the file is already in memory
+	const char* files[] = { "model/body_dif.png", "texture/container.jpg" };
+	for (const char* file : files)
+	{
+		std::string name = std::string("texture/decode_") + file;
+		if (!suite.is_selected(name))
+			continue;
+		File_Handle data = File_System::read(asset_root + "/" + file);
+		Decoded_Image probe;
+		if (data->is_ready())
+			Image_Decoder::decode(probe, data->get_data().data(), data->get_size(), true);
+		if (!probe.pixels)
+		{
+			std::cout << "Failed to load image from : " << data->get_path() << std::endl;
+			continue;
+		}
+		Image_Decoder::free_image(probe);
+		suite.run(name, [&data]()
+		{
+			Decoded_Image image;
+			Image_Decoder::decode(image, data->get_data().data(), data->get_size(), true);
+			Image_Decoder::free_image(image);
+		}, (uint64_t)probe.width * probe.height);
+	}
+
+	//reads and parallel decodes of every nanosuit map, as Model's texture loading does them
+	std::vector<std::string> paths = material_textures(asset_root);
+	if (paths.empty() || !suite.is_selected("texture/decode_batch_nanosuit"))
+		return;
+	suite.run_fixed("texture/decode_batch_nanosuit", 5, [&paths]()
+	{
+		std::vector<Decoded_Image> images = Image_Decoder::decode_batch(paths, false);
+		Image_Decoder::free_images(images);
+	}, paths.size());
+}
+
+static void benchmark_layouts(Benchmark_Suite& suite)
+{
+	suite.run("layout/buffer_layout_model_vertex", []()
+	{
+		Buffer_Layout layout = {
+			{ Shader_Data_Type::Float3, "a_position" },
+			{ Shader_Data_Type::Float3, "a_normal" },
+			{ Shader_Data_Type::Float2, "a_texcoord" },
+			{ Shader_Data_Type::Float3, "a_tangent" },
+			{ Shader_Data_Type::Float3, "a_bitangent" },
+			{ Shader_Data_Type::Int4, "a_bone_ids" },
+			{ Shader_Data_Type::Float4, "a_weights" }
+		};
+		benchmark_keep(&layout);
+	});
+
+	//what is left at runtime for compile-time layouts, the count is read back so the hash is not folded
+	static volatile uint32_t attribute_count = vertex_layout_of<Vertex>().count;
+	suite.run("layout/hash_model_vertex", []()
+	{
+		Vertex_Layout_View view = vertex_layout_of<Vertex>();
+		static uint64_t hash;
+		hash = hash_vertex_attributes(view.attributes, attribute_count, view.stride);
+		benchmark_keep(&hash);
+	});
+}
+
+static void benchmark_transforms(Benchmark_Suite& suite)
+{
+	Perspective_Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+	suite.run("transform/camera_mouse_update", [&camera]()
+	{
+		camera.process_mouse_event(0.5f, 0.25f);
+		benchmark_keep(&camera);
+	}, 1);
+
+	const uint32_t objects = 1024;
+	std::vector<glm::vec3> positions(objects), axes(objects);
+	std::vector<float> angles(objects);
+	for (uint32_t i = 0; i < objects; i++)
+	{
+		positions[i] = glm::vec3(random_float(-50.0f, 50.0f), random_float(-5.0f, 5.0f), random_float(-50.0f, 50.0f));
+		axes[i] = glm::normalize(glm::vec3(random_float(-1.0f, 1.0f), 1.0f, random_float(-1.0f, 1.0f)));
+		angles[i] = random_float(0.0f, 6.28f);
+	}
+	std::vector<glm::mat4> models(objects), mvps(objects);
+	suite.run("transform/model_matrices_1k", [&]()
+	{
+		for (uint32_t i = 0; i < objects; i++)
+		{
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
+			model = glm::rotate(model, angles[i], axes[i]);
+			models[i] = glm::scale(model, glm::vec3(0.5f));
+		}
+		benchmark_keep(models.data());
+	}, objects);
+
+	glm::mat4 view_projection = camera.get_view_projection_matrix();
+	suite.run("transform/mvp_1k", [&]()
+	{
+		for (uint32_t i = 0; i < objects; i++)
+			mvps[i] = view_projection * models[i];
+		benchmark_keep(mvps.data());
+	}, objects);
+}
+
+//spot cones from needle thin to wider than a hemisphere: every point a spot light reaches must lie inside
+//the bounding sphere the cluster assignment tests against
+static bool check_spot_bounds(Benchmark_Suite& suite)
+{
+	if (!suite.is_selected("culling/light_clusters_256"))
+		return true;
+	uint32_t escaped_points = 0;
+	const uint32_t spot_count = 512, samples = 256;
+	for (uint32_t i = 0; i < spot_count; i++)
+	{
+		glm::vec3 direction(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
+		if (glm::dot(direction, direction) < 1e-4f)
+			direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		float outer_angle = 2.0f + 176.0f * i / (spot_count - 1);
+		Cluster_Light light = Cluster_Light::spot(glm::vec3(random_float(-10.0f, 10.0f), random_float(0.0f, 5.0f), random_float(-10.0f, 10.0f)),
+			direction, random_float(1.0f, 20.0f), outer_angle * 0.5f, outer_angle, glm::vec3(1.0f));
+		glm::vec4 sphere = light.get_bounding_sphere();
+		for (uint32_t s = 0; s < samples; s++)
+		{
+			//a random direction pulled inside the cone, at a random distance up to the range
+			glm::vec3 ray(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
+			ray = glm::normalize(ray + light.direction * 1e-3f);
+			float cos_ray = glm::dot(ray, light.direction);
+			if (cos_ray < light.spot_cos_outer)
+			{
+				glm::vec3 side = glm::normalize(ray - light.direction * cos_ray);
+				float sin_outer = sqrt(std::max(0.0f, 1.0f - light.spot_cos_outer * light.spot_cos_outer));
+				ray = light.direction * light.spot_cos_outer + side * sin_outer;
+			}
+			float distance = light.range * ((s & 1) ? 1.0f : random_float(0.0f, 1.0f));
+			glm::vec3 point = light.position + ray * distance;
+			if (glm::length(point - glm::vec3(sphere)) > sphere.w * 1.0001f + 1e-4f)
+				escaped_points++;
+		}
+	}
+	std::cout << "spot bounds: " << escaped_points << " of " << spot_count * samples << " cone points outside their sphere, "
+		<< (escaped_points == 0 ? "valid" : "INVALID") << std::endl;
+	suite.add_check("light_spot_bounds_escaped_points", escaped_points);
+	return escaped_points == 0;
+}
+
+static bool benchmark_culling(Benchmark_Suite& suite)
+{
+	const uint32_t light_count = 256;
+	std::vector<Cluster_Light> lights;
+	for (uint32_t i = 0; i < light_count; i++)
+	{
+		glm::vec3 position(random_float(-40.0f, 40.0f), random_float(0.0f, 10.0f), random_float(-80.0f, 0.0f));
+		lights.push_back(Cluster_Light::point(position, random_float(2.0f, 10.0f), glm::vec3(1.0f)));
+	}
+	Light_Cluster_Grid grid;
+	grid.set_projection(45.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 5.0f), glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	suite.run("culling/light_clusters_256", [&]()
+	{
+		grid.assign(view, lights);
+		benchmark_keep(grid.get_light_indices().data());
+	}, light_count);
+
+	if (!suite.is_selected("culling/light_clusters_4096"))
+		return true;
+	//dense enough that the far clusters overflow max_lights_per_cluster
+	const uint32_t many_count = 4096;
+	std::vector<Cluster_Light> many;
+	for (uint32_t i = 0; i < many_count; i++)
+	{
+		glm::vec3 position(random_float(-40.0f, 40.0f), random_float(0.0f, 10.0f), random_float(-80.0f, 0.0f));
+		many.push_back(Cluster_Light::point(position, random_float(2.0f, 10.0f), glm::vec3(1.0f)));
+	}
+	suite.run("culling/light_clusters_4096", [&]()
+	{
+		grid.assign(view, many);
+		benchmark_keep(grid.get_light_indices().data());
+	}, many_count);
+
+	//every light against every cluster box: each cluster must hold the first max_lights_per_cluster hits in
+	//light order, and everything past that must show up in the overflow count
+	uint32_t max_lights = grid.get_config().max_lights_per_cluster;
+	uint32_t wrong_clusters = 0, expected_overflow = 0, expected_overflowing = 0;
+	std::vector<uint32_t> expected;
+	for (uint32_t cluster = 0; cluster < grid.get_cluster_count(); cluster++)
+	{
+		const Cluster_AABB& box = grid.get_cluster_bounds(cluster);
+		expected.clear();
+		for (uint32_t i = 0; i < many_count; i++)
+		{
+			glm::vec4 center = view * glm::vec4(many[i].position, 1.0f);
+			glm::vec3 d = glm::max(box.min - glm::vec3(center), glm::vec3(0.0f)) + glm::max(glm::vec3(center) - box.max, glm::vec3(0.0f));
+			if (glm::dot(d, d) <= many[i].range * many[i].range)
+				expected.push_back(i);
+		}
+		if (expected.size() > max_lights)
+		{
+			expected_overflow += (uint32_t)expected.size() - max_lights;
+			expected_overflowing++;
+			expected.resize(max_lights);
+		}
+		glm::uvec2 range = grid.get_cluster_ranges()[cluster];
+		if (range.y != expected.size() || !std::equal(expected.begin(), expected.end(), grid.get_light_indices().begin() + range.x))
+			wrong_clusters++;
+	}
+	bool overflow_counted = grid.get_overflow_count() == expected_overflow && grid.get_overflowing_cluster_count() == expected_overflowing;
+	bool valid = wrong_clusters == 0 && overflow_counted && expected_overflow > 0;
+	std::cout << "light clusters: " << wrong_clusters << " of " << grid.get_cluster_count() << " clusters differ from brute force, "
+		<< grid.get_overflow_count() << " lights dropped in " << grid.get_overflowing_cluster_count() << " clusters (expected "
+		<< expected_overflow << " in " << expected_overflowing << "), " << (valid ? "valid" : "INVALID") << std::endl;
+	suite.add_check("light_cluster_mismatches", wrong_clusters);
+	suite.add_check("light_cluster_overflow", grid.get_overflow_count());
+	return valid;
+}
+
+//cascade fitting for a camera sweeping sideways and turning: splits must tile [near, shadow distance], every slice
+//corner must land inside its cascade's light volume, centers must sit on the snap grid and only move in whole
+//steps, and turning the camera must not change any cascade's size
+static bool benchmark_shadow_cascades(Benchmark_Suite& suite)
+{
+	if (!suite.is_selected("culling/shadow_cascades"))
+		return true;
+	Shadow_Config config;
+	const float near_plane = 0.1f, far_plane = 100.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, near_plane, far_plane);
+	glm::vec3 light_direction = glm::normalize(glm::vec3(-0.3f, -1.0f, -0.5f));
+	Shadow_Cascade cascades[MAX_SHADOW_CASCADES];
+	suite.run("culling/shadow_cascades", [&]()
+	{
+		fit_shadow_cascades(config, glm::lookAt(glm::vec3(0.0f, 2.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), projection, light_direction, cascades);
+		benchmark_keep(cascades);
+	}, config.cascade_count);
+
+	uint32_t split_errors = 0, uncovered_corners = 0, off_grid_centers = 0, partial_moves = 0, resized_cascades = 0;
+	Shadow_Cascade previous[MAX_SHADOW_CASCADES];
+	const uint32_t positions = 256, headings = 32;
+	for (uint32_t p = 0; p < positions; p++)
+	{
+		glm::vec3 position(-5.0f + 0.037f * p, 2.0f, 5.0f);
+		for (uint32_t h = 0; h < headings; h++)
+		{
+			float yaw = glm::radians(360.0f * h / headings);
+			glm::vec3 forward(sin(yaw), -0.3f, -cos(yaw));
+			glm::mat4 view = glm::lookAt(position, position + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+			fit_shadow_cascades(config, view, projection, light_direction, cascades);
+
+			float expected_near = near_plane;
+			for (uint32_t i = 0; i < config.cascade_count; i++)
+			{
+				const Shadow_Cascade& cascade = cascades[i];
+				if (fabs(cascade.split_near - expected_near) > 1e-4f || cascade.split_far <= cascade.split_near)
+					split_errors++;
+				expected_near = cascade.split_far;
+
+				//the slice's corners from the camera's side, then through the cascade's light matrix
+				glm::mat4 inverse_view = glm::inverse(view);
+				float tan_y = tan(glm::radians(45.0f) * 0.5f), tan_x = tan_y * 16.0f / 9.0f;
+				for (int c = 0; c < 8; c++)
+				{
+					float depth = (c & 4) ? cascade.split_far : cascade.split_near;
+					glm::vec4 corner = inverse_view * glm::vec4(((c & 1) ? 1.0f : -1.0f) * tan_x * depth, ((c & 2) ? 1.0f : -1.0f) * tan_y * depth, -depth, 1.0f);
+					glm::vec4 clip = cascade.light_view_projection * corner;
+					if (fabs(clip.x) > 1.0001f || fabs(clip.y) > 1.0001f || fabs(clip.z) > 1.0001f)
+						uncovered_corners++;
+				}
+
+				float step = shadow_snap_step(config, cascade.radius);
+				glm::vec2 grid = glm::vec2(cascade.center) / step;
+				if (glm::any(glm::greaterThan(glm::abs(grid - glm::round(grid)), glm::vec2(1e-3f))))
+					off_grid_centers++;
+				if (h == 0 && p > 0)
+				{
+					glm::vec2 moved = glm::vec2(cascade.center - previous[i].center) / step;
+					if (glm::any(glm::greaterThan(glm::abs(moved - glm::round(moved)), glm::vec2(1e-3f))))
+						partial_moves++;
+				}
+				if (h > 0 && cascade.radius != previous[i].radius)
+					resized_cascades++;
+				if (h == 0)
+					previous[i] = cascade;
+			}
+			if (fabs(expected_near - std::min(far_plane, config.shadow_distance)) > 1e-3f)
+				split_errors++;
+		}
+	}
+	bool valid = split_errors == 0 && uncovered_corners == 0 && off_grid_centers == 0 && partial_moves == 0 && resized_cascades == 0;
+	std::cout << "shadow cascades: " << split_errors << " split errors, " << uncovered_corners << " uncovered corners, "
+		<< off_grid_centers << " off-grid centers, " << partial_moves << " partial moves, " << resized_cascades
+		<< " cascades resized by turning, " << (valid ? "valid" : "INVALID") << std::endl;
+	suite.add_check("shadow_cascade_split_errors", split_errors);
+	suite.add_check("shadow_cascade_uncovered_corners", uncovered_corners);
+	suite.add_check("shadow_cascade_snap_errors", off_grid_centers + partial_moves);
+	suite.add_check("shadow_cascade_resized_by_turning", resized_cascades);
+	return valid;
+}
+
+//a 4x4 wall in front of the camera: a box right behind it must be rejected, boxes beside it, in front of it,
+//straddling its edge or only partly covered must be kept
+static bool benchmark_occlusion(Benchmark_Suite& suite)
+{
+	if (!suite.is_selected("culling/occlusion"))
+		return true;
+	const glm::vec3 wall[] = { glm::vec3(-2.0f, -2.0f, 0.0f), glm::vec3(2.0f, -2.0f, 0.0f), glm::vec3(2.0f, 2.0f, 0.0f), glm::vec3(-2.0f, 2.0f, 0.0f) };
+	const uint32_t wall_indices[] = { 0, 1, 2, 0, 2, 3 };
+	glm::mat4 view_projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+		* glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Occlusion_Culler culler;
+	suite.run("culling/occlusion_rasterize", [&]()
+	{
+		culler.begin_frame(view_projection);
+		culler.add_occluder(wall, wall_indices, 6, glm::mat4(1.0f));
+		culler.rasterize();
+	}, culler.get_width() * culler.get_height());
+
+	struct Occludee
+	{
+		glm::vec3 center;
+		bool visible;
+	};
+	const Occludee occludees[] = {
+		{ glm::vec3(0.0f, 0.0f, -3.0f), false },	//behind
+		{ glm::vec3(-1.0f, 1.0f, -1.0f), false },	//behind, off centre
+		{ glm::vec3(4.0f, 0.0f, -3.0f), true },		//beside
+		{ glm::vec3(0.0f, 3.5f, -3.0f), true },		//above
+		{ glm::vec3(0.0f, 0.0f, 2.0f), true },		//in front
+		{ glm::vec3(2.0f, 0.0f, -1.0f), true },		//straddling the right edge
+		{ glm::vec3(0.0f, 0.0f, 0.0f), true },		//cutting through the wall
+	};
+	uint32_t wrong = 0;
+	for (const Occludee& occludee : occludees)
+		if (culler.is_visible(occludee.center - 0.5f, occludee.center + 0.5f) != occludee.visible)
+			wrong++;
+	suite.run("culling/occlusion_test_boxes", [&]()
+	{
+		uint32_t visible = 0;
+		for (const Occludee& occludee : occludees)
+			visible += culler.is_visible(occludee.center - 0.5f, occludee.center + 0.5f);
+		benchmark_keep(&visible);
+	}, sizeof(occludees) / sizeof(occludees[0]));
+
+	std::cout << "occlusion: " << wrong << " of " << sizeof(occludees) / sizeof(occludees[0]) << " boxes misclassified, "
+		<< (wrong == 0 ? "valid" : "INVALID") << std::endl;
+	suite.add_check("occlusion_misclassified_boxes", wrong);
+	return wrong == 0;
+}
+
+//render queue order: opaque front to back by shader, then texture, then depth in the low bits
+static void benchmark_sorting(Benchmark_Suite& suite)
+{
+	const uint32_t draws = 16384;
+	std::vector<uint64_t> keys(draws), sorted(draws);
+	for (uint64_t& key : keys)
+	{
+		uint64_t shader = (uint64_t)random_float(0.0f, 16.0f);
+		uint64_t texture = (uint64_t)random_float(0.0f, 256.0f);
+		uint64_t depth = (uint64_t)random_float(0.0f, 16777215.0f);
+		key = shader << 40 | texture << 24 | depth;
+	}
+	suite.run("sorting/draw_keys_16k", [&]()
+	{
+		sorted = keys;
+		std::sort(sorted.begin(), sorted.end());
+		benchmark_keep(sorted.data());
+	}, draws);
+}
+
+//the particle kernels at the million particles the renderer is meant to keep interactive, each checked
+//against a plain scalar version of what it computes
+static bool benchmark_particles(Benchmark_Suite& suite)
+{
+	bool selected = false;
+	for (const char* name : { "particles/emit_1m", "particles/integrate_1m", "particles/update_1m", "particles/write_instances", "particles/write_instances_sorted" })
+		selected = selected || suite.is_selected(name);
+	if (!selected)
+		return true;
+	const uint32_t capacity = 1 << 20;
+	const float dt = 1.0f / 60.0f;
+	Particle_Emitter emitter;
+	emitter.extent = glm::vec3(5.0f, 0.0f, 5.0f);
+	emitter.speed_min = 2.0f;
+	emitter.speed_max = 6.0f;
+	emitter.lifetime_min = 1.0f;
+	emitter.lifetime_max = 3.0f;
+	emitter.rate = capacity * 0.45f;
+	emitter.end_size = 0.1f;
+
+	Particle_System particles(capacity);
+	particles.set_drag(0.1f);
+	particles.add_emitter(emitter);
+	suite.run("particles/emit_1m", [&]()
+	{
+		particles.clear();
+		particles.emit(0, capacity);
+	}, capacity);
+
+	//integrate against the same step written out per particle
+	const Particle_Streams& streams = particles.get_streams();
+	std::vector<float> expected_y(capacity), expected_life(capacity);
+	float damping = 1.0f - 0.1f * dt;
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		float velocity = streams.velocity_y[i] * damping - 9.81f * dt;
+		expected_y[i] = streams.position_y[i] + velocity * dt;
+		expected_life[i] = streams.life[i] + streams.life_rate[i] * dt;
+	}
+	particles.integrate(dt);
+	uint32_t integrate_mismatches = 0;
+	for (uint32_t i = 0; i < capacity; i++)
+		if (std::abs(streams.position_y[i] - expected_y[i]) > 1e-5f || std::abs(streams.life[i] - expected_life[i]) > 1e-6f)
+			integrate_mismatches++;
+	suite.run("particles/integrate_1m", [&]()
+	{
+		particles.integrate(0.0f);
+	}, capacity);
+
+	std::vector<Particle_Instance> instances(capacity);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 3.0f, 12.0f), glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	//kill after aging everything a random amount: exactly the live ones must survive, untouched. Written out
+	//serially: the k-th live particle past the survivor count fills the k-th dead slot below it. Some die past
+	//the survivor count as well, and a sorted write first leaves its order in the scratch kill() reuses
+	particles.integrate(1.5f);
+	particles.write_instances(view, true, instances.data());
+	uint32_t before = particles.get_count(), alive = 0;
+	for (uint32_t i = 0; i < before; i++)
+		alive += streams.life[i] < 1.0f;
+	std::vector<float> survivor_life(streams.life.begin(), streams.life.begin() + alive);
+	std::vector<float> survivor_x(streams.position_x.begin(), streams.position_x.begin() + alive);
+	std::vector<float> survivor_velocity_z(streams.velocity_z.begin(), streams.velocity_z.begin() + alive);
+	for (uint32_t hole = 0, filler = alive; hole < alive; hole++)
+	{
+		if (streams.life[hole] < 1.0f)
+			continue;
+		while (!(streams.life[filler] < 1.0f))
+			filler++;
+		survivor_life[hole] = streams.life[filler];
+		survivor_x[hole] = streams.position_x[filler];
+		survivor_velocity_z[hole] = streams.velocity_z[filler];
+		filler++;
+	}
+	uint32_t killed = particles.kill();
+	uint32_t kill_mismatches = (particles.get_count() != alive) + (alive + killed != before);
+	for (uint32_t i = 0; i < std::min(particles.get_count(), alive); i++)
+		if (streams.life[i] != survivor_life[i] || streams.position_x[i] != survivor_x[i] || streams.velocity_z[i] != survivor_velocity_z[i])
+			kill_mismatches++;
+	//only the last two dying after a sorted write: nothing has to move
+	Particle_Emitter short_lived = emitter;
+	short_lived.lifetime_min = short_lived.lifetime_max = 0.5f;
+	Particle_System few(8);
+	few.add_emitter(emitter);
+	few.add_emitter(short_lived);
+	few.emit(0, 6);
+	few.emit(1, 2);
+	few.integrate(0.6f);
+	std::vector<float> few_x(few.get_streams().position_x.begin(), few.get_streams().position_x.begin() + 6);
+	few.write_instances(view, true, instances.data());
+	kill_mismatches += (few.kill() != 2) + (few.get_count() != 6);
+	for (uint32_t i = 0; i < std::min(few.get_count(), 6u); i++)
+		kill_mismatches += few.get_streams().position_x[i] != few_x[i];
+
+	//steady state: the emitter refills what dies, most of the capacity alive
+	for (uint32_t frame = 0; frame < 240; frame++)
+		particles.update(dt);
+	suite.run("particles/update_1m", [&]()
+	{
+		particles.update(dt);
+	}, capacity);
+
+	suite.run("particles/write_instances", [&]()
+	{
+		benchmark_keep(instances.data() + particles.write_instances(view, false, instances.data()));
+	}, particles.get_count());
+	suite.run("particles/write_instances_sorted", [&]()
+	{
+		benchmark_keep(instances.data() + particles.write_instances(view, true, instances.data()));
+	}, particles.get_count());
+	//back to front, up to the 16 bit depth keys: within 1% of the distance
+	uint32_t written = particles.write_instances(view, true, instances.data());
+	uint32_t sort_mismatches = written != particles.get_count();
+	float previous = -1e30f;
+	for (uint32_t i = 0; i < written; i++)
+	{
+		float depth = (view * glm::vec4(instances[i].position, 1.0f)).z;
+		if (depth < previous - std::abs(previous) * 0.01f)
+			sort_mismatches++;
+		previous = std::max(previous, depth);
+	}
+
+	bool valid = integrate_mismatches == 0 && kill_mismatches == 0 && sort_mismatches == 0;
+	std::cout << "particles: " << particles.get_count() << " alive in steady state, "
+		<< (valid ? "valid" : "INVALID") << std::endl;
+	suite.add_check("particle_integrate_mismatches", integrate_mismatches);
+	suite.add_check("particle_kill_mismatches", kill_mismatches);
+	suite.add_check("particle_sort_mismatches", sort_mismatches);
+	return valid;
+}
+
+bool run_hot_path_benchmarks(Benchmark_Suite& suite, const std::string& asset_root)
+{
+	bool valid = benchmark_mesh_import(suite, asset_root);
+	valid = benchmark_meshlets(suite, asset_root) && valid;
+	benchmark_texture_decode(suite, asset_root);
+	benchmark_layouts(suite);
+	benchmark_transforms(suite);
+	valid = check_spot_bounds(suite) && valid;
+	valid = benchmark_culling(suite) && valid;
+	valid = benchmark_shadow_cascades(suite) && valid;
+	valid = benchmark_occlusion(suite) && valid;
+	benchmark_sorting(suite);
+	valid = benchmark_particles(suite) && valid;
+	return valid;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+#include "benchmark.h"
+
+//Microbenchmarks of the GL-free hot paths: model import and vertex conversion, image decode, vertex layouts,
+//camera and transform math, light, meshlet and occlusion culling, draw sorting and the particle kernels.
+//Needs Job_System and File_System running.
+//asset_root is the directory holding model/ and texture/, LearnOpenGL/Asset in the repository.
+//false when one of the CPU checks that come with them (vertex welding, tangent space determinism, meshlet clustering,
+//light clusters and spot bounds, shadow cascade fitting, occlusion culling, particle kernels) fails.
+bool run_hot_path_benchmarks(Benchmark_Suite& suite, const std::string& asset_root);
@@ -0,0 +1,395 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <string>
+
+#include "benchmark.h"
+#include "hot-paths.h"
+#include "Core/job-system.h"
+#include "Core/file-system.h"
+#include "Core/allocators.h"
+#include "Core/memory-tracker.h"
+#include "Renderer/render-graph.h"
+#include "Renderer/resource-cache.h"
+
+//Scaling of the job system on an embarrassingly parallel load: every element does the same amount of
+//independent arithmetic, so the ideal speedup is the thread count.
+static double benchmark_parallel_for(std::vector<float>& output, uint32_t repeats)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t r = 0; r < repeats; r++)
+	{
+		Job_System::parallel_for((uint32_t)output.size(), [&output](uint32_t i)
+		{
+			float x = (float)i * 0.001f;
+			float sum = 0.0f;
+			for (uint32_t k = 0; k < 64; k++)
+				sum += std::sin(x + (float)k) * std::cos(x - (float)k);
+			output[i] = sum;
+		});
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//a diamond a -> (b, c) -> d repeated, checks ordering and measures per job overhead
+static double benchmark_task_graph(uint32_t graphs, bool& ordered)
+{
+	std::vector<uint32_t> state(graphs, 0);
+	ordered = true;
+	auto start = std::chrono::steady_clock::now();
+	Job_Counter counter;
+	for (uint32_t g = 0; g < graphs; g++)
+	{
+		uint32_t* value = &state[g];
+		Job* a = Job_System::create([value]() { *value = 1; }, &counter);
+		Job* b = Job_System::create([value]() { if (*value != 1) *value = 100; }, &counter);
+		Job* c = Job_System::create([value]() { if (*value != 1) *value = 100; }, &counter);
+		Job* d = Job_System::create([value]() { *value = *value == 1 ? 2 : 100; }, &counter);
+		Job_System::add_dependency(b, a);
+		Job_System::add_dependency(c, a);
+		Job_System::add_dependency(d, b);
+		Job_System::add_dependency(d, c);
+		Job_System::submit(d);
+		Job_System::submit(c);
+		Job_System::submit(b);
+		Job_System::submit(a);
+		//keep the number of live jobs well below the pool size
+		if (g % 512 == 511)
+			Job_System::wait(counter);
+	}
+	Job_System::wait(counter);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	for (uint32_t value : state)
+		ordered = ordered && value == 2;
+
+	//more successors than a job holds, the ones past MAX_JOB_SUCCESSORS go through relay jobs
+	const uint32_t fan_out = MAX_JOB_SUCCESSORS * 8;
+	std::atomic<uint32_t> source_done{ 0 }, after_source{ 0 };
+	Job* source = Job_System::create([&source_done]() { source_done = 1; }, &counter);
+	for (uint32_t i = 0; i < fan_out; i++)
+	{
+		Job* successor = Job_System::create([&source_done, &after_source]() { after_source += source_done.load(); }, &counter);
+		Job_System::add_dependency(successor, source);
+		Job_System::submit(successor);
+	}
+	Job_System::submit(source);
+	Job_System::wait(counter);
+	ordered = ordered && after_source == fan_out;
+	return ms;
+}
+
+//Frame-shaped work on the transient allocators: an arena draw list, culling output, formatted strings,
+//pooled objects and a parallel_for. After warm-up no frame may touch the heap.
+struct Bench_Draw
+{
+	uint32_t mesh;
+	float depth;
+	float model[16];
+};
+
+static uint64_t steady_state_allocations(uint32_t warmup_frames, uint32_t frames)
+{
+	Linear_Arena arena(4 * 1024);
+	std::vector<float> depths(4096);
+	uint64_t allocations = 0;
+	for (uint32_t frame = 0; frame < warmup_frames + frames; frame++)
+	{
+		Allocation_Scope scope;
+		arena.reset();
+
+		Job_System::parallel_for((uint32_t)depths.size(), [&depths, frame](uint32_t i)
+		{
+			depths[i] = std::fmod((float)(i * 7919 + frame), 100.0f);
+		});
+
+		Arena_Vector<uint32_t> visible{ Arena_Allocator<uint32_t>(&arena) };
+		visible.reserve(depths.size());
+		for (uint32_t i = 0; i < (uint32_t)depths.size(); i++)
+			if (depths[i] < 50.0f)
+				visible.push_back(i);
+
+		Arena_Vector<Bench_Draw> draws{ Arena_Allocator<Bench_Draw>(&arena) };
+		for (uint32_t index : visible)
+			draws.push_back({ index, depths[index], {} });
+		const char* label = arena.format("frame %u: %u draws", frame, (uint32_t)draws.size());
+
+		std::shared_ptr<Bench_Draw> pooled = make_pooled<Bench_Draw>();
+		pooled->mesh = (uint32_t)label[0];
+
+		if (frame >= warmup_frames)
+			allocations += scope.count();
+	}
+	return allocations;
+}
+
+//Deferred-style frame on the render graph, compiled without a GL context. The debug view has no consumer and
+//must be culled, the bloom target must reuse the normal buffer's memory once lighting is done with it.
+static bool check_render_graph(Render_Graph_Stats& stats)
+{
+	Render_Graph graph;
+	Render_Target_Desc color = { 1280, 720, Render_Format::RGBA8 };
+	Render_Target_Desc hdr = { 1280, 720, Render_Format::RGBA16F };
+	Render_Target_Desc depth = { 1280, 720, Render_Format::Depth24_Stencil8 };
+	Render_Target_Desc shadow = { 2048, 2048, Render_Format::Depth32F };
+	Render_Handle backbuffer = graph.import_target("backbuffer", color, 0);
+	Render_Handle shadow_map, albedo, normal, scene_depth, lit, bloom, debug;
+	Render_Graph::Execute_Function nothing = [](const Render_Pass_Context&) {};
+
+	uint32_t debug_pass = graph.add_pass("debug normals", [&](Render_Pass_Builder& builder)
+	{
+		debug = builder.write(builder.create("debug", color));
+	}, nothing);
+	uint32_t gbuffer_pass = graph.add_pass("gbuffer", [&](Render_Pass_Builder& builder)
+	{
+		albedo = builder.write(builder.create("albedo", color));
+		normal = builder.write(builder.create("normal", hdr));
+		scene_depth = builder.write(builder.create("depth", depth));
+	}, nothing);
+	uint32_t shadow_pass = graph.add_pass("shadow", [&](Render_Pass_Builder& builder)
+	{
+		shadow_map = builder.write(builder.create("shadow map", shadow));
+	}, nothing);
+	uint32_t lighting_pass = graph.add_pass("lighting", [&](Render_Pass_Builder& builder)
+	{
+		builder.read(albedo);
+		builder.read(normal);
+		builder.read(scene_depth);
+		builder.read(shadow_map);
+		lit = builder.write(builder.create("lit", hdr));
+	}, nothing);
+	uint32_t bloom_pass = graph.add_pass("bloom", [&](Render_Pass_Builder& builder)
+	{
+		builder.read(lit);
+		bloom = builder.write(builder.create("bloom", hdr));
+	}, nothing);
+	uint32_t tonemap_pass = graph.add_pass("tonemap", [&](Render_Pass_Builder& builder)
+	{
+		builder.read(lit);
+		builder.read(bloom);
+		backbuffer = builder.write(backbuffer);
+	}, nothing);
+	uint32_t outline_pass = graph.add_pass("outline", [&](Render_Pass_Builder& builder)
+	{
+		builder.read(scene_depth);
+		backbuffer = builder.write(backbuffer);
+	}, nothing);
+
+	if (!graph.compile())
+		return false;
+	stats = graph.get_stats();
+
+	const std::vector<uint32_t>& order = graph.get_order();
+	auto position = [&](uint32_t pass) { return std::find(order.begin(), order.end(), pass) - order.begin(); };
+	bool ordered = position(gbuffer_pass) < position(lighting_pass) && position(shadow_pass) < position(lighting_pass)
+		&& position(lighting_pass) < position(bloom_pass) && position(bloom_pass) < position(tonemap_pass)
+		&& position(tonemap_pass) < position(outline_pass);
+	bool culled = graph.is_culled(debug_pass) && order.size() == 6 && graph.get_slot(debug) < 0;
+	bool aliased = graph.get_slot(bloom) == graph.get_slot(normal) && graph.get_slot(lit) != graph.get_slot(bloom)
+		&& graph.get_slot(albedo) != graph.get_slot(scene_depth) && stats.peak_transient_bytes < stats.transient_bytes;
+
+	//write after read: decals draw over the depth that composite still samples, so composite has to run first
+	Render_Graph hazard_graph;
+	Render_Handle output = hazard_graph.import_target("backbuffer", color, 0);
+	Render_Handle hazard_depth, occlusion;
+	hazard_graph.add_pass("gbuffer", [&](Render_Pass_Builder& builder)
+	{
+		hazard_depth = builder.write(builder.create("depth", depth));
+	}, nothing);
+	hazard_graph.add_pass("ssao", [&](Render_Pass_Builder& builder)
+	{
+		builder.read(hazard_depth);
+		occlusion = builder.write(builder.create("ssao", color));
+	}, nothing);
+	//declared before decals, and with nothing but the old depth to wait for it would otherwise be picked later
+	uint32_t composite_pass = hazard_graph.add_pass("composite", [&](Render_Pass_Builder& builder)
+	{
+		builder.read(hazard_depth);
+		output = builder.write(output);
+	}, nothing);
+	uint32_t decals_pass = hazard_graph.add_pass("decals", [&](Render_Pass_Builder& builder)
+	{
+		builder.read(occlusion);
+		builder.write(hazard_depth);
+		builder.set_side_effect();
+	}, nothing);
+	if (!hazard_graph.compile())
+		return false;
+	const std::vector<uint32_t>& hazard_order = hazard_graph.get_order();
+	bool hazard_ordered = std::find(hazard_order.begin(), hazard_order.end(), composite_pass) < std::find(hazard_order.begin(), hazard_order.end(), decals_pass);
+	return ordered && culled && aliased && hazard_ordered;
+}
+
+//The Resource_Manager's bookkeeping without GL: six resources of 1000 GPU bytes (2000 for the last) against a
+//4000 byte budget. Unreferenced ones must go least recently released first, a cache hit takes its resource
+//off the list, referenced ones stay even over budget, and a reused slot must not answer a stale handle.
+static bool check_resource_cache(Resource_Stats& stats, std::string& eviction_order)
+{
+	struct Tracked
+	{
+		char name;
+		std::string* destroyed;
+		Tracked(char name, std::string* destroyed) : name(name), destroyed(destroyed) {}
+		~Tracked() { *destroyed += name; }
+	};
+	Resource_Cache cache;
+	cache.set_budget(1 << 20, 4000);
+	auto load = [&](char name, uint64_t gpu_bytes)
+	{
+		std::string key(1, name);
+		uint32_t index = cache.find(key);
+		if (index == Resource_Cache::NONE)
+			index = cache.insert(key, Resource_Type::Texture, std::make_shared<Tracked>(name, &eviction_order), 0, gpu_bytes);
+		//what Resource_Ref does, before the budget is enforced
+		Resource_Handle<Tracked> handle = { index, cache.get_generation(index) };
+		cache.add_reference(handle.index, handle.generation);
+		cache.enforce_budget();
+		return handle;
+	};
+	auto release = [&](Resource_Handle<Tracked> handle) { cache.release(handle.index, handle.generation); };
+	auto resolves = [&](Resource_Handle<Tracked> handle) { return cache.get_object(handle.index, handle.generation, Resource_Type::Texture) != nullptr; };
+
+	Resource_Handle<Tracked> a = load('A', 1000), b = load('B', 1000), c = load('C', 1000), d = load('D', 1000);
+	release(c);
+	release(a);
+	release(d);
+	bool at_budget = eviction_order.empty() && cache.get_stats().resident == 4 && cache.get_stats().referenced == 1;
+	//a cache hit while A waits on the list
+	Resource_Handle<Tracked> a_again = load('A', 1000);
+	bool hit = a_again == a && cache.get_stats().cache_hits == 1;
+	Resource_Handle<Tracked> e = load('E', 1000);
+	Resource_Handle<Tracked> f = load('F', 2000);
+	//only C and D were unreferenced, so the cache stays over budget until A is let go
+	bool over_budget = eviction_order == "CD" && cache.get_stats().gpu_bytes == 5000;
+	release(a_again);
+	bool ordered = eviction_order == "CDA" && cache.get_stats().gpu_bytes == 4000 && cache.find_resident("A") == Resource_Cache::NONE;
+
+	//E went into a new slot before C was evicted, F took the slot C freed with a newer generation
+	bool reused = f.index == c.index && f.generation != c.generation && e.index != c.index;
+	bool stale = !resolves(a) && !resolves(c) && !resolves(d) && resolves(b) && resolves(e) && resolves(f);
+	//a stale release must not touch the new owner of the slot, nor a handle of another type resolve
+	release(c);
+	stale = stale && resolves(f) && cache.get_stats().referenced == 3
+		&& cache.get_object(f.index, f.generation, Resource_Type::Model) == nullptr;
+
+	release(b);
+	release(e);
+	release(f);
+	cache.evict_unused();
+	stats = cache.get_stats();
+	return at_budget && hit && over_budget && ordered && reused && stale && eviction_order == "CDABEF" && stats.resident == 0;
+}
+
+//Benchmark [--json results.json] [--baseline earlier.json] [--assets dir] [--filter name]
+//Runs from LearnOpenGL/ like the app, so the default asset root is the same relative path.
+int main(int argc, char** argv)
+{
+	std::string json_path = "benchmark-results.json", baseline_path, asset_root = "Asset";
+	Benchmark_Options options;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string argument = argv[i];
+		if (argument == "--json") json_path = argv[i + 1];
+		else if (argument == "--baseline") baseline_path = argv[i + 1];
+		else if (argument == "--assets") asset_root = argv[i + 1];
+		else if (argument == "--filter") options.filter = argv[i + 1];
+		else std::cout << "Unknown argument : " << argument << std::endl;
+	}
+	Benchmark_Suite suite(options);
+	bool valid = true;
+
+	if (suite.is_selected("jobs/"))
+	{
+		uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<float> output(1 << 16);
+		const uint32_t repeats = 8;
+
+		std::cout << "parallel_for, " << output.size() << " elements x " << repeats << std::endl;
+		std::cout << "threads      ms  speedup  efficiency   steals  idle ms" << std::endl;
+		double serial_ms = 0.0;
+		for (uint32_t threads = 1; threads <= hardware; threads = threads < hardware ? std::min(threads * 2, hardware) : threads + 1)
+		{
+			if (threads > 1)
+				Job_System::init(threads - 1);
+			//warm up the workers and the pools
+			benchmark_parallel_for(output, 1);
+			Job_System::reset_stats();
+
+			double ms = benchmark_parallel_for(output, repeats);
+			if (threads == 1)
+				serial_ms = ms;
+			suite.add("jobs/parallel_for_threads_" + std::to_string(threads), ms / repeats, output.size());
+			Job_Thread_Stats total = Job_System::get_stats().total();
+			std::cout << std::setw(7) << threads << std::fixed << std::setprecision(2)
+				<< std::setw(8) << ms
+				<< std::setw(9) << serial_ms / ms
+				<< std::setw(11) << serial_ms / ms / threads * 100.0 << "%"
+				<< std::setw(9) << total.steals
+				<< std::setw(9) << total.idle_ms << std::endl;
+
+			if (threads == hardware)
+			{
+				bool ordered;
+				double graph_ms = benchmark_task_graph(20000, ordered);
+				std::cout << "task graph, 20000 diamonds: " << graph_ms << " ms, " << (ordered ? "ordered" : "ORDER VIOLATED") << std::endl;
+				suite.add("jobs/task_graph_20k", graph_ms, 20000 * 4);
+				suite.add_check("task_graph_ordered", ordered ? 1.0 : 0.0);
+				valid = valid && ordered;
+			}
+			Job_System::shutdown();
+		}
+	}
+
+	Job_System::init();
+	File_System::init();
+	if (suite.is_selected("frame/"))
+	{
+		uint64_t allocations = steady_state_allocations(4, 200);
+		std::cout << "steady-state frames, 200 after warm-up: " << allocations << " heap allocations";
+		if (!Memory_Tracker::is_enabled())
+			std::cout << " (tracking disabled)";
+		std::cout << std::endl;
+		suite.add_check("steady_state_allocations", (double)allocations);
+		valid = valid && allocations == 0;
+	}
+
+	if (suite.is_selected("render_graph/"))
+	{
+		Render_Graph_Stats graph_stats;
+		bool graph_valid = check_render_graph(graph_stats);
+		std::cout << "render graph: " << graph_stats.passes - graph_stats.culled_passes << "/" << graph_stats.passes << " passes, "
+			<< graph_stats.transient_targets << " transients in " << graph_stats.physical_targets << " targets, peak "
+			<< graph_stats.peak_transient_bytes / (1024.0 * 1024.0) << " MB instead of " << graph_stats.transient_bytes / (1024.0 * 1024.0) << " MB, "
+			<< (graph_valid ? "valid" : "INVALID") << std::endl;
+		suite.add_check("render_graph_valid", graph_valid ? 1.0 : 0.0);
+		suite.add_check("render_graph_peak_transient_bytes", (double)graph_stats.peak_transient_bytes);
+		valid = valid && graph_valid;
+	}
+
+	if (suite.is_selected("resource_cache/"))
+	{
+		Resource_Stats cache_stats;
+		std::string eviction_order;
+		bool cache_valid = check_resource_cache(cache_stats, eviction_order);
+		std::cout << "resource cache: " << cache_stats.loads << " loads, " << cache_stats.cache_hits << " hits, "
+			<< cache_stats.evictions << " evictions in order " << eviction_order << ", " << (cache_valid ? "valid" : "INVALID") << std::endl;
+		suite.add_check("resource_cache_valid", cache_valid ? 1.0 : 0.0);
+		valid = valid && cache_valid;
+	}
+
+	std::cout << std::endl << "name                                          median ns  stddev  throughput" << std::endl;
+	valid = run_hot_path_benchmarks(suite, asset_root) && valid;
+	File_System::shutdown();
+	Job_System::shutdown();
+
+	if (!suite.write_json(json_path))
+		valid = false;
+	else
+		std::cout << "results written to " << json_path << std::endl;
+	if (!baseline_path.empty())
+		suite.compare(baseline_path);
+	return valid ? 0 : 1;
+}
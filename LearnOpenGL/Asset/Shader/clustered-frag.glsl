@@ -0,0 +1,114 @@
+#version 330 core
+// variants: HAS_SPECULAR_MAP, RECEIVE_SHADOWS
+// a directional sun plus every point and spot light of the fragment's cluster
+
+out vec4 frag_color;
+
+in vec3 v_normal;
+in vec3 v_world_pos;
+in vec3 v_view_pos;
+in vec2 v_texcoord;
+
+uniform sampler2D texture1;
+#ifdef HAS_SPECULAR_MAP
+uniform sampler2D texture_specular1;
+#else
+uniform vec3 specular_strength = vec3(0.2);
+#endif
+uniform float shininess = 32.0;
+uniform vec3 view_pos;
+uniform vec3 ambient_color = vec3(0.25);
+uniform vec3 light_direction = vec3(-0.3, -1.0, -0.5);
+uniform vec3 light_color = vec3(0.8);
+
+#ifdef RECEIVE_SHADOWS
+// written by Cascaded_Shadow_Map::bind
+uniform sampler2DArrayShadow u_shadow_map;
+uniform mat4 u_cascade_matrices[4];
+uniform vec4 u_cascade_splits;
+uniform int u_cascade_count;
+
+float calculate_shadow(vec3 normal, vec3 light_dir)
+{
+	float view_depth = -v_view_pos.z;
+	if (view_depth >= u_cascade_splits[u_cascade_count - 1])
+		return 1.0;
+	int cascade = u_cascade_count - 1;
+	for (int i = u_cascade_count - 1; i >= 0; i--)
+		if (view_depth < u_cascade_splits[i])
+			cascade = i;
+
+	// push along the normal a little to keep acne off surfaces facing away from the light
+	vec3 offset_pos = v_world_pos + normal * 0.02 * (1.0 - max(dot(normal, light_dir), 0.0));
+	vec4 light_pos = u_cascade_matrices[cascade] * vec4(offset_pos, 1.0);
+	vec3 shadow_coord = light_pos.xyz / light_pos.w * 0.5 + 0.5;
+	return texture(u_shadow_map, vec4(shadow_coord.xy, float(cascade), shadow_coord.z));
+}
+#endif
+
+// written by Clustered_Lighting, 4 texels per light:
+// (position, range) (color, intensity) (direction, cos outer) (cos inner, -, -, -)
+uniform samplerBuffer u_cluster_lights;
+uniform usamplerBuffer u_cluster_ranges;	// (offset, count) per cluster
+uniform usamplerBuffer u_cluster_indices;
+uniform vec3 u_cluster_grid;				// tiles x, tiles y, slices z
+uniform vec4 u_cluster_params;				// tile width, tile height, slice scale, slice bias
+
+vec3 calculate_light(int light, vec3 normal, vec3 view_dir, vec3 diffuse_map, vec3 specular_map)
+{
+	vec4 position_range = texelFetch(u_cluster_lights, light * 4 + 0);
+	vec4 color_intensity = texelFetch(u_cluster_lights, light * 4 + 1);
+	vec4 direction_outer = texelFetch(u_cluster_lights, light * 4 + 2);
+	float cos_inner = texelFetch(u_cluster_lights, light * 4 + 3).x;
+
+	vec3 to_light = position_range.xyz - v_world_pos;
+	float distance = length(to_light);
+	if (distance >= position_range.w)
+		return vec3(0.0);
+	vec3 light_dir = to_light / distance;
+
+	// smooth window that reaches zero at the light's range
+	float falloff = clamp(1.0 - pow(distance / position_range.w, 4.0), 0.0, 1.0);
+	float attenuation = falloff * falloff / (distance * distance + 1.0);
+	float spot = smoothstep(direction_outer.w, cos_inner, dot(-light_dir, direction_outer.xyz));
+
+	vec3 radiance = color_intensity.rgb * color_intensity.a * attenuation * spot;
+	vec3 half_vector = normalize(view_dir + light_dir);
+	vec3 diffuse_color = diffuse_map * max(0.0, dot(normal, light_dir));
+	vec3 specular_color = specular_map * pow(max(0.0, dot(normal, half_vector)), shininess);
+	return radiance * (diffuse_color + specular_color);
+}
+
+void main()
+{
+	vec3 normal = normalize(v_normal);
+	vec3 view_dir = normalize(view_pos - v_world_pos);
+	vec3 diffuse_map = texture(texture1, v_texcoord).rgb;
+#ifdef HAS_SPECULAR_MAP
+	vec3 specular_map = texture(texture_specular1, v_texcoord).rgb;
+#else
+	vec3 specular_map = specular_strength;
+#endif
+
+	// find this fragment's cluster, the same exponential slicing as Light_Cluster_Grid
+	ivec3 grid = ivec3(u_cluster_grid);
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy / u_cluster_params.xy), ivec2(0), grid.xy - 1);
+	int slice = clamp(int(floor(log(-v_view_pos.z) * u_cluster_params.z - u_cluster_params.w)), 0, grid.z - 1);
+	int cluster = (slice * grid.y + tile.y) * grid.x + tile.x;
+	uvec2 range = texelFetch(u_cluster_ranges, cluster).xy;
+
+	vec3 color = ambient_color * diffuse_map;
+	vec3 sun_dir = normalize(-light_direction);
+	vec3 sun_half = normalize(view_dir + sun_dir);
+	vec3 sun = light_color * (diffuse_map * max(0.0, dot(normal, sun_dir)) + specular_map * pow(max(0.0, dot(normal, sun_half)), shininess));
+#ifdef RECEIVE_SHADOWS
+	sun *= calculate_shadow(normal, sun_dir);
+#endif
+	color += sun;
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int light = int(texelFetch(u_cluster_indices, int(range.x + i)).x);
+		color += calculate_light(light, normal, view_dir, diffuse_map, specular_map);
+	}
+	frag_color = vec4(color, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec2 a_texcoord;
+
+out vec3 v_normal;
+out vec3 v_world_pos;
+out vec3 v_view_pos;
+out vec2 v_texcoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	vec4 world_pos = model * vec4(a_position, 1.0);
+	v_normal = mat3(transpose(inverse(model))) * a_normal;
+	v_texcoord = a_texcoord;
+	v_world_pos = world_pos.xyz;
+	v_view_pos = vec3(view * world_pos);
+	gl_Position = projection * vec4(v_view_pos, 1.0);
+}
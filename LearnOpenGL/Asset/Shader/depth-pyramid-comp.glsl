@@ -0,0 +1,39 @@
+#version 430 core
+// One level of the max depth pyramid. The pyramid is a power of two no larger than the depth buffer:
+// level 0 keeps the farthest of the (up to 3x3) depth texels under each texel, later levels reduce 2x2.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D u_depth;
+uniform ivec2 u_depth_size;
+uniform int u_first_level;
+layout(r32f, binding = 0) uniform readonly image2D u_source;
+layout(r32f, binding = 1) uniform writeonly image2D u_destination;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(u_destination);
+	if (any(greaterThanEqual(texel, size)))
+		return;
+
+	float depth = 0.0;
+	if (u_first_level != 0)
+	{
+		ivec2 low = texel * u_depth_size / size;
+		ivec2 high = min(((texel + 1) * u_depth_size + size - 1) / size, u_depth_size);
+		for (int y = low.y; y < high.y; y++)
+			for (int x = low.x; x < high.x; x++)
+				depth = max(depth, texelFetch(u_depth, ivec2(x, y), 0).r);
+	}
+	else
+	{
+		// a side that already reached 1 texel is read twice
+		ivec2 last = imageSize(u_source) - 1;
+		ivec2 low = min(texel * 2, last);
+		ivec2 high = min(texel * 2 + 1, last);
+		depth = max(
+			max(imageLoad(u_source, low).r, imageLoad(u_source, ivec2(high.x, low.y)).r),
+			max(imageLoad(u_source, ivec2(low.x, high.y)).r, imageLoad(u_source, high).r));
+	}
+	imageStore(u_destination, texel, vec4(depth));
+}
@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+
+//drawn while the real program is still compiling
+void main()
+{
+    FragColor = vec4(0.5, 0.5, 0.5, 1.0);
+}
@@ -0,0 +1,115 @@
+#version 430 core
+// GPU culling, one thread per instance: frustum test, then a Hi-Z occlusion test against the max depth
+// pyramid when there is one. Survivors append a draw command and their model matrix.
+layout(local_size_x = 64) in;
+
+struct Mesh_Info
+{
+	vec4 bounds_min;
+	vec4 bounds_max;
+	uint index_count;
+	uint first_index;
+	int base_vertex;
+	uint padding;
+};
+
+struct Instance
+{
+	mat4 model;
+	uint mesh;
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+// DrawElementsIndirectCommand
+struct Draw_Command
+{
+	uint count;
+	uint instance_count;
+	uint first_index;
+	int base_vertex;
+	uint base_instance;
+};
+
+layout(std430, binding = 0) readonly buffer Meshes { Mesh_Info meshes[]; };
+layout(std430, binding = 1) readonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 2) writeonly buffer Commands { Draw_Command commands[]; };
+layout(std430, binding = 3) writeonly buffer Visible_Models { mat4 visible_models[]; };
+layout(std430, binding = 4) buffer Draw_Count { uint draw_count; };
+
+uniform uint u_instance_count;
+uniform vec4 u_frustum_planes[6];
+
+uniform int u_occlusion;
+uniform sampler2D u_depth_pyramid;
+uniform mat4 u_pyramid_view_projection;
+uniform ivec2 u_pyramid_size;
+uniform int u_pyramid_levels;
+
+bool frustum_visible(vec3 center, vec3 extents)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		vec4 plane = u_frustum_planes[i];
+		if (dot(plane.xyz, center) + plane.w + dot(abs(plane.xyz), extents) < 0.0)
+			return false;
+	}
+	return true;
+}
+
+bool occlusion_visible(vec3 center, vec3 extents)
+{
+	vec3 low = vec3(1e30), high = vec3(-1e30);
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = center + extents * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = u_pyramid_view_projection * vec4(corner, 1.0);
+		// crosses the near plane, there is no screen rectangle to test
+		if (clip.w <= 1e-5)
+			return true;
+		vec3 ndc = clip.xyz / clip.w;
+		low = min(low, ndc);
+		high = max(high, ndc);
+	}
+	vec2 low_uv = clamp(low.xy * 0.5 + 0.5, 0.0, 1.0);
+	vec2 high_uv = clamp(high.xy * 0.5 + 0.5, 0.0, 1.0);
+	float nearest = low.z * 0.5 + 0.5;
+
+	// the level where the rectangle spans at most 2x2 texels, their farthest depth bounds every occluder in it
+	vec2 extent = (high_uv - low_uv) * vec2(u_pyramid_size);
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, u_pyramid_levels - 1);
+	ivec2 size = max(u_pyramid_size >> level, ivec2(1));
+	ivec2 low_texel = min(ivec2(low_uv * vec2(size)), size - 1);
+	ivec2 high_texel = min(ivec2(high_uv * vec2(size)), size - 1);
+	float occluder = max(
+		max(texelFetch(u_depth_pyramid, low_texel, level).r, texelFetch(u_depth_pyramid, ivec2(high_texel.x, low_texel.y), level).r),
+		max(texelFetch(u_depth_pyramid, ivec2(low_texel.x, high_texel.y), level).r, texelFetch(u_depth_pyramid, high_texel, level).r));
+	return nearest <= occluder;
+}
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= u_instance_count)
+		return;
+
+	Instance instance = instances[index];
+	Mesh_Info mesh = meshes[instance.mesh];
+	vec3 center = (mesh.bounds_min.xyz + mesh.bounds_max.xyz) * 0.5;
+	vec3 extents = (mesh.bounds_max.xyz - mesh.bounds_min.xyz) * 0.5;
+
+	// world space box around the transformed model space box
+	mat3 basis = mat3(instance.model);
+	vec3 world_center = (instance.model * vec4(center, 1.0)).xyz;
+	vec3 world_extents = abs(basis[0]) * extents.x + abs(basis[1]) * extents.y + abs(basis[2]) * extents.z;
+
+	if (!frustum_visible(world_center, world_extents))
+		return;
+	if (u_occlusion != 0 && !occlusion_visible(world_center, world_extents))
+		return;
+
+	uint slot = atomicAdd(draw_count, 1u);
+	commands[slot] = Draw_Command(mesh.index_count, 1u, mesh.first_index, mesh.base_vertex, slot);
+	visible_models[slot] = instance.model;
+}
@@ -0,0 +1,115 @@
+#version 330 core
+// variants: HAS_DIFFUSE_MAP, HAS_SPECULAR_MAP, HAS_NORMAL_MAP, HAS_HEIGHT_MAP, ALPHA_TEST, RECEIVE_SHADOWS, TEXTURE_ARRAYS
+// only the maps a mesh actually has are sampled, missing ones fall back to constants
+out vec4 frag_color;
+
+in vec3 v_world_pos;
+in vec3 v_normal;
+in vec2 v_texcoord;
+#ifdef RECEIVE_SHADOWS
+in float v_view_depth;
+#endif
+#if defined(HAS_NORMAL_MAP) || defined(HAS_HEIGHT_MAP)
+in mat3 v_TBN;
+#endif
+
+// with TEXTURE_ARRAYS every map is a layer of an array shared by the whole model
+#ifdef TEXTURE_ARRAYS
+flat in uvec4 v_material_layers;
+#define MATERIAL_SAMPLER sampler2DArray
+#define SAMPLE_MATERIAL(map, slot, uv) texture(map, vec3(uv, float(v_material_layers[slot])))
+#else
+#define MATERIAL_SAMPLER sampler2D
+#define SAMPLE_MATERIAL(map, slot, uv) texture(map, uv)
+#endif
+
+#ifdef HAS_DIFFUSE_MAP
+uniform MATERIAL_SAMPLER texture_diffuse1;
+#endif
+#ifdef HAS_SPECULAR_MAP
+uniform MATERIAL_SAMPLER texture_specular1;
+#endif
+#ifdef HAS_NORMAL_MAP
+uniform MATERIAL_SAMPLER texture_normal1;
+#endif
+#ifdef HAS_HEIGHT_MAP
+uniform MATERIAL_SAMPLER texture_height1;
+uniform float height_scale = 0.02;
+#endif
+
+uniform vec3 base_color = vec3(0.8);
+uniform vec3 light_direction = vec3(-0.3, -1.0, -0.5);
+uniform vec3 light_color = vec3(1.0);
+uniform vec3 view_pos;
+uniform float shininess = 32.0;
+
+#ifdef RECEIVE_SHADOWS
+// written by Cascaded_Shadow_Map::bind
+uniform sampler2DArrayShadow u_shadow_map;
+uniform mat4 u_cascade_matrices[4];
+uniform vec4 u_cascade_splits;
+uniform int u_cascade_count;
+
+float calculate_shadow(vec3 normal, vec3 light_dir)
+{
+	int cascade = u_cascade_count - 1;
+	for (int i = u_cascade_count - 1; i >= 0; i--)
+		if (v_view_depth < u_cascade_splits[i])
+			cascade = i;
+	if (v_view_depth >= u_cascade_splits[u_cascade_count - 1])
+		return 1.0;
+
+	// push along the normal a little to keep acne off surfaces facing away from the light
+	vec3 offset_pos = v_world_pos + normal * 0.02 * (1.0 - max(dot(normal, light_dir), 0.0));
+	vec4 light_pos = u_cascade_matrices[cascade] * vec4(offset_pos, 1.0);
+	vec3 shadow_coord = light_pos.xyz / light_pos.w * 0.5 + 0.5;
+	return texture(u_shadow_map, vec4(shadow_coord.xy, float(cascade), shadow_coord.z));
+}
+#endif
+
+void main()
+{
+	vec3 view_dir = normalize(view_pos - v_world_pos);
+	vec2 texcoord = v_texcoord;
+#ifdef HAS_HEIGHT_MAP
+	// simple parallax offset along the tangent-space view direction
+	vec3 view_dir_ts = normalize(transpose(v_TBN) * view_dir);
+	float height = SAMPLE_MATERIAL(texture_height1, 3, texcoord).r;
+	texcoord -= view_dir_ts.xy / max(view_dir_ts.z, 0.1) * (height * height_scale);
+#endif
+
+#ifdef HAS_DIFFUSE_MAP
+	vec4 albedo = SAMPLE_MATERIAL(texture_diffuse1, 0, texcoord);
+#else
+	vec4 albedo = vec4(base_color, 1.0);
+#endif
+#ifdef ALPHA_TEST
+	if (albedo.a < 0.1)
+		discard;
+#endif
+
+#ifdef HAS_NORMAL_MAP
+	vec3 normal = normalize(v_TBN * (SAMPLE_MATERIAL(texture_normal1, 2, texcoord).rgb * 2.0 - 1.0));
+#else
+	vec3 normal = normalize(v_normal);
+#endif
+
+#ifdef HAS_SPECULAR_MAP
+	vec3 specular_strength = SAMPLE_MATERIAL(texture_specular1, 1, texcoord).rgb;
+#else
+	vec3 specular_strength = vec3(0.1);
+#endif
+
+	vec3 light_dir = normalize(-light_direction);
+	vec3 half_vector = normalize(view_dir + light_dir);
+	vec3 ambient_color = 0.1 * albedo.rgb;
+	vec3 diffuse_color = light_color * max(0.0, dot(normal, light_dir)) * albedo.rgb;
+	vec3 specular_color = light_color * pow(max(0.0, dot(normal, half_vector)), shininess) * specular_strength;
+#ifdef RECEIVE_SHADOWS
+	float shadow = calculate_shadow(normal, light_dir);
+	diffuse_color *= shadow;
+	specular_color *= shadow;
+#endif
+
+	frag_color = vec4(ambient_color + diffuse_color + specular_color, albedo.a);
+}
@@ -0,0 +1,49 @@
+#version 330 core
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec2 a_texcoord;
+layout(location = 3) in vec3 a_tangent;
+layout(location = 4) in vec3 a_bitangent;
+#ifdef TEXTURE_ARRAYS
+// array layer of the diffuse, specular, normal and height map
+layout(location = 7) in uvec4 a_material_layers;
+flat out uvec4 v_material_layers;
+#endif
+
+out vec3 v_world_pos;
+out vec3 v_normal;
+out vec2 v_texcoord;
+#ifdef RECEIVE_SHADOWS
+out float v_view_depth;
+#endif
+#if defined(HAS_NORMAL_MAP) || defined(HAS_HEIGHT_MAP)
+out mat3 v_TBN;
+#endif
+
+#ifdef INDIRECT_INSTANCES
+// written per visible instance by the GPU culling pass, baseInstance selects the row
+layout(location = 8) in mat4 a_model;
+#define model a_model
+#else
+uniform mat4 model;
+#endif
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+	mat3 normal_matrix = mat3(transpose(inverse(model)));
+	v_world_pos = vec3(model * vec4(a_position, 1.0));
+	v_normal = normal_matrix * a_normal;
+	v_texcoord = a_texcoord;
+#ifdef TEXTURE_ARRAYS
+	v_material_layers = a_material_layers;
+#endif
+#if defined(HAS_NORMAL_MAP) || defined(HAS_HEIGHT_MAP)
+	v_TBN = mat3(normalize(normal_matrix * a_tangent), normalize(normal_matrix * a_bitangent), normalize(v_normal));
+#endif
+#ifdef RECEIVE_SHADOWS
+	v_view_depth = -(view * vec4(v_world_pos, 1.0)).z;
+#endif
+	gl_Position = projection * view * vec4(v_world_pos, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+// one camera facing quad per instance, the corners come from gl_VertexID
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in float aSize;
+layout(location = 2) in int aColor; // RGBA8, red in the low byte
+
+out vec2 Corner;
+out vec4 Color;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    Corner = vec2(gl_VertexID & 1, (gl_VertexID >> 1) & 1) * 2.0 - 1.0;
+    Color = vec4(aColor & 255, (aColor >> 8) & 255, (aColor >> 16) & 255, (aColor >> 24) & 255) / 255.0;
+    // offset in view space, so the quad always faces the camera
+    vec4 center = view * vec4(aPos, 1.0);
+    gl_Position = projection * (center + vec4(Corner * aSize, 0.0, 0.0));
+}
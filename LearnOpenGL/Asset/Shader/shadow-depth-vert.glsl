@@ -0,0 +1,16 @@
+#version 330 core
+// depth only, fetches nothing but the position stream
+layout(location = 0) in vec3 a_position;
+
+uniform mat4 u_light_view_projection;
+#ifdef INDIRECT_INSTANCES
+layout(location = 8) in mat4 a_model;
+#define u_model a_model
+#else
+uniform mat4 u_model;
+#endif
+
+void main()
+{
+	gl_Position = u_light_view_projection * u_model * vec4(a_position, 1.0);
+}
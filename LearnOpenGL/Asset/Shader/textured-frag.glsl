@@ -0,0 +1,66 @@
+#version 330 core
+// variants: ALPHA_TEST (blending), FLAT_COLOR (stencil outline), LINEAR_DEPTH (depth visualisation), RECEIVE_SHADOWS
+out vec4 FragColor;
+
+in vec2 TexCoords;
+#ifdef RECEIVE_SHADOWS
+in vec3 WorldPos;
+in float ViewDepth;
+
+// written by Cascaded_Shadow_Map::bind
+uniform sampler2DArrayShadow u_shadow_map;
+uniform mat4 u_cascade_matrices[4];
+uniform vec4 u_cascade_splits;
+uniform int u_cascade_count;
+uniform float shadow_strength = 0.5;
+
+float CalculateShadow()
+{
+    if (ViewDepth >= u_cascade_splits[u_cascade_count - 1])
+        return 1.0;
+    int cascade = u_cascade_count - 1;
+    for (int i = u_cascade_count - 1; i >= 0; i--)
+        if (ViewDepth < u_cascade_splits[i])
+            cascade = i;
+
+    // no normals here, the slope scaled offset of the depth pass keeps the acne away
+    vec4 lightPos = u_cascade_matrices[cascade] * vec4(WorldPos, 1.0);
+    vec3 shadowCoord = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+    return texture(u_shadow_map, vec4(shadowCoord.xy, float(cascade), shadowCoord.z));
+}
+#endif
+
+#if defined(FLAT_COLOR)
+uniform vec4 flat_color = vec4(0.04, 0.28, 0.26, 1.0);
+#elif defined(LINEAR_DEPTH)
+uniform float near = 0.1;
+uniform float far = 100.0;
+
+float LinearizeDepth(float depth)
+{
+    float z = depth * 2.0 - 1.0; // back to NDC
+    return (2.0 * near * far) / (far + near - z * (far - near));
+}
+#else
+uniform sampler2D texture1;
+#endif
+
+void main()
+{
+#if defined(FLAT_COLOR)
+    FragColor = flat_color;
+#elif defined(LINEAR_DEPTH)
+    float depth = LinearizeDepth(gl_FragCoord.z) / far;
+    FragColor = vec4(vec3(depth), 1.0);
+#else
+    vec4 texColor = texture(texture1, TexCoords);
+#ifdef ALPHA_TEST
+    if (texColor.a < 0.1)
+        discard;
+#endif
+#ifdef RECEIVE_SHADOWS
+    texColor.rgb *= mix(1.0 - shadow_strength, 1.0, CalculateShadow());
+#endif
+    FragColor = texColor;
+#endif
+}
@@ -0,0 +1,24 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+#ifdef RECEIVE_SHADOWS
+out vec3 WorldPos;
+out float ViewDepth;
+#endif
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    vec4 worldPos = model * vec4(aPos, 1.0);
+#ifdef RECEIVE_SHADOWS
+    WorldPos = worldPos.xyz;
+    ViewDepth = -(view * worldPos).z;
+#endif
+    gl_Position = projection * view * worldPos;
+}
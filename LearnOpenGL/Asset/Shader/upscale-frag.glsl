@@ -0,0 +1,33 @@
+#version 330 core
+// bilinear upscale of the rendered corner of the scene target followed by a contrast adaptive sharpen:
+// the cross of neighbours one source texel away is subtracted, less where the neighbourhood already has contrast
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 texel_size;
+uniform vec2 uv_max;      // centre of the last rendered texel
+uniform float sharpness;  // 0 is plain bilinear
+
+vec3 Tap(vec2 uv)
+{
+    return texture(source, min(uv, uv_max)).rgb;
+}
+
+void main()
+{
+    vec3 center = Tap(TexCoords);
+    vec3 north = Tap(TexCoords + vec2(0.0, texel_size.y));
+    vec3 south = Tap(TexCoords - vec2(0.0, texel_size.y));
+    vec3 east = Tap(TexCoords + vec2(texel_size.x, 0.0));
+    vec3 west = Tap(TexCoords - vec2(texel_size.x, 0.0));
+
+    vec3 lowest = min(center, min(min(north, south), min(east, west)));
+    vec3 highest = max(center, max(max(north, south), max(east, west)));
+    // how far the neighbourhood is from clipping, sharpening more would overshoot
+    vec3 amount = sqrt(clamp(min(lowest, 1.0 - highest) / max(highest, vec3(1.0 / 256.0)), 0.0, 1.0));
+    vec3 weight = amount * (-sharpness / 5.0);
+    vec3 color = (center + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+    FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+// one triangle covering the screen, no vertex buffer
+out vec2 TexCoords;
+
+uniform vec2 uv_scale; // rendered part of the source texture
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = corner * uv_scale;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
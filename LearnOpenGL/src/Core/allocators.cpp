@@ -0,0 +1,165 @@
+#include "allocators.h"
+
+#include <cstdio>
+#include <cstdarg>
+#include <new>
+#include <algorithm>
+
+static const size_t s_arena_alignment = 64;
+
+static size_t align_up(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+Linear_Arena::Linear_Arena(size_t capacity)
+	:m_capacity(capacity)
+{
+	if (m_capacity)
+		m_memory = static_cast<unsigned char*>(::operator new(m_capacity, std::align_val_t(s_arena_alignment)));
+}
+
+Linear_Arena::~Linear_Arena()
+{
+	reset();
+	if (m_memory)
+		::operator delete(m_memory, std::align_val_t(s_arena_alignment));
+}
+
+Linear_Arena::Linear_Arena(Linear_Arena&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+Linear_Arena& Linear_Arena::operator=(Linear_Arena&& other) noexcept
+{
+	std::swap(m_memory, other.m_memory);
+	std::swap(m_capacity, other.m_capacity);
+	std::swap(m_used, other.m_used);
+	std::swap(m_peak, other.m_peak);
+	std::swap(m_overflow_bytes, other.m_overflow_bytes);
+	std::swap(m_overflow, other.m_overflow);
+	return *this;
+}
+
+void* Linear_Arena::allocate(size_t size, size_t alignment)
+{
+	size_t offset = align_up(m_used, alignment);
+	if (offset + size <= m_capacity)
+	{
+		m_used = offset + size;
+		m_peak = std::max(m_peak, m_used + m_overflow_bytes);
+		return m_memory + offset;
+	}
+
+	//does not fit, the header is padded so the payload keeps its alignment
+	size_t block_alignment = std::max(alignment, s_arena_alignment);
+	size_t header = align_up(sizeof(Overflow_Block), block_alignment);
+	unsigned char* block = static_cast<unsigned char*>(::operator new(header + size, std::align_val_t(block_alignment)));
+	Overflow_Block* overflow = reinterpret_cast<Overflow_Block*>(block);
+	overflow->next = m_overflow;
+	overflow->alignment = block_alignment;
+	m_overflow = overflow;
+	m_overflow_bytes += size;
+	m_peak = std::max(m_peak, m_used + m_overflow_bytes);
+	return block + header;
+}
+
+const char* Linear_Arena::format(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	va_list copy;
+	va_copy(copy, args);
+	int length = vsnprintf(nullptr, 0, format, copy);
+	va_end(copy);
+
+	char* text = allocate_array<char>(length > 0 ? length + 1 : 1);
+	if (length > 0)
+		vsnprintf(text, length + 1, format, args);
+	else
+		text[0] = 0;
+	va_end(args);
+	return text;
+}
+
+void Linear_Arena::reset()
+{
+	bool overflowed = m_overflow != nullptr;
+	while (m_overflow)
+	{
+		Overflow_Block* next = m_overflow->next;
+		::operator delete(m_overflow, std::align_val_t(m_overflow->alignment));
+		m_overflow = next;
+	}
+
+	//grow once so the same frame fits next time
+	if (overflowed && m_peak > m_capacity)
+	{
+		if (m_memory)
+			::operator delete(m_memory, std::align_val_t(s_arena_alignment));
+		m_capacity = align_up(m_peak + m_peak / 4, s_arena_alignment);
+		m_memory = static_cast<unsigned char*>(::operator new(m_capacity, std::align_val_t(s_arena_alignment)));
+	}
+	m_used = 0;
+	m_overflow_bytes = 0;
+	m_peak = 0;
+}
+
+Fixed_Pool::Fixed_Pool(size_t block_size, size_t alignment, size_t blocks_per_chunk)
+	:m_alignment(std::max(alignment, alignof(Free_Block))), m_blocks_per_chunk(blocks_per_chunk)
+{
+	m_block_size = align_up(std::max(block_size, sizeof(Free_Block)), m_alignment);
+}
+
+Fixed_Pool::~Fixed_Pool()
+{
+	for (void* chunk : m_chunks)
+		::operator delete(chunk, std::align_val_t(m_alignment));
+}
+
+void Fixed_Pool::grow()
+{
+	unsigned char* chunk = static_cast<unsigned char*>(::operator new(m_block_size * m_blocks_per_chunk, std::align_val_t(m_alignment)));
+	m_chunks.push_back(chunk);
+	for (size_t i = m_blocks_per_chunk; i > 0; i--)
+	{
+		Free_Block* block = reinterpret_cast<Free_Block*>(chunk + (i - 1) * m_block_size);
+		block->next = m_free;
+		m_free = block;
+	}
+}
+
+void* Fixed_Pool::allocate()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_free)
+		grow();
+	Free_Block* block = m_free;
+	m_free = block->next;
+	m_live++;
+	return block;
+}
+
+void Fixed_Pool::deallocate(void* block)
+{
+	if (!block)
+		return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Free_Block* free_block = static_cast<Free_Block*>(block);
+	free_block->next = m_free;
+	m_free = free_block;
+	m_live--;
+}
+
+size_t Fixed_Pool::get_live_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_live;
+}
+
+size_t Fixed_Pool::get_capacity() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_chunks.size() * m_blocks_per_chunk;
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+//Bump allocator for data that lives for one frame. allocate() is a pointer increment, nothing is freed
+//individually and reset() makes the whole block reusable. Requests that do not fit go to separate heap
+//blocks until the next reset(), which then grows the main block so steady-state frames stay allocation free.
+class Linear_Arena
+{
+public:
+	explicit Linear_Arena(size_t capacity = 64 * 1024);
+	~Linear_Arena();
+	Linear_Arena(Linear_Arena&& other) noexcept;
+	Linear_Arena& operator=(Linear_Arena&& other) noexcept;
+	Linear_Arena(const Linear_Arena&) = delete;
+	Linear_Arena& operator=(const Linear_Arena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	template<typename T>
+	T* allocate_array(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+	//printf into the arena, valid until reset()
+	const char* format(const char* format, ...);
+	void reset();
+
+	size_t get_capacity() const { return m_capacity; }
+	size_t get_used() const { return m_used; }
+	//largest used + overflow seen between two resets
+	size_t get_peak() const { return m_peak; }
+	size_t get_overflow_bytes() const { return m_overflow_bytes; }
+
+private:
+	struct Overflow_Block
+	{
+		Overflow_Block* next;
+		size_t alignment;
+	};
+
+	unsigned char* m_memory = nullptr;
+	size_t m_capacity = 0;
+	size_t m_used = 0;
+	size_t m_peak = 0;
+	size_t m_overflow_bytes = 0;
+	Overflow_Block* m_overflow = nullptr;
+};
+
+template<typename T>
+class Arena_Allocator
+{
+public:
+	typedef T value_type;
+
+	Arena_Allocator(Linear_Arena* arena = nullptr) noexcept : m_arena(arena) {}
+	template<typename U>
+	Arena_Allocator(const Arena_Allocator<U>& other) noexcept : m_arena(other.get_arena()) {}
+
+	T* allocate(size_t count) { return m_arena->allocate_array<T>(count); }
+	void deallocate(T*, size_t) noexcept {}
+
+	Linear_Arena* get_arena() const { return m_arena; }
+
+	template<typename U>
+	bool operator==(const Arena_Allocator<U>& other) const { return m_arena == other.get_arena(); }
+	template<typename U>
+	bool operator!=(const Arena_Allocator<U>& other) const { return m_arena != other.get_arena(); }
+
+private:
+	Linear_Arena* m_arena;
+};
+
+template<typename T>
+using Arena_Vector = std::vector<T, Arena_Allocator<T>>;
+
+//Free list of equally sized blocks carved out of chunks that are never returned to the heap.
+//Thread safe, renderer objects may be released from any thread.
+class Fixed_Pool
+{
+public:
+	Fixed_Pool(size_t block_size, size_t alignment, size_t blocks_per_chunk = 64);
+	~Fixed_Pool();
+	Fixed_Pool(const Fixed_Pool&) = delete;
+	Fixed_Pool& operator=(const Fixed_Pool&) = delete;
+
+	void* allocate();
+	void deallocate(void* block);
+
+	size_t get_block_size() const { return m_block_size; }
+	size_t get_live_count() const;
+	size_t get_capacity() const;
+
+	//one pool per size and alignment, shared by every Pool_Allocator that needs it
+	template<size_t Size, size_t Alignment>
+	static Fixed_Pool& get_shared()
+	{
+		static Fixed_Pool pool(Size, Alignment);
+		return pool;
+	}
+
+private:
+	struct Free_Block
+	{
+		Free_Block* next;
+	};
+
+	void grow();
+
+	size_t m_block_size;
+	size_t m_alignment;
+	size_t m_blocks_per_chunk;
+	Free_Block* m_free = nullptr;
+	std::vector<void*> m_chunks;
+	size_t m_live = 0;
+	mutable std::mutex m_mutex;
+};
+
+//STL allocator over the shared pool for T. Single objects come from the pool, arrays from the heap.
+template<typename T>
+class Pool_Allocator
+{
+public:
+	typedef T value_type;
+
+	Pool_Allocator() noexcept {}
+	template<typename U>
+	Pool_Allocator(const Pool_Allocator<U>&) noexcept {}
+
+	T* allocate(size_t count)
+	{
+		if (count == 1)
+			return static_cast<T*>(get_pool().allocate());
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignof(T))));
+	}
+
+	void deallocate(T* pointer, size_t count) noexcept
+	{
+		if (count == 1)
+			get_pool().deallocate(pointer);
+		else
+			::operator delete(pointer, std::align_val_t(alignof(T)));
+	}
+
+	static Fixed_Pool& get_pool() { return Fixed_Pool::get_shared<sizeof(T), alignof(T)>(); }
+
+	template<typename U>
+	bool operator==(const Pool_Allocator<U>&) const { return true; }
+	template<typename U>
+	bool operator!=(const Pool_Allocator<U>&) const { return false; }
+};
+
+//shared_ptr with the object and its control block in a single pooled block
+template<typename T, typename... Args>
+std::shared_ptr<T> make_pooled(Args&&... args)
+{
+	return std::allocate_shared<T>(Pool_Allocator<T>(), std::forward<Args>(args)...);
+}
@@ -0,0 +1,503 @@
+#include "file-system.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <unordered_map>
+#include <filesystem>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define FILE_SYSTEM_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+static bool s_initialized = false;
+static File_System_Stats s_stats;
+
+//reads in flight by path, for deduplication, guarded by s_mutex
+static std::mutex s_mutex;
+static std::unordered_map<std::string, std::weak_ptr<File_Read>> s_in_flight;
+
+//File_Read::wait() sleeps here
+static std::mutex s_done_mutex;
+static std::condition_variable s_done_cv;
+
+//thread pool fallback
+static std::vector<std::thread> s_readers;
+static std::deque<File_Handle> s_reader_queue;
+static std::condition_variable s_reader_cv;
+static bool s_reader_exit = false;
+
+void File_Read::wait() const
+{
+	if (is_done())
+		return;
+	std::unique_lock<std::mutex> lock(s_done_mutex);
+	s_done_cv.wait(lock, [this] { return is_done(); });
+}
+
+bool File_System::read_blocking(File_Read& read)
+{
+	bool success = false;
+	FILE* file = fopen(read.m_path.c_str(), "rb");
+	if (file)
+	{
+		if (fseek(file, 0, SEEK_END) == 0)
+		{
+			long size = ftell(file);
+			if (size >= 0 && fseek(file, 0, SEEK_SET) == 0)
+			{
+				read.m_data.resize((size_t)size);
+				success = fread(read.m_data.data(), 1, (size_t)size, file) == (size_t)size;
+			}
+		}
+		fclose(file);
+	}
+	return success;
+}
+
+void File_System::complete(const File_Handle& read, bool success)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		auto it = s_in_flight.find(read->m_path);
+		if (it != s_in_flight.end() && it->second.lock() == read)
+			s_in_flight.erase(it);
+		if (success)
+			s_stats.bytes_read += read->m_data.size();
+		else
+		{
+			s_stats.failed++;
+			std::cout << "Could not read file " << read->m_path << std::endl;
+		}
+	}
+	if (!success)
+		read->m_data.clear();
+	{
+		std::lock_guard<std::mutex> lock(s_done_mutex);
+		read->m_status.store(success ? File_Status::Ready : File_Status::Failed, std::memory_order_release);
+	}
+	s_done_cv.notify_all();
+}
+
+void File_System::reader_loop()
+{
+	while (true)
+	{
+		File_Handle read;
+		{
+			std::unique_lock<std::mutex> lock(s_mutex);
+			s_reader_cv.wait(lock, [] { return s_reader_exit || !s_reader_queue.empty(); });
+			if (s_reader_queue.empty())
+				return;
+			read = std::move(s_reader_queue.front());
+			s_reader_queue.pop_front();
+		}
+		complete(read, read_blocking(*read));
+	}
+}
+
+#ifdef FILE_SYSTEM_IO_URING
+//Raw io_uring, no liburing: the submission and completion rings are mapped once and driven with
+//io_uring_enter. One completion thread reaps results and refills the ring from the backlog.
+struct Uring_Backend
+{
+	int fd = -1;
+	void* sq_ring = nullptr;
+	size_t sq_ring_size = 0;
+	void* cq_ring = nullptr;
+	size_t cq_ring_size = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqes_size = 0;
+
+	unsigned* sq_tail = nullptr;
+	unsigned* sq_mask = nullptr;
+	unsigned* sq_array = nullptr;
+	unsigned sq_entries = 0;
+	unsigned* cq_head = nullptr;
+	unsigned* cq_tail = nullptr;
+	unsigned* cq_mask = nullptr;
+	io_uring_cqe* cqes = nullptr;
+
+	//guards everything below and the sq ring
+	std::mutex mutex;
+	std::thread completion_thread;
+	unsigned in_ring = 0;
+	std::deque<File_Handle> backlog;
+	std::unordered_map<File_Read*, File_Handle> submitted;
+
+	typedef std::vector<std::pair<File_Handle, bool>> Finished_Reads;
+
+	bool setup(unsigned entries)
+	{
+		io_uring_params params = {};
+		int ring_fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+		if (ring_fd < 0)
+			return false;
+
+		sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		void* sqe_memory = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+		if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqe_memory == MAP_FAILED)
+		{
+			if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+			if (cq_ring != MAP_FAILED) munmap(cq_ring, cq_ring_size);
+			if (sqe_memory != MAP_FAILED) munmap(sqe_memory, sqes_size);
+			close(ring_fd);
+			return false;
+		}
+
+		unsigned char* sq = static_cast<unsigned char*>(sq_ring);
+		unsigned char* cq = static_cast<unsigned char*>(cq_ring);
+		sqes = static_cast<io_uring_sqe*>(sqe_memory);
+		sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		sq_entries = params.sq_entries;
+		cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		fd = ring_fd;
+		return true;
+	}
+
+	void destroy()
+	{
+		munmap(sqes, sqes_size);
+		munmap(sq_ring, sq_ring_size);
+		munmap(cq_ring, cq_ring_size);
+		close(fd);
+		fd = -1;
+	}
+
+	//caller holds the mutex. Reads are capped at sq_entries in flight so the completion ring,
+	//which is twice as large, never overflows
+	bool queue(uint8_t opcode, int file, void* buffer, unsigned length, uint64_t offset, uint64_t user_data)
+	{
+		if (opcode != IORING_OP_NOP && in_ring >= sq_entries)
+			return false;
+		unsigned tail = *sq_tail;
+		unsigned index = tail & *sq_mask;
+		io_uring_sqe& sqe = sqes[index];
+		sqe = io_uring_sqe();
+		sqe.opcode = opcode;
+		sqe.fd = file;
+		sqe.addr = (uint64_t)(uintptr_t)buffer;
+		sqe.len = length;
+		sqe.off = offset;
+		sqe.user_data = user_data;
+		sq_array[index] = index;
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+		in_ring++;
+		return true;
+	}
+
+	void enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+	{
+		while (syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0) < 0 && errno == EINTR)
+			;
+	}
+
+	//caller holds the mutex. Opens and sizes the file on its first pass, then queues a read of the rest
+	bool start(const File_Handle& read, Finished_Reads& finished)
+	{
+		if (read->m_descriptor < 0)
+		{
+			read->m_descriptor = open(read->m_path.c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat info;
+			if (read->m_descriptor < 0 || fstat(read->m_descriptor, &info) != 0)
+			{
+				finished.push_back({ read, false });
+				return true;
+			}
+			read->m_data.resize((size_t)info.st_size);
+			read->m_offset = 0;
+			if (info.st_size == 0)
+			{
+				finished.push_back({ read, true });
+				return true;
+			}
+		}
+		//the kernel caps single reads anyway, the rest comes back as a short read
+		size_t length = std::min<size_t>(read->m_data.size() - read->m_offset, 1u << 30);
+		if (!queue(IORING_OP_READ, read->m_descriptor, read->m_data.data() + read->m_offset, (unsigned)length, read->m_offset, (uint64_t)(uintptr_t)read.get()))
+			return false;
+		submitted[read.get()] = read;
+		return true;
+	}
+
+	//caller holds the mutex, returns the number of reads queued
+	unsigned pump(Finished_Reads& finished)
+	{
+		unsigned before = in_ring;
+		while (!backlog.empty() && start(backlog.front(), finished))
+			backlog.pop_front();
+		return in_ring - before;
+	}
+
+	void finish(Finished_Reads& finished)
+	{
+		for (auto& result : finished)
+		{
+			File_Read& read = *result.first;
+			if (read.m_descriptor >= 0)
+			{
+				close(read.m_descriptor);
+				read.m_descriptor = -1;
+			}
+			File_System::complete(result.first, result.second);
+		}
+		finished.clear();
+	}
+
+	void submit(const std::vector<File_Handle>& reads)
+	{
+		Finished_Reads finished;
+		unsigned queued;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			backlog.insert(backlog.end(), reads.begin(), reads.end());
+			queued = pump(finished);
+		}
+		//one syscall for the whole batch
+		if (queued)
+			enter(queued, 0, 0);
+		finish(finished);
+	}
+
+	void completion_loop()
+	{
+		Finished_Reads finished;
+		bool stopping = false;
+		while (true)
+		{
+			enter(0, 1, IORING_ENTER_GETEVENTS);
+
+			unsigned queued;
+			bool drained;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				unsigned head = *cq_head;
+				while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+				{
+					io_uring_cqe cqe = cqes[head & *cq_mask];
+					head++;
+					in_ring--;
+					//user_data 0 is the nop queued by stop()
+					if (cqe.user_data == 0)
+					{
+						stopping = true;
+						continue;
+					}
+
+					auto it = submitted.find((File_Read*)(uintptr_t)cqe.user_data);
+					File_Handle read = std::move(it->second);
+					submitted.erase(it);
+					if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP)
+					{
+						//kernel without IORING_OP_READ, read this one the slow way
+						finished.push_back({ read, File_System::read_blocking(*read) });
+						continue;
+					}
+					if (cqe.res <= 0)
+					{
+						finished.push_back({ read, false });
+						continue;
+					}
+					read->m_offset += (size_t)cqe.res;
+					if (read->m_offset < read->m_data.size())
+						backlog.push_front(read);
+					else
+						finished.push_back({ read, true });
+				}
+				__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+				queued = pump(finished);
+				drained = submitted.empty() && backlog.empty();
+			}
+			if (queued)
+				enter(queued, 0, 0);
+			finish(finished);
+
+			//reads still in flight at shutdown are completed first
+			if (stopping && drained)
+				return;
+		}
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue(IORING_OP_NOP, -1, nullptr, 0, 0, 0);
+		}
+		enter(1, 0, 0);
+		completion_thread.join();
+		destroy();
+	}
+};
+static Uring_Backend s_uring;
+#endif
+
+void File_System::init(uint32_t fallback_threads)
+{
+	if (s_initialized)
+		return;
+	s_initialized = true;
+
+#ifdef FILE_SYSTEM_IO_URING
+	if (s_uring.setup(64))
+	{
+		s_uring.completion_thread = std::thread(&Uring_Backend::completion_loop, &s_uring);
+		return;
+	}
+	std::cout << "io_uring not available, file reads use a thread pool" << std::endl;
+#endif
+
+	s_reader_exit = false;
+	for (uint32_t i = 0; i < std::max(fallback_threads, 1u); i++)
+		s_readers.emplace_back(reader_loop);
+}
+
+void File_System::shutdown()
+{
+	if (!s_initialized)
+		return;
+
+#ifdef FILE_SYSTEM_IO_URING
+	if (s_uring.fd >= 0)
+		s_uring.stop();
+#endif
+
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_reader_exit = true;
+	}
+	s_reader_cv.notify_all();
+	for (std::thread& reader : s_readers)
+		reader.join();
+	s_readers.clear();
+	s_initialized = false;
+}
+
+bool File_System::is_using_io_uring()
+{
+#ifdef FILE_SYSTEM_IO_URING
+	return s_uring.fd >= 0;
+#else
+	return false;
+#endif
+}
+
+File_Handle File_System::request(const std::string& path, bool& created)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_stats.requests++;
+	auto it = s_in_flight.find(path);
+	if (it != s_in_flight.end())
+	{
+		if (File_Handle existing = it->second.lock())
+		{
+			s_stats.deduplicated++;
+			created = false;
+			return existing;
+		}
+	}
+	File_Handle read = std::make_shared<File_Read>(path);
+	s_in_flight[path] = read;
+	created = true;
+	return read;
+}
+
+void File_System::submit(const std::vector<File_Handle>& reads)
+{
+	if (reads.empty())
+		return;
+
+	if (!s_initialized)
+	{
+		for (const File_Handle& read : reads)
+			complete(read, read_blocking(*read));
+		return;
+	}
+
+#ifdef FILE_SYSTEM_IO_URING
+	if (s_uring.fd >= 0)
+	{
+		s_uring.submit(reads);
+		return;
+	}
+#endif
+
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for (const File_Handle& read : reads)
+			s_reader_queue.push_back(read);
+	}
+	s_reader_cv.notify_all();
+}
+
+File_Handle File_System::read_async(const std::string& path)
+{
+	bool created;
+	File_Handle read = request(path, created);
+	if (created)
+		submit({ read });
+	return read;
+}
+
+std::vector<File_Handle> File_System::read_batch(const std::vector<std::string>& paths)
+{
+	std::vector<File_Handle> reads;
+	std::vector<File_Handle> created_reads;
+	reads.reserve(paths.size());
+	for (const std::string& path : paths)
+	{
+		bool created;
+		reads.push_back(request(path, created));
+		if (created)
+			created_reads.push_back(reads.back());
+	}
+	submit(created_reads);
+	return reads;
+}
+
+File_Handle File_System::read(const std::string& path)
+{
+	File_Handle read = read_async(path);
+	read->wait();
+	return read;
+}
+
+std::string File_System::read_text(const std::string& path)
+{
+	File_Handle read = File_System::read(path);
+	if (!read->is_ready())
+		return std::string();
+	return std::string(read->get_text(), read->get_size());
+}
+
+bool File_System::exists(const std::string& path)
+{
+	std::error_code error;
+	return std::filesystem::is_regular_file(path, error);
+}
+
+File_System_Stats File_System::get_stats()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return s_stats;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+enum class File_Status { Pending, Ready, Failed };
+
+//One whole-file read. Shared between every caller that asked for the same path while it was in flight.
+class File_Read
+{
+public:
+	explicit File_Read(const std::string& path) : m_path(path) {}
+
+	const std::string& get_path() const { return m_path; }
+	File_Status get_status() const { return m_status.load(std::memory_order_acquire); }
+	bool is_done() const { return get_status() != File_Status::Pending; }
+	bool is_ready() const { return get_status() == File_Status::Ready; }
+	//blocks until the read completed or failed
+	void wait() const;
+
+	//only valid once ready
+	const std::vector<unsigned char>& get_data() const { return m_data; }
+	const char* get_text() const { return reinterpret_cast<const char*>(m_data.data()); }
+	size_t get_size() const { return m_data.size(); }
+
+private:
+	friend class File_System;
+	friend struct Uring_Backend;
+
+	std::string m_path;
+	std::vector<unsigned char> m_data;
+	std::atomic<File_Status> m_status{ File_Status::Pending };
+	//io_uring bookkeeping
+	int m_descriptor = -1;
+	size_t m_offset = 0;
+};
+
+typedef std::shared_ptr<File_Read> File_Handle;
+
+struct File_System_Stats
+{
+	uint64_t requests = 0;
+	uint64_t deduplicated = 0;		//requests answered by a read already in flight
+	uint64_t bytes_read = 0;
+	uint64_t failed = 0;
+};
+
+//Asynchronous whole-file reads for assets. On Linux the reads go through io_uring, a batch is a single
+//submission; elsewhere, or when the kernel refuses io_uring, a small pool of blocking reader threads is
+//used. Reads of a path that is already in flight share the same File_Read.
+//Before init() every read completes synchronously on the caller.
+class File_System
+{
+public:
+	static void init(uint32_t fallback_threads = 2);
+	static void shutdown();
+
+	static File_Handle read_async(const std::string& path);
+	//queues all of them before waiting on any, so the device sees the whole batch at once
+	static std::vector<File_Handle> read_batch(const std::vector<std::string>& paths);
+	//read_async + wait
+	static File_Handle read(const std::string& path);
+	//contents as a string, empty when the read failed
+	static std::string read_text(const std::string& path);
+
+	static bool exists(const std::string& path);
+	static bool is_using_io_uring();
+	static File_System_Stats get_stats();
+
+private:
+	friend struct Uring_Backend;
+
+	static File_Handle request(const std::string& path, bool& created);
+	static void submit(const std::vector<File_Handle>& reads);
+	static void complete(const File_Handle& read, bool success);
+	static bool read_blocking(File_Read& read);
+	static void reader_loop();
+};
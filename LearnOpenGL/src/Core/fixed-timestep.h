@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+
+//Accumulator for a fixed simulation rate decoupled from the frame rate. Each frame advance() returns how
+//many steps of get_step() seconds to simulate, get_alpha() is how far the frame sits between the last
+//two simulated states and is used to interpolate them for rendering.
+class Fixed_Timestep
+{
+public:
+	//after a hitch at most max_steps are simulated, the rest of the time is dropped instead of spiralling
+	Fixed_Timestep(double step = 1.0 / 120.0, uint32_t max_steps = 8)
+		:m_step(step), m_max_steps(max_steps) {}
+
+	uint32_t advance(double now)
+	{
+		if (m_last_time < 0.0)
+			m_last_time = now;
+		m_accumulator += now - m_last_time;
+		m_last_time = now;
+
+		uint32_t steps = (uint32_t)(m_accumulator / m_step);
+		if (steps > m_max_steps)
+		{
+			steps = m_max_steps;
+			m_accumulator = 0.0;
+		}
+		else
+			m_accumulator -= steps * m_step;
+		return steps;
+	}
+
+	double get_step() const { return m_step; }
+	float get_alpha() const { return (float)std::min(m_accumulator / m_step, 1.0); }
+
+private:
+	double m_step;
+	uint32_t m_max_steps;
+	double m_accumulator = 0.0;
+	double m_last_time = -1.0;
+};
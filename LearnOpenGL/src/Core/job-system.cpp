@@ -0,0 +1,356 @@
+#include "job-system.h"
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+
+//Chase-Lev work-stealing deque with the C11 orderings from Le et al., "Correct and Efficient
+//Work-Stealing for Weak Memory Models". Fixed capacity, push fails when full and the caller runs inline.
+class Job_Deque
+{
+public:
+	static const int64_t capacity = Job_System::JOB_POOL_SIZE;
+
+	bool push(Job* job)
+	{
+		int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		int64_t top = m_top.load(std::memory_order_acquire);
+		if (bottom - top >= capacity)
+			return false;
+		m_jobs[bottom & (capacity - 1)].store(job, std::memory_order_relaxed);
+		//publishes the slot to thieves, same as the paper's release fence
+		m_bottom.store(bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	//owner only
+	Job* pop()
+	{
+		int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+		if (top > bottom)
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		Job* job = m_jobs[bottom & (capacity - 1)].load(std::memory_order_relaxed);
+		if (top == bottom)
+		{
+			//last job, race the thieves for it
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	//any thread
+	Job* steal()
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+			return nullptr;
+		Job* job = m_jobs[top & (capacity - 1)].load(std::memory_order_relaxed);
+		//lost to the owner or another thief
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return job;
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> m_top{ 0 };
+	alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+	std::atomic<Job*> m_jobs[capacity];
+};
+
+struct alignas(64) Job_Thread
+{
+	Job_Deque deque;
+	uint32_t random = 0;
+	//written by the owner only, read for get_stats()
+	std::atomic<uint64_t> executed{ 0 };
+	std::atomic<uint64_t> steals{ 0 };
+	std::atomic<uint64_t> failed_steals{ 0 };
+	std::atomic<uint64_t> idle_ns{ 0 };
+};
+
+static std::vector<std::unique_ptr<Job_Thread>> s_threads;
+static std::vector<std::thread> s_workers;
+static std::atomic<bool> s_exit{ false };
+//jobs pushed and not yet picked up, sleeping workers only wake for these
+static std::atomic<int32_t> s_queued{ 0 };
+static std::atomic<int32_t> s_sleeping{ 0 };
+static std::mutex s_sleep_mutex;
+static std::condition_variable s_wake;
+
+static thread_local int32_t t_thread_index = -1;
+static thread_local std::unique_ptr<Job[]> t_pool;
+static thread_local uint32_t t_pool_index = 0;
+
+static uint64_t now_ns()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void execute(Job* job);
+
+static void schedule(Job* job)
+{
+	if (t_thread_index < 0 || !s_threads[t_thread_index]->deque.push(job))
+	{
+		execute(job);
+		return;
+	}
+	s_queued.fetch_add(1);
+	if (s_sleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(s_sleep_mutex);
+		s_wake.notify_one();
+	}
+}
+
+//own deque first, then a few random victims
+static Job* find_job(int32_t index)
+{
+	Job_Thread& self = *s_threads[index];
+	Job* job = self.deque.pop();
+	if (!job)
+	{
+		uint32_t count = (uint32_t)s_threads.size();
+		for (uint32_t attempt = 0; attempt < count && !job; attempt++)
+		{
+			//xorshift, cheap and per thread
+			self.random ^= self.random << 13;
+			self.random ^= self.random >> 17;
+			self.random ^= self.random << 5;
+			uint32_t victim = self.random % count;
+			if (victim == (uint32_t)index)
+				continue;
+			job = s_threads[victim]->deque.steal();
+			if (job)
+				self.steals.fetch_add(1, std::memory_order_relaxed);
+			else
+				self.failed_steals.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	if (job)
+		s_queued.fetch_sub(1);
+	return job;
+}
+
+static void execute(Job* job)
+{
+	job->function(*job);
+	if (t_thread_index >= 0)
+		s_threads[t_thread_index]->executed.fetch_add(1, std::memory_order_relaxed);
+
+	//successors are released before the counter so a waiter never sees done with work still unscheduled
+	for (uint32_t i = 0; i < job->successor_count; i++)
+	{
+		Job* successor = job->successors[i];
+		if (successor->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			schedule(successor);
+	}
+	if (job->counter)
+		job->counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static void worker_main(int32_t index)
+{
+	t_thread_index = index;
+	Job_Thread& self = *s_threads[index];
+	while (!s_exit.load(std::memory_order_relaxed))
+	{
+		Job* job = find_job(index);
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+
+		uint64_t idle_start = now_ns();
+		//spin briefly before sleeping, new work usually arrives in bursts
+		for (uint32_t spin = 0; spin < 64 && s_queued.load() <= 0 && !s_exit.load(std::memory_order_relaxed); spin++)
+			std::this_thread::yield();
+		if (s_queued.load() <= 0)
+		{
+			std::unique_lock<std::mutex> lock(s_sleep_mutex);
+			s_sleeping.fetch_add(1);
+			s_wake.wait(lock, [] { return s_queued.load() > 0 || s_exit.load(); });
+			s_sleeping.fetch_sub(1);
+		}
+		self.idle_ns.fetch_add(now_ns() - idle_start, std::memory_order_relaxed);
+	}
+}
+
+void Job_System::init(uint32_t worker_count)
+{
+	if (!s_threads.empty())
+		return;
+	if (worker_count == 0)
+	{
+		uint32_t hardware = std::thread::hardware_concurrency();
+		worker_count = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	s_exit = false;
+	for (uint32_t i = 0; i <= worker_count; i++)
+	{
+		s_threads.push_back(std::make_unique<Job_Thread>());
+		s_threads.back()->random = 0x9E3779B9u * (i + 1);
+	}
+	t_thread_index = 0;
+	for (uint32_t i = 1; i <= worker_count; i++)
+		s_workers.emplace_back(worker_main, (int32_t)i);
+}
+
+void Job_System::shutdown()
+{
+	if (s_threads.empty())
+		return;
+	if (t_thread_index != 0)
+	{
+		std::cout << "Job_System::shutdown must be called from the thread that called init" << std::endl;
+		return;
+	}
+
+	//whatever is still queued runs before the workers leave
+	while (s_queued.load() > 0)
+	{
+		if (Job* job = find_job(0))
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+	{
+		std::lock_guard<std::mutex> lock(s_sleep_mutex);
+		s_exit = true;
+	}
+	s_wake.notify_all();
+	for (std::thread& worker : s_workers)
+		worker.join();
+	s_workers.clear();
+	s_threads.clear();
+	s_queued = 0;
+	t_thread_index = -1;
+}
+
+bool Job_System::is_initialized()
+{
+	return !s_threads.empty();
+}
+
+uint32_t Job_System::get_thread_count()
+{
+	return s_threads.empty() ? 1 : (uint32_t)s_threads.size();
+}
+
+int32_t Job_System::get_thread_index()
+{
+	return t_thread_index;
+}
+
+Job* Job_System::allocate()
+{
+	if (!t_pool)
+		t_pool.reset(new Job[JOB_POOL_SIZE]);
+	Job* job = &t_pool[t_pool_index];
+	t_pool_index = (t_pool_index + 1) & (JOB_POOL_SIZE - 1);
+	return job;
+}
+
+//empty job standing in for the last successor of a full list
+struct Job_Relay
+{
+	void operator()() const {}
+};
+
+void Job_System::add_dependency(Job* job, Job* dependency)
+{
+	//a full list hands its last successor to a relay that runs after dependency and starts it, and the
+	//successors that do not fit go onto the relay, or the relay's relay
+	while (dependency->successor_count >= MAX_JOB_SUCCESSORS)
+	{
+		Job*& last = dependency->successors[MAX_JOB_SUCCESSORS - 1];
+		if (last->function != &invoke<Job_Relay>)
+		{
+			//last keeps its one pending count, it now waits on the relay instead
+			Job* relay = create(Job_Relay());
+			relay->successors[relay->successor_count++] = last;
+			relay->pending_dependencies.fetch_add(1, std::memory_order_relaxed);
+			submit(relay);
+			last = relay;
+		}
+		dependency = last;
+	}
+	dependency->successors[dependency->successor_count++] = job;
+	job->pending_dependencies.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Job_System::submit(Job* job)
+{
+	//drops the submit reference, the last dependency to finish schedules it otherwise
+	if (job->pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		schedule(job);
+}
+
+void Job_System::wait(const Job_Counter& counter)
+{
+	int32_t index = t_thread_index;
+	uint64_t idle_start = 0;
+	while (!counter.is_done())
+	{
+		Job* job = index >= 0 ? find_job(index) : nullptr;
+		if (job)
+		{
+			if (idle_start)
+			{
+				s_threads[index]->idle_ns.fetch_add(now_ns() - idle_start, std::memory_order_relaxed);
+				idle_start = 0;
+			}
+			execute(job);
+		}
+		else
+		{
+			//the rest is running on other threads
+			if (index >= 0 && !idle_start)
+				idle_start = now_ns();
+			std::this_thread::yield();
+		}
+	}
+	if (idle_start)
+		s_threads[index]->idle_ns.fetch_add(now_ns() - idle_start, std::memory_order_relaxed);
+}
+
+Job_Stats Job_System::get_stats()
+{
+	Job_Stats stats;
+	for (const std::unique_ptr<Job_Thread>& thread : s_threads)
+	{
+		Job_Thread_Stats entry;
+		entry.executed = thread->executed.load(std::memory_order_relaxed);
+		entry.steals = thread->steals.load(std::memory_order_relaxed);
+		entry.failed_steals = thread->failed_steals.load(std::memory_order_relaxed);
+		entry.idle_ms = thread->idle_ns.load(std::memory_order_relaxed) / 1e6;
+		stats.threads.push_back(entry);
+	}
+	return stats;
+}
+
+void Job_System::reset_stats()
+{
+	for (const std::unique_ptr<Job_Thread>& thread : s_threads)
+	{
+		thread->executed = 0;
+		thread->steals = 0;
+		thread->failed_steals = 0;
+		thread->idle_ns = 0;
+	}
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+
+//number of jobs still to finish, wait() returns once it drops to zero
+struct Job_Counter
+{
+	std::atomic<int32_t> pending{ 0 };
+
+	bool is_done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+static const uint32_t MAX_JOB_SUCCESSORS = 6;
+static const uint32_t JOB_PAYLOAD_SIZE = 64;
+
+struct alignas(64) Job
+{
+	void (*function)(Job& job) = nullptr;
+	Job_Counter* counter = nullptr;
+	//1 for submit() plus one per unfinished dependency, runnable at zero
+	std::atomic<int32_t> pending_dependencies{ 0 };
+	uint32_t successor_count = 0;
+	Job* successors[MAX_JOB_SUCCESSORS];
+	alignas(16) unsigned char payload[JOB_PAYLOAD_SIZE];
+};
+
+struct Job_Thread_Stats
+{
+	uint64_t executed = 0;
+	uint64_t steals = 0;			//jobs taken from another thread's deque
+	uint64_t failed_steals = 0;		//victim empty or lost the race
+	double idle_ms = 0.0;			//spinning or sleeping without work
+};
+
+struct Job_Stats
+{
+	std::vector<Job_Thread_Stats> threads;	//index 0 is the thread that called init()
+
+	Job_Thread_Stats total() const
+	{
+		Job_Thread_Stats sum;
+		for (const Job_Thread_Stats& thread : threads)
+		{
+			sum.executed += thread.executed;
+			sum.steals += thread.steals;
+			sum.failed_steals += thread.failed_steals;
+			sum.idle_ms += thread.idle_ms;
+		}
+		return sum;
+	}
+};
+
+//Work-stealing job scheduler. Every thread owns a Chase-Lev deque: it pushes and pops at the bottom
+//without locks, idle threads steal from the top of a random victim. The thread that calls init() takes
+//part as thread 0, so it can submit jobs and help run them in wait().
+//Jobs come from a per-thread ring of JOB_POOL_SIZE slots and are never freed, a slot is reused once the
+//ring wraps, so a thread must not have more than that many jobs alive at once.
+//Jobs are queued only from the init() thread or a worker. Before init(), or from any other thread,
+//everything runs inline on the caller so GL-free systems stay usable headless. shutdown() must run
+//before exit, workers parked on the wake condition would otherwise block static destruction.
+class Job_System
+{
+public:
+	static const uint32_t JOB_POOL_SIZE = 4096;
+
+	//worker_count 0 uses every hardware thread besides the caller
+	static void init(uint32_t worker_count = 0);
+	static void shutdown();
+
+	static bool is_initialized();
+	//workers plus the init() thread, 1 when not initialized
+	static uint32_t get_thread_count();
+	//0 for the init() thread, 1..n for workers, -1 for any other thread
+	static int32_t get_thread_index();
+
+	//a job that will not run before submit(), counter is incremented now and decremented when it finishes
+	template<typename Function>
+	static Job* create(Function&& function, Job_Counter* counter = nullptr);
+	//job waits for dependency to finish; wire the graph before submitting either of them. Past
+	//MAX_JOB_SUCCESSORS the extra successors hang off relay jobs, each taking a pool slot
+	static void add_dependency(Job* job, Job* dependency);
+	static void submit(Job* job);
+
+	template<typename Function>
+	static void run(Function&& function, Job_Counter& counter) { submit(create(std::forward<Function>(function), &counter)); }
+
+	//runs other jobs while the counter is not zero instead of blocking
+	static void wait(const Job_Counter& counter);
+
+	//function(i) for i in [0, count). Chunks are sized so each thread gets about four of them, never smaller
+	//than min_grain, the caller works on them too and returns when all are done
+	template<typename Function>
+	static void parallel_for(uint32_t count, const Function& function, uint32_t min_grain = 1);
+
+	static Job_Stats get_stats();
+	static void reset_stats();
+
+private:
+	static Job* allocate();
+	static void finish(Job& job);
+
+	template<typename Function>
+	static void invoke(Job& job)
+	{
+		Function* function = reinterpret_cast<Function*>(job.payload);
+		(*function)();
+		function->~Function();
+	}
+};
+
+template<typename Function>
+Job* Job_System::create(Function&& function, Job_Counter* counter)
+{
+	typedef typename std::decay<Function>::type Stored;
+	static_assert(sizeof(Stored) <= JOB_PAYLOAD_SIZE, "job capture too large, capture a pointer instead");
+	static_assert(alignof(Stored) <= 16, "job capture over-aligned");
+
+	Job* job = allocate();
+	new (job->payload) Stored(std::forward<Function>(function));
+	job->function = &invoke<Stored>;
+	job->counter = counter;
+	job->successor_count = 0;
+	job->pending_dependencies.store(1, std::memory_order_relaxed);
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	return job;
+}
+
+template<typename Function>
+void Job_System::parallel_for(uint32_t count, const Function& function, uint32_t min_grain)
+{
+	if (count == 0)
+		return;
+	uint32_t thread_count = get_thread_count();
+	uint32_t grain = std::max(std::max(min_grain, 1u), count / (thread_count * 4));
+	if (thread_count == 1 || grain >= count || get_thread_index() < 0)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			function(i);
+		return;
+	}
+
+	Job_Counter counter;
+	const Function* shared = &function;
+	for (uint32_t begin = 0; begin < count; begin += grain)
+	{
+		uint32_t end = std::min(begin + grain, count);
+		run([shared, begin, end]()
+		{
+			for (uint32_t i = begin; i < end; i++)
+				(*shared)(i);
+		}, counter);
+	}
+	wait(counter);
+}
@@ -0,0 +1,110 @@
+#include "memory-tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+static std::atomic<uint64_t> s_allocations{ 0 };
+static std::atomic<uint64_t> s_frees{ 0 };
+static std::atomic<uint64_t> s_allocated_bytes{ 0 };
+static thread_local uint64_t t_allocations = 0;
+
+bool Memory_Tracker::is_enabled()
+{
+#ifdef DISABLE_ALLOCATION_TRACKING
+	return false;
+#else
+	return true;
+#endif
+}
+
+uint64_t Memory_Tracker::get_allocation_count() { return s_allocations.load(std::memory_order_relaxed); }
+uint64_t Memory_Tracker::get_free_count() { return s_frees.load(std::memory_order_relaxed); }
+uint64_t Memory_Tracker::get_allocated_bytes() { return s_allocated_bytes.load(std::memory_order_relaxed); }
+uint64_t Memory_Tracker::get_thread_allocation_count() { return t_allocations; }
+
+#ifndef DISABLE_ALLOCATION_TRACKING
+
+static void* tracked_allocate(size_t size, size_t alignment)
+{
+	if (size == 0)
+		size = 1;
+	s_allocations.fetch_add(1, std::memory_order_relaxed);
+	s_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	t_allocations++;
+	if (alignment <= alignof(std::max_align_t))
+		return std::malloc(size);
+#ifdef _MSC_VER
+	return _aligned_malloc(size, alignment);
+#else
+	void* memory = nullptr;
+	return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+#endif
+}
+
+static void tracked_free(void* memory, size_t alignment)
+{
+	if (!memory)
+		return;
+	s_frees.fetch_add(1, std::memory_order_relaxed);
+#ifdef _MSC_VER
+	if (alignment > alignof(std::max_align_t))
+	{
+		_aligned_free(memory);
+		return;
+	}
+#else
+	(void)alignment;
+#endif
+	std::free(memory);
+}
+
+void* operator new(size_t size)
+{
+	if (void* memory = tracked_allocate(size, 0))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	if (void* memory = tracked_allocate(size, 0))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return tracked_allocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return tracked_allocate(size, 0); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if (void* memory = tracked_allocate(size, (size_t)alignment))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	if (void* memory = tracked_allocate(size, (size_t)alignment))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return tracked_allocate(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return tracked_allocate(size, (size_t)alignment); }
+
+void operator delete(void* memory) noexcept { tracked_free(memory, 0); }
+void operator delete[](void* memory) noexcept { tracked_free(memory, 0); }
+void operator delete(void* memory, size_t) noexcept { tracked_free(memory, 0); }
+void operator delete[](void* memory, size_t) noexcept { tracked_free(memory, 0); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { tracked_free(memory, 0); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { tracked_free(memory, 0); }
+void operator delete(void* memory, std::align_val_t alignment) noexcept { tracked_free(memory, (size_t)alignment); }
+void operator delete[](void* memory, std::align_val_t alignment) noexcept { tracked_free(memory, (size_t)alignment); }
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept { tracked_free(memory, (size_t)alignment); }
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept { tracked_free(memory, (size_t)alignment); }
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept { tracked_free(memory, (size_t)alignment); }
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept { tracked_free(memory, (size_t)alignment); }
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+//Counts every global operator new/delete, so a frame can be checked for heap traffic by comparing the
+//counts before and after it. Plain malloc calls from C libraries are not seen.
+//What is checked: the Benchmark's steady_state_allocations check asserts zero only for a synthetic frame
+//(arena draw list, parallel_for, pooled objects), not for the GL render loop; main.cpp shows the real
+//frames' count in the window title but nothing fails on it. Driver and GLFW heap use goes through malloc
+//and is invisible either way.
+//Defining DISABLE_ALLOCATION_TRACKING leaves the global operators alone and every count at zero.
+class Memory_Tracker
+{
+public:
+	static bool is_enabled();
+
+	//all threads since startup
+	static uint64_t get_allocation_count();
+	static uint64_t get_free_count();
+	static uint64_t get_allocated_bytes();
+	//the calling thread only
+	static uint64_t get_thread_allocation_count();
+};
+
+//allocations made between construction and count(), all threads
+class Allocation_Scope
+{
+public:
+	Allocation_Scope() : m_start(Memory_Tracker::get_allocation_count()) {}
+	uint64_t count() const { return Memory_Tracker::get_allocation_count() - m_start; }
+
+private:
+	uint64_t m_start;
+};
@@ -3,30 +3,7 @@
 #include <vector>
 #include <iostream>
 
-enum class Shader_Data_Type
-{
-	None = 0, Float, Float2, Float3, Float4, Int, Int2, Int3, Int4, Bool, Mat3, Mat4
-};
-
-static uint32_t shader_data_type_size(Shader_Data_Type type)
-{
-	switch (type)
-	{
-	case Shader_Data_Type::Float:		return 4;
-	case Shader_Data_Type::Float2:		return 4 * 2;
-	case Shader_Data_Type::Float3:		return 4 * 3;
-	case Shader_Data_Type::Float4:		return 4 * 4;
-	case Shader_Data_Type::Mat3:		return 4 * 3 * 3;
-	case Shader_Data_Type::Mat4:		return 4 * 4 * 4;
-	case Shader_Data_Type::Int:			return 4;
-	case Shader_Data_Type::Int2:		return 4 * 2;
-	case Shader_Data_Type::Int3:		return 4 * 3;
-	case Shader_Data_Type::Int4:		return 4 * 4;
-	case Shader_Data_Type::Bool:		return 1;
-	}
-	std::cout << "unknown Shader_Data_Type!" << std::endl;
-	return 0;
-}
+#include "vertex-layout.h"
 
 struct Buffer_Element
 {
@@ -44,22 +21,7 @@ struct Buffer_Element
 
 	uint32_t get_value_count() const		//how many value does this element have
 	{
-		switch (type)
-		{
-		case Shader_Data_Type::Float:		return 1;
-		case Shader_Data_Type::Float2:		return 2;
-		case Shader_Data_Type::Float3:		return 3;
-		case Shader_Data_Type::Float4:		return 4;
-		case Shader_Data_Type::Mat3:		return 3 * 3;
-		case Shader_Data_Type::Mat4:		return 4 * 4;
-		case Shader_Data_Type::Int:			return 1;
-		case Shader_Data_Type::Int2:		return 2;
-		case Shader_Data_Type::Int3:		return 3;
-		case Shader_Data_Type::Int4:		return 4;
-		case Shader_Data_Type::Bool:		return 1;
-		}
-		std::cout << "unknown Shader_Data_Type!" << std::endl;
-		return 0;
+		return shader_data_type_count(type);
 	}
 };
 
@@ -75,6 +37,18 @@ public:
 
 	inline uint32_t get_stride() const { return m_stride; }
 	inline const std::vector<Buffer_Element>& get_elements() const { return m_elements; }
+	//identifies the vertex format, names are left out since they don't change the GL state
+	inline uint64_t get_hash() const { return m_hash; }
+	//the same description the compile-time layouts produce, valid as long as this layout
+	Vertex_Layout_View get_view() const
+	{
+		Vertex_Layout_View view;
+		view.attributes = m_attributes.data();
+		view.count = (uint32_t)m_attributes.size();
+		view.stride = m_stride;
+		view.hash = m_hash;
+		return view;
+	}
 
 	std::vector<Buffer_Element>::const_iterator begin() const { return m_elements.begin(); }
 	std::vector<Buffer_Element>::const_iterator end() const { return m_elements.end(); }
@@ -90,11 +64,24 @@ private:
 			offset += element.size; //next offset is current offset add current element size
 			m_stride += element.size; //stride is all elements' size
 		}
+
+		m_attributes.clear();
+		for (const auto& element : m_elements)
+		{
+			Vertex_Attribute attribute;
+			attribute.type = element.type;
+			attribute.offset = element.offset;
+			attribute.normalized = element.normalized;
+			m_attributes.push_back(attribute);
+		}
+		m_hash = hash_vertex_attributes(m_attributes.data(), (uint32_t)m_attributes.size(), m_stride);
 	}
 
 private:
 	std::vector<Buffer_Element> m_elements;
+	std::vector<Vertex_Attribute> m_attributes;
 	uint32_t m_stride = 0;
+	uint64_t m_hash = 0;
 };
 
 class Vertex_Buffer
@@ -107,12 +94,17 @@ public:
 	void unbind() const;
 
 	const Buffer_Layout& get_layout() const { return m_buffer_layout; }
-	void set_layout(const Buffer_Layout& layout) { m_buffer_layout = layout; }
+	void set_layout(const Buffer_Layout& layout) { m_buffer_layout = layout; m_static_layout = Vertex_Layout_View(); }
+	//compile-time layout from vertex_layout_of<V>(), no per-buffer strings or vectors
+	void set_layout(const Vertex_Layout_View& layout) { m_static_layout = layout; }
+	Vertex_Layout_View get_layout_view() const { return m_static_layout.attributes ? m_static_layout : m_buffer_layout.get_view(); }
+	uint32_t get_render_ID() const { return m_render_ID; }
 
 
 private:
 	uint32_t m_render_ID;
 	Buffer_Layout m_buffer_layout;
+	Vertex_Layout_View m_static_layout;
 };
 
 
@@ -126,6 +118,7 @@ public:
 	void unbind() const;
 
 	uint32_t get_indices_count() const { return m_indices_count; }
+	uint32_t get_render_ID() const { return m_render_ID; }
 
 private:
 	uint32_t m_render_ID;
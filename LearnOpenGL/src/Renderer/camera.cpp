@@ -1,5 +1,7 @@
 #include "camera.h"
 
+#include <cmath>
+
 Perspective_Camera::Perspective_Camera(glm::vec3 position, glm::vec3 euler, glm::vec3 up, float fov)
 	:m_position(position), m_world_up(up), m_fov(fov), m_euler(euler), m_camera_speed(2.5f), m_mouse_sensitivity(0.1f)
 {
@@ -24,7 +26,7 @@ void Perspective_Camera::process_key_event(camera_movement direction, float delt
 	update_view_matrix();
 }
 
-void Perspective_Camera::process_mouse_event(float x_offset, float y_offset, GLboolean constrain_pitch)
+void Perspective_Camera::process_mouse_event(float x_offset, float y_offset, bool constrain_pitch)
 {
 	x_offset *= m_mouse_sensitivity;
 	y_offset *= m_mouse_sensitivity;
@@ -58,12 +60,26 @@ void Perspective_Camera::process_scroll_event(float y_offset)
 	update_view_matrix();
 }
 
+void Perspective_Camera::set_aspect_ratio(float aspect_ratio)
+{
+	//a minimized window reports a zero height, keep the last usable ratio
+	if (!(aspect_ratio > 0.0f) || std::isinf(aspect_ratio))
+		return;
+	m_aspect_ratio = aspect_ratio;
+	update_view_matrix();
+}
+
 void Perspective_Camera::update_view_matrix()
 {
 	m_view_matrix = glm::lookAt(m_position, m_position + m_front, m_up);
-	glm::mat4 projection_matrix = glm::perspective(glm::radians(m_fov), 800.0f / 600.0f, 0.1f, 100.0f);
-	m_view_projection_matrix = projection_matrix * m_view_matrix;
+	m_projection_matrix = glm::perspective(glm::radians(m_fov), m_aspect_ratio, m_near, m_far);
+	m_view_projection_matrix = m_projection_matrix * m_view_matrix;
+
+}
 
+glm::mat4 Perspective_Camera::get_view_matrix_at(const glm::vec3& position) const
+{
+	return glm::lookAt(position, position + m_front, m_up);
 }
 
 void Perspective_Camera::update_camera_space_vector()
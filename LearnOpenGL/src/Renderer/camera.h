@@ -1,6 +1,5 @@
 #pragma once
 
-#include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -14,20 +13,28 @@ public:
 	Perspective_Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 euler = glm::vec3(0.0f, -90.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float fov = 45.0f);
 
 	void process_key_event(camera_movement direction, float delta_time);
-	void process_mouse_event(float x_offset, float y_offset, GLboolean constrainPitch = true);
+	void process_mouse_event(float x_offset, float y_offset, bool constrain_pitch = true);
 	void process_scroll_event(float y_offset);
 	
 	void set_camera_speed(float speed) { m_camera_speed = speed; }
 	void set_mouse_sensitivity(float sensitivity) { m_mouse_sensitivity = sensitivity; }
 	void set_possition(glm::vec3 position) { m_position = position; }
 	void set_euler(glm::vec3 euler) { m_euler = euler; }
+	//width / height of the target the camera renders to, follow the framebuffer size
+	void set_aspect_ratio(float aspect_ratio);
 
 	const glm::mat4 get_view_matrix() const { return m_view_matrix; }
 	const glm::mat4 get_view_projection_matrix() const { return m_view_projection_matrix; }
+	const glm::mat4 get_projection_matrix() const { return m_projection_matrix; }
 	const glm::vec3 get_position() const { return m_position; }
 	const glm::vec3 get_front() const { return m_front; }
 	const glm::vec3 get_euler() const { return m_euler; }
 	const float get_zoom() const { return m_fov; }
+	const float get_near_plane() const { return m_near; }
+	const float get_far_plane() const { return m_far; }
+	const float get_aspect_ratio() const { return m_aspect_ratio; }
+	//current orientation seen from another position, used to render an interpolated position
+	glm::mat4 get_view_matrix_at(const glm::vec3& position) const;
 
 private:
 	void update_view_matrix();
@@ -41,11 +48,15 @@ private:
 	glm::vec3 m_euler;
 
 	float m_fov;
+	float m_near = 0.1f;
+	float m_far = 100.0f;
+	float m_aspect_ratio = 1.0f;
 
 	float m_camera_speed;
 	float m_mouse_sensitivity;
 	float m_zoom;
 
 	glm::mat4 m_view_matrix;
+	glm::mat4 m_projection_matrix;
 	glm::mat4 m_view_projection_matrix;
 };
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "cascaded-shadow-map.h"
+
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+static GLuint create_depth_array(uint32_t resolution, uint32_t layers, bool sampled_with_compare)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, sampled_with_compare ? GL_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, sampled_with_compare ? GL_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+	if (sampled_with_compare)
+	{
+		//hardware 2x2 PCF through sampler2DArrayShadow
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return texture;
+}
+
+Cascaded_Shadow_Map::Cascaded_Shadow_Map(const Shadow_Config& config)
+	:m_config(config)
+{
+	m_config.cascade_count = std::min(std::max(m_config.cascade_count, 1u), (uint32_t)MAX_SHADOW_CASCADES);
+	m_config.snap_texels = std::min(m_config.snap_texels, m_config.resolution / 4);
+	for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		m_static_region[i] = glm::vec4(0.0f);
+		m_dynamic_hash[i] = 0;
+	}
+
+	m_shadow_map = create_depth_array(m_config.resolution, m_config.cascade_count, true);
+	m_static_cache = create_depth_array(m_config.resolution, m_config.cascade_count, false);
+
+	//depth only framebuffers, [0] renders the static cache, [1] the final map
+	glGenFramebuffers(2, m_framebuffers);
+	for (int i = 0; i < 2; i++)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[i]);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	//receivers sampling before the first render() see no shadow instead of undefined depth
+	for (uint32_t i = 0; i < m_config.cascade_count; i++)
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_shadow_map, 0, i);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+Cascaded_Shadow_Map::~Cascaded_Shadow_Map()
+{
+	glDeleteFramebuffers(2, m_framebuffers);
+	glDeleteTextures(1, &m_shadow_map);
+	glDeleteTextures(1, &m_static_cache);
+}
+
+void Cascaded_Shadow_Map::update(const Perspective_Camera& camera, const glm::vec3& light_direction)
+{
+	glm::mat4 projection = glm::perspective(glm::radians(camera.get_zoom()), camera.get_aspect_ratio(), camera.get_near_plane(), camera.get_far_plane());
+	update(camera.get_view_matrix(), projection, light_direction);
+}
+
+void Cascaded_Shadow_Map::update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& light_direction)
+{
+	glm::vec3 direction = glm::normalize(light_direction);
+	if (direction != m_light_direction)
+	{
+		m_light_direction = direction;
+		m_static_dirty = true;
+	}
+	fit_shadow_cascades(m_config, view, projection, m_light_direction, m_cascades);
+}
+
+bool Cascaded_Shadow_Map::caster_in_cascade(const Shadow_Caster& caster, const Shadow_Cascade& cascade) const
+{
+	//light-space box of the caster from its center and extents
+	glm::mat4 to_light = cascade.light_view * caster.model;
+	glm::vec3 center = glm::vec3(to_light * glm::vec4((caster.bounds_min + caster.bounds_max) * 0.5f, 1.0f));
+	glm::vec3 extents = (caster.bounds_max - caster.bounds_min) * 0.5f;
+	glm::mat3 rotation(to_light);
+	glm::vec3 light_extents(0.0f);
+	for (int axis = 0; axis < 3; axis++)
+		light_extents += glm::abs(rotation[axis]) * extents[axis];
+
+	float r = cascade.radius;
+	if (fabs(center.x) - light_extents.x > r || fabs(center.y) - light_extents.y > r)
+		return false;
+	//anything between the light and the cascade still casts into it
+	return center.z - light_extents.z <= r + m_config.caster_margin && center.z + light_extents.z >= -r;
+}
+
+void Cascaded_Shadow_Map::draw_casters(Shader& depth_shader, const std::vector<Shadow_Caster>& casters, const Shadow_Cascade& cascade, bool static_casters)
+{
+	depth_shader.set_mat4("u_light_view_projection", cascade.light_view_projection);
+	Vertex_Binding bound;
+	for (const Shadow_Caster& caster : casters)
+	{
+		if (caster.is_static != static_casters)
+			continue;
+		if (!caster_in_cascade(caster, cascade))
+		{
+			m_stats.casters_culled++;
+			continue;
+		}
+		depth_shader.set_mat4("u_model", caster.model);
+		Vertex_Array_Cache::bind(caster.geometry, bound);
+		if (caster.indexed)
+			glDrawElements(GL_TRIANGLES, caster.count, GL_UNSIGNED_INT, 0);
+		else
+			glDrawArrays(GL_TRIANGLES, 0, caster.count);
+		m_stats.casters_drawn++;
+	}
+	glBindVertexArray(0);
+}
+
+void Cascaded_Shadow_Map::render(Shader& depth_shader, const std::vector<Shadow_Caster>& casters)
+{
+	m_stats = Shadow_Stats();
+
+	//called from inside a pass, whatever it draws into is restored afterwards
+	GLint viewport[4], framebuffer = 0;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glViewport(0, 0, m_config.resolution, m_config.resolution);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	depth_shader.bind();
+
+	for (uint32_t i = 0; i < m_config.cascade_count; i++)
+	{
+		const Shadow_Cascade& cascade = m_cascades[i];
+
+		//FNV-1a over the transforms of the dynamic casters that touch this cascade
+		uint64_t dynamic_hash = 14695981039346656037ull;
+		for (const Shadow_Caster& caster : casters)
+		{
+			if (caster.is_static || !caster_in_cascade(caster, cascade))
+				continue;
+			const uint32_t* words = (const uint32_t*)&caster.model[0][0];
+			for (int w = 0; w < 16; w++)
+			{
+				dynamic_hash ^= words[w];
+				dynamic_hash *= 1099511628211ull;
+			}
+			//shared vertex arrays tell geometries apart only by their buffers
+			GLuint ids[] = { caster.geometry.vertex_array, caster.geometry.vertex_buffers[0], caster.geometry.index_buffer };
+			for (GLuint id : ids)
+			{
+				dynamic_hash ^= id;
+				dynamic_hash *= 1099511628211ull;
+			}
+		}
+
+		glm::vec4 region(cascade.center, cascade.radius);
+		bool redraw_static = m_static_dirty || region != m_static_region[i];
+		if (redraw_static)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[0]);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_static_cache, 0, i);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			draw_casters(depth_shader, casters, cascade, true);
+			m_static_region[i] = region;
+			m_stats.static_redraws++;
+		}
+
+		if (redraw_static || dynamic_hash != m_dynamic_hash[i])
+		{
+			//start from the cached static depth, then add whatever moves
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffers[0]);
+			glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_static_cache, 0, i);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffers[1]);
+			glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_shadow_map, 0, i);
+			glBlitFramebuffer(0, 0, m_config.resolution, m_config.resolution, 0, 0, m_config.resolution, m_config.resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[1]);
+			draw_casters(depth_shader, casters, cascade, false);
+			m_dynamic_hash[i] = dynamic_hash;
+			m_stats.cascade_redraws++;
+		}
+	}
+	m_static_dirty = false;
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+const Cascaded_Shadow_Map::Receiver_Uniforms& Cascaded_Shadow_Map::get_receiver_uniforms(const Shader& shader)
+{
+	GLint program = shader.ID();
+	for (const Receiver_Uniforms& receiver : m_receivers)
+		if (receiver.shader == &shader && receiver.program == program && receiver.version == shader.get_program_version())
+			return receiver;
+
+	//a handful of receiving shaders per frame, the oldest entry makes room
+	Receiver_Uniforms& receiver = m_receivers[m_next_receiver];
+	m_next_receiver = (m_next_receiver + 1) % (sizeof(m_receivers) / sizeof(m_receivers[0]));
+	receiver.shader = &shader;
+	receiver.program = program;
+	receiver.version = shader.get_program_version();
+	receiver.shadow_map = glGetUniformLocation(program, "u_shadow_map");
+	receiver.cascade_count = glGetUniformLocation(program, "u_cascade_count");
+	receiver.cascade_matrices = glGetUniformLocation(program, "u_cascade_matrices");
+	receiver.cascade_splits = glGetUniformLocation(program, "u_cascade_splits");
+	return receiver;
+}
+
+void Cascaded_Shadow_Map::bind(Shader& shader, uint32_t texture_unit)
+{
+	glActiveTexture(GL_TEXTURE0 + texture_unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadow_map);
+	glActiveTexture(GL_TEXTURE0);
+
+	//expects the shader to be bound
+	const Receiver_Uniforms& receiver = get_receiver_uniforms(shader);
+	glm::mat4 matrices[MAX_SHADOW_CASCADES];
+	glm::vec4 splits(0.0f);
+	for (uint32_t i = 0; i < m_config.cascade_count; i++)
+	{
+		splits[i] = m_cascades[i].split_far;
+		matrices[i] = m_cascades[i].light_view_projection;
+	}
+	glUniform1i(receiver.shadow_map, texture_unit);
+	glUniform1i(receiver.cascade_count, m_config.cascade_count);
+	//array elements sit at consecutive locations, one call sets them all
+	glUniformMatrix4fv(receiver.cascade_matrices, m_config.cascade_count, GL_FALSE, &matrices[0][0][0]);
+	glUniform4fv(receiver.cascade_splits, 1, &splits[0]);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "shadow-cascades.h"
+#include "shader.h"
+#include "vertex-array-cache.h"
+
+//Something that casts shadows. Bounds are in model space and are used for per-cascade culling.
+struct Shadow_Caster
+{
+	Vertex_Binding geometry;
+	uint32_t count = 0;					//vertices, or indices when indexed
+	bool indexed = false;
+	bool is_static = true;
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::vec3 bounds_min = glm::vec3(0.0f);
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+};
+
+struct Shadow_Stats
+{
+	uint32_t static_redraws = 0;		//cascades whose static cache was re-rendered this frame
+	uint32_t cascade_redraws = 0;		//cascades whose final map changed this frame
+	uint32_t casters_drawn = 0;
+	uint32_t casters_culled = 0;
+};
+
+//Directional light cascaded shadow maps. Each cascade keeps a cached depth layer with only static casters;
+//it is rebuilt when the cascade's snapped light-space region moves, and the final layer is only rebuilt
+//(cache copy + dynamic casters) when that happens or a dynamic caster inside the cascade moves.
+class Cascaded_Shadow_Map
+{
+public:
+	Cascaded_Shadow_Map(const Shadow_Config& config = Shadow_Config());
+	~Cascaded_Shadow_Map();
+
+	//fit the cascades to the camera, direction points from the light into the scene
+	void update(const Perspective_Camera& camera, const glm::vec3& light_direction);
+	//same from the matrices a frame is drawn with, projection must come from glm::perspective
+	void update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& light_direction);
+	//depth_shader only needs location 0 and the "u_light_view_projection"/"u_model" uniforms
+	void render(Shader& depth_shader, const std::vector<Shadow_Caster>& casters);
+	//static casters were added, removed or moved
+	void invalidate_static() { m_static_dirty = true; }
+
+	//bind the shadow map for shaders built with SHADER_FEATURE_RECEIVE_SHADOWS (RECEIVE_SHADOWS in the GLSL)
+	void bind(Shader& shader, uint32_t texture_unit);
+
+	const Shadow_Cascade& get_cascade(uint32_t index) const { return m_cascades[index]; }
+	const Shadow_Stats& get_stats() const { return m_stats; }
+	const Shadow_Config& get_config() const { return m_config; }
+
+private:
+	//uniform locations of one receiving program, looked up again when the shader swaps its program
+	struct Receiver_Uniforms
+	{
+		const Shader* shader = nullptr;
+		GLint program = 0;
+		uint32_t version = 0;
+		GLint shadow_map = -1;
+		GLint cascade_count = -1;
+		GLint cascade_matrices = -1;
+		GLint cascade_splits = -1;
+	};
+	const Receiver_Uniforms& get_receiver_uniforms(const Shader& shader);
+
+	bool caster_in_cascade(const Shadow_Caster& caster, const Shadow_Cascade& cascade) const;
+	void draw_casters(Shader& depth_shader, const std::vector<Shadow_Caster>& casters, const Shadow_Cascade& cascade, bool static_casters);
+
+private:
+	Shadow_Config m_config;
+	Shadow_Cascade m_cascades[MAX_SHADOW_CASCADES];
+	glm::vec3 m_light_direction = glm::vec3(0.0f, -1.0f, 0.0f);
+
+	//what each cache layer was rendered for, a mismatch means it has to be redrawn
+	glm::vec4 m_static_region[MAX_SHADOW_CASCADES];
+	uint64_t m_dynamic_hash[MAX_SHADOW_CASCADES];
+	bool m_static_dirty = true;
+
+	GLuint m_shadow_map = 0;			//depth array sampled by the lighting shaders
+	GLuint m_static_cache = 0;			//depth array holding only static casters
+	GLuint m_framebuffers[2] = { 0, 0 };
+	Shadow_Stats m_stats;
+	Receiver_Uniforms m_receivers[4];
+	uint32_t m_next_receiver = 0;
+};
@@ -0,0 +1,109 @@
+#include "clustered-lighting.h"
+
+#include <iostream>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+Clustered_Lighting::Clustered_Lighting(const Cluster_Grid_Config& config)
+	:m_grid(config)
+{
+	static const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	glGenBuffers(3, m_buffers);
+	glGenTextures(3, m_textures);
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+		//a buffer texture needs storage before it can be attached
+		glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+Clustered_Lighting::~Clustered_Lighting()
+{
+	glDeleteTextures(3, m_textures);
+	glDeleteBuffers(3, m_buffers);
+}
+
+void Clustered_Lighting::update(const Perspective_Camera& camera, const std::vector<Cluster_Light>& lights)
+{
+	glm::mat4 projection = glm::perspective(glm::radians(camera.get_zoom()), camera.get_aspect_ratio(), camera.get_near_plane(), camera.get_far_plane());
+	update(camera.get_view_matrix(), projection, lights);
+}
+
+void Clustered_Lighting::update(const glm::mat4& view, const glm::mat4& projection, const std::vector<Cluster_Light>& lights)
+{
+	//the grid only needs rebuilding when the projection changes, its parameters back out of the matrix
+	float fov = glm::degrees(2.0f * atan(1.0f / projection[1][1]));
+	float aspect_ratio = projection[1][1] / projection[0][0];
+	float near_plane = projection[3][2] / (projection[2][2] - 1.0f);
+	float far_plane = projection[3][2] / (projection[2][2] + 1.0f);
+	if (fov != m_fov || aspect_ratio != m_aspect_ratio || near_plane != m_near || far_plane != m_far)
+	{
+		m_fov = fov;
+		m_aspect_ratio = aspect_ratio;
+		m_near = near_plane;
+		m_far = far_plane;
+		m_grid.set_projection(m_fov, m_aspect_ratio, m_near, m_far);
+	}
+	m_grid.assign(view, lights);
+	//once per new worst case, a frame that drops lights would otherwise print every frame
+	if (m_grid.get_overflow_count() > m_reported_overflow)
+	{
+		m_reported_overflow = m_grid.get_overflow_count();
+		std::cout << "Clustered_Lighting: dropped " << m_reported_overflow << " lights in " << m_grid.get_overflowing_cluster_count()
+			<< " clusters past max_lights_per_cluster (" << m_grid.get_config().max_lights_per_cluster << ")" << std::endl;
+	}
+
+	//orphan and refill every frame, the driver hands back fresh storage instead of waiting on last frame's draws
+	const void* data[3] = { lights.data(), m_grid.get_cluster_ranges().data(), m_grid.get_light_indices().data() };
+	size_t sizes[3] = { lights.size() * sizeof(Cluster_Light), m_grid.get_cluster_ranges().size() * sizeof(glm::uvec2), m_grid.get_light_indices().size() * sizeof(uint32_t) };
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, sizes[i] > 0 ? sizes[i] : 16, nullptr, GL_STREAM_DRAW);
+		if (sizes[i] > 0)
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+const Clustered_Lighting::Receiver_Uniforms& Clustered_Lighting::get_receiver_uniforms(const Shader& shader)
+{
+	GLint program = shader.ID();
+	for (const Receiver_Uniforms& receiver : m_receivers)
+		if (receiver.shader == &shader && receiver.program == program && receiver.version == shader.get_program_version())
+			return receiver;
+
+	//a handful of lit shaders per frame, the oldest entry makes room
+	static const char* samplers[3] = { "u_cluster_lights", "u_cluster_ranges", "u_cluster_indices" };
+	Receiver_Uniforms& receiver = m_receivers[m_next_receiver];
+	m_next_receiver = (m_next_receiver + 1) % (sizeof(m_receivers) / sizeof(m_receivers[0]));
+	receiver.shader = &shader;
+	receiver.program = program;
+	receiver.version = shader.get_program_version();
+	for (int i = 0; i < 3; i++)
+		receiver.samplers[i] = glGetUniformLocation(program, samplers[i]);
+	receiver.grid = glGetUniformLocation(program, "u_cluster_grid");
+	receiver.params = glGetUniformLocation(program, "u_cluster_params");
+	return receiver;
+}
+
+void Clustered_Lighting::bind(Shader& shader, uint32_t first_texture_unit, uint32_t viewport_width, uint32_t viewport_height)
+{
+	const Receiver_Uniforms& receiver = get_receiver_uniforms(shader);
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + first_texture_unit + i);
+		glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+		glUniform1i(receiver.samplers[i], first_texture_unit + i);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	const Cluster_Grid_Config& config = m_grid.get_config();
+	glUniform3f(receiver.grid, (float)config.tiles_x, (float)config.tiles_y, (float)config.slices_z);
+	glUniform4f(receiver.params, (float)viewport_width / config.tiles_x, (float)viewport_height / config.tiles_y, m_grid.get_slice_scale(), m_grid.get_slice_bias());
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <glad/glad.h>
+
+#include "light-clusters.h"
+#include "camera.h"
+#include "shader.h"
+
+//Uploads a Light_Cluster_Grid through buffer textures so GL 3.3 shaders can loop over the lights of
+//their own cluster only. See Asset/Shader/clustered-frag.glsl for the consuming side.
+class Clustered_Lighting
+{
+public:
+	Clustered_Lighting(const Cluster_Grid_Config& config = Cluster_Grid_Config());
+	~Clustered_Lighting();
+
+	//assign lights to clusters for this frame's camera and stream the result to the GPU
+	void update(const Perspective_Camera& camera, const std::vector<Cluster_Light>& lights);
+	//same from the matrices a frame is drawn with, projection must come from glm::perspective
+	void update(const glm::mat4& view, const glm::mat4& projection, const std::vector<Cluster_Light>& lights);
+	//bind the three buffer textures starting at first_texture_unit and set the grid uniforms, the shader must be bound
+	void bind(Shader& shader, uint32_t first_texture_unit, uint32_t viewport_width, uint32_t viewport_height);
+
+	const Light_Cluster_Grid& get_grid() const { return m_grid; }
+
+private:
+	//uniform locations of one lit program, looked up again when the shader swaps its program
+	struct Receiver_Uniforms
+	{
+		const Shader* shader = nullptr;
+		GLint program = 0;
+		uint32_t version = 0;
+		GLint samplers[3] = { -1, -1, -1 };
+		GLint grid = -1;
+		GLint params = -1;
+	};
+	const Receiver_Uniforms& get_receiver_uniforms(const Shader& shader);
+
+private:
+	Light_Cluster_Grid m_grid;
+	float m_fov = 0.0f, m_aspect_ratio = 0.0f, m_near = 0.0f, m_far = 0.0f;
+	//largest Light_Cluster_Grid::get_overflow_count() printed so far
+	uint32_t m_reported_overflow = 0;
+
+	//lights: RGBA32F, cluster ranges: RG32UI, light indices: R32UI
+	GLuint m_buffers[3] = { 0, 0, 0 };
+	GLuint m_textures[3] = { 0, 0, 0 };
+	Receiver_Uniforms m_receivers[4];
+	uint32_t m_next_receiver = 0;
+};
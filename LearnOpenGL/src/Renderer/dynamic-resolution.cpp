@@ -0,0 +1,153 @@
+#include "dynamic-resolution.h"
+
+#include <cmath>
+#include <algorithm>
+
+//native at full scale, otherwise a multiple of step that is never larger than native
+static uint32_t scaled_size(uint32_t native, float scale, uint32_t step)
+{
+	if (scale >= 1.0f || native <= step)
+		return native;
+	uint32_t size = (uint32_t)(native * scale / step + 0.5f) * step;
+	return std::min(std::max(size, step), native);
+}
+
+Dynamic_Resolution::~Dynamic_Resolution()
+{
+	shutdown();
+}
+
+bool Dynamic_Resolution::init(const Dynamic_Resolution_Config& config, const std::string& shader_directory)
+{
+	m_config = config;
+	m_config.min_scale = std::max(m_config.min_scale, 0.1f);
+	m_config.max_scale = std::max(m_config.max_scale, m_config.min_scale);
+	m_config.size_step = std::max(m_config.size_step, 1u);
+	m_scale = m_config.max_scale;
+	m_pixel_cost = 0.0f;
+
+	//compiled up front, a fallback program would draw garbage over the whole screen
+	m_upscale_shader = std::make_shared<Shader>(shader_directory + "upscale-vert.glsl", shader_directory + "upscale-frag.glsl");
+	//the full screen triangle comes from gl_VertexID, core profiles still want a vertex array bound
+	glGenVertexArrays(1, &m_vertex_array);
+	for (Timer_Query& timer : m_queries)
+		glGenQueries(1, &timer.query);
+	m_query_head = 0;
+	m_query_count = 0;
+	return m_upscale_shader->is_ready();
+}
+
+void Dynamic_Resolution::shutdown()
+{
+	if (!m_vertex_array)
+		return;
+	for (Timer_Query& timer : m_queries)
+	{
+		glDeleteQueries(1, &timer.query);
+		timer.query = 0;
+	}
+	glDeleteVertexArrays(1, &m_vertex_array);
+	m_vertex_array = 0;
+	m_upscale_shader.reset();
+	m_query_count = 0;
+}
+
+void Dynamic_Resolution::begin_frame(uint32_t native_width, uint32_t native_height)
+{
+	float gpu_ms = -1.0f;
+	while (m_query_count > 0)
+	{
+		Timer_Query& oldest = m_queries[m_query_head];
+		GLint available = 0;
+		glGetQueryObjectiv(oldest.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(oldest.query, GL_QUERY_RESULT, &elapsed);
+		gpu_ms = (float)(elapsed / 1e6);
+		update_scale(gpu_ms, oldest.scale);
+		m_query_head = (m_query_head + 1) % QUERY_COUNT;
+		m_query_count--;
+	}
+
+	m_native_width = native_width;
+	m_native_height = native_height;
+	m_render_width = scaled_size(native_width, m_scale, m_config.size_step);
+	m_render_height = scaled_size(native_height, m_scale, m_config.size_step);
+
+	std::lock_guard<std::mutex> lock(m_stats_mutex);
+	m_stats.scale = m_scale;
+	if (gpu_ms >= 0.0f)
+		m_stats.gpu_ms = gpu_ms;
+	m_stats.render_width = m_render_width;
+	m_stats.render_height = m_render_height;
+}
+
+void Dynamic_Resolution::begin_timing()
+{
+	m_timing = m_vertex_array && m_query_count < QUERY_COUNT;
+	if (!m_timing)
+		return;
+	Timer_Query& timer = m_queries[(m_query_head + m_query_count) % QUERY_COUNT];
+	//the sizes are rounded, the time scales with the pixel ratio they actually have
+	uint64_t native_pixels = (uint64_t)m_native_width * m_native_height;
+	timer.scale = native_pixels ? std::sqrt((float)((double)m_render_width * m_render_height / native_pixels)) : 1.0f;
+	glBeginQuery(GL_TIME_ELAPSED, timer.query);
+}
+
+void Dynamic_Resolution::end_timing()
+{
+	if (!m_timing)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	m_query_count++;
+	m_timing = false;
+}
+
+void Dynamic_Resolution::upscale(GLuint source, uint32_t source_width, uint32_t source_height)
+{
+	if (!m_vertex_array || source_width == 0 || source_height == 0)
+		return;
+	glm::vec2 source_size((float)source_width, (float)source_height);
+	glm::vec2 render_size((float)std::min(m_render_width, source_width), (float)std::min(m_render_height, source_height));
+
+	glDisable(GL_DEPTH_TEST);
+	m_upscale_shader->bind();
+	m_upscale_shader->set_int("source", 0);
+	m_upscale_shader->set_vec2("uv_scale", render_size / source_size);
+	m_upscale_shader->set_vec2("texel_size", 1.0f / source_size);
+	//centre of the last rendered texel, bilinear taps past it would blend in what was never drawn this frame
+	m_upscale_shader->set_vec2("uv_max", (render_size - 0.5f) / source_size);
+	m_upscale_shader->set_float("sharpness", m_config.sharpness);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, source);
+	glBindVertexArray(m_vertex_array);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+}
+
+float Dynamic_Resolution::update_scale(float gpu_ms, float measured_scale)
+{
+	//what the measured passes would cost at native resolution, smoothed so one slow frame does not halve it
+	float pixel_cost = gpu_ms / std::max(measured_scale * measured_scale, 1e-4f);
+	m_pixel_cost = m_pixel_cost > 0.0f ? m_pixel_cost + (pixel_cost - m_pixel_cost) * 0.3f : pixel_cost;
+	float fitting = m_pixel_cost > 0.0f ? std::sqrt(m_config.target_ms / m_pixel_cost) : m_config.max_scale;
+	fitting = std::min(std::max(fitting, m_config.min_scale), m_config.max_scale);
+
+	//over budget costs dropped frames, under it only some sharpness: drop fast, climb slowly and not on noise
+	if (fitting < m_scale)
+		m_scale += (fitting - m_scale) * 0.5f;
+	else if (fitting > m_scale * 1.05f || fitting == m_config.max_scale)
+		m_scale += (fitting - m_scale) * 0.1f;
+	//the last few percent would take forever to close
+	if (m_config.max_scale - m_scale < 0.005f)
+		m_scale = m_config.max_scale;
+	return m_scale;
+}
+
+Dynamic_Resolution_Stats Dynamic_Resolution::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(m_stats_mutex);
+	return m_stats;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <mutex>
+
+#include "shader.h"
+
+struct Dynamic_Resolution_Config
+{
+	float target_ms = 12.0f;			//GPU time of the scaled passes to hold, keep headroom below the refresh interval
+	float min_scale = 0.5f;				//per axis, of the native resolution
+	float max_scale = 1.0f;
+	float sharpness = 0.5f;				//of the upscale, 0 is plain bilinear
+	uint32_t size_step = 8;				//render sizes are multiples of this, small scale changes do not resize every frame
+};
+
+struct Dynamic_Resolution_Stats
+{
+	float scale = 1.0f;
+	float gpu_ms = 0.0f;				//last measured scaled passes
+	uint32_t render_width = 0;
+	uint32_t render_height = 0;
+};
+
+//Renders the 3D scene below native resolution when the GPU cannot hold the frame budget.
+//The scaled passes are bracketed with GL_TIME_ELAPSED queries from a small ring, read back a few frames
+//later without waiting. Their cost is taken as proportional to the pixel count, which gives the scale
+//that would just fit the target; the scale drops towards it quickly and climbs back slowly.
+//The scene is drawn into the top-left corner of a native sized target, so changing the scale never
+//reallocates anything, and upscale() stretches that corner over the back buffer with a contrast
+//adaptive sharpen. Everything after it, overlays and captures, stays at native resolution.
+//Belongs to the thread that owns the GL context.
+class Dynamic_Resolution
+{
+public:
+	Dynamic_Resolution() = default;
+	~Dynamic_Resolution();
+	Dynamic_Resolution(const Dynamic_Resolution&) = delete;
+	Dynamic_Resolution& operator=(const Dynamic_Resolution&) = delete;
+
+	//false when the upscale shader does not build
+	bool init(const Dynamic_Resolution_Config& config = Dynamic_Resolution_Config(), const std::string& shader_directory = "Asset/Shader/");
+	void shutdown();
+
+	//once per frame before the scaled passes: reads finished queries and picks this frame's render size
+	void begin_frame(uint32_t native_width, uint32_t native_height);
+	uint32_t get_render_width() const { return m_render_width; }
+	uint32_t get_render_height() const { return m_render_height; }
+
+	//around the scaled passes; skipped without stalling when every query is still in flight
+	void begin_timing();
+	void end_timing();
+
+	//draws the rendered corner of source, a texture of source_width x source_height, into the bound framebuffer
+	void upscale(GLuint source, uint32_t source_width, uint32_t source_height);
+
+	//GL-free controller step: the scale to use after the scaled passes took gpu_ms at measured_scale
+	float update_scale(float gpu_ms, float measured_scale);
+
+	//any thread
+	Dynamic_Resolution_Stats get_stats() const;
+
+private:
+	static constexpr uint32_t QUERY_COUNT = 4;
+
+	struct Timer_Query
+	{
+		GLuint query = 0;
+		float scale = 1.0f;				//the frame's scale, the measurement is only meaningful with it
+		bool pending = false;
+	};
+
+	Dynamic_Resolution_Config m_config;
+	std::shared_ptr<Shader> m_upscale_shader;
+	GLuint m_vertex_array = 0;
+
+	Timer_Query m_queries[QUERY_COUNT];
+	uint32_t m_query_head = 0;			//oldest pending
+	uint32_t m_query_count = 0;
+	bool m_timing = false;
+
+	float m_scale = 1.0f;
+	float m_pixel_cost = 0.0f;			//smoothed ms at scale 1
+	uint32_t m_native_width = 0;
+	uint32_t m_native_height = 0;
+	uint32_t m_render_width = 0;
+	uint32_t m_render_height = 0;
+
+	mutable std::mutex m_stats_mutex;
+	Dynamic_Resolution_Stats m_stats;
+};
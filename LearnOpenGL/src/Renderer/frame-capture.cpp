@@ -0,0 +1,299 @@
+#include "frame-capture.h"
+
+#include <GLFW/glfw3.h>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <stb_image_write.h>
+
+#include "image-decoder.h"
+#include "Core/file-system.h"
+
+Frame_Capture::~Frame_Capture()
+{
+	shutdown();
+}
+
+void Frame_Capture::init(uint32_t ring_size)
+{
+	m_slots.resize(std::max(ring_size, 1u));
+	for (Readback_Slot& slot : m_slots)
+		glGenBuffers(1, &slot.buffer);
+	m_head = 0;
+	m_busy_slots = 0;
+	m_exit = false;
+	m_worker = std::thread(&Frame_Capture::worker_loop, this);
+}
+
+void Frame_Capture::shutdown()
+{
+	if (m_slots.empty())
+		return;
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_work_cv.notify_one();
+	m_worker.join();
+	for (Readback_Slot& slot : m_slots)
+		glDeleteBuffers(1, &slot.buffer);
+	m_slots.clear();
+}
+
+bool Frame_Capture::capture(uint32_t width, uint32_t height, const Capture_Request& request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.requested++;
+		if (m_slots.empty() || m_busy_slots == m_slots.size() || width == 0 || height == 0)
+		{
+			m_stats.dropped++;
+			return false;
+		}
+	}
+
+	Readback_Slot& slot = m_slots[(m_head + m_busy_slots) % m_slots.size()];
+	size_t size = (size_t)width * height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	if (slot.capacity < size)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		slot.capacity = size;
+	}
+	//with a pack buffer bound the pointer is an offset, the call returns once the copy is queued
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	slot.request = request;
+	m_busy_slots++;
+	return true;
+}
+
+void Frame_Capture::update()
+{
+	//slots are filled in order, so the oldest one finishes first
+	while (m_busy_slots > 0 && retire(m_slots[m_head], false))
+	{
+		m_head = (m_head + 1) % (uint32_t)m_slots.size();
+		m_busy_slots--;
+	}
+}
+
+void Frame_Capture::flush()
+{
+	while (m_busy_slots > 0)
+	{
+		retire(m_slots[m_head], true);
+		m_head = (m_head + 1) % (uint32_t)m_slots.size();
+		m_busy_slots--;
+	}
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle_cv.wait(lock, [this] { return m_jobs.empty() && !m_processing; });
+}
+
+std::vector<Capture_Result> Frame_Capture::take_results()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<Capture_Result> results;
+	results.swap(m_results);
+	return results;
+}
+
+Capture_Stats Frame_Capture::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+bool Frame_Capture::retire(Readback_Slot& slot, bool block)
+{
+	GLenum status = glClientWaitSync(slot.fence, block ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, 0);
+	while (block && status == GL_TIMEOUT_EXPIRED)
+		status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	double map_start = glfwGetTime();
+	std::vector<unsigned char> pixels;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_free_pixels.empty())
+		{
+			pixels.swap(m_free_pixels.back());
+			m_free_pixels.pop_back();
+		}
+	}
+	size_t size = (size_t)slot.width * slot.height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (mapped)
+	{
+		pixels.resize(size);
+		memcpy(pixels.data(), mapped, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.map_ms = (float)((glfwGetTime() - map_start) * 1000.0);
+	if (!mapped)
+	{
+		Capture_Result result;
+		result.name = slot.request.name;
+		result.mode = slot.request.mode;
+		result.message = "could not map the readback buffer";
+		m_results.push_back(result);
+		m_stats.failed++;
+		m_free_pixels.push_back(std::move(pixels));
+		return true;
+	}
+	m_jobs.emplace_back();
+	Capture_Job& job = m_jobs.back();
+	job.request = slot.request;
+	job.width = slot.width;
+	job.height = slot.height;
+	job.pixels.swap(pixels);
+	m_work_cv.notify_one();
+	return true;
+}
+
+void Frame_Capture::worker_loop()
+{
+	//RGB conversion target of every PNG, grows to the largest capture once and is reused after that
+	std::vector<unsigned char> rgb;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_work_cv.wait(lock, [this] { return m_exit || !m_jobs.empty(); });
+		if (m_jobs.empty())
+			return;
+		Capture_Job job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		m_processing = true;
+		lock.unlock();
+
+		Capture_Result result = process(job, rgb);
+
+		lock.lock();
+		m_processing = false;
+		if (result.passed)
+			m_stats.completed++;
+		else
+			m_stats.failed++;
+		m_results.push_back(std::move(result));
+		m_free_pixels.push_back(std::move(job.pixels));
+		if (m_jobs.empty())
+			m_idle_cv.notify_all();
+	}
+}
+
+//RGB rows top down from the RGBA rows bottom up that glReadPixels gives, alpha of the back buffer is meaningless
+static void to_top_down_rgb(const unsigned char* pixels, uint32_t width, uint32_t height, std::vector<unsigned char>& rgb)
+{
+	rgb.resize((size_t)width * height * 3);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const unsigned char* source = pixels + (size_t)(height - 1 - y) * width * 4;
+		unsigned char* target = rgb.data() + (size_t)y * width * 3;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			target[x * 3 + 0] = source[x * 4 + 0];
+			target[x * 3 + 1] = source[x * 4 + 1];
+			target[x * 3 + 2] = source[x * 4 + 2];
+		}
+	}
+}
+
+Capture_Result Frame_Capture::process(Capture_Job& job, std::vector<unsigned char>& rgb)
+{
+	Capture_Result result;
+	result.name = job.request.name;
+	result.mode = job.request.mode;
+	result.width = job.width;
+	result.height = job.height;
+
+	if (job.request.mode == Capture_Mode::Write_Png)
+	{
+		to_top_down_rgb(job.pixels.data(), job.width, job.height, rgb);
+		result.passed = stbi_write_png(job.request.path.c_str(), (int)job.width, (int)job.height, 3, rgb.data(), (int)job.width * 3) != 0;
+		if (!result.passed)
+			result.message = "could not write " + job.request.path;
+		return result;
+	}
+
+	File_Handle file = File_System::read(job.request.path);
+	if (!file->is_ready())
+	{
+		result.message = "missing reference " + job.request.path;
+		return result;
+	}
+	//flipped so its rows run bottom up like the readback
+	Decoded_Image reference;
+	Image_Decoder::decode(reference, file->get_data().data(), file->get_size(), true);
+	if (!reference.pixels || reference.channels < 3)
+	{
+		result.message = "could not decode reference " + job.request.path;
+		Image_Decoder::free_image(reference);
+		return result;
+	}
+	if ((uint32_t)reference.width != job.width || (uint32_t)reference.height != job.height)
+	{
+		result.message = "reference is " + std::to_string(reference.width) + "x" + std::to_string(reference.height)
+			+ ", capture is " + std::to_string(job.width) + "x" + std::to_string(job.height);
+		Image_Decoder::free_image(reference);
+		return result;
+	}
+
+	size_t pixel_count = (size_t)job.width * job.height;
+	for (size_t i = 0; i < pixel_count; i++)
+	{
+		const unsigned char* captured = job.pixels.data() + i * 4;
+		const unsigned char* expected = reference.pixels + i * reference.channels;
+		uint32_t difference = 0;
+		for (int c = 0; c < 3; c++)
+			difference = std::max(difference, (uint32_t)std::abs((int)captured[c] - (int)expected[c]));
+		result.max_difference = std::max(result.max_difference, difference);
+		if (difference > job.request.tolerance)
+			result.mismatched_pixels++;
+	}
+
+	result.passed = (double)result.mismatched_pixels <= (double)job.request.max_mismatch * (double)pixel_count;
+	if (!result.passed)
+	{
+		result.message = std::to_string(result.mismatched_pixels) + " of " + std::to_string(pixel_count)
+			+ " pixels differ by more than " + std::to_string(job.request.tolerance) + ", up to " + std::to_string(result.max_difference);
+		//the difference image reuses the readback: matching pixels dimmed, mismatches red
+		if (!job.request.difference_path.empty())
+		{
+			for (size_t i = 0; i < pixel_count; i++)
+			{
+				unsigned char* captured = job.pixels.data() + i * 4;
+				const unsigned char* expected = reference.pixels + i * reference.channels;
+				bool mismatch = false;
+				for (int c = 0; c < 3; c++)
+					mismatch |= (uint32_t)std::abs((int)captured[c] - (int)expected[c]) > job.request.tolerance;
+				if (mismatch)
+				{
+					captured[0] = 255;
+					captured[1] = 0;
+					captured[2] = 0;
+				}
+				else
+				{
+					for (int c = 0; c < 3; c++)
+						captured[c] = (unsigned char)(captured[c] / 4);
+				}
+			}
+			to_top_down_rgb(job.pixels.data(), job.width, job.height, rgb);
+			stbi_write_png(job.request.difference_path.c_str(), (int)job.width, (int)job.height, 3, rgb.data(), (int)job.width * 3);
+		}
+	}
+	Image_Decoder::free_image(reference);
+	return result;
+}
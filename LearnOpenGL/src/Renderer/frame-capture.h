@@ -0,0 +1,110 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+enum class Capture_Mode { Write_Png, Compare };
+
+struct Capture_Request
+{
+	std::string name;					//shows up in the result
+	Capture_Mode mode = Capture_Mode::Write_Png;
+	std::string path;					//PNG to write, or the reference image to compare against
+	uint32_t tolerance = 2;				//per channel difference that still counts as equal
+	float max_mismatch = 0.001f;		//fraction of pixels allowed to differ by more than the tolerance
+	std::string difference_path;		//compare only: written on failure, mismatching pixels in red, empty skips it
+};
+
+struct Capture_Result
+{
+	std::string name;
+	Capture_Mode mode = Capture_Mode::Write_Png;
+	bool passed = false;
+	uint32_t width = 0, height = 0;
+	uint32_t max_difference = 0;		//largest per channel difference, compare only
+	uint64_t mismatched_pixels = 0;
+	std::string message;				//why it failed, empty when it passed
+};
+
+struct Capture_Stats
+{
+	uint64_t requested = 0;
+	uint64_t dropped = 0;				//every buffer of the ring still busy, the frame was skipped
+	uint64_t completed = 0;
+	uint64_t failed = 0;
+	float map_ms = 0.0f;				//last map and copy out of a finished buffer, the only readback cost on the GL thread
+};
+
+//Asynchronous readback of the default framebuffer for captures and image regression checks.
+//capture() only queues a glReadPixels into a pixel pack buffer of a small ring and fences it, the copy
+//happens on the GPU timeline. update() polls the fences without waiting and maps the buffers that are
+//done, a worker thread then writes the PNG or compares it with a reference image. A busy ring drops
+//the capture instead of stalling, so continuous capture keeps the frame rate.
+//Everything but take_results() and get_stats() belongs to the thread that owns the GL context.
+class Frame_Capture
+{
+public:
+	Frame_Capture() = default;
+	~Frame_Capture();
+	Frame_Capture(const Frame_Capture&) = delete;
+	Frame_Capture& operator=(const Frame_Capture&) = delete;
+
+	void init(uint32_t ring_size = 3);
+	//finishes every queued capture first
+	void shutdown();
+
+	//reads the back buffer of the frame that was just drawn, call before the swap.
+	//false when the ring is full and the capture was dropped
+	bool capture(uint32_t width, uint32_t height, const Capture_Request& request);
+	//once per frame: hands finished readbacks to the worker, never waits for the GPU
+	void update();
+	//blocks until every capture is read back and processed, headless checks call it before take_results()
+	void flush();
+
+	std::vector<Capture_Result> take_results();
+	Capture_Stats get_stats() const;
+	bool is_busy() const { return m_busy_slots > 0; }
+
+private:
+	struct Readback_Slot
+	{
+		GLuint buffer = 0;
+		GLsync fence = nullptr;
+		uint32_t width = 0, height = 0;
+		size_t capacity = 0;
+		Capture_Request request;
+	};
+	struct Capture_Job
+	{
+		Capture_Request request;
+		uint32_t width = 0, height = 0;
+		std::vector<unsigned char> pixels;	//RGBA rows bottom up, as glReadPixels returns them
+	};
+
+	//maps a slot whose fence signalled, or waits for it when block is set
+	bool retire(Readback_Slot& slot, bool block);
+	void worker_loop();
+	//rgb is the worker's scratch for the PNGs it writes
+	static Capture_Result process(Capture_Job& job, std::vector<unsigned char>& rgb);
+
+private:
+	std::vector<Readback_Slot> m_slots;
+	uint32_t m_head = 0;				//oldest slot in flight
+	uint32_t m_busy_slots = 0;
+
+	std::thread m_worker;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_work_cv;
+	std::condition_variable m_idle_cv;
+	std::deque<Capture_Job> m_jobs;
+	std::vector<std::vector<unsigned char>> m_free_pixels;	//recycled so continuous capture does not allocate
+	std::vector<Capture_Result> m_results;
+	bool m_processing = false;
+	bool m_exit = false;
+	Capture_Stats m_stats;
+};
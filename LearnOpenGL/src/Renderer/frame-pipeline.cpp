@@ -0,0 +1,192 @@
+#include "frame-pipeline.h"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+
+Frame_Pipeline::Frame_Pipeline(GLFWwindow* window, bool threaded, uint32_t frames_in_flight)
+	:m_window(window), m_threaded(threaded), m_packets(std::max(frames_in_flight, 1u))
+{
+	m_free.slots.resize(m_packets.size());
+	m_ready.slots.resize(m_packets.size());
+	for (Frame_Packet& packet : m_packets)
+		m_free.push_back(&packet);
+}
+
+Frame_Pipeline::~Frame_Pipeline()
+{
+	stop();
+}
+
+void Frame_Pipeline::start(const std::function<void(const Frame_Packet&)>& submit)
+{
+	m_submit = submit;
+	m_running = true;
+	if (!m_threaded)
+		return;
+
+	//a context can only be current on one thread at a time
+	glfwMakeContextCurrent(nullptr);
+	m_exit = false;
+	m_render_thread = std::thread(&Frame_Pipeline::render_loop, this);
+}
+
+void Frame_Pipeline::stop()
+{
+	if (!m_running)
+		return;
+	m_running = false;
+	if (!m_threaded)
+	{
+		retire_fences(0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_ready_cv.notify_one();
+	m_render_thread.join();
+	glfwMakeContextCurrent(m_window);
+}
+
+void Frame_Pipeline::latch_camera(const Camera_Latch& latch)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_latch = latch;
+	m_has_latch = true;
+}
+
+Frame_Packet& Frame_Pipeline::begin_packet()
+{
+	double wait_start = glfwGetTime();
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_free_cv.wait(lock, [this] { return !m_free.empty(); });
+		m_building = m_free.front();
+		m_free.pop_front();
+		m_stats.wait_ms = (float)((glfwGetTime() - wait_start) * 1000.0);
+	}
+	m_build_start = glfwGetTime();
+
+	//the old draw list lives in the arena, drop it before the reset and reserve what the last frame used
+	Frame_Packet& packet = *m_building;
+	size_t draw_count = packet.draws.size();
+	Arena_Vector<Draw_Item>(Arena_Allocator<Draw_Item>(&packet.arena)).swap(packet.draws);
+	packet.arena.reset();
+	packet.draws.reserve(draw_count);
+	packet.frame_index = m_frame_index++;
+	packet.capture = nullptr;
+	packet.particles = Particle_Draw();
+	return *m_building;
+}
+
+void Frame_Pipeline::end_packet()
+{
+	Frame_Packet* packet = m_building;
+	m_building = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.build_ms = (float)((glfwGetTime() - m_build_start) * 1000.0);
+	}
+
+	if (!m_threaded)
+	{
+		submit_packet(*packet);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.push_back(packet);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_ready.push_back(packet);
+	}
+	m_ready_cv.notify_one();
+}
+
+Frame_Pipeline_Stats Frame_Pipeline::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void Frame_Pipeline::retire_fences(size_t keep)
+{
+	while (m_fence_count)
+	{
+		Frame_Fence& oldest = m_fences[m_fence_head];
+		GLuint64 timeout = m_fence_count > keep ? 100000000 : 0;
+		GLenum result = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if (result == GL_TIMEOUT_EXPIRED && timeout)
+			continue;
+		if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+			break;
+
+		float present_ms = (float)((glfwGetTime() - oldest.submit_time) * 1000.0);
+		glDeleteSync(oldest.fence);
+		m_fence_head = (m_fence_head + 1) % MAX_GPU_FRAMES;
+		m_fence_count--;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.submit_to_present_ms = present_ms;
+	}
+}
+
+void Frame_Pipeline::submit_packet(Frame_Packet& packet)
+{
+	//keep the driver from queuing more than m_max_gpu_frames, every queued frame is a frame of latency
+	double wait_start = glfwGetTime();
+	if (m_max_gpu_frames)
+		retire_fences(m_max_gpu_frames - 1);
+	double submit_start = glfwGetTime();
+
+	if (m_late_latch)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_has_latch && m_latch.input_time > packet.input_time)
+		{
+			packet.input_time = m_latch.input_time;
+			packet.view = m_latch.view;
+			packet.projection = m_latch.projection;
+			packet.camera_position = m_latch.camera_position;
+		}
+	}
+
+	m_submit(packet);
+	glfwSwapBuffers(m_window);
+	if (m_max_gpu_frames && m_fence_count < MAX_GPU_FRAMES)
+		m_fences[(m_fence_head + m_fence_count++) % MAX_GPU_FRAMES] = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), submit_start };
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.gpu_wait_ms = (float)((submit_start - wait_start) * 1000.0);
+	m_stats.submit_ms = (float)((glfwGetTime() - submit_start) * 1000.0);
+	m_stats.input_to_submit_ms = packet.input_time > 0.0 ? (float)((submit_start - packet.input_time) * 1000.0) : 0.0f;
+}
+
+void Frame_Pipeline::render_loop()
+{
+	glfwMakeContextCurrent(m_window);
+	while (true)
+	{
+		Frame_Packet* packet;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			//drain what is already queued before leaving
+			m_ready_cv.wait(lock, [this] { return m_exit || !m_ready.empty(); });
+			if (m_ready.empty())
+				break;
+			packet = m_ready.front();
+			m_ready.pop_front();
+		}
+
+		submit_packet(*packet);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(packet);
+		}
+		m_free_cv.notify_one();
+	}
+	retire_fences(0);
+	glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "vertex-array-cache.h"
+#include "particle-system.h"
+#include "Core/allocators.h"
+
+struct GLFWwindow;
+struct Capture_Request;
+
+struct Draw_Item
+{
+	Shader* shader = nullptr;
+	Vertex_Binding geometry;
+	GLuint texture = 0;
+	uint32_t count = 0;				//vertices, or indices when indexed
+	bool indexed = false;
+	glm::mat4 model = glm::mat4(1.0f);
+};
+
+//all particles of a frame, drawn in one instanced call after the opaque draws
+struct Particle_Draw
+{
+	Shader* shader = nullptr;
+	const Particle_Instance* instances = nullptr;	//in the packet's arena, back to front
+	uint32_t count = 0;
+};
+
+//Everything the render thread needs for one frame. Filled by the main thread, read-only once published.
+//Transient data lives in the packet's arena, which is reset when the packet is reused.
+struct Frame_Packet
+{
+	Frame_Packet() : draws(Arena_Allocator<Draw_Item>(&arena)) {}
+	Frame_Packet(const Frame_Packet&) = delete;
+	Frame_Packet& operator=(const Frame_Packet&) = delete;
+
+	Linear_Arena arena;
+	uint64_t frame_index = 0;
+	double input_time = 0.0;		//glfwGetTime() when the input behind the camera was sampled
+	uint32_t viewport_width = 0;
+	uint32_t viewport_height = 0;
+	bool dynamic_resolution = false;	//3D scene drawn below the viewport size and upscaled, see Dynamic_Resolution
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::vec3 camera_position = glm::vec3(0.0f);
+	glm::vec4 clear_color = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+	const Capture_Request* capture = nullptr;	//read back once drawn, must outlive the submission
+	Arena_Vector<Draw_Item> draws;
+	Particle_Draw particles;
+};
+
+struct Frame_Pipeline_Stats
+{
+	float build_ms = 0.0f;			//main thread, begin_packet to end_packet
+	float wait_ms = 0.0f;			//main thread blocked on a free packet
+	float submit_ms = 0.0f;			//render thread, GL submission and swap
+	float gpu_wait_ms = 0.0f;		//render thread blocked on the GPU queue cap
+	float input_to_submit_ms = 0.0f;	//input sample to the start of GL submission
+	float submit_to_present_ms = 0.0f;	//start of submission to the frame's fence signalling, an upper bound
+};
+
+//newest camera published by the main thread, picked up by the render thread right before it submits
+struct Camera_Latch
+{
+	double input_time = 0.0;
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::vec3 camera_position = glm::vec3(0.0f);
+};
+
+//Two-thread frame pipeline: the main thread builds frame N+1 while a render thread that owns the GL
+//context submits frame N. At most frames_in_flight packets exist, so the main thread can never run
+//further ahead than that. With threaded = false the packet is submitted inline, same code path.
+class Frame_Pipeline
+{
+public:
+	static constexpr uint32_t MAX_GPU_FRAMES = 4;
+
+	Frame_Pipeline(GLFWwindow* window, bool threaded = true, uint32_t frames_in_flight = 2);
+	~Frame_Pipeline();
+
+	//hands the GL context to the render thread, submit runs there once per packet before the swap
+	void start(const std::function<void(const Frame_Packet&)>& submit);
+	//waits for the last packet, then gives the context back to the calling thread
+	void stop();
+
+	//main thread: a cleared packet to fill, blocks while every packet is still in flight
+	Frame_Packet& begin_packet();
+	void end_packet();
+
+	//frames the driver may queue before submission blocks, enforced with fence syncs, 0 leaves it to the driver
+	void set_max_gpu_frames(uint32_t frames) { m_max_gpu_frames = std::min(frames, MAX_GPU_FRAMES); }
+	//the render thread replaces the packet camera with the newest latched one if it is more recent.
+	//culling still used the packet camera, so keep culling margins for fast turns
+	void set_late_latch(bool enable) { m_late_latch = enable; }
+	void latch_camera(const Camera_Latch& latch);
+
+	bool is_threaded() const { return m_threaded; }
+	Frame_Pipeline_Stats get_stats() const;
+
+private:
+	void render_loop();
+	void submit_packet(Frame_Packet& packet);
+	//render thread: retires signalled fences, blocking on the oldest until at most keep remain
+	void retire_fences(size_t keep);
+
+private:
+	GLFWwindow* m_window;
+	bool m_threaded;
+	std::function<void(const Frame_Packet&)> m_submit;
+
+	//fixed ring of packet pointers, a deque would allocate as it wraps
+	struct Packet_Queue
+	{
+		std::vector<Frame_Packet*> slots;
+		size_t head = 0;
+		size_t count = 0;
+
+		bool empty() const { return count == 0; }
+		Frame_Packet* front() const { return slots[head]; }
+		void pop_front() { head = (head + 1) % slots.size(); count--; }
+		void push_back(Frame_Packet* packet) { slots[(head + count++) % slots.size()] = packet; }
+	};
+
+	std::vector<Frame_Packet> m_packets;
+	Packet_Queue m_free;
+	Packet_Queue m_ready;
+	Frame_Packet* m_building = nullptr;
+	uint64_t m_frame_index = 0;
+
+	std::thread m_render_thread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_free_cv;
+	std::condition_variable m_ready_cv;
+	bool m_exit = false;
+	bool m_running = false;
+
+	Frame_Pipeline_Stats m_stats;
+	double m_build_start = 0.0;
+
+	bool m_late_latch = false;
+	bool m_has_latch = false;
+	Camera_Latch m_latch;
+
+	struct Frame_Fence
+	{
+		GLsync fence;
+		double submit_time;
+	};
+	uint32_t m_max_gpu_frames = 0;
+	Frame_Fence m_fences[MAX_GPU_FRAMES];
+	uint32_t m_fence_head = 0;
+	uint32_t m_fence_count = 0;
+};
@@ -0,0 +1,436 @@
+#include "gl-instrumentation.h"
+
+#include <glad/glad.h>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+#ifdef GL_INSTRUMENTATION
+#include <atomic>
+#include <mutex>
+#endif
+
+#define GL_CALL_NAME(name, category) #name,
+static const char* s_call_names[GL_CALL_COUNT] = { GL_INSTRUMENTED_CALLS(GL_CALL_NAME) };
+#undef GL_CALL_NAME
+
+#define GL_CALL_CATEGORY(name, category) GL_CALL_CATEGORY_##category,
+static const uint8_t s_call_categories[GL_CALL_COUNT] = { GL_INSTRUMENTED_CALLS(GL_CALL_CATEGORY) };
+#undef GL_CALL_CATEGORY
+
+static const char* s_category_names[GL_CALL_CATEGORY_COUNT] = { "draw", "bind", "state", "uniform", "upload", "other" };
+
+const char* Gl_Instrumentation::get_call_name(uint32_t call)
+{
+	return call < GL_CALL_COUNT ? s_call_names[call] : "";
+}
+
+const char* Gl_Instrumentation::get_category_name(uint32_t category)
+{
+	return category < GL_CALL_CATEGORY_COUNT ? s_category_names[category] : "";
+}
+
+std::string Gl_Instrumentation::format_summary(const Gl_Frame_Stats& stats)
+{
+	std::string summary;
+	char line[160];
+	snprintf(line, sizeof(line), "frame %llu: %llu calls, %llu redundant, %.1f KB buffer upload, %.1f KB texture upload\n",
+		(unsigned long long)stats.frame, (unsigned long long)stats.total_calls, (unsigned long long)stats.total_redundant,
+		stats.buffer_upload_bytes / 1024.0, stats.texture_upload_bytes / 1024.0);
+	summary += line;
+	for (uint32_t category = 0; category < GL_CALL_CATEGORY_COUNT; category++)
+	{
+		snprintf(line, sizeof(line), "  %-8s %llu\n", s_category_names[category], (unsigned long long)stats.category_calls[category]);
+		summary += line;
+	}
+
+	std::vector<uint32_t> called;
+	for (uint32_t call = 0; call < GL_CALL_COUNT; call++)
+		if (stats.calls[call] > 0)
+			called.push_back(call);
+	std::sort(called.begin(), called.end(), [&](uint32_t a, uint32_t b) { return stats.calls[a] > stats.calls[b]; });
+	for (uint32_t call : called)
+	{
+		if (stats.redundant[call] > 0)
+			snprintf(line, sizeof(line), "  %-34s %8llu  (%llu redundant)\n", s_call_names[call], (unsigned long long)stats.calls[call], (unsigned long long)stats.redundant[call]);
+		else
+			snprintf(line, sizeof(line), "  %-34s %8llu\n", s_call_names[call], (unsigned long long)stats.calls[call]);
+		summary += line;
+	}
+	return summary;
+}
+
+#ifdef GL_INSTRUMENTATION
+
+//calls arrive from the render thread and from the shader compiler's context, so the counters are atomics
+static std::atomic<uint64_t> s_calls[GL_CALL_COUNT];
+static std::atomic<uint64_t> s_redundant[GL_CALL_COUNT];
+static std::atomic<uint64_t> s_buffer_upload_bytes{ 0 };
+static std::atomic<uint64_t> s_texture_upload_bytes{ 0 };
+static std::mutex s_published_mutex;
+static Gl_Frame_Stats s_published;
+static uint64_t s_frame = 0;
+
+//What the current context has bound, per thread since each context is current on one thread at a time.
+//Starts unknown, so the first set after a context moves threads is never reported as redundant.
+static const uint32_t s_tracked_texture_units = 32;
+static const GLenum s_tracked_texture_targets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D, GL_TEXTURE_BUFFER };
+static const uint32_t s_tracked_texture_target_count = sizeof(s_tracked_texture_targets) / sizeof(s_tracked_texture_targets[0]);
+static const GLenum s_tracked_buffer_targets[] = { GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+	GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER };
+static const uint32_t s_tracked_buffer_target_count = sizeof(s_tracked_buffer_targets) / sizeof(s_tracked_buffer_targets[0]);
+static const GLenum s_tracked_capabilities[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_STENCIL_TEST, GL_SCISSOR_TEST,
+	GL_POLYGON_OFFSET_FILL, GL_MULTISAMPLE, GL_FRAMEBUFFER_SRGB, GL_DEPTH_CLAMP, GL_PROGRAM_POINT_SIZE };
+static const uint32_t s_tracked_capability_count = sizeof(s_tracked_capabilities) / sizeof(s_tracked_capabilities[0]);
+static const int32_t UNKNOWN = -1;
+
+struct Gl_Shadow_State
+{
+	Gl_Shadow_State()
+	{
+		forget_textures();
+		std::fill(std::begin(buffers), std::end(buffers), UNKNOWN);
+		std::fill(std::begin(capabilities), std::end(capabilities), UNKNOWN);
+		std::fill(std::begin(viewport), std::end(viewport), UNKNOWN);
+	}
+
+	int64_t program = UNKNOWN;
+	int64_t vertex_array = UNKNOWN;
+	int64_t draw_framebuffer = UNKNOWN;
+	int64_t read_framebuffer = UNKNOWN;
+	int64_t active_texture = UNKNOWN;
+	int64_t textures[s_tracked_texture_units][s_tracked_texture_target_count];
+	int64_t buffers[s_tracked_buffer_target_count];
+	int32_t capabilities[s_tracked_capability_count];
+	int64_t depth_func = UNKNOWN;
+	int64_t depth_mask = UNKNOWN;
+	int64_t blend_func = UNKNOWN;
+	int64_t cull_face = UNKNOWN;
+	int64_t viewport[4];
+
+	void forget_textures() { std::fill(&textures[0][0], &textures[0][0] + s_tracked_texture_units * s_tracked_texture_target_count, UNKNOWN); }
+};
+static thread_local Gl_Shadow_State s_state;
+
+static void count_redundant(uint32_t call)
+{
+	s_redundant[call].fetch_add(1, std::memory_order_relaxed);
+}
+
+//stores value and returns whether it was already there
+static bool update(int64_t& tracked, int64_t value)
+{
+	bool same = tracked == value;
+	tracked = value;
+	return same;
+}
+
+template<typename Array>
+static int32_t find_index(const Array& array, GLenum value)
+{
+	for (uint32_t i = 0; i < sizeof(array) / sizeof(array[0]); i++)
+		if (array[i] == value)
+			return (int32_t)i;
+	return -1;
+}
+
+static uint64_t get_pixel_size(GLenum format, GLenum type)
+{
+	switch (type)
+	{
+	case GL_UNSIGNED_INT_24_8:
+	case GL_UNSIGNED_INT_10F_11F_11F_REV:
+	case GL_UNSIGNED_INT_2_10_10_10_REV:
+	case GL_UNSIGNED_INT_8_8_8_8:
+	case GL_UNSIGNED_INT_8_8_8_8_REV:
+		return 4;
+	}
+	uint64_t component_size = 1;
+	if (type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT)
+		component_size = 2;
+	else if (type == GL_INT || type == GL_UNSIGNED_INT || type == GL_FLOAT)
+		component_size = 4;
+	uint64_t components = 1;
+	if (format == GL_RG || format == GL_RG_INTEGER)
+		components = 2;
+	else if (format == GL_RGB || format == GL_BGR || format == GL_RGB_INTEGER)
+		components = 3;
+	else if (format == GL_RGBA || format == GL_BGRA || format == GL_RGBA_INTEGER)
+		components = 4;
+	return components * component_size;
+}
+
+static void count_texture_upload(GLenum format, GLenum type, uint64_t texels, const void* pixels)
+{
+	//a null pointer only allocates, unless a pixel unpack buffer is bound and it is an offset into that
+	static const int32_t unpack = find_index(s_tracked_buffer_targets, GL_PIXEL_UNPACK_BUFFER);
+	if (!pixels && s_state.buffers[unpack] <= 0)
+		return;
+	s_texture_upload_bytes.fetch_add(texels * get_pixel_size(format, type), std::memory_order_relaxed);
+}
+
+//Hooks inspect the arguments of a call before it is forwarded, the default does nothing
+template<uint32_t Call>
+struct Gl_Observer
+{
+	template<typename... Args>
+	static void before(Args...) {}
+};
+
+template<> struct Gl_Observer<GL_CALL_glUseProgram>
+{
+	static void before(GLuint program) { if (update(s_state.program, program)) count_redundant(GL_CALL_glUseProgram); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glBindVertexArray>
+{
+	static void before(GLuint vertex_array) { if (update(s_state.vertex_array, vertex_array)) count_redundant(GL_CALL_glBindVertexArray); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glBindBuffer>
+{
+	//the element array binding belongs to the vertex array, it is not tracked
+	static void before(GLenum target, GLuint buffer)
+	{
+		int32_t index = find_index(s_tracked_buffer_targets, target);
+		if (index >= 0 && update(s_state.buffers[index], buffer))
+			count_redundant(GL_CALL_glBindBuffer);
+	}
+};
+
+//also binds the generic target, only that part is tracked
+template<> struct Gl_Observer<GL_CALL_glBindBufferBase>
+{
+	static void before(GLenum target, GLuint, GLuint buffer)
+	{
+		int32_t index = find_index(s_tracked_buffer_targets, target);
+		if (index >= 0)
+			s_state.buffers[index] = buffer;
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glActiveTexture>
+{
+	static void before(GLenum unit) { if (update(s_state.active_texture, unit)) count_redundant(GL_CALL_glActiveTexture); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glBindTexture>
+{
+	static void before(GLenum target, GLuint texture)
+	{
+		int32_t index = find_index(s_tracked_texture_targets, target);
+		int64_t unit = s_state.active_texture - GL_TEXTURE0;
+		if (index < 0 || s_state.active_texture == UNKNOWN || unit < 0 || unit >= (int64_t)s_tracked_texture_units)
+			return;
+		if (update(s_state.textures[unit][index], texture))
+			count_redundant(GL_CALL_glBindTexture);
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glBindFramebuffer>
+{
+	static void before(GLenum target, GLuint framebuffer)
+	{
+		bool same = true;
+		if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+			same = update(s_state.draw_framebuffer, framebuffer) && same;
+		if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+			same = update(s_state.read_framebuffer, framebuffer) && same;
+		if (same)
+			count_redundant(GL_CALL_glBindFramebuffer);
+	}
+};
+
+template<bool Enable, uint32_t Call>
+static void observe_capability(GLenum capability)
+{
+	int32_t index = find_index(s_tracked_capabilities, capability);
+	if (index < 0)
+		return;
+	bool same = s_state.capabilities[index] == (Enable ? 1 : 0);
+	s_state.capabilities[index] = Enable ? 1 : 0;
+	if (same)
+		count_redundant(Call);
+}
+
+template<> struct Gl_Observer<GL_CALL_glEnable>
+{
+	static void before(GLenum capability) { observe_capability<true, GL_CALL_glEnable>(capability); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glDisable>
+{
+	static void before(GLenum capability) { observe_capability<false, GL_CALL_glDisable>(capability); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glDepthFunc>
+{
+	static void before(GLenum function) { if (update(s_state.depth_func, function)) count_redundant(GL_CALL_glDepthFunc); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glDepthMask>
+{
+	static void before(GLboolean mask) { if (update(s_state.depth_mask, mask)) count_redundant(GL_CALL_glDepthMask); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glBlendFunc>
+{
+	static void before(GLenum source, GLenum destination)
+	{
+		if (update(s_state.blend_func, ((int64_t)source << 32) | destination))
+			count_redundant(GL_CALL_glBlendFunc);
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glCullFace>
+{
+	static void before(GLenum face) { if (update(s_state.cull_face, face)) count_redundant(GL_CALL_glCullFace); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glViewport>
+{
+	static void before(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		bool same = update(s_state.viewport[0], x);
+		same = update(s_state.viewport[1], y) && same;
+		same = update(s_state.viewport[2], width) && same;
+		same = update(s_state.viewport[3], height) && same;
+		if (same)
+			count_redundant(GL_CALL_glViewport);
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glBufferData>
+{
+	static void before(GLenum, GLsizeiptr size, const void* data, GLenum)
+	{
+		if (data)
+			s_buffer_upload_bytes.fetch_add((uint64_t)size, std::memory_order_relaxed);
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glBufferSubData>
+{
+	static void before(GLenum, GLintptr, GLsizeiptr size, const void*)
+	{
+		s_buffer_upload_bytes.fetch_add((uint64_t)size, std::memory_order_relaxed);
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glTexImage2D>
+{
+	static void before(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint, GLenum format, GLenum type, const void* pixels)
+	{
+		count_texture_upload(format, type, (uint64_t)width * height, pixels);
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glTexImage3D>
+{
+	static void before(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLint, GLenum format, GLenum type, const void* pixels)
+	{
+		count_texture_upload(format, type, (uint64_t)width * height * depth, pixels);
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glTexSubImage2D>
+{
+	static void before(GLenum, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+	{
+		count_texture_upload(format, type, (uint64_t)width * height, pixels);
+	}
+};
+
+template<> struct Gl_Observer<GL_CALL_glTexSubImage3D>
+{
+	static void before(GLenum, GLint, GLint, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+	{
+		count_texture_upload(format, type, (uint64_t)width * height * depth, pixels);
+	}
+};
+
+//deleting a bound object unbinds it, a name handed out again later must not look redundant
+template<> struct Gl_Observer<GL_CALL_glDeleteBuffers>
+{
+	static void before(GLsizei, const GLuint*) { std::fill(std::begin(s_state.buffers), std::end(s_state.buffers), UNKNOWN); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glDeleteTextures>
+{
+	static void before(GLsizei, const GLuint*) { s_state.forget_textures(); }
+};
+
+template<> struct Gl_Observer<GL_CALL_glDeleteVertexArrays>
+{
+	static void before(GLsizei, const GLuint*) { s_state.vertex_array = UNKNOWN; }
+};
+
+template<> struct Gl_Observer<GL_CALL_glDeleteFramebuffers>
+{
+	static void before(GLsizei, const GLuint*) { s_state.draw_framebuffer = s_state.read_framebuffer = UNKNOWN; }
+};
+
+//Counting wrapper with the exact signature of the glad pointer it replaces
+template<uint32_t Call, typename Function>
+struct Gl_Hook;
+
+template<uint32_t Call, typename Result, typename... Args>
+struct Gl_Hook<Call, Result (APIENTRYP)(Args...)>
+{
+	static Result (APIENTRYP original)(Args...);
+
+	static Result APIENTRY forward(Args... args)
+	{
+		s_calls[Call].fetch_add(1, std::memory_order_relaxed);
+		Gl_Observer<Call>::before(args...);
+		return original(args...);
+	}
+};
+
+template<uint32_t Call, typename Result, typename... Args>
+Result (APIENTRYP Gl_Hook<Call, Result (APIENTRYP)(Args...)>::original)(Args...) = nullptr;
+
+template<uint32_t Call, typename Function>
+static void install_hook(Function& pointer)
+{
+	typedef Gl_Hook<Call, Function> Hook;
+	//not loaded (extension missing), or already wrapped
+	if (!pointer || pointer == &Hook::forward)
+		return;
+	Hook::original = pointer;
+	pointer = &Hook::forward;
+}
+
+void Gl_Instrumentation::install()
+{
+#define GL_INSTALL_HOOK(name, category) install_hook<GL_CALL_##name>(glad_##name);
+	GL_INSTRUMENTED_CALLS(GL_INSTALL_HOOK)
+#undef GL_INSTALL_HOOK
+}
+
+void Gl_Instrumentation::end_frame()
+{
+	Gl_Frame_Stats stats;
+	stats.frame = s_frame++;
+	for (uint32_t call = 0; call < GL_CALL_COUNT; call++)
+	{
+		stats.calls[call] = s_calls[call].exchange(0, std::memory_order_relaxed);
+		stats.redundant[call] = s_redundant[call].exchange(0, std::memory_order_relaxed);
+		stats.category_calls[s_call_categories[call]] += stats.calls[call];
+		stats.total_calls += stats.calls[call];
+		stats.total_redundant += stats.redundant[call];
+	}
+	stats.buffer_upload_bytes = s_buffer_upload_bytes.exchange(0, std::memory_order_relaxed);
+	stats.texture_upload_bytes = s_texture_upload_bytes.exchange(0, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(s_published_mutex);
+	s_published = stats;
+}
+
+Gl_Frame_Stats Gl_Instrumentation::get_last_frame()
+{
+	std::lock_guard<std::mutex> lock(s_published_mutex);
+	return s_published;
+}
+
+#endif
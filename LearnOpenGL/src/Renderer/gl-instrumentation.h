@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+//Per frame GL call statistics. Built with GL_INSTRUMENTATION defined (premake --gl-instrumentation),
+//install() swaps the glad function pointers below for wrappers that count the call and forward it.
+//Without the define every function here is an empty inline and the pointers are never touched.
+
+enum Gl_Call_Category
+{
+	GL_CALL_CATEGORY_DRAW,				//draws, dispatches, clears and blits
+	GL_CALL_CATEGORY_BIND,
+	GL_CALL_CATEGORY_STATE,
+	GL_CALL_CATEGORY_UNIFORM,
+	GL_CALL_CATEGORY_UPLOAD,
+	GL_CALL_CATEGORY_OTHER,
+	GL_CALL_CATEGORY_COUNT
+};
+
+//every entry point that is counted, with its category
+#define GL_INSTRUMENTED_CALLS(X) \
+	X(glDrawArrays, DRAW) X(glDrawElements, DRAW) X(glDrawArraysInstanced, DRAW) X(glDrawElementsInstanced, DRAW) \
+	X(glMultiDrawElements, DRAW) X(glMultiDrawElementsIndirect, DRAW) X(glMultiDrawElementsIndirectCount, DRAW) \
+	X(glDispatchCompute, DRAW) X(glClear, DRAW) X(glBlitFramebuffer, DRAW) \
+	X(glUseProgram, BIND) X(glBindVertexArray, BIND) X(glBindBuffer, BIND) X(glBindBufferBase, BIND) \
+	X(glBindVertexBuffer, BIND) X(glActiveTexture, BIND) X(glBindTexture, BIND) X(glBindImageTexture, BIND) \
+	X(glBindFramebuffer, BIND) \
+	X(glEnable, STATE) X(glDisable, STATE) X(glDepthFunc, STATE) X(glDepthMask, STATE) X(glBlendFunc, STATE) \
+	X(glCullFace, STATE) X(glColorMask, STATE) X(glViewport, STATE) X(glClearColor, STATE) X(glPolygonOffset, STATE) \
+	X(glPixelStorei, STATE) X(glDrawBuffer, STATE) X(glReadBuffer, STATE) \
+	X(glUniform1i, UNIFORM) X(glUniform1ui, UNIFORM) X(glUniform1f, UNIFORM) X(glUniform2i, UNIFORM) X(glUniform2f, UNIFORM) \
+	X(glUniform3f, UNIFORM) X(glUniform4f, UNIFORM) X(glUniform3fv, UNIFORM) X(glUniform4fv, UNIFORM) \
+	X(glUniformMatrix4fv, UNIFORM) X(glGetUniformLocation, UNIFORM) \
+	X(glBufferData, UPLOAD) X(glBufferSubData, UPLOAD) X(glTexImage2D, UPLOAD) X(glTexImage3D, UPLOAD) \
+	X(glTexSubImage2D, UPLOAD) X(glTexSubImage3D, UPLOAD) X(glGenerateMipmap, UPLOAD) \
+	X(glMapBufferRange, OTHER) X(glUnmapBuffer, OTHER) X(glReadPixels, OTHER) X(glFenceSync, OTHER) \
+	X(glClientWaitSync, OTHER) X(glGetIntegerv, OTHER) X(glFlush, OTHER) X(glFinish, OTHER) \
+	X(glDeleteBuffers, OTHER) X(glDeleteTextures, OTHER) X(glDeleteVertexArrays, OTHER) X(glDeleteFramebuffers, OTHER)
+
+#define GL_CALL_ENUM(name, category) GL_CALL_##name,
+enum Gl_Call : uint32_t
+{
+	GL_INSTRUMENTED_CALLS(GL_CALL_ENUM)
+	GL_CALL_COUNT
+};
+#undef GL_CALL_ENUM
+
+struct Gl_Frame_Stats
+{
+	uint64_t frame = 0;
+	uint64_t calls[GL_CALL_COUNT] = {};
+	//binds and state sets to what was already current; the call is still made, this only reports it
+	uint64_t redundant[GL_CALL_COUNT] = {};
+	uint64_t category_calls[GL_CALL_CATEGORY_COUNT] = {};
+	uint64_t total_calls = 0;
+	uint64_t total_redundant = 0;
+	uint64_t buffer_upload_bytes = 0;	//glBufferData with data and glBufferSubData
+	uint64_t texture_upload_bytes = 0;	//glTexImage and glTexSubImage from client memory
+};
+
+class Gl_Instrumentation
+{
+public:
+#ifdef GL_INSTRUMENTATION
+	static constexpr bool enabled = true;
+	//after the loader and every extension pointer the app loads itself, calling it again wraps late ones
+	static void install();
+	//once per frame on the render thread: publishes what was counted since the last call
+	static void end_frame();
+	static Gl_Frame_Stats get_last_frame();
+#else
+	static constexpr bool enabled = false;
+	static void install() {}
+	static void end_frame() {}
+	static Gl_Frame_Stats get_last_frame() { return Gl_Frame_Stats(); }
+#endif
+
+	static const char* get_call_name(uint32_t call);
+	static const char* get_category_name(uint32_t category);
+	//totals per category, then every entry point that was called, most frequent first
+	static std::string format_summary(const Gl_Frame_Stats& stats);
+};
@@ -0,0 +1,338 @@
+#include "gpu-culling.h"
+#include "vertex-array.h"
+#include "shader.h"
+
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+static const uint32_t CULL_GROUP_SIZE = 64;
+static const uint32_t PYRAMID_GROUP_SIZE = 8;
+
+//largest power of two not above size
+static uint32_t previous_power_of_two(uint32_t size)
+{
+	uint32_t power = 1;
+	while (power * 2 <= size)
+		power *= 2;
+	return power;
+}
+
+bool Depth_Pyramid::init(const std::string& shader_directory)
+{
+	m_program = Shader::create_compute_program(shader_directory + "depth-pyramid-comp.glsl");
+	return m_program != 0;
+}
+
+void Depth_Pyramid::shutdown()
+{
+	if (m_texture)
+		glDeleteTextures(1, &m_texture);
+	if (m_program)
+		glDeleteProgram(m_program);
+	m_texture = m_program = 0;
+	m_width = m_height = m_levels = 0;
+}
+
+void Depth_Pyramid::build(GLuint depth_texture, uint32_t width, uint32_t height, const glm::mat4& view_projection)
+{
+	if (!m_program || width == 0 || height == 0)
+		return;
+
+	uint32_t pyramid_width = previous_power_of_two(width), pyramid_height = previous_power_of_two(height);
+	if (pyramid_width != m_width || pyramid_height != m_height)
+	{
+		if (m_texture)
+			glDeleteTextures(1, &m_texture);
+		m_width = pyramid_width;
+		m_height = pyramid_height;
+		m_levels = 1;
+		while ((m_width >> m_levels) || (m_height >> m_levels))
+			m_levels++;
+		glGenTextures(1, &m_texture);
+		glBindTexture(GL_TEXTURE_2D, m_texture);
+		glTexStorage2D(GL_TEXTURE_2D, m_levels, GL_R32F, m_width, m_height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	m_view_projection = view_projection;
+
+	glUseProgram(m_program);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depth_texture);
+	glUniform1i(glGetUniformLocation(m_program, "u_depth"), 0);
+	glUniform2i(glGetUniformLocation(m_program, "u_depth_size"), (GLint)width, (GLint)height);
+	GLint first_level = glGetUniformLocation(m_program, "u_first_level");
+	for (uint32_t level = 0; level < m_levels; level++)
+	{
+		//level 0 reads the depth texture, the source image is bound but unused
+		glUniform1i(first_level, level == 0 ? 1 : 0);
+		glBindImageTexture(0, m_texture, level == 0 ? 0 : level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, m_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		uint32_t level_width = std::max(m_width >> level, 1u), level_height = std::max(m_height >> level, 1u);
+		glDispatchCompute((level_width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (level_height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+	glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glUseProgram(0);
+}
+
+bool Gpu_Culler::is_supported()
+{
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+bool Gpu_Culler::init(const std::string& shader_directory)
+{
+	if (!is_supported())
+	{
+		std::cout << "GPU culling needs OpenGL 4.3" << std::endl;
+		return false;
+	}
+	m_program = Shader::create_compute_program(shader_directory + "gpu-cull-comp.glsl");
+	if (!m_program)
+		return false;
+
+	m_draw_count_supported = GLAD_GL_VERSION_4_6 != 0;
+	if (!m_draw_count_supported && glfwExtensionSupported("GL_ARB_indirect_parameters"))
+	{
+		//same signature as the 4.6 core function, which our glad only loads for 4.6 contexts
+		glad_glMultiDrawElementsIndirectCount = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)glfwGetProcAddress("glMultiDrawElementsIndirectCountARB");
+		m_draw_count_supported = glad_glMultiDrawElementsIndirectCount != nullptr;
+	}
+
+	GLuint buffers[8];
+	glGenBuffers(8, buffers);
+	m_position_buffer = buffers[0];
+	m_attribute_buffer = buffers[1];
+	m_index_buffer = buffers[2];
+	m_mesh_buffer = buffers[3];
+	m_instance_buffer = buffers[4];
+	m_command_buffer = buffers[5];
+	m_visible_buffer = buffers[6];
+	m_counter_buffer = buffers[7];
+
+	uint32_t zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counter_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), &zero, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	//positions at 0, the other attributes at 1-6, the visible model matrices at 8-11 one per draw
+	glGenVertexArrays(1, &m_vertex_array);
+	glBindVertexArray(m_vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, m_position_buffer);
+	apply_vertex_layout(vertex_layout_of<Vertex_Position>(), 0);
+	glBindBuffer(GL_ARRAY_BUFFER, m_attribute_buffer);
+	apply_vertex_layout(vertex_layout_of<Vertex_Attributes>(), 1);
+	glBindBuffer(GL_ARRAY_BUFFER, m_visible_buffer);
+	apply_vertex_layout(vertex_layout_of<Indirect_Instance_Vertex>(), 8);
+	for (uint32_t column = 0; column < 4; column++)
+		glVertexAttribDivisor(8 + column, 1);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+void Gpu_Culler::shutdown()
+{
+	GLuint buffers[8] = { m_position_buffer, m_attribute_buffer, m_index_buffer, m_mesh_buffer,
+		m_instance_buffer, m_command_buffer, m_visible_buffer, m_counter_buffer };
+	glDeleteBuffers(8, buffers);
+	if (m_vertex_array)
+		glDeleteVertexArrays(1, &m_vertex_array);
+	if (m_program)
+		glDeleteProgram(m_program);
+	m_position_buffer = m_attribute_buffer = m_index_buffer = m_mesh_buffer = 0;
+	m_instance_buffer = m_command_buffer = m_visible_buffer = m_counter_buffer = 0;
+	m_vertex_array = m_program = 0;
+	m_command_capacity = 0;
+
+	m_positions.clear();
+	m_attributes.clear();
+	m_indices.clear();
+	m_meshes.clear();
+	m_instances.clear();
+	m_stats = Gpu_Culling_Stats();
+}
+
+uint32_t Gpu_Culler::add_mesh(const std::vector<glm::vec3>& positions, const std::vector<Vertex_Attributes>& attributes, const std::vector<unsigned int>& indices)
+{
+	Gpu_Mesh_Info mesh = {};
+	mesh.bounds_min = mesh.bounds_max = glm::vec4(positions.empty() ? glm::vec3(0.0f) : positions[0], 0.0f);
+	for (const glm::vec3& position : positions)
+	{
+		mesh.bounds_min = glm::min(mesh.bounds_min, glm::vec4(position, 0.0f));
+		mesh.bounds_max = glm::max(mesh.bounds_max, glm::vec4(position, 0.0f));
+	}
+	mesh.index_count = (uint32_t)indices.size();
+	mesh.first_index = (uint32_t)m_indices.size();
+	mesh.base_vertex = (int32_t)m_positions.size();
+
+	m_positions.insert(m_positions.end(), positions.begin(), positions.end());
+	//a mesh without attributes still needs its rows so base_vertex lines up in both streams
+	m_attributes.insert(m_attributes.end(), attributes.begin(), attributes.end());
+	m_attributes.resize(m_positions.size(), Vertex_Attributes());
+	m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+	m_meshes.push_back(mesh);
+	m_geometry_dirty = true;
+	m_stats.meshes = (uint32_t)m_meshes.size();
+	return (uint32_t)m_meshes.size() - 1;
+}
+
+uint32_t Gpu_Culler::add_instance(uint32_t mesh, const glm::mat4& model)
+{
+	if (mesh >= m_meshes.size())
+	{
+		std::cout << "Gpu_Culler: unknown mesh " << mesh << std::endl;
+		return 0xFFFFFFFF;
+	}
+	Gpu_Instance instance = {};
+	instance.model = model;
+	instance.mesh = mesh;
+	m_instances.push_back(instance);
+	m_instances_dirty = true;
+	m_stats.instances = (uint32_t)m_instances.size();
+	return (uint32_t)m_instances.size() - 1;
+}
+
+void Gpu_Culler::set_instance_transform(uint32_t instance, const glm::mat4& model)
+{
+	if (instance >= m_instances.size())
+		return;
+	m_instances[instance].model = model;
+	m_instances_dirty = true;
+}
+
+void Gpu_Culler::clear_instances()
+{
+	m_instances.clear();
+	m_instances_dirty = true;
+	m_stats.instances = 0;
+}
+
+void Gpu_Culler::upload_geometry()
+{
+	if (!m_geometry_dirty)
+		return;
+	glBindBuffer(GL_ARRAY_BUFFER, m_position_buffer);
+	glBufferData(GL_ARRAY_BUFFER, m_positions.size() * sizeof(glm::vec3), m_positions.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, m_attribute_buffer);
+	glBufferData(GL_ARRAY_BUFFER, m_attributes.size() * sizeof(Vertex_Attributes), m_attributes.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//GL_ELEMENT_ARRAY_BUFFER belongs to the VAO, so the indices go through another target
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_index_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, m_indices.size() * sizeof(unsigned int), m_indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_mesh_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_meshes.size() * sizeof(Gpu_Mesh_Info), m_meshes.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	m_geometry_dirty = false;
+}
+
+void Gpu_Culler::upload_instances()
+{
+	if (!m_instances_dirty)
+		return;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instance_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_instances.size() * sizeof(Gpu_Instance), m_instances.data(), GL_DYNAMIC_DRAW);
+	//every instance may survive, so there is a command and a matrix slot for each
+	if (m_instances.size() > m_command_capacity)
+	{
+		m_command_capacity = (uint32_t)m_instances.size();
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_command_buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, m_command_capacity * sizeof(Draw_Elements_Indirect_Command), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visible_buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, m_command_capacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	m_instances_dirty = false;
+}
+
+void Gpu_Culler::cull(const glm::mat4& view_projection)
+{
+	if (!m_program)
+		return;
+	upload_geometry();
+	upload_instances();
+	if (m_instances.empty())
+		return;
+
+	uint32_t zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counter_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+	if (!m_draw_count_supported)
+	{
+		//without a GPU draw count every slot is drawn, the unused ones must stay empty draws
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_command_buffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	//clip space planes, a world point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all six
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+	glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+
+	glUseProgram(m_program);
+	glUniform1ui(glGetUniformLocation(m_program, "u_instance_count"), (GLuint)m_instances.size());
+	glUniform4fv(glGetUniformLocation(m_program, "u_frustum_planes"), 6, glm::value_ptr(planes[0]));
+	bool occlusion = m_pyramid && m_pyramid->is_valid();
+	glUniform1i(glGetUniformLocation(m_program, "u_occlusion"), occlusion ? 1 : 0);
+	if (occlusion)
+	{
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, m_pyramid->get_texture());
+		glUniform1i(glGetUniformLocation(m_program, "u_depth_pyramid"), 0);
+		glUniformMatrix4fv(glGetUniformLocation(m_program, "u_pyramid_view_projection"), 1, GL_FALSE, glm::value_ptr(m_pyramid->get_view_projection()));
+		glUniform2i(glGetUniformLocation(m_program, "u_pyramid_size"), (GLint)m_pyramid->get_width(), (GLint)m_pyramid->get_height());
+		glUniform1i(glGetUniformLocation(m_program, "u_pyramid_levels"), (GLint)m_pyramid->get_levels());
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_mesh_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_instance_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_visible_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_counter_buffer);
+	glDispatchCompute(((uint32_t)m_instances.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	//the commands and the count are read by the indirect draw, the matrices as vertex attributes
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	glUseProgram(0);
+}
+
+void Gpu_Culler::draw()
+{
+	if (!m_program || m_instances.empty())
+		return;
+	glBindVertexArray(m_vertex_array);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_command_buffer);
+	if (m_draw_count_supported)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER, m_counter_buffer);
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, (GLsizei)m_instances.size(), 0);
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	else
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)m_instances.size(), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+uint32_t Gpu_Culler::read_visible_count()
+{
+	uint32_t count = 0;
+	if (!m_counter_buffer)
+		return count;
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counter_buffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	m_stats.visible = count;
+	return count;
+}
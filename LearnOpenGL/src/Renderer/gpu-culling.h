@@ -0,0 +1,144 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+
+//Buffer layouts shared with gpu-cull-comp.glsl (std430).
+struct Gpu_Mesh_Info
+{
+	glm::vec4 bounds_min;				//model space, w unused
+	glm::vec4 bounds_max;
+	uint32_t index_count;
+	uint32_t first_index;
+	int32_t base_vertex;
+	uint32_t padding;
+};
+static_assert(sizeof(Gpu_Mesh_Info) == 48, "Gpu_Mesh_Info must match the std430 layout");
+
+struct Gpu_Instance
+{
+	glm::mat4 model;
+	uint32_t mesh;
+	uint32_t padding[3];
+};
+static_assert(sizeof(Gpu_Instance) == 80, "Gpu_Instance must match the std430 layout");
+
+//what glMultiDrawElementsIndirect reads, tightly packed
+struct Draw_Elements_Indirect_Command
+{
+	uint32_t count;
+	uint32_t instance_count;
+	uint32_t first_index;
+	int32_t base_vertex;
+	uint32_t base_instance;
+};
+
+//the per draw model matrix, an instanced attribute at locations 8-11 (INDIRECT_INSTANCES in the shaders)
+struct Indirect_Instance_Vertex
+{
+	glm::mat4 model;
+};
+
+template<> struct Vertex_Format<Indirect_Instance_Vertex>
+{
+	static constexpr Vertex_Attribute attributes[] = {
+		VERTEX_ATTRIBUTE(Indirect_Instance_Vertex, model),
+	};
+};
+
+//Max-depth mip chain of a depth buffer for Hi-Z occlusion tests, built with a compute shader.
+//Level 0 has the size of the depth buffer, each level keeps the farthest depth of the texels below it.
+class Depth_Pyramid
+{
+public:
+	bool init(const std::string& shader_directory);
+	void shutdown();
+
+	//depth_texture is sampled with texelFetch; view_projection is what it was rendered with
+	void build(GLuint depth_texture, uint32_t width, uint32_t height, const glm::mat4& view_projection);
+
+	GLuint get_texture() const { return m_texture; }
+	uint32_t get_width() const { return m_width; }
+	uint32_t get_height() const { return m_height; }
+	uint32_t get_levels() const { return m_levels; }
+	const glm::mat4& get_view_projection() const { return m_view_projection; }
+	bool is_valid() const { return m_texture != 0 && m_levels > 0; }
+
+private:
+	GLuint m_program = 0;
+	GLuint m_texture = 0;
+	uint32_t m_width = 0, m_height = 0, m_levels = 0;
+	glm::mat4 m_view_projection = glm::mat4(1.0f);
+};
+
+struct Gpu_Culling_Stats
+{
+	uint32_t meshes = 0;
+	uint32_t instances = 0;
+	uint32_t visible = 0;				//only filled by read_visible_count()
+};
+
+//GPU-driven drawing: every mesh lives in one set of shared buffers, every instance in an SSBO. A compute
+//shader frustum culls the instances, and tests them against a Depth_Pyramid when one is set. Each
+//survivor appends a draw command and its model matrix through an atomic counter. draw() then submits the
+//lot with glMultiDrawElementsIndirectCount, or, without GL 4.6 / ARB_indirect_parameters, with
+//glMultiDrawElementsIndirect over a command buffer cleared to empty draws. The CPU cost no longer
+//depends on how many instances there are or how many survive.
+//Needs GL 4.3 (compute shaders, SSBOs, indirect multi draw), which includes Mesa's software GL 4.5.
+//Benchmark/gpu checks it against a CPU frustum test and per instance draws, see the GpuBenchmark project.
+class Gpu_Culler
+{
+public:
+	//GL 4.3 context current
+	static bool is_supported();
+
+	bool init(const std::string& shader_directory = "Asset/Shader/");
+	void shutdown();
+
+	//positions and attributes as Mesh keeps them with split streams, returns the mesh index
+	uint32_t add_mesh(const std::vector<glm::vec3>& positions, const std::vector<Vertex_Attributes>& attributes, const std::vector<unsigned int>& indices);
+	uint32_t add_instance(uint32_t mesh, const glm::mat4& model);
+	void set_instance_transform(uint32_t instance, const glm::mat4& model);
+	void clear_instances();
+
+	//nullptr or an invalid pyramid disables the occlusion test
+	void set_depth_pyramid(const Depth_Pyramid* pyramid) { m_pyramid = pyramid; }
+
+	//dispatch the culling for this camera, the commands are ready for draw() afterwards; leaves no program bound
+	void cull(const glm::mat4& view_projection);
+	//one indirect call for everything visible; the bound shader needs the INDIRECT_INSTANCES feature
+	void draw();
+
+	bool has_draw_count() const { return m_draw_count_supported; }
+	//reads the counter back, stalls the pipeline, debugging and tests only
+	uint32_t read_visible_count();
+	const Gpu_Culling_Stats& get_stats() const { return m_stats; }
+
+private:
+	void upload_geometry();
+	void upload_instances();
+
+private:
+	GLuint m_program = 0;
+	GLuint m_vertex_array = 0;
+	GLuint m_position_buffer = 0, m_attribute_buffer = 0, m_index_buffer = 0;
+	GLuint m_mesh_buffer = 0, m_instance_buffer = 0;
+	GLuint m_command_buffer = 0, m_visible_buffer = 0, m_counter_buffer = 0;
+	uint32_t m_command_capacity = 0;
+
+	std::vector<glm::vec3> m_positions;
+	std::vector<Vertex_Attributes> m_attributes;
+	std::vector<unsigned int> m_indices;
+	std::vector<Gpu_Mesh_Info> m_meshes;
+	std::vector<Gpu_Instance> m_instances;
+	bool m_geometry_dirty = false;
+	bool m_instances_dirty = false;
+
+	bool m_draw_count_supported = false;
+	const Depth_Pyramid* m_pyramid = nullptr;
+	Gpu_Culling_Stats m_stats;
+};
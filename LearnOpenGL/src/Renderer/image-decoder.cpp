@@ -0,0 +1,75 @@
+#include "image-decoder.h"
+#include "Core/file-system.h"
+#include "Core/job-system.h"
+
+#include <stb_image.h>
+#include <cstring>
+#include <algorithm>
+
+std::vector<Decoded_Image> Image_Decoder::decode_batch(const std::vector<std::string>& paths, bool flip_vertically)
+{
+	std::vector<Decoded_Image> images(paths.size());
+	std::vector<File_Handle> files = File_System::read_batch(paths);
+	for (size_t i = 0; i < paths.size(); i++)
+		images[i].path = paths[i];
+
+	//start a decode for every file that has arrived, only block on the disk when nothing else is ready
+	Job_Counter decoded;
+	std::vector<bool> started(paths.size(), false);
+	size_t started_count = 0;
+	while (started_count < paths.size())
+	{
+		size_t oldest = paths.size();
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			if (started[i])
+				continue;
+			if (!files[i]->is_done())
+			{
+				oldest = std::min(oldest, i);
+				continue;
+			}
+			started[i] = true;
+			started_count++;
+			if (!files[i]->is_ready())
+				continue;
+			Decoded_Image* image = &images[i];
+			const File_Read* file = files[i].get();
+			Job_System::run([image, file, flip_vertically] { decode(*image, file->get_data().data(), file->get_size(), flip_vertically); }, decoded);
+		}
+		if (started_count < paths.size())
+			files[oldest]->wait();
+	}
+	Job_System::wait(decoded);
+	return images;
+}
+
+void Image_Decoder::decode(Decoded_Image& image, const unsigned char* data, size_t size, bool flip_vertically)
+{
+	image.pixels = stbi_load_from_memory(data, (int)size, &image.width, &image.height, &image.channels, 0);
+	if (!image.pixels || !flip_vertically)
+		return;
+
+	size_t row = (size_t)image.width * image.channels;
+	std::vector<unsigned char> swap(row);
+	for (int y = 0; y < image.height / 2; y++)
+	{
+		unsigned char* top = image.pixels + y * row;
+		unsigned char* bottom = image.pixels + (image.height - 1 - y) * row;
+		memcpy(swap.data(), top, row);
+		memcpy(top, bottom, row);
+		memcpy(bottom, swap.data(), row);
+	}
+}
+
+void Image_Decoder::free_image(Decoded_Image& image)
+{
+	stbi_image_free(image.pixels);
+	image.pixels = nullptr;
+}
+
+void Image_Decoder::free_images(std::vector<Decoded_Image>& images)
+{
+	for (Decoded_Image& image : images)
+		free_image(image);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//pixels as stb_image returned them, null when the file could not be read or decoded
+struct Decoded_Image
+{
+	std::string path;
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+};
+
+//The CPU half of texture loading, without GL so it can run and be measured headless.
+class Image_Decoder
+{
+public:
+	//every file is requested in one batch and each one is decoded on the job system as soon as its bytes arrive
+	static std::vector<Decoded_Image> decode_batch(const std::vector<std::string>& paths, bool flip_vertically);
+	//encoded bytes already in memory; flips by hand since stb's flip flag is global state
+	static void decode(Decoded_Image& image, const unsigned char* data, size_t size, bool flip_vertically);
+	static void free_image(Decoded_Image& image);
+	static void free_images(std::vector<Decoded_Image>& images);
+};
@@ -0,0 +1,271 @@
+#include "light-clusters.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "Core/job-system.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CLUSTER_USE_SSE 1
+#endif
+
+//padding lanes sit far behind the camera so they fail every depth test
+static const float s_padding_z = 1.0e18f;
+
+Cluster_Light Cluster_Light::point(const glm::vec3& position, float range, const glm::vec3& color, float intensity)
+{
+	Cluster_Light light = {};
+	light.position = position;
+	light.range = range;
+	light.color = color;
+	light.intensity = intensity;
+	light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	//a cone wider than the sphere, the spot factor is always 1
+	light.spot_cos_outer = -2.0f;
+	light.spot_cos_inner = -1.0f;
+	return light;
+}
+
+Cluster_Light Cluster_Light::spot(const glm::vec3& position, const glm::vec3& direction, float range, float inner_angle, float outer_angle, const glm::vec3& color, float intensity)
+{
+	Cluster_Light light = point(position, range, color, intensity);
+	light.direction = glm::normalize(direction);
+	light.spot_cos_outer = cos(glm::radians(outer_angle));
+	light.spot_cos_inner = cos(glm::radians(std::min(inner_angle, outer_angle)));
+	return light;
+}
+
+glm::vec4 Cluster_Light::get_bounding_sphere() const
+{
+	float cos_angle = spot_cos_outer;
+	//cones wider than a hemisphere reach behind the light, only the whole range sphere holds them
+	if (!is_spot() || cos_angle <= 0.0f)
+		return glm::vec4(position, range);
+	//past 45 degrees the cap's rim is the widest part, before that the tip and the rim bound it
+	if (cos_angle < 0.70710678f)
+		return glm::vec4(position + direction * (range * cos_angle), range * sqrt(1.0f - cos_angle * cos_angle));
+	float radius = range / (2.0f * cos_angle);
+	return glm::vec4(position + direction * radius, radius);
+}
+
+Light_Cluster_Grid::Light_Cluster_Grid(const Cluster_Grid_Config& config)
+	:m_config(config)
+{
+	//placeholder until the first set_projection() with the real camera
+	set_projection(45.0f, 1.0f, 0.1f, 100.0f);
+}
+
+void Light_Cluster_Grid::set_projection(float fov, float aspect_ratio, float near_plane, float far_plane)
+{
+	m_near = near_plane;
+	m_far = far_plane;
+
+	//exponential slices keep clusters roughly cubic in view space
+	float log_ratio = log(m_far / m_near);
+	m_slice_scale = m_config.slices_z / log_ratio;
+	m_slice_bias = m_config.slices_z * log(m_near) / log_ratio;
+	m_slice_depths.resize(m_config.slices_z + 1);
+	for (uint32_t z = 0; z <= m_config.slices_z; z++)
+		m_slice_depths[z] = m_near * pow(m_far / m_near, (float)z / m_config.slices_z);
+
+	float tan_y = tan(glm::radians(fov) * 0.5f);
+	float tan_x = tan_y * aspect_ratio;
+	m_bounds.resize(get_cluster_count());
+	for (uint32_t z = 0; z < m_config.slices_z; z++)
+	{
+		float d0 = m_slice_depths[z], d1 = m_slice_depths[z + 1];
+		for (uint32_t y = 0; y < m_config.tiles_y; y++)
+		{
+			float ndc_y0 = -1.0f + 2.0f * y / m_config.tiles_y;
+			float ndc_y1 = -1.0f + 2.0f * (y + 1) / m_config.tiles_y;
+			for (uint32_t x = 0; x < m_config.tiles_x; x++)
+			{
+				float ndc_x0 = -1.0f + 2.0f * x / m_config.tiles_x;
+				float ndc_x1 = -1.0f + 2.0f * (x + 1) / m_config.tiles_x;
+
+				//the tile's side planes pass through the eye, so the box spans both ends of the slice
+				float xs[4] = { ndc_x0 * tan_x * d0, ndc_x1 * tan_x * d0, ndc_x0 * tan_x * d1, ndc_x1 * tan_x * d1 };
+				float ys[4] = { ndc_y0 * tan_y * d0, ndc_y1 * tan_y * d0, ndc_y0 * tan_y * d1, ndc_y1 * tan_y * d1 };
+
+				Cluster_AABB& box = m_bounds[get_cluster_index(x, y, z)];
+				box.min = glm::vec3(*std::min_element(xs, xs + 4), *std::min_element(ys, ys + 4), -d1);
+				box.max = glm::vec3(*std::max_element(xs, xs + 4), *std::max_element(ys, ys + 4), -d0);
+			}
+		}
+	}
+
+	m_slices.resize(m_config.slices_z);
+	m_ranges.resize(get_cluster_count());
+}
+
+void Light_Cluster_Grid::assign(const glm::mat4& view, const std::vector<Cluster_Light>& lights)
+{
+	//bounding spheres in view space
+	m_light_count = (uint32_t)lights.size();
+	uint32_t padded = (m_light_count + 3) & ~3u;
+	m_light_x.resize(padded);
+	m_light_y.resize(padded);
+	m_light_z.resize(padded);
+	m_light_radius.resize(padded);
+	for (uint32_t i = 0; i < m_light_count; i++)
+	{
+		glm::vec4 sphere = lights[i].get_bounding_sphere();
+		glm::vec4 view_center = view * glm::vec4(glm::vec3(sphere), 1.0f);
+		m_light_x[i] = view_center.x;
+		m_light_y[i] = view_center.y;
+		m_light_z[i] = view_center.z;
+		m_light_radius[i] = sphere.w;
+	}
+	for (uint32_t i = m_light_count; i < padded; i++)
+	{
+		m_light_x[i] = m_light_y[i] = 0.0f;
+		m_light_z[i] = s_padding_z;
+		m_light_radius[i] = 0.0f;
+	}
+
+	//one slice per job, near slices are cheaper than far ones so they are not batched
+	Job_System::parallel_for(m_config.slices_z, [this](uint32_t slice) { assign_slices(slice, slice + 1); });
+
+	//stitch the per slice lists together
+	uint32_t tiles = m_config.tiles_x * m_config.tiles_y;
+	size_t total = 0;
+	for (const Slice_Output& slice : m_slices)
+		total += slice.indices.size();
+	m_indices.resize(total);
+
+	uint32_t offset = 0;
+	m_overflow = 0;
+	m_overflowing_clusters = 0;
+	for (uint32_t z = 0; z < m_config.slices_z; z++)
+	{
+		const Slice_Output& slice = m_slices[z];
+		m_overflow += slice.overflow;
+		m_overflowing_clusters += slice.overflowing_clusters;
+		if (!slice.indices.empty())
+			memcpy(&m_indices[offset], slice.indices.data(), slice.indices.size() * sizeof(uint32_t));
+		for (uint32_t tile = 0; tile < tiles; tile++)
+		{
+			m_ranges[z * tiles + tile] = glm::uvec2(offset, slice.counts[tile]);
+			offset += slice.counts[tile];
+		}
+	}
+}
+
+void Light_Cluster_Grid::assign_slices(uint32_t first_slice, uint32_t last_slice)
+{
+	uint32_t padded = (uint32_t)m_light_x.size();
+	uint32_t tiles = m_config.tiles_x * m_config.tiles_y;
+
+	for (uint32_t z = first_slice; z < last_slice; z++)
+	{
+		Slice_Output& out = m_slices[z];
+		out.candidates.clear();
+		out.indices.clear();
+		out.counts.assign(tiles, 0);
+		out.overflow = 0;
+		out.overflowing_clusters = 0;
+
+		//1. lights whose depth range overlaps the slice
+		float d0 = m_slice_depths[z], d1 = m_slice_depths[z + 1];
+#ifdef CLUSTER_USE_SSE
+		__m128 near_depth = _mm_set1_ps(d0), far_depth = _mm_set1_ps(d1);
+		for (uint32_t i = 0; i < padded; i += 4)
+		{
+			__m128 depth = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_light_z[i]));
+			__m128 radius = _mm_loadu_ps(&m_light_radius[i]);
+			__m128 hit = _mm_and_ps(_mm_cmple_ps(_mm_sub_ps(depth, radius), far_depth), _mm_cmpge_ps(_mm_add_ps(depth, radius), near_depth));
+			int mask = _mm_movemask_ps(hit);
+			while (mask)
+			{
+				int lane = 0;
+				while (!(mask & (1 << lane)))
+					lane++;
+				out.candidates.push_back(i + lane);
+				mask &= mask - 1;
+			}
+		}
+#else
+		for (uint32_t i = 0; i < padded; i++)
+		{
+			float depth = -m_light_z[i];
+			if (depth - m_light_radius[i] <= d1 && depth + m_light_radius[i] >= d0)
+				out.candidates.push_back(i);
+		}
+#endif
+		if (out.candidates.empty())
+			continue;
+
+		//2. gather the candidates into contiguous SoA so every tile test streams through them
+		uint32_t candidate_count = (uint32_t)out.candidates.size();
+		uint32_t candidate_padded = (candidate_count + 3) & ~3u;
+		out.x.resize(candidate_padded);
+		out.y.resize(candidate_padded);
+		out.z.resize(candidate_padded);
+		out.radius.resize(candidate_padded);
+		for (uint32_t i = 0; i < candidate_padded; i++)
+		{
+			bool real = i < candidate_count;
+			uint32_t light = real ? out.candidates[i] : 0;
+			out.x[i] = real ? m_light_x[light] : 0.0f;
+			out.y[i] = real ? m_light_y[light] : 0.0f;
+			out.z[i] = real ? m_light_z[light] : s_padding_z;
+			out.radius[i] = real ? m_light_radius[light] : 0.0f;
+		}
+
+		//3. sphere against cluster box, four lights at a time
+		for (uint32_t tile = 0; tile < tiles; tile++)
+		{
+			const Cluster_AABB& box = m_bounds[z * tiles + tile];
+			uint32_t count = 0;
+#ifdef CLUSTER_USE_SSE
+			__m128 zero = _mm_setzero_ps();
+			__m128 min_x = _mm_set1_ps(box.min.x), max_x = _mm_set1_ps(box.max.x);
+			__m128 min_y = _mm_set1_ps(box.min.y), max_y = _mm_set1_ps(box.max.y);
+			__m128 min_z = _mm_set1_ps(box.min.z), max_z = _mm_set1_ps(box.max.z);
+			for (uint32_t i = 0; i < candidate_padded; i += 4)
+			{
+				__m128 cx = _mm_loadu_ps(&out.x[i]), cy = _mm_loadu_ps(&out.y[i]), cz = _mm_loadu_ps(&out.z[i]);
+				__m128 r = _mm_loadu_ps(&out.radius[i]);
+				//distance from the center to the box, zero on the axes where the center is inside
+				__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_x, cx), zero), _mm_max_ps(_mm_sub_ps(cx, max_x), zero));
+				__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_y, cy), zero), _mm_max_ps(_mm_sub_ps(cy, max_y), zero));
+				__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_z, cz), zero), _mm_max_ps(_mm_sub_ps(cz, max_z), zero));
+				__m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, _mm_mul_ps(r, r)));
+				while (mask)
+				{
+					int lane = 0;
+					while (!(mask & (1 << lane)))
+						lane++;
+					if (count < m_config.max_lights_per_cluster)
+						out.indices.push_back(out.candidates[i + lane]);
+					count++;
+					mask &= mask - 1;
+				}
+			}
+#else
+			for (uint32_t i = 0; i < candidate_count; i++)
+			{
+				glm::vec3 center(out.x[i], out.y[i], out.z[i]);
+				glm::vec3 d = glm::max(box.min - center, glm::vec3(0.0f)) + glm::max(center - box.max, glm::vec3(0.0f));
+				if (glm::dot(d, d) <= out.radius[i] * out.radius[i])
+				{
+					if (count < m_config.max_lights_per_cluster)
+						out.indices.push_back(out.candidates[i]);
+					count++;
+				}
+			}
+#endif
+			//the lights past the limit are still counted so the caller can tell the grid is too coarse
+			if (count > m_config.max_lights_per_cluster)
+			{
+				out.overflow += count - m_config.max_lights_per_cluster;
+				out.overflowing_clusters++;
+				count = m_config.max_lights_per_cluster;
+			}
+			out.counts[tile] = count;
+		}
+	}
+}
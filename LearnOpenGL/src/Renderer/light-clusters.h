@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+//One light as the clustered shaders see it, 4 texels of a RGBA32F buffer texture.
+//Point lights are spot lights whose cone covers the whole sphere.
+struct Cluster_Light
+{
+	glm::vec3 position;
+	float range;
+	glm::vec3 color;
+	float intensity;
+	glm::vec3 direction;
+	float spot_cos_outer;
+	float spot_cos_inner;
+	float padding[3];
+
+	static Cluster_Light point(const glm::vec3& position, float range, const glm::vec3& color, float intensity = 1.0f);
+	//angles in degrees, measured from the cone axis
+	static Cluster_Light spot(const glm::vec3& position, const glm::vec3& direction, float range, float inner_angle, float outer_angle, const glm::vec3& color, float intensity = 1.0f);
+
+	bool is_spot() const { return spot_cos_outer > -1.0f; }
+	//world space (center, radius) around everything the light reaches, tight around narrow cones
+	glm::vec4 get_bounding_sphere() const;
+};
+static_assert(sizeof(Cluster_Light) == 64, "Cluster_Light is uploaded as 4 RGBA32F texels");
+
+struct Cluster_Grid_Config
+{
+	uint32_t tiles_x = 16;
+	uint32_t tiles_y = 9;
+	uint32_t slices_z = 24;
+	uint32_t max_lights_per_cluster = 128;
+};
+
+struct Cluster_AABB
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+//Splits the view frustum into tiles_x * tiles_y screen tiles and slices_z exponential depth slices and
+//records which lights touch each cluster. Pure CPU, no GL, so it can be tested and benchmarked headless.
+class Light_Cluster_Grid
+{
+public:
+	Light_Cluster_Grid(const Cluster_Grid_Config& config = Cluster_Grid_Config());
+
+	//rebuild the view-space cluster bounds, fov in degrees as Perspective_Camera stores it
+	void set_projection(float fov, float aspect_ratio, float near_plane, float far_plane);
+	//slices are assigned in parallel on the job system
+	void assign(const glm::mat4& view, const std::vector<Cluster_Light>& lights);
+
+	uint32_t get_cluster_index(uint32_t x, uint32_t y, uint32_t z) const { return (z * m_config.tiles_y + y) * m_config.tiles_x + x; }
+	uint32_t get_cluster_count() const { return m_config.tiles_x * m_config.tiles_y * m_config.slices_z; }
+	const Cluster_AABB& get_cluster_bounds(uint32_t cluster) const { return m_bounds[cluster]; }
+	const Cluster_Grid_Config& get_config() const { return m_config; }
+
+	//(offset, count) into get_light_indices() for every cluster
+	const std::vector<glm::uvec2>& get_cluster_ranges() const { return m_ranges; }
+	const std::vector<uint32_t>& get_light_indices() const { return m_indices; }
+	//light and cluster pairs the last assign() dropped because a cluster already held max_lights_per_cluster,
+	//and how many clusters that happened in. The kept ones are the first in light order.
+	uint32_t get_overflow_count() const { return m_overflow; }
+	uint32_t get_overflowing_cluster_count() const { return m_overflowing_clusters; }
+
+	//slice = floor(log(view depth) * scale - bias), what the fragment shader evaluates
+	float get_slice_scale() const { return m_slice_scale; }
+	float get_slice_bias() const { return m_slice_bias; }
+
+private:
+	void assign_slices(uint32_t first_slice, uint32_t last_slice);
+
+private:
+	Cluster_Grid_Config m_config;
+	float m_near = 0.1f;
+	float m_far = 100.0f;
+	float m_slice_scale = 0.0f;
+	float m_slice_bias = 0.0f;
+	std::vector<Cluster_AABB> m_bounds;
+	std::vector<float> m_slice_depths;		//slices_z + 1 view depths
+
+	//view-space light spheres as SoA, padded to a multiple of 4 for SIMD
+	std::vector<float> m_light_x, m_light_y, m_light_z, m_light_radius;
+	uint32_t m_light_count = 0;
+
+	//per slice scratch so slices can be filled from different threads
+	struct Slice_Output
+	{
+		std::vector<uint32_t> candidates;
+		std::vector<float> x, y, z, radius;
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> counts;
+		uint32_t overflow = 0;
+		uint32_t overflowing_clusters = 0;
+	};
+	std::vector<Slice_Output> m_slices;
+
+	std::vector<glm::uvec2> m_ranges;
+	std::vector<uint32_t> m_indices;
+	uint32_t m_overflow = 0;
+	uint32_t m_overflowing_clusters = 0;
+};
@@ -0,0 +1,132 @@
+#include "mesh-import.h"
+#include "tangent-space.h"
+
+#include <assimp/mesh.h>
+#include <cstring>
+
+//fills the members Vertex and Vertex_Attributes share, tangents only when the file had them
+template<typename T>
+static void read_attributes(const aiMesh* mesh, unsigned int i, bool has_normals, const aiVector3D* texcoords, T& vertex)
+{
+	if (has_normals)
+		vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+	//only the first of the up to 8 texture coordinate sets is used
+	if (texcoords)
+		vertex.TexCoords = glm::vec2(texcoords[i].x, texcoords[i].y);
+	if (texcoords && mesh->HasTangentsAndBitangents())
+	{
+		vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+		vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+	}
+}
+
+//what Assimp's GenSmoothNormals and CalcTangentSpace used to add, written into the vertex array
+template<typename T>
+static void generate_missing(const aiMesh* mesh, const glm::vec3* positions, size_t position_stride, std::vector<T>& vertices, const std::vector<unsigned int>& indices)
+{
+	if (vertices.empty())
+		return;
+	if (!mesh->HasNormals())
+		generate_smooth_normals(positions, position_stride, &vertices[0].Normal, sizeof(T), vertices.size(), indices);
+	if (!mesh->mTextureCoords[0] || mesh->HasTangentsAndBitangents())
+		return;
+	generate_tangents(positions, position_stride, &vertices[0].Normal, &vertices[0].TexCoords, &vertices[0].Tangent, &vertices[0].Bitangent,
+		sizeof(T), vertices.size(), indices);
+	//Assimp's CalcTangentsProcess ran after FlipUVs too, but its bitangent is the negated texture space v
+	//direction of the UVs it saw (CalcTangentsProcess.cpp, the bitangent = (w * sx - v * tx) * dirCorrection
+	//lines), which is the file's unflipped v. The maps are authored against that v, so keep its convention
+	if (MODEL_IMPORT_FLAGS & aiProcess_FlipUVs)
+		for (T& vertex : vertices)
+			vertex.Bitangent = -vertex.Bitangent;
+}
+
+static void read_indices(const aiMesh* mesh, std::vector<unsigned int>& indices)
+{
+	indices.clear();
+	//triangulated on import, so every face has 3 indices
+	indices.reserve((size_t)mesh->mNumFaces * 3);
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+	}
+}
+
+//Merges duplicate corners and rewrites the indices. Runs before the generators so they see fewer vertices;
+//corners they would give the same frame have the same position, normal and texture coordinate and are
+//merged here already. Returns the welded vertex count, remap is left for the caller to compact its arrays.
+static uint32_t weld(const Weld_Stream* streams, uint32_t stream_count, size_t vertex_count, size_t vertex_size, std::vector<unsigned int>& indices,
+	const Mesh_Import_Options& options, Weld_Stats* weld_stats, std::vector<uint32_t>& remap)
+{
+	uint32_t welded_count = (uint32_t)vertex_count;
+	if (options.weld && vertex_count > 0)
+	{
+		welded_count = build_weld_remap(streams, stream_count, vertex_count, options.weld_epsilon, remap);
+		remap_indices(indices, remap);
+	}
+	if (weld_stats)
+	{
+		weld_stats->vertices_before = vertex_count;
+		weld_stats->vertices_after = welded_count;
+		weld_stats->bytes_before = vertex_count * vertex_size;
+		weld_stats->bytes_after = (uint64_t)welded_count * vertex_size;
+	}
+	return welded_count;
+}
+
+void import_mesh_geometry(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	const Mesh_Import_Options& options, Weld_Stats* weld_stats)
+{
+	vertices.clear();
+	vertices.reserve(mesh->mNumVertices);
+	bool has_normals = mesh->HasNormals();
+	const aiVector3D* texcoords = mesh->mTextureCoords[0];
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		//bone slots are filled by the animation code, keep them deterministic until then
+		Vertex vertex = {};
+		vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		read_attributes(mesh, i, has_normals, texcoords, vertex);
+		vertices.push_back(vertex);
+	}
+	read_indices(mesh, indices);
+
+	Weld_Stream stream = { vertices.data(), vertex_layout_of<Vertex>() };
+	std::vector<uint32_t> remap;
+	uint32_t welded_count = weld(&stream, 1, vertices.size(), sizeof(Vertex), indices, options, weld_stats, remap);
+	if (welded_count != vertices.size())
+		apply_weld_remap(vertices, remap, welded_count);
+	generate_missing(mesh, vertices.empty() ? nullptr : &vertices[0].Position, sizeof(Vertex), vertices, indices);
+}
+
+void import_mesh_streams(const aiMesh* mesh, std::vector<glm::vec3>& positions, std::vector<Vertex_Attributes>& attributes, std::vector<unsigned int>& indices,
+	const Mesh_Import_Options& options, Weld_Stats* weld_stats)
+{
+	//aiVector3D is three packed floats, the positions copy straight across
+	static_assert(sizeof(aiVector3D) == sizeof(glm::vec3), "aiVector3D is not three floats");
+	positions.resize(mesh->mNumVertices);
+	if (mesh->mNumVertices)
+		memcpy(positions.data(), mesh->mVertices, mesh->mNumVertices * sizeof(glm::vec3));
+
+	attributes.clear();
+	attributes.reserve(mesh->mNumVertices);
+	bool has_normals = mesh->HasNormals();
+	const aiVector3D* texcoords = mesh->mTextureCoords[0];
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		Vertex_Attributes vertex = {};
+		read_attributes(mesh, i, has_normals, texcoords, vertex);
+		attributes.push_back(vertex);
+	}
+	read_indices(mesh, indices);
+
+	Weld_Stream streams[2] = { { positions.data(), vertex_layout_of<Vertex_Position>() }, { attributes.data(), vertex_layout_of<Vertex_Attributes>() } };
+	std::vector<uint32_t> remap;
+	uint32_t welded_count = weld(streams, 2, positions.size(), sizeof(glm::vec3) + sizeof(Vertex_Attributes), indices, options, weld_stats, remap);
+	if (welded_count != positions.size())
+	{
+		apply_weld_remap(positions, remap, welded_count);
+		apply_weld_remap(attributes, remap, welded_count);
+	}
+	generate_missing(mesh, positions.data(), sizeof(glm::vec3), attributes, indices);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include <assimp/postprocess.h>
+
+#include "vertex.h"
+#include "vertex-weld.h"
+
+struct aiMesh;
+
+//post-processing every model is imported with; normals and tangents are generated by import_mesh_*,
+//which is faster than Assimp's single threaded steps and runs per mesh in parallel
+static const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+struct Mesh_Import_Options
+{
+	//merge vertices with matching attributes, Assimp is not asked to (aiProcess_JoinIdenticalVertices)
+	bool weld = true;
+	//quantization step of the weld, 0 only merges bit-identical vertices
+	float weld_epsilon = 1e-6f;
+};
+
+//Assimp mesh to the vertex and index arrays Mesh uploads. No GL, so it runs and is measured headless;
+//Model::processMesh adds the materials on top. Vertices are welded first, then missing normals are
+//generated smooth and missing tangents with generate_tangents (see tangent-space.h) when there are
+//texture coordinates. weld_stats, when given, receives the vertex counts and bytes before and after.
+void import_mesh_geometry(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	const Mesh_Import_Options& options = Mesh_Import_Options(), Weld_Stats* weld_stats = nullptr);
+//the same data as two streams: tightly packed positions for depth-only passes and CPU queries, the rest interleaved
+void import_mesh_streams(const aiMesh* mesh, std::vector<glm::vec3>& positions, std::vector<Vertex_Attributes>& attributes, std::vector<unsigned int>& indices,
+	const Mesh_Import_Options& options = Mesh_Import_Options(), Weld_Stats* weld_stats = nullptr);
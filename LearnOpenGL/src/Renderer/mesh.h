@@ -6,30 +6,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <Renderer/shader.h>
+#include <Renderer/vertex.h>
+#include <Renderer/vertex-array-cache.h>
+#include <Renderer/meshlets.h>
 
 #include <string>
 #include <vector>
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 struct Texture {
     unsigned int id;
     string type;
@@ -39,36 +23,242 @@ struct Texture {
 class Mesh {
 public:
     // mesh Data
-    vector<Vertex>       vertices;
+    vector<Vertex>       vertices;      // interleaved meshes only
+    vector<glm::vec3>    positions;     // always filled, contiguous for CPU work (bounds, picking rays)
+    vector<Vertex_Attributes> attributes; // split meshes only, the second stream next to positions
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    // vertex arrays come from Vertex_Array_Cache, shared by every mesh of the same layout where attrib binding is available
+    Vertex_Binding geometry;
+    // only location 0 and the indices, for depth, shadow and picking passes.
+    // on split meshes it never touches the attribute stream, interleaved ones still fetch at 88 byte stride
+    Vertex_Binding depthGeometry;
+    bool splitStreams = false;
+    // model space bounds, from the position stream
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    // clusters of the index buffer, which the import stored in meshlet order; empty if it was not clustered
+    vector<Meshlet>      meshlets;
+    // shader variant features implied by the textures this mesh actually has
+    Shader_Features features = SHADER_FEATURE_NONE;
+    // texture array layer of each map (diffuse, specular, normal, height) when the model packed its textures, -1 if absent
+    glm::ivec4 materialLayers = glm::ivec4(-1);
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
 
+        positions.reserve(this->vertices.size());
+        for (const Vertex& vertex : this->vertices)
+            positions.push_back(vertex.Position);
+
+        computeBounds();
+        setupMaterial();
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
+    // split streams: positions in one buffer, everything else interleaved in a second one
+    Mesh(vector<glm::vec3> positions, vector<Vertex_Attributes> attributes, vector<unsigned int> indices, vector<Texture> textures)
+    {
+        this->positions = std::move(positions);
+        this->attributes = std::move(attributes);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        splitStreams = true;
+
+        computeBounds();
+        setupMaterial();
+        setupStreams();
+    }
+
+    // owns its vertex arrays and buffers: moving hands them over, copies are not allowed
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    Mesh(Mesh&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    Mesh& operator=(Mesh&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        releaseBuffers();
+        vertices = std::move(other.vertices);
+        positions = std::move(other.positions);
+        attributes = std::move(other.attributes);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        splitStreams = other.splitStreams;
+        boundsMin = other.boundsMin;
+        boundsMax = other.boundsMax;
+        meshlets = std::move(other.meshlets);
+        features = other.features;
+        materialLayers = other.materialLayers;
+        samplerNames = std::move(other.samplerNames);
+        geometry = other.geometry;
+        depthGeometry = other.depthGeometry;
+        VBO = other.VBO;
+        EBO = other.EBO;
+        attributeVBO = other.attributeVBO;
+        other.geometry = other.depthGeometry = Vertex_Binding();
+        other.VBO = other.EBO = other.attributeVBO = 0;
+        return *this;
+    }
+
+    // the textures belong to the model that loaded them
+    ~Mesh()
+    {
+        releaseBuffers();
+    }
+
+    // what the geometry takes in system memory and in its GL buffers
+    size_t getCpuBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + positions.capacity() * sizeof(glm::vec3)
+            + attributes.capacity() * sizeof(Vertex_Attributes) + indices.capacity() * sizeof(unsigned int)
+            + meshlets.capacity() * sizeof(Meshlet);
+    }
+
+    size_t getGpuBytes() const
+    {
+        if (VBO == 0)
+            return 0;
+        size_t vertexBytes = splitStreams ? positions.size() * sizeof(glm::vec3) + attributes.size() * sizeof(Vertex_Attributes)
+            : vertices.size() * sizeof(Vertex);
+        return vertexBytes + indices.size() * sizeof(unsigned int);
+    }
+
+    // frees the GL buffers and vertex arrays, the CPU copy stays for culling and rebuilding.
+    // Model calls it once the mesh was merged into a batch, drawing the mesh afterwards is an error
+    void releaseBuffers()
+    {
+        // a moved-from mesh owns nothing and makes no GL calls
+        if (VBO == 0)
+            return;
+        Vertex_Array_Cache::release(geometry);
+        Vertex_Array_Cache::release(depthGeometry);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        if (attributeVBO)
+            glDeleteBuffers(1, &attributeVBO);
+        VBO = EBO = attributeVBO = 0;
+    }
+
     // render the mesh
     void Draw(Shader& shader)
     {
-        // bind appropriate textures
+        bindTextures(shader);
+
+        // draw mesh
+        Vertex_Binding bound;
+        Vertex_Array_Cache::bind(geometry, bound);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render only some index ranges, e.g. the meshlets that survived a Meshlet_Culler
+    void DrawRanges(Shader& shader, const vector<Meshlet_Range>& ranges)
+    {
+        if (ranges.empty())
+            return;
+        bindTextures(shader);
+        drawIndexRanges(geometry, ranges);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // one glMultiDrawElements over the ranges of the geometry's element buffer
+    static void drawIndexRanges(const Vertex_Binding& geometry, const vector<Meshlet_Range>& ranges)
+    {
+        // render thread only, kept around so a frame does not allocate
+        static vector<GLsizei> counts;
+        static vector<const void*> offsets;
+        counts.clear();
+        offsets.clear();
+        for (const Meshlet_Range& range : ranges)
+        {
+            counts.push_back((GLsizei)range.index_count);
+            offsets.push_back((const void*)(uintptr_t)(range.first_index * sizeof(unsigned int)));
+        }
+        Vertex_Binding bound;
+        Vertex_Array_Cache::bind(geometry, bound);
+        glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)ranges.size());
+        glBindVertexArray(0);
+    }
+
+    // positions only, no textures: the shader just needs location 0
+    void DrawDepth()
+    {
+        Vertex_Binding bound;
+        Vertex_Array_Cache::bind(depthGeometry, bound);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+private:
+    // bind appropriate textures, the sampler names were built once in the constructor
+    void bindTextures(Shader& shader)
+    {
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            glUniform1i(glGetUniformLocation(shader.ID(), samplerNames[i].c_str()), i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // render data 
+    unsigned int VBO = 0, EBO = 0;
+    unsigned int attributeVBO = 0;
+    // one sampler uniform name per texture, same order
+    vector<string> samplerNames;
+
+    void computeBounds()
+    {
+        if (positions.empty())
+            return;
+        boundsMin = boundsMax = positions[0];
+        for (const glm::vec3& position : positions)
+        {
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        }
+    }
+
+    // shader features and sampler names from the textures
+    void setupMaterial()
+    {
+        for (const Texture& texture : textures)
+        {
+            if (texture.type == "texture_diffuse")
+                features |= SHADER_FEATURE_DIFFUSE_MAP;
+            else if (texture.type == "texture_specular")
+                features |= SHADER_FEATURE_SPECULAR_MAP;
+            else if (texture.type == "texture_normal")
+                features |= SHADER_FEATURE_NORMAL_MAP;
+            else if (texture.type == "texture_height")
+                features |= SHADER_FEATURE_HEIGHT_MAP;
+        }
+
+        // sampler uniform names (diffuse_textureN etc.), built here so drawing never allocates strings
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr = 1;
         unsigned int heightNr = 1;
-        for (unsigned int i = 0; i < textures.size(); i++)
+        for (const Texture& texture : textures)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures[i].type;
+            const string& name = texture.type;
             if (name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if (name == "texture_specular")
@@ -77,68 +267,58 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to string
             else if (name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID(), (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerNames.push_back(name + number);
         }
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
-    // initializes all the buffer objects/arrays
+    // initializes all the buffer objects, the vertex arrays are the cache's
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
+        // create buffers
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        // the element buffer binding belongs to whichever vertex array is bound
+        glBindVertexArray(0);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        // the depth geometry shares both buffers, reading only the positions
+        Vertex_Layout_View layout = vertex_layout_of<Vertex>();
+        geometry = Vertex_Array_Cache::acquire(&layout, &VBO, 1, EBO);
+        Vertex_Layout_View depthLayout = vertex_layout_prefix(layout, 1);
+        depthGeometry = Vertex_Array_Cache::acquire(&depthLayout, &VBO, 1, EBO);
+    }
+
+    // VBO holds the positions, attributeVBO the rest
+    void setupStreams()
+    {
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &attributeVBO);
+        glGenBuffers(1, &EBO);
 
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-        // ids
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-        // weights
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, attributeVBO);
+        glBufferData(GL_ARRAY_BUFFER, attributes.size() * sizeof(Vertex_Attributes), attributes.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        Vertex_Layout_View layouts[] = { vertex_layout_of<Vertex_Position>(), vertex_layout_of<Vertex_Attributes>() };
+        GLuint buffers[] = { VBO, attributeVBO };
+        geometry = Vertex_Array_Cache::acquire(layouts, buffers, 2, EBO);
+        depthGeometry = Vertex_Array_Cache::acquire(layouts, buffers, 1, EBO);
     }
 };
@@ -0,0 +1,278 @@
+#include "meshlets.h"
+#include "occlusion-culler.h"
+
+#include <cmath>
+#include <algorithm>
+
+//cones whose triangles spread further than this from the axis (cos) are never rejected, as in meshoptimizer
+static const float s_min_cone_dot = 0.1f;
+//a triangle only joins a meshlet within about 72 degrees of its average normal. Narrow cones are rejected far
+//more often for somewhat smaller meshlets: welded nanosuit gets 37 instead of 80 triangles per meshlet and
+//19% instead of 1% of them backfacing from cameras around it
+static const float s_min_growth_dot = 0.3f;
+//how much being further out than the meshlet's current radius counts against a candidate, in vertices
+static const float s_distance_weight = 0.5f;
+
+static const glm::vec3& position_at(const glm::vec3* positions, size_t stride, uint32_t index)
+{
+	return *(const glm::vec3*)((const char*)positions + stride * index);
+}
+
+//unit normal of a counter-clockwise triangle, zero when it is degenerate
+static glm::vec3 triangle_normal(const glm::vec3* positions, size_t stride, const unsigned int* triangle)
+{
+	const glm::vec3& a = position_at(positions, stride, triangle[0]);
+	glm::vec3 normal = glm::cross(position_at(positions, stride, triangle[1]) - a, position_at(positions, stride, triangle[2]) - a);
+	float length = glm::length(normal);
+	return length > 0.0f ? normal / length : glm::vec3(0.0f);
+}
+
+//bounding sphere and normal cone of the meshlet, indices points at its first index
+static void compute_meshlet_bounds(Meshlet& meshlet, const glm::vec3* positions, size_t stride, const unsigned int* indices)
+{
+	glm::vec3 low(1e30f), high(-1e30f);
+	for (uint32_t i = 0; i < meshlet.index_count; i++)
+	{
+		const glm::vec3& position = position_at(positions, stride, indices[i]);
+		low = glm::min(low, position);
+		high = glm::max(high, position);
+	}
+	meshlet.center = (low + high) * 0.5f;
+	float radius_squared = 0.0f;
+	for (uint32_t i = 0; i < meshlet.index_count; i++)
+	{
+		glm::vec3 offset = position_at(positions, stride, indices[i]) - meshlet.center;
+		radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+	}
+	meshlet.radius = std::sqrt(radius_squared);
+
+	//axis: average of the unit triangle normals, degenerate triangles face nowhere and are skipped
+	glm::vec3 axis(0.0f);
+	for (uint32_t i = 0; i + 2 < meshlet.index_count; i += 3)
+		axis += triangle_normal(positions, stride, indices + i);
+	meshlet.cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.cone_cutoff = 1.0f;
+	float axis_length = glm::length(axis);
+	if (axis_length <= 1e-6f)
+		return;
+	axis /= axis_length;
+
+	float min_dot = 1.0f;
+	for (uint32_t i = 0; i + 2 < meshlet.index_count; i += 3)
+	{
+		glm::vec3 normal = triangle_normal(positions, stride, indices + i);
+		if (normal != glm::vec3(0.0f))
+			min_dot = std::min(min_dot, glm::dot(axis, normal));
+	}
+	meshlet.cone_axis = axis;
+	if (min_dot > s_min_cone_dot)
+		meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+std::vector<Meshlet> build_meshlets(const glm::vec3* positions, size_t vertex_count, size_t stride, std::vector<unsigned int>& indices, uint32_t max_vertices, uint32_t max_triangles)
+{
+	std::vector<Meshlet> meshlets;
+	uint32_t triangle_count = (uint32_t)(indices.size() / 3);
+	if (triangle_count == 0 || vertex_count == 0 || max_vertices < 3 || max_triangles == 0)
+		return meshlets;
+
+	//triangles around every vertex, compressed rows
+	std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0), adjacency(triangle_count * 3);
+	for (uint32_t i = 0; i < triangle_count * 3; i++)
+		adjacency_offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		adjacency_offsets[v + 1] += adjacency_offsets[v];
+	std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (uint32_t i = 0; i < triangle_count * 3; i++)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	//unit normals and centroids, to keep meshlets flat and round as they grow
+	std::vector<glm::vec3> normals(triangle_count), centroids(triangle_count);
+	for (uint32_t t = 0; t < triangle_count; t++)
+	{
+		normals[t] = triangle_normal(positions, stride, indices.data() + t * 3);
+		centroids[t] = (position_at(positions, stride, indices[t * 3]) + position_at(positions, stride, indices[t * 3 + 1]) + position_at(positions, stride, indices[t * 3 + 2])) / 3.0f;
+	}
+
+	std::vector<bool> emitted(triangle_count, false);
+	//slot of a vertex in the meshlet being built, -1 when it is not in it
+	std::vector<int32_t> slots(vertex_count, -1);
+	std::vector<uint32_t> meshlet_vertices, candidates;
+	std::vector<unsigned int> reordered;
+	reordered.reserve(indices.size());
+	meshlets.reserve(triangle_count / max_triangles + 1);
+
+	uint32_t seed = 0;
+	while (true)
+	{
+		while (seed < triangle_count && emitted[seed])
+			seed++;
+		if (seed == triangle_count)
+			break;
+
+		Meshlet meshlet;
+		meshlet.first_index = (uint32_t)reordered.size();
+		uint32_t triangle = seed, triangles = 0;
+		glm::vec3 normal_sum(0.0f), centroid_sum(0.0f);
+		float radius = 0.0f;
+		while (true)
+		{
+			//take the triangle, its vertices and its neighbours as the next candidates
+			emitted[triangle] = true;
+			triangles++;
+			normal_sum += normals[triangle];
+			centroid_sum += centroids[triangle];
+			radius = std::max(radius, glm::length(centroids[triangle] - centroid_sum / (float)triangles));
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				unsigned int vertex = indices[triangle * 3 + corner];
+				reordered.push_back(vertex);
+				if (slots[vertex] < 0)
+				{
+					slots[vertex] = (int32_t)meshlet_vertices.size();
+					meshlet_vertices.push_back(vertex);
+				}
+				for (uint32_t a = adjacency_offsets[vertex]; a < adjacency_offsets[vertex + 1]; a++)
+					if (!emitted[adjacency[a]])
+						candidates.push_back(adjacency[a]);
+			}
+			if (triangles == max_triangles)
+				break;
+
+			//the neighbour facing the same way that adds the fewest vertices and stays closest to the middle,
+			//so the meshlet grows as a compact patch whose normal cone stays narrow
+			float normal_length = glm::length(normal_sum);
+			glm::vec3 axis = normal_length > 0.0f ? normal_sum / normal_length : glm::vec3(0.0f);
+			glm::vec3 centroid = centroid_sum / (float)triangles;
+			//degenerate triangles face nowhere and fit anywhere
+			auto faces_along = [&](uint32_t candidate)
+			{
+				return normal_length <= 0.0f || normals[candidate] == glm::vec3(0.0f) || glm::dot(axis, normals[candidate]) >= s_min_growth_dot;
+			};
+			uint32_t best = 0xFFFFFFFF;
+			float best_score = 1e30f;
+			for (size_t c = 0; c < candidates.size();)
+			{
+				uint32_t candidate = candidates[c];
+				if (emitted[candidate])
+				{
+					candidates[c] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				uint32_t added = 0;
+				for (uint32_t corner = 0; corner < 3; corner++)
+					added += slots[indices[candidate * 3 + corner]] < 0 ? 1 : 0;
+				float distance = glm::length(centroids[candidate] - centroid) / std::max(radius, 1e-6f);
+				float score = added + s_distance_weight * distance;
+				if (meshlet_vertices.size() + added <= max_vertices && score < best_score && faces_along(candidate))
+				{
+					best = candidate;
+					best_score = score;
+				}
+				c++;
+			}
+			//no neighbour left to grow through (unwelded meshes have none at all): continue in index order,
+			//which importers mostly emit as neighbouring triangles anyway
+			while (best == 0xFFFFFFFF && seed < triangle_count && emitted[seed])
+				seed++;
+			if (best == 0xFFFFFFFF && seed < triangle_count && candidates.empty() && faces_along(seed))
+			{
+				uint32_t added = 0;
+				for (uint32_t corner = 0; corner < 3; corner++)
+					added += slots[indices[seed * 3 + corner]] < 0 ? 1 : 0;
+				if (meshlet_vertices.size() + added <= max_vertices)
+					best = seed;
+			}
+			if (best == 0xFFFFFFFF)
+				break;
+			triangle = best;
+		}
+
+		meshlet.index_count = triangles * 3;
+		meshlet.vertex_count = (uint32_t)meshlet_vertices.size();
+		compute_meshlet_bounds(meshlet, positions, stride, reordered.data() + meshlet.first_index);
+		meshlets.push_back(meshlet);
+
+		for (uint32_t vertex : meshlet_vertices)
+			slots[vertex] = -1;
+		meshlet_vertices.clear();
+		candidates.clear();
+	}
+
+	//a trailing partial triangle is kept so nothing is lost
+	reordered.insert(reordered.end(), indices.begin() + triangle_count * 3, indices.end());
+	indices.swap(reordered);
+	return meshlets;
+}
+
+bool meshlet_is_backfacing(const Meshlet& meshlet, const glm::vec3& camera_position)
+{
+	//conservative for the whole bounding sphere, so no apex is needed
+	glm::vec3 to_center = meshlet.center - camera_position;
+	return glm::dot(to_center, meshlet.cone_axis) >= meshlet.cone_cutoff * glm::length(to_center) + meshlet.radius;
+}
+
+void Meshlet_Culler::begin_frame(const glm::mat4& view_projection, const glm::vec3& camera_position, Occlusion_Culler* occlusion)
+{
+	m_view_projection = view_projection;
+	m_camera_position = camera_position;
+	m_occlusion = occlusion;
+	m_stats = Meshlet_Cull_Stats();
+
+	//world space planes, normalized so the sphere test can compare against the radius
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+	m_planes[0] = rows[3] + rows[0];
+	m_planes[1] = rows[3] - rows[0];
+	m_planes[2] = rows[3] + rows[1];
+	m_planes[3] = rows[3] - rows[1];
+	m_planes[4] = rows[3] + rows[2];
+	m_planes[5] = rows[3] - rows[2];
+	for (glm::vec4& plane : m_planes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+void Meshlet_Culler::cull(const std::vector<Meshlet>& meshlets, const glm::mat4& model, std::vector<Meshlet_Range>& ranges)
+{
+	//the cone test runs in model space, where a rigid, uniformly scaled transform keeps the angles
+	glm::vec3 camera_position = glm::vec3(glm::inverse(model) * glm::vec4(m_camera_position, 1.0f));
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	size_t first_range = ranges.size();
+
+	for (const Meshlet& meshlet : meshlets)
+	{
+		m_stats.tested++;
+		if (m_backface_culling && meshlet_is_backfacing(meshlet, camera_position))
+		{
+			m_stats.backfacing++;
+			continue;
+		}
+
+		glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.center, 1.0f));
+		float radius = meshlet.radius * scale;
+		bool inside = true;
+		for (const glm::vec4& plane : m_planes)
+			inside = inside && glm::dot(glm::vec3(plane), center) + plane.w >= -radius;
+		if (!inside)
+		{
+			m_stats.outside_frustum++;
+			continue;
+		}
+
+		if (m_occlusion && !m_occlusion->is_visible(meshlet.center - glm::vec3(meshlet.radius), meshlet.center + glm::vec3(meshlet.radius), model))
+		{
+			m_stats.occluded++;
+			continue;
+		}
+
+		m_stats.visible++;
+		//meshlets are stored back to back, so neighbours that both survive become one range
+		if (ranges.size() > first_range && ranges.back().first_index + ranges.back().index_count == meshlet.first_index)
+			ranges.back().index_count += meshlet.index_count;
+		else
+			ranges.push_back({ meshlet.first_index, meshlet.index_count });
+	}
+	m_stats.ranges += (uint32_t)(ranges.size() - first_range);
+}
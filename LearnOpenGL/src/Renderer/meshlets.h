@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Occlusion_Culler;
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+//A cluster of neighbouring triangles, one contiguous range of its mesh's index buffer.
+//Bounds and cone are in model space.
+struct Meshlet
+{
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+	uint32_t vertex_count = 0;			//unique vertices, at most the max_vertices it was built with
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+	//every triangle normal is within the cone around the axis; cutoff is the sine of its half angle,
+	//1 when the cone is too wide to ever be backfacing as a whole
+	glm::vec3 cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+	float cone_cutoff = 1.0f;
+};
+
+//Partitions indices into meshlets of at most max_vertices unique vertices and max_triangles triangles,
+//growing each from a seed triangle through shared vertices (in index order once there are none to grow
+//through), and reorders indices in place so every meshlet is one contiguous range.
+//stride is the byte distance between positions, so interleaved vertices work.
+std::vector<Meshlet> build_meshlets(const glm::vec3* positions, size_t vertex_count, size_t stride, std::vector<unsigned int>& indices,
+	uint32_t max_vertices = MESHLET_MAX_VERTICES, uint32_t max_triangles = MESHLET_MAX_TRIANGLES);
+
+//true when every triangle of the meshlet faces away from a camera at this model space position
+bool meshlet_is_backfacing(const Meshlet& meshlet, const glm::vec3& camera_position);
+
+//index range to submit, see Mesh::drawIndexRanges
+struct Meshlet_Range
+{
+	uint32_t first_index;
+	uint32_t index_count;
+};
+
+struct Meshlet_Cull_Stats
+{
+	uint32_t tested = 0;
+	uint32_t backfacing = 0;
+	uint32_t outside_frustum = 0;
+	uint32_t occluded = 0;
+	uint32_t visible = 0;
+	uint32_t ranges = 0;				//after merging neighbours, what the draws submit
+};
+
+//Per frame meshlet rejection on the CPU: normal cone backface test, frustum test of the bounding sphere and,
+//when an Occlusion_Culler is given, its occlusion test. The survivors of a mesh are compacted into index
+//ranges, neighbouring meshlets merged, ready for one glMultiDrawElements.
+//Backface rejection is only valid for draws that cull back faces, turn it off for double sided ones.
+class Meshlet_Culler
+{
+public:
+	//occlusion must have been rasterized for this frame already, nullptr skips the test
+	void begin_frame(const glm::mat4& view_projection, const glm::vec3& camera_position, Occlusion_Culler* occlusion = nullptr);
+	void set_backface_culling(bool enabled) { m_backface_culling = enabled; }
+
+	//appends the visible ranges of one mesh; model may rotate, translate and scale uniformly
+	void cull(const std::vector<Meshlet>& meshlets, const glm::mat4& model, std::vector<Meshlet_Range>& ranges);
+
+	const Meshlet_Cull_Stats& get_stats() const { return m_stats; }
+
+private:
+	glm::mat4 m_view_projection = glm::mat4(1.0f);
+	glm::vec3 m_camera_position = glm::vec3(0.0f);
+	glm::vec4 m_planes[6];
+	Occlusion_Culler* m_occlusion = nullptr;
+	bool m_backface_culling = true;
+	Meshlet_Cull_Stats m_stats;
+};
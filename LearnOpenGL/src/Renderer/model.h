@@ -3,13 +3,22 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <stb_image.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/IOSystem.hpp>
+#include <assimp/MemoryIOWrapper.h>
 
 #include <Renderer/mesh.h>
 #include <Renderer/shader.h>
+#include <Renderer/shader-cache.h>
+#include <Renderer/mesh-import.h>
+#include <Renderer/texture-loader.h>
+#include <Renderer/texture-array.h>
+#include <Renderer/cascaded-shadow-map.h>
+#include <Renderer/gpu-culling.h>
+#include <Core/file-system.h>
+#include <Core/job-system.h>
 
 #include <string>
 #include <fstream>
@@ -17,10 +26,79 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <functional>
+#include <bitset>
+#include <algorithm>
 using namespace std;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
+// material map kinds that get their own texture array, in Mesh::materialLayers order
+#define MATERIAL_MAP_COUNT 4
+static_assert(MATERIAL_MAP_COUNT == sizeof(Vertex_Material_Layers), "batched vertices carry one layer byte per map kind");
+static const char* const materialMapTypes[MATERIAL_MAP_COUNT] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+static const char* const arraySamplerNames[MATERIAL_MAP_COUNT] = { "texture_diffuse1", "texture_specular1", "texture_normal1", "texture_height1" };
+
+// what packing the material textures into arrays saved per frame, compared to drawing mesh by mesh
+struct Texture_Batch_Stats
+{
+    unsigned int draws_before = 0;
+    unsigned int draws_after = 0;
+    unsigned int texture_binds_before = 0;
+    unsigned int texture_binds_after = 0;
+    unsigned int arrays = 0;
+    unsigned int layers = 0;
+    unsigned int resized_layers = 0;
+};
+
+// meshes with the same shader features merged into one buffer, drawn with a single call.
+// every vertex carries the array layers of its mesh's maps, so no per-mesh state is left.
+struct Mesh_Batch
+{
+    Shader_Features features = SHADER_FEATURE_NONE;
+    unsigned int VBO = 0, EBO = 0, layerVBO = 0;
+    // split models: VBO holds the positions and attributeVBO the rest
+    unsigned int attributeVBO = 0;
+    // from Vertex_Array_Cache like a Mesh's; depthGeometry reads positions and indices only, see Mesh::depthGeometry
+    Vertex_Binding geometry, depthGeometry;
+    unsigned int indexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    // the meshlets of every merged mesh, moved to the batch's index ranges
+    vector<Meshlet> meshlets;
+    // vertex, layer and index buffers together
+    size_t gpuBytes = 0;
+};
+
+// hands assimp whole files read through File_System, so the model and its .mtl are parsed from memory
+class File_System_Stream : public Assimp::MemoryIOStream
+{
+public:
+    explicit File_System_Stream(const File_Handle& file)
+        : Assimp::MemoryIOStream(file->get_data().data(), file->get_size()), m_file(file) {}
+
+private:
+    File_Handle m_file;
+};
+
+class File_System_IO : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char* pFile) const override { return File_System::exists(pFile); }
+    char getOsSeparator() const override { return '/'; }
+
+    Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb") override
+    {
+        if (strchr(pMode, 'w') || strchr(pMode, 'a'))
+            return nullptr;
+        File_Handle file = File_System::read(pFile);
+        if (!file->is_ready())
+            return nullptr;
+        return new File_System_Stream(file);
+    }
+
+    void Close(Assimp::IOStream* pFile) override { delete pFile; }
+};
+
 class Model
 {
 public:
@@ -29,27 +107,251 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // set when the material textures were packed into arrays: meshes then only draw through the batches
+    bool texturesPacked = false;
+    Texture_Array textureArrays[MATERIAL_MAP_COUNT];
+    vector<Mesh_Batch> batches;
+    Texture_Batch_Stats batchStats;
+    // vertices of all meshes before and after welding
+    Weld_Stats weldStats;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    // packTextureArrays puts equally typed material maps into texture arrays and merges meshes into batches,
+    // the shaders then need the TEXTURE_ARRAYS variant.
+    // splitVertexStreams keeps positions in their own buffer, so depth-only passes fetch 12 instead of 88 bytes a vertex.
+    // importOptions controls the vertex welding.
+    Model(string const& path, bool gamma = false, bool packTextureArrays = false, bool splitVertexStreams = false,
+        const Mesh_Import_Options& importOptions = Mesh_Import_Options())
+        : gammaCorrection(gamma), packTextures(packTextureArrays), splitStreams(splitVertexStreams), importOptions(importOptions)
     {
         loadModel(path);
     }
 
+    // owns the batches' buffers, the texture arrays and every texture it loaded; the meshes free their own,
+    // which after packing they already did
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    ~Model()
+    {
+        for (Mesh_Batch& batch : batches)
+        {
+            Vertex_Array_Cache::release(batch.geometry);
+            Vertex_Array_Cache::release(batch.depthGeometry);
+            GLuint buffers[] = { batch.VBO, batch.EBO, batch.layerVBO, batch.attributeVBO };
+            glDeleteBuffers(4, buffers);
+        }
+        for (Texture_Array& textureArray : textureArrays)
+            if (textureArray.id)
+                glDeleteTextures(1, &textureArray.id);
+        // meshes share these ids, textures_loaded has each one once
+        for (const Texture& texture : textures_loaded)
+            if (texture.id)
+                glDeleteTextures(1, &texture.id);
+    }
+
+    // mesh data kept for CPU work, and what the buffers and textures take on the GPU
+    size_t getCpuBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh& mesh : meshes)
+            bytes += mesh.getCpuBytes();
+        for (const Mesh_Batch& batch : batches)
+            bytes += batch.meshlets.capacity() * sizeof(Meshlet);
+        return bytes;
+    }
+
+    // queries the texture sizes, so the context must be current
+    size_t getGpuBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh& mesh : meshes)
+            bytes += mesh.getGpuBytes();
+        for (const Mesh_Batch& batch : batches)
+            bytes += batch.gpuBytes;
+        for (const Texture_Array& textureArray : textureArrays)
+            bytes += (size_t)Texture_Loader::get_gpu_bytes(textureArray.id, GL_TEXTURE_2D_ARRAY);
+        for (const Texture& texture : textures_loaded)
+            bytes += (size_t)Texture_Loader::get_gpu_bytes(texture.id);
+        return bytes;
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader& shader)
     {
+        if (texturesPacked)
+        {
+            bindTextureArrays(shader);
+            for (const Mesh_Batch& batch : batches)
+                drawBatch(batch);
+            return;
+        }
         for (unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // like Draw(shader), but only the meshlets that pass the culler's backface, frustum and occlusion tests.
+    // the culler has begun this frame already, model is the matrix the shader draws with
+    void DrawClusters(Shader& shader, Meshlet_Culler& culler, const glm::mat4& model)
+    {
+        if (texturesPacked)
+        {
+            bindTextureArrays(shader);
+            for (const Mesh_Batch& batch : batches)
+            {
+                visibleRanges.clear();
+                culler.cull(batch.meshlets, model, visibleRanges);
+                if (!visibleRanges.empty())
+                    Mesh::drawIndexRanges(batch.geometry, visibleRanges);
+            }
+            return;
+        }
+        for (Mesh& mesh : meshes)
+        {
+            visibleRanges.clear();
+            culler.cull(mesh.meshlets, model, visibleRanges);
+            mesh.DrawRanges(shader, visibleRanges);
+        }
+    }
+
+    // draws every mesh with the variant of 'program' matching the textures it has, so shaders never sample dummies.
+    // meshes sharing a variant are drawn back to back and set_uniforms runs once for every variant that gets bound.
+    void Draw(Shader_Variant_Cache& variants, const string& program, const std::function<void(Shader&)>& set_uniforms, Shader_Features extra_features = SHADER_FEATURE_NONE)
+    {
+        if (texturesPacked)
+        {
+            // one draw per batch, the arrays stay bound across all of them
+            for (unsigned int i = 0; i < batches.size(); i++)
+            {
+                std::shared_ptr<Shader> shader = variants.get(program, batches[i].features | extra_features | SHADER_FEATURE_TEXTURE_ARRAYS);
+                shader->bind();
+                set_uniforms(*shader);
+                if (i == 0)
+                    bindTextureArrays(*shader);
+                else
+                    setTextureArraySamplers(*shader);
+                drawBatch(batches[i]);
+            }
+            return;
+        }
+
+        // one bit per feature combination, no heap allocation per draw
+        std::bitset<1u << SHADER_FEATURE_COUNT> drawn;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Shader_Features features = meshes[i].features | extra_features;
+            if (drawn.test(features))
+                continue;
+            drawn.set(features);
+
+            std::shared_ptr<Shader> shader = variants.get(program, features);
+            shader->bind();
+            set_uniforms(*shader);
+            for (unsigned int j = i; j < meshes.size(); j++)
+                if ((meshes[j].features | extra_features) == features)
+                    meshes[j].Draw(*shader);
+        }
+    }
+
+    // positions only, for depth prepasses and picking; the shader just needs location 0
+    void DrawDepth()
+    {
+        if (texturesPacked)
+        {
+            Vertex_Binding bound;
+            for (const Mesh_Batch& batch : batches)
+            {
+                Vertex_Array_Cache::bind(batch.depthGeometry, bound);
+                glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT, 0);
+            }
+            glBindVertexArray(0);
+            return;
+        }
+        for (Mesh& mesh : meshes)
+            mesh.DrawDepth();
+    }
+
+    // one caster per draw, through the depth geometry and with model space bounds for the cascade culling
+    void appendShadowCasters(vector<Shadow_Caster>& casters, const glm::mat4& model, bool isStatic = true) const
+    {
+        auto append = [&](const Vertex_Binding& depthGeometry, unsigned int indexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+        {
+            Shadow_Caster caster;
+            caster.geometry = depthGeometry;
+            caster.count = indexCount;
+            caster.indexed = true;
+            caster.is_static = isStatic;
+            caster.model = model;
+            caster.bounds_min = boundsMin;
+            caster.bounds_max = boundsMax;
+            casters.push_back(caster);
+        };
+        if (texturesPacked)
+        {
+            for (const Mesh_Batch& batch : batches)
+                append(batch.depthGeometry, batch.indexCount, batch.boundsMin, batch.boundsMax);
+            return;
+        }
+        for (const Mesh& mesh : meshes)
+            append(mesh.depthGeometry, (unsigned int)mesh.indices.size(), mesh.boundsMin, mesh.boundsMax);
+    }
+
+    // copies the geometry of every mesh into a GPU culler and returns the culler's mesh index for each,
+    // instances are then added with Gpu_Culler::add_instance. Only geometry goes over, materials stay here.
+    vector<uint32_t> addToGpuCuller(Gpu_Culler& culler) const
+    {
+        vector<uint32_t> ids;
+        for (const Mesh& mesh : meshes)
+        {
+            if (mesh.splitStreams)
+            {
+                ids.push_back(culler.add_mesh(mesh.positions, mesh.attributes, mesh.indices));
+                continue;
+            }
+            vector<Vertex_Attributes> attributes(mesh.vertices.size());
+            for (size_t i = 0; i < mesh.vertices.size(); i++)
+            {
+                const Vertex& vertex = mesh.vertices[i];
+                attributes[i].Normal = vertex.Normal;
+                attributes[i].TexCoords = vertex.TexCoords;
+                attributes[i].Tangent = vertex.Tangent;
+                attributes[i].Bitangent = vertex.Bitangent;
+                std::copy(vertex.m_BoneIDs, vertex.m_BoneIDs + MAX_BONE_INFLUENCE, attributes[i].m_BoneIDs);
+                std::copy(vertex.m_Weights, vertex.m_Weights + MAX_BONE_INFLUENCE, attributes[i].m_Weights);
+            }
+            ids.push_back(culler.add_mesh(mesh.positions, attributes, mesh.indices));
+        }
+        return ids;
+    }
+
 private:
+    // what importGeometry builds for one mesh before processMesh adds the materials
+    struct MeshGeometry
+    {
+        vector<Vertex> vertices;
+        vector<glm::vec3> positions;
+        vector<Vertex_Attributes> attributes;
+        vector<unsigned int> indices;
+        vector<Meshlet> meshlets;
+        Weld_Stats weldStats;
+    };
+
+    Texture_Loader textureLoader;
+    bool packTextures;
+    bool splitStreams;
+    Mesh_Import_Options importOptions;
+    // scratch for DrawClusters, reused every frame
+    vector<Meshlet_Range> visibleRanges;
+    Texture_Array_Packer texturePackers[MATERIAL_MAP_COUNT];
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        // the importer owns the handler
+        importer.SetIOHandler(new File_System_IO());
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -60,86 +362,260 @@ private:
         directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        vector<aiMesh*> sceneMeshes;
+        processNode(scene->mRootNode, scene, sceneMeshes);
+        // welded vertices, generated normals and tangents and meshlets only depend on their own mesh, so they are built
+        // on every core; materials and uploads stay on this thread
+        vector<MeshGeometry> geometry(sceneMeshes.size());
+        Job_System::parallel_for((uint32_t)sceneMeshes.size(), [&](uint32_t i)
+        {
+            importGeometry(sceneMeshes[i], geometry[i]);
+        });
+        weldStats = Weld_Stats();
+        for (size_t i = 0; i < sceneMeshes.size(); i++)
+        {
+            weldStats.add(geometry[i].weldStats);
+            meshes.push_back(processMesh(sceneMeshes[i], scene, geometry[i]));
+        }
+        if (importOptions.weld)
+            cout << "Welded " << path << ": " << weldStats.vertices_before << " -> " << weldStats.vertices_after << " vertices, "
+                << (weldStats.bytes_before - weldStats.bytes_after) / 1024 << " KB saved" << endl;
+        if (packTextures)
+            packMaterialTextures();
+        // every texture the materials asked for is read, decoded and uploaded in one go
+        textureLoader.load_all();
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    // builds the texture arrays and batches, falls back to separate textures if a map kind has too many images
+    void packMaterialTextures()
     {
-        // process each mesh located at the current node
-        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        for (Mesh& mesh : meshes)
         {
-            // the node object only contains indices to index the actual objects in the scene. 
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            for (const Texture& texture : mesh.textures)
+            {
+                for (int type = 0; type < MATERIAL_MAP_COUNT; type++)
+                {
+                    // the first map of each kind is the one the shaders sample
+                    if (texture.type == materialMapTypes[type] && mesh.materialLayers[type] < 0)
+                        mesh.materialLayers[type] = texturePackers[type].add(this->directory + '/' + texture.path);
+                }
+            }
+            for (int type = 0; type < MATERIAL_MAP_COUNT; type++)
+            {
+                bool hasMap = false;
+                for (const Texture& texture : mesh.textures)
+                    hasMap |= texture.type == materialMapTypes[type];
+                if (hasMap && mesh.materialLayers[type] < 0)
+                {
+                    cout << "Too many " << materialMapTypes[type] << " maps for one texture array, loading them separately" << endl;
+                    loadUnpackedTextures();
+                    return;
+                }
+            }
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++)
+
+        batchStats = Texture_Batch_Stats();
+        for (int type = 0; type < MATERIAL_MAP_COUNT; type++)
         {
-            processNode(node->mChildren[i], scene);
+            if (texturePackers[type].empty())
+                continue;
+            textureArrays[type] = texturePackers[type].build();
+            batchStats.arrays++;
+            batchStats.layers += textureArrays[type].layers;
+            batchStats.resized_layers += textureArrays[type].resized_layers;
         }
+        buildBatches();
+        texturesPacked = true;
 
+        batchStats.draws_before = (unsigned int)meshes.size();
+        batchStats.draws_after = (unsigned int)batches.size();
+        for (const Mesh& mesh : meshes)
+            batchStats.texture_binds_before += (unsigned int)mesh.textures.size();
+        batchStats.texture_binds_after = batchStats.arrays;
+        cout << "Packed " << batchStats.layers << " textures into " << batchStats.arrays << " arrays (" << batchStats.resized_layers << " resized): "
+            << batchStats.draws_before << " -> " << batchStats.draws_after << " draws, "
+            << batchStats.texture_binds_before << " -> " << batchStats.texture_binds_after << " texture binds per frame" << endl;
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    // packing gave up, every texture goes through the regular loader after all
+    void loadUnpackedTextures()
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        for (Texture& loaded : textures_loaded)
+            loaded.id = textureLoader.add(this->directory + '/' + loaded.path);
+        for (Mesh& mesh : meshes)
+        {
+            mesh.materialLayers = glm::ivec4(-1);
+            for (Texture& texture : mesh.textures)
+                for (const Texture& loaded : textures_loaded)
+                    if (loaded.path == texture.path)
+                        texture.id = loaded.id;
+        }
+    }
+
+    void buildBatches()
+    {
+        vector<bool> batched(meshes.size(), false);
+        for (unsigned int first = 0; first < meshes.size(); first++)
+        {
+            if (batched[first])
+                continue;
 
-        // walk through each of the mesh's vertices
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-        {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
+            Mesh_Batch batch;
+            batch.features = meshes[first].features;
+            batch.boundsMin = meshes[first].boundsMin;
+            batch.boundsMax = meshes[first].boundsMax;
+            vector<Vertex> vertices;
+            vector<glm::vec3> positions;
+            vector<Vertex_Attributes> attributes;
+            vector<unsigned int> indices;
+            vector<Vertex_Material_Layers> layers;
+            for (unsigned int i = first; i < meshes.size(); i++)
             {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
+                const Mesh& mesh = meshes[i];
+                if (batched[i] || mesh.features != batch.features)
+                    continue;
+                batched[i] = true;
+
+                unsigned int baseVertex = (unsigned int)positions.size();
+                positions.insert(positions.end(), mesh.positions.begin(), mesh.positions.end());
+                if (splitStreams)
+                    attributes.insert(attributes.end(), mesh.attributes.begin(), mesh.attributes.end());
+                else
+                    vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+                batch.boundsMin = glm::min(batch.boundsMin, mesh.boundsMin);
+                batch.boundsMax = glm::max(batch.boundsMax, mesh.boundsMax);
+                for (Meshlet meshlet : mesh.meshlets)
+                {
+                    meshlet.first_index += (uint32_t)indices.size();
+                    batch.meshlets.push_back(meshlet);
+                }
+                for (unsigned int index : mesh.indices)
+                    indices.push_back(baseVertex + index);
+                // missing maps are never sampled, their layer does not matter
+                Vertex_Material_Layers meshLayers;
+                for (int type = 0; type < MATERIAL_MAP_COUNT; type++)
+                    meshLayers.Layers[type] = (unsigned char)std::max(0, mesh.materialLayers[type]);
+                layers.insert(layers.end(), mesh.positions.size(), meshLayers);
             }
-            // texture coordinates
-            if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            batch.indexCount = (unsigned int)indices.size();
+
+            glGenBuffers(1, &batch.VBO);
+            glGenBuffers(1, &batch.EBO);
+            glGenBuffers(1, &batch.layerVBO);
+            // the element buffer binding belongs to whichever vertex array is bound
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, batch.VBO);
+            if (splitStreams)
             {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+                glGenBuffers(1, &batch.attributeVBO);
+                glBindBuffer(GL_ARRAY_BUFFER, batch.attributeVBO);
+                glBufferData(GL_ARRAY_BUFFER, attributes.size() * sizeof(Vertex_Attributes), attributes.data(), GL_STATIC_DRAW);
             }
             else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+                glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+            // material layers, one byte per map kind
+            glBindBuffer(GL_ARRAY_BUFFER, batch.layerVBO);
+            glBufferData(GL_ARRAY_BUFFER, layers.size() * sizeof(Vertex_Material_Layers), layers.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-            vertices.push_back(vertex);
+            // every stream before the layers ends at location 6, so they land on location 7
+            Vertex_Layout_View layouts[MAX_VERTEX_STREAMS];
+            GLuint buffers[MAX_VERTEX_STREAMS];
+            uint32_t streamCount = 0;
+            if (splitStreams)
+            {
+                layouts[streamCount] = vertex_layout_of<Vertex_Position>();
+                buffers[streamCount++] = batch.VBO;
+                layouts[streamCount] = vertex_layout_of<Vertex_Attributes>();
+                buffers[streamCount++] = batch.attributeVBO;
+            }
+            else
+            {
+                layouts[streamCount] = vertex_layout_of<Vertex>();
+                buffers[streamCount++] = batch.VBO;
+            }
+            layouts[streamCount] = vertex_layout_of<Vertex_Material_Layers>();
+            buffers[streamCount++] = batch.layerVBO;
+            batch.geometry = Vertex_Array_Cache::acquire(layouts, buffers, streamCount, batch.EBO);
+            Vertex_Layout_View depthLayout = vertex_layout_prefix(layouts[0], 1);
+            batch.depthGeometry = Vertex_Array_Cache::acquire(&depthLayout, &batch.VBO, 1, batch.EBO);
+            batch.gpuBytes = positions.size() * (splitStreams ? sizeof(glm::vec3) + sizeof(Vertex_Attributes) : sizeof(Vertex))
+                + layers.size() * sizeof(Vertex_Material_Layers) + indices.size() * sizeof(unsigned int);
+            batches.push_back(std::move(batch));
         }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        // the batches hold a copy of every mesh's geometry, the meshes' own buffers would only double the memory
+        for (Mesh& mesh : meshes)
+            mesh.releaseBuffers();
+    }
+
+    void setTextureArraySamplers(Shader& shader)
+    {
+        for (int type = 0; type < MATERIAL_MAP_COUNT; type++)
+            if (textureArrays[type].id)
+                glUniform1i(glGetUniformLocation(shader.ID(), arraySamplerNames[type]), type);
+    }
+
+    void bindTextureArrays(Shader& shader)
+    {
+        for (int type = 0; type < MATERIAL_MAP_COUNT; type++)
+        {
+            if (!textureArrays[type].id)
+                continue;
+            glActiveTexture(GL_TEXTURE0 + type);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, textureArrays[type].id);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        setTextureArraySamplers(shader);
+    }
+
+    void drawBatch(const Mesh_Batch& batch)
+    {
+        Vertex_Binding bound;
+        Vertex_Array_Cache::bind(batch.geometry, bound);
+        glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    // processes a node in a recursive fashion. Collects each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(aiNode* node, const aiScene* scene, vector<aiMesh*>& sceneMeshes)
+    {
+        // process each mesh located at the current node
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        {
+            // the node object only contains indices to index the actual objects in the scene. 
+            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+            sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+        }
+        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            processNode(node->mChildren[i], scene, sceneMeshes);
         }
+
+    }
+
+    // positions, normals, texture coordinates and tangents, shared with the headless benchmark. Runs on a worker.
+    void importGeometry(const aiMesh* mesh, MeshGeometry& geometry) const
+    {
+        if (splitStreams)
+            import_mesh_streams(mesh, geometry.positions, geometry.attributes, geometry.indices, importOptions, &geometry.weldStats);
+        else
+            import_mesh_geometry(mesh, geometry.vertices, geometry.indices, importOptions, &geometry.weldStats);
+        // cluster the triangles for Meshlet_Culler, this reorders the indices so each meshlet is one range
+        geometry.meshlets = splitStreams
+            ? build_meshlets(geometry.positions.data(), geometry.positions.size(), sizeof(glm::vec3), geometry.indices)
+            : build_meshlets(geometry.vertices.empty() ? nullptr : &geometry.vertices[0].Position, geometry.vertices.size(), sizeof(Vertex), geometry.indices);
+    }
+
+    Mesh processMesh(aiMesh* mesh, const aiScene* scene, MeshGeometry& geometry)
+    {
+        // data to fill
+        vector<Texture> textures;
+
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -149,6 +625,7 @@ private:
         // specular: texture_specularN
         // normal: texture_normalN
 
+        // with packing the textures are only recorded here, their arrays are built once all meshes are known
         // 1. diffuse maps
         vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
@@ -163,7 +640,11 @@ private:
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        Mesh result = splitStreams
+            ? Mesh(std::move(geometry.positions), std::move(geometry.attributes), std::move(geometry.indices), textures)
+            : Mesh(std::move(geometry.vertices), std::move(geometry.indices), textures);
+        result.meshlets = std::move(geometry.meshlets);
+        return result;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -189,7 +670,7 @@ private:
             if (!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = packTextures ? 0 : textureLoader.add(this->directory + '/' + str.C_Str());
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -201,42 +682,7 @@ private:
 };
 
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+inline unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return Texture_Loader::load(directory + '/' + string(path));
 }
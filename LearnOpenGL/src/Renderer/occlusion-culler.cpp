@@ -0,0 +1,292 @@
+#include "occlusion-culler.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "Core/job-system.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE 1
+#endif
+
+//triangles this close to the eye are dropped instead of clipped, skipping an occluder is always safe
+static const float s_near_w = 1.0e-3f;
+
+Occlusion_Culler::Occlusion_Culler(uint32_t width, uint32_t height)
+	:m_width((width + tile_width - 1) / tile_width * tile_width), m_height((height + tile_height - 1) / tile_height * tile_height)
+{
+	m_tiles_x = m_width / tile_width;
+	m_tiles_y = m_height / tile_height;
+	m_depth.resize(m_width * m_height, 1.0f);
+
+	uint32_t level_width = m_width, level_height = m_height;
+	while (level_width > 1 || level_height > 1)
+	{
+		level_width = (level_width + 1) / 2;
+		level_height = (level_height + 1) / 2;
+		m_level_sizes.push_back(glm::uvec2(level_width, level_height));
+		m_max_levels.emplace_back(level_width * level_height, 1.0f);
+		m_min_levels.emplace_back(level_width * level_height, 1.0f);
+	}
+}
+
+void Occlusion_Culler::begin_frame(const glm::mat4& view_projection)
+{
+	m_view_projection = view_projection;
+	m_occluders.clear();
+	m_stats = Occlusion_Stats();
+}
+
+void Occlusion_Culler::add_occluder(const glm::vec3* positions, const uint32_t* indices, uint32_t index_count, const glm::mat4& model)
+{
+	Occluder occluder;
+	occluder.positions = positions;
+	occluder.indices = indices;
+	occluder.index_count = index_count;
+	occluder.model = model;
+	occluder.first_triangle = m_stats.occluder_triangles;
+	m_occluders.push_back(occluder);
+	m_stats.occluder_triangles += index_count / 3;
+}
+
+void Occlusion_Culler::rasterize()
+{
+	//1. transform and set up every triangle, one occluder per job
+	m_triangles.resize(m_stats.occluder_triangles);
+	Job_System::parallel_for((uint32_t)m_occluders.size(), [this](uint32_t i) { setup_occluder(m_occluders[i]); });
+	for (const Triangle& triangle : m_triangles)
+		m_stats.rasterized_triangles += triangle.valid ? 1 : 0;
+
+	//2. every tile owns its pixels, so tiles fill without any synchronisation
+	std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+	Job_System::parallel_for(m_tiles_x * m_tiles_y, [this](uint32_t tile) { rasterize_tile(tile); });
+
+	build_hierarchy();
+}
+
+void Occlusion_Culler::setup_occluder(const Occluder& occluder)
+{
+	glm::mat4 model_view_projection = m_view_projection * occluder.model;
+	for (uint32_t t = 0; t < occluder.index_count / 3; t++)
+	{
+		Triangle& triangle = m_triangles[occluder.first_triangle + t];
+		triangle.valid = false;
+
+		glm::vec3 screen[3];
+		bool behind = false;
+		for (int v = 0; v < 3; v++)
+		{
+			glm::vec4 clip = model_view_projection * glm::vec4(occluder.positions[occluder.indices[t * 3 + v]], 1.0f);
+			if (clip.w < s_near_w)
+			{
+				behind = true;
+				break;
+			}
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			screen[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * m_width, (ndc.y * 0.5f + 0.5f) * m_height, ndc.z);
+		}
+		if (behind)
+			continue;
+
+		//counter-clockwise is front facing, back faces are always behind the front of a closed occluder
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+		if (area <= 0.0f)
+			continue;
+
+		float min_x = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+		float max_x = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+		float min_y = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+		float max_y = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+		if (max_x < 0.0f || max_y < 0.0f || min_x >= m_width || min_y >= m_height)
+			continue;
+		triangle.min_x = std::max(0, (int)floor(min_x));
+		triangle.min_y = std::max(0, (int)floor(min_y));
+		triangle.max_x = std::min((int)m_width - 1, (int)ceil(max_x));
+		triangle.max_y = std::min((int)m_height - 1, (int)ceil(max_y));
+
+		//E(p) = a * x + b * y + c, positive inside for a counter-clockwise triangle
+		for (int e = 0; e < 3; e++)
+		{
+			const glm::vec3& v0 = screen[e];
+			const glm::vec3& v1 = screen[(e + 1) % 3];
+			triangle.edge_a[e] = v0.y - v1.y;
+			triangle.edge_b[e] = v1.x - v0.x;
+			triangle.edge_c[e] = -(triangle.edge_a[e] * v0.x + triangle.edge_b[e] * v0.y);
+		}
+
+		float dz1 = screen[1].z - screen[0].z, dz2 = screen[2].z - screen[0].z;
+		triangle.dzdx = (dz1 * (screen[2].y - screen[0].y) - dz2 * (screen[1].y - screen[0].y)) / area;
+		triangle.dzdy = (dz2 * (screen[1].x - screen[0].x) - dz1 * (screen[2].x - screen[0].x)) / area;
+		triangle.z0 = screen[0].z - triangle.dzdx * screen[0].x - triangle.dzdy * screen[0].y;
+		triangle.valid = true;
+	}
+}
+
+void Occlusion_Culler::rasterize_tile(uint32_t tile)
+{
+	int tile_x0 = (int)((tile % m_tiles_x) * tile_width), tile_y0 = (int)((tile / m_tiles_x) * tile_height);
+	int tile_x1 = tile_x0 + tile_width - 1, tile_y1 = tile_y0 + tile_height - 1;
+
+	for (const Triangle& triangle : m_triangles)
+	{
+		if (!triangle.valid || triangle.max_x < tile_x0 || triangle.min_x > tile_x1 || triangle.max_y < tile_y0 || triangle.min_y > tile_y1)
+			continue;
+
+		int x0 = std::max(triangle.min_x, tile_x0) & ~3;
+		int x1 = std::min(triangle.max_x, tile_x1);
+		int y0 = std::max(triangle.min_y, tile_y0);
+		int y1 = std::min(triangle.max_y, tile_y1);
+
+#ifdef OCCLUSION_USE_SSE
+		__m128 a0 = _mm_set1_ps(triangle.edge_a[0]), a1 = _mm_set1_ps(triangle.edge_a[1]), a2 = _mm_set1_ps(triangle.edge_a[2]);
+		__m128 dzdx = _mm_set1_ps(triangle.dzdx);
+		__m128 zero = _mm_setzero_ps();
+		__m128 lane_offset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		for (int y = y0; y <= y1; y++)
+		{
+			float py = y + 0.5f;
+			__m128 row0 = _mm_set1_ps(triangle.edge_b[0] * py + triangle.edge_c[0]);
+			__m128 row1 = _mm_set1_ps(triangle.edge_b[1] * py + triangle.edge_c[1]);
+			__m128 row2 = _mm_set1_ps(triangle.edge_b[2] * py + triangle.edge_c[2]);
+			__m128 row_z = _mm_set1_ps(triangle.z0 + triangle.dzdy * py);
+			float* row = &m_depth[y * m_width];
+			for (int x = x0; x <= x1; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane_offset);
+				//strictly inside only, occluders must never cover more than they really do
+				__m128 inside = _mm_and_ps(_mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a0, px), row0), zero),
+					_mm_and_ps(_mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a1, px), row1), zero), _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(a2, px), row2), zero)));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+				__m128 depth = _mm_loadu_ps(row + x);
+				__m128 z = _mm_min_ps(depth, _mm_add_ps(_mm_mul_ps(dzdx, px), row_z));
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, depth)));
+			}
+		}
+#else
+		for (int y = y0; y <= y1; y++)
+		{
+			float py = y + 0.5f;
+			for (int x = x0; x <= x1; x++)
+			{
+				float px = x + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++)
+					inside = inside && triangle.edge_a[e] * px + triangle.edge_b[e] * py + triangle.edge_c[e] > 0.0f;
+				if (!inside)
+					continue;
+				float z = triangle.z0 + triangle.dzdx * px + triangle.dzdy * py;
+				float& depth = m_depth[y * m_width + x];
+				depth = std::min(depth, z);
+			}
+		}
+#endif
+	}
+}
+
+void Occlusion_Culler::build_hierarchy()
+{
+	uint32_t source_width = m_width, source_height = m_height;
+	const float* source_max = m_depth.data();
+	const float* source_min = m_depth.data();
+	for (size_t level = 0; level < m_max_levels.size(); level++)
+	{
+		glm::uvec2 size = m_level_sizes[level];
+		float* max_out = m_max_levels[level].data();
+		float* min_out = m_min_levels[level].data();
+		for (uint32_t y = 0; y < size.y; y++)
+		{
+			uint32_t sy0 = y * 2, sy1 = std::min(y * 2 + 1, source_height - 1);
+			for (uint32_t x = 0; x < size.x; x++)
+			{
+				uint32_t sx0 = x * 2, sx1 = std::min(x * 2 + 1, source_width - 1);
+				max_out[y * size.x + x] = std::max(std::max(source_max[sy0 * source_width + sx0], source_max[sy0 * source_width + sx1]),
+					std::max(source_max[sy1 * source_width + sx0], source_max[sy1 * source_width + sx1]));
+				min_out[y * size.x + x] = std::min(std::min(source_min[sy0 * source_width + sx0], source_min[sy0 * source_width + sx1]),
+					std::min(source_min[sy1 * source_width + sx0], source_min[sy1 * source_width + sx1]));
+			}
+		}
+		source_width = size.x;
+		source_height = size.y;
+		source_max = max_out;
+		source_min = min_out;
+	}
+}
+
+bool Occlusion_Culler::is_visible(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::mat4& model)
+{
+	m_stats.tested++;
+
+	glm::mat4 model_view_projection = m_view_projection * model;
+	float min_x = 1.0f, max_x = -1.0f, min_y = 1.0f, max_y = -1.0f, min_z = 1.0f;
+	for (int c = 0; c < 8; c++)
+	{
+		glm::vec3 corner((c & 1) ? bounds_max.x : bounds_min.x, (c & 2) ? bounds_max.y : bounds_min.y, (c & 4) ? bounds_max.z : bounds_min.z);
+		glm::vec4 clip = model_view_projection * glm::vec4(corner, 1.0f);
+		//the box reaches behind the eye, nothing sensible to test against
+		if (clip.w < s_near_w)
+			return true;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		min_x = std::min(min_x, ndc.x);
+		max_x = std::max(max_x, ndc.x);
+		min_y = std::min(min_y, ndc.y);
+		max_y = std::max(max_y, ndc.y);
+		min_z = std::min(min_z, ndc.z);
+	}
+	if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f)
+	{
+		m_stats.culled++;
+		return false;
+	}
+
+	//conservative pixel rectangle at full resolution
+	int x0 = std::max(0, (int)floor((min_x * 0.5f + 0.5f) * m_width));
+	int x1 = std::min((int)m_width - 1, (int)floor((max_x * 0.5f + 0.5f) * m_width));
+	int y0 = std::max(0, (int)floor((min_y * 0.5f + 0.5f) * m_height));
+	int y1 = std::min((int)m_height - 1, (int)floor((max_y * 0.5f + 0.5f) * m_height));
+
+	//start at the level where the rectangle spans at most 2x2 texels and refine only where it is ambiguous
+	int level = -1;
+	while (level + 1 < (int)m_max_levels.size() && ((x1 >> (level + 1)) - (x0 >> (level + 1)) > 1 || (y1 >> (level + 1)) - (y0 >> (level + 1)) > 1))
+		level++;
+
+	struct Texel { int level, x, y; };
+	Texel stack[64];
+	int stack_size = 0;
+	int shift = level + 1;
+	for (int y = y0 >> shift; y <= (y1 >> shift); y++)
+		for (int x = x0 >> shift; x <= (x1 >> shift); x++)
+			stack[stack_size++] = { level, x, y };
+
+	while (stack_size > 0)
+	{
+		Texel texel = stack[--stack_size];
+		if (texel.level < 0)
+		{
+			if (min_z <= m_depth[texel.y * m_width + texel.x])
+				return true;
+			continue;
+		}
+		uint32_t level_width = m_level_sizes[texel.level].x;
+		//behind the farthest occluder depth in this texel, nothing to see here
+		if (min_z > m_max_levels[texel.level][texel.y * level_width + texel.x])
+			continue;
+		//in front of the nearest occluder depth, certainly visible
+		if (min_z <= m_min_levels[texel.level][texel.y * level_width + texel.x])
+			return true;
+
+		int child_shift = texel.level;
+		for (int cy = texel.y * 2; cy <= texel.y * 2 + 1; cy++)
+			for (int cx = texel.x * 2; cx <= texel.x * 2 + 1; cx++)
+			{
+				//only children that overlap the rectangle
+				if ((cx << child_shift) > x1 || ((cx + 1) << child_shift) - 1 < x0 || (cy << child_shift) > y1 || ((cy + 1) << child_shift) - 1 < y0)
+					continue;
+				stack[stack_size++] = { texel.level - 1, cx, cy };
+			}
+	}
+
+	m_stats.culled++;
+	return false;
+}
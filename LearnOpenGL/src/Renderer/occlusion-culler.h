@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Occlusion_Stats
+{
+	uint32_t occluder_triangles = 0;	//submitted
+	uint32_t rasterized_triangles = 0;	//survived near plane, backface and screen rejection
+	uint32_t tested = 0;
+	uint32_t culled = 0;
+};
+
+//Software occlusion culling in the spirit of masked occlusion culling: a few low-poly occluders are
+//rasterized four pixels at a time into a small depth buffer, split into screen tiles that are filled
+//in parallel, then reduced into a min/max depth hierarchy that occludee boxes are tested against.
+//Depth is NDC z/w, which interpolates linearly in screen space, cleared to 1 (far).
+//No GL involved, the whole thing runs and can be tested headless.
+class Occlusion_Culler
+{
+public:
+	//width must be a multiple of the tile width, tiles are rasterized in parallel on the job system
+	Occlusion_Culler(uint32_t width = 256, uint32_t height = 128);
+
+	void begin_frame(const glm::mat4& view_projection);
+	//occluder data must stay alive until rasterize() returns, counter-clockwise triangles are front facing
+	void add_occluder(const glm::vec3* positions, const uint32_t* indices, uint32_t index_count, const glm::mat4& model);
+	void rasterize();
+
+	//true if any part of the box may be visible, false only when it is certainly hidden
+	bool is_visible(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::mat4& model = glm::mat4(1.0f));
+
+	uint32_t get_width() const { return m_width; }
+	uint32_t get_height() const { return m_height; }
+	const std::vector<float>& get_depth_buffer() const { return m_depth; }
+	uint32_t get_level_count() const { return (uint32_t)m_max_levels.size(); }
+	const Occlusion_Stats& get_stats() const { return m_stats; }
+
+	static const uint32_t tile_width = 32;
+	static const uint32_t tile_height = 16;
+
+private:
+	struct Occluder
+	{
+		const glm::vec3* positions;
+		const uint32_t* indices;
+		uint32_t index_count;
+		glm::mat4 model;
+		uint32_t first_triangle;
+	};
+
+	//screen space triangle with its edge functions and depth plane, ready for any tile
+	struct Triangle
+	{
+		float edge_a[3], edge_b[3], edge_c[3];
+		float z0, dzdx, dzdy;
+		int min_x, min_y, max_x, max_y;
+		bool valid;
+	};
+
+	void setup_occluder(const Occluder& occluder);
+	void rasterize_tile(uint32_t tile);
+	void build_hierarchy();
+
+private:
+	uint32_t m_width, m_height;
+	uint32_t m_tiles_x, m_tiles_y;
+	glm::mat4 m_view_projection = glm::mat4(1.0f);
+
+	std::vector<Occluder> m_occluders;
+	std::vector<Triangle> m_triangles;
+	std::vector<float> m_depth;
+
+	//level 0 is half resolution, each level halves again; max is the farthest occluder depth, min the nearest
+	std::vector<std::vector<float>> m_max_levels;
+	std::vector<std::vector<float>> m_min_levels;
+	std::vector<glm::uvec2> m_level_sizes;
+
+	Occlusion_Stats m_stats;
+};
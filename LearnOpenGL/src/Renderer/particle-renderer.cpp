@@ -0,0 +1,73 @@
+#include "particle-renderer.h"
+
+#include <cstring>
+
+#include "vertex-array.h"
+
+Particle_Renderer::~Particle_Renderer()
+{
+	shutdown();
+}
+
+void Particle_Renderer::init()
+{
+	glGenVertexArrays(1, &m_vertex_array);
+	glGenBuffers(1, &m_instance_buffer);
+	glBindVertexArray(m_vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instance_buffer);
+	apply_vertex_layout(vertex_layout_of<Particle_Instance>(), 0);
+	//position, size and color all advance per instance, the quad corners come from gl_VertexID
+	for (uint32_t location = 0; location < 3; location++)
+		glVertexAttribDivisor(location, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_capacity = 0;
+}
+
+void Particle_Renderer::shutdown()
+{
+	if (!m_vertex_array)
+		return;
+	glDeleteBuffers(1, &m_instance_buffer);
+	glDeleteVertexArrays(1, &m_vertex_array);
+	m_instance_buffer = 0;
+	m_vertex_array = 0;
+	m_capacity = 0;
+}
+
+void Particle_Renderer::draw(Shader& shader, const Particle_Instance* instances, uint32_t count, const glm::mat4& view, const glm::mat4& projection)
+{
+	if (!m_vertex_array || count == 0 || !shader.is_ready())
+		return;
+
+	size_t size = (size_t)count * sizeof(Particle_Instance);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instance_buffer);
+	//grown by half again so a slowly rising count does not reallocate every frame
+	if (size > m_capacity)
+	{
+		m_capacity = size + size / 2;
+		glBufferData(GL_ARRAY_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+	}
+	//invalidating the whole buffer orphans it, the last frame's draw keeps reading the old storage
+	void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!mapped)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+	memcpy(mapped, instances, size);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	shader.bind();
+	shader.set_mat4("view", view);
+	shader.set_mat4("projection", projection);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+	glBindVertexArray(m_vertex_array);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+	glBindVertexArray(0);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+}
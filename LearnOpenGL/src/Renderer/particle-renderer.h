@@ -0,0 +1,32 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "particle-system.h"
+
+//Draws Particle_Instance arrays as instanced camera facing quads, one draw call for all of them.
+//The instances are streamed into a buffer that is orphaned every frame, so the driver hands out fresh
+//storage instead of waiting for the GPU to finish reading the previous frame's particles.
+//Belongs to the thread that owns the GL context.
+class Particle_Renderer
+{
+public:
+	Particle_Renderer() = default;
+	~Particle_Renderer();
+	Particle_Renderer(const Particle_Renderer&) = delete;
+	Particle_Renderer& operator=(const Particle_Renderer&) = delete;
+
+	void init();
+	void shutdown();
+
+	//alpha blended over the bound framebuffer, depth tested but not written; instances should be back to front.
+	//skipped while the shader is still building
+	void draw(Shader& shader, const Particle_Instance* instances, uint32_t count, const glm::mat4& view, const glm::mat4& projection);
+
+private:
+	GLuint m_vertex_array = 0;
+	GLuint m_instance_buffer = 0;
+	size_t m_capacity = 0;				//bytes
+};
@@ -0,0 +1,445 @@
+#include "particle-system.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "Core/job-system.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PARTICLE_USE_SSE 1
+#endif
+
+//particles per parallel_for item, a multiple of four
+static const uint32_t s_block_size = 16384;
+//radix sort digits, two passes cover the 16 bit depth keys
+static const uint32_t s_radix_bits = 8;
+static const uint32_t s_radix_size = 1 << s_radix_bits;
+
+static uint32_t round_up4(uint32_t count)
+{
+	return (count + 3) & ~3u;
+}
+
+#ifndef PARTICLE_USE_SSE
+static float random_lane(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+#endif
+
+#ifdef PARTICLE_USE_SSE
+//random_lane() on all four lanes
+static __m128 random_lanes(__m128i& state)
+{
+	state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+	state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+	state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(state, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+//low + (high - low) * random
+static __m128 random_range(__m128i& state, float low, float high)
+{
+	return _mm_add_ps(_mm_set1_ps(low), _mm_mul_ps(random_lanes(state), _mm_set1_ps(high - low)));
+}
+#endif
+
+static int pack_color(const glm::vec4& color)
+{
+	glm::vec4 clamped = glm::clamp(color, glm::vec4(0.0f), glm::vec4(1.0f)) * 255.0f + 0.5f;
+	uint32_t packed = (uint32_t)clamped.r | (uint32_t)clamped.g << 8 | (uint32_t)clamped.b << 16 | (uint32_t)clamped.a << 24;
+	return (int)packed;
+}
+
+Particle_System::Particle_System(uint32_t capacity)
+	:m_capacity(capacity), m_random{ 0x9E3779B9u, 0x7F4A7C15u, 0x85EBCA6Bu, 0xC2B2AE35u }
+{
+	//four more than the padded capacity: emit() writes whole groups starting at any count
+	size_t padded = round_up4(capacity) + 4;
+	for (std::vector<float>* stream : { &m_streams.position_x, &m_streams.position_y, &m_streams.position_z,
+		&m_streams.velocity_x, &m_streams.velocity_y, &m_streams.velocity_z, &m_streams.life, &m_streams.life_rate })
+		stream->assign(padded, 0.0f);
+	m_streams.emitter.assign(padded, 0);
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		m_sort_keys[i].resize(capacity);
+		m_sort_order[i].resize(capacity);
+	}
+	size_t blocks = ((size_t)capacity + s_block_size - 1) / s_block_size;
+	m_block_histograms.resize(blocks * s_radix_size);
+	m_block_offsets.resize(blocks);
+}
+
+uint32_t Particle_System::add_emitter(const Particle_Emitter& emitter)
+{
+	Emitter_State state;
+	state.config = emitter;
+	m_emitters.push_back(state);
+	return (uint32_t)m_emitters.size() - 1;
+}
+
+void Particle_System::update(float dt)
+{
+	if (dt <= 0.0f)
+		return;
+	integrate(dt);
+	kill();
+	for (uint32_t e = 0; e < m_emitters.size(); e++)
+	{
+		Emitter_State& emitter = m_emitters[e];
+		emitter.pending += emitter.config.rate * dt;
+		uint32_t count = (uint32_t)emitter.pending;
+		emitter.pending -= (float)count;
+		emit(e, count);
+	}
+}
+
+uint32_t Particle_System::emit(uint32_t emitter_index, uint32_t count)
+{
+	uint32_t emitted = std::min(count, m_capacity - m_count);
+	m_stats.dropped += count - emitted;
+	if (emitted == 0)
+		return 0;
+
+	const Particle_Emitter& emitter = m_emitters[emitter_index].config;
+	float direction_length = glm::length(emitter.direction);
+	glm::vec3 direction = direction_length > 0.0f ? emitter.direction / direction_length : glm::vec3(0.0f, 1.0f, 0.0f);
+	Particle_Streams& s = m_streams;
+	uint32_t first = m_count, end = m_count + emitted;
+#ifdef PARTICLE_USE_SSE
+	//the last group runs past end into the padding, those lanes are overwritten by the next emit
+	__m128i state = _mm_loadu_si128((const __m128i*)m_random);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128i emitter_lanes = _mm_set1_epi32((int)emitter_index);
+	for (uint32_t i = first; i < end; i += 4)
+	{
+		__m128 x = _mm_add_ps(_mm_set1_ps(emitter.position.x), random_range(state, -emitter.extent.x, emitter.extent.x));
+		__m128 y = _mm_add_ps(_mm_set1_ps(emitter.position.y), random_range(state, -emitter.extent.y, emitter.extent.y));
+		__m128 z = _mm_add_ps(_mm_set1_ps(emitter.position.z), random_range(state, -emitter.extent.z, emitter.extent.z));
+		__m128 dx = _mm_add_ps(_mm_set1_ps(direction.x), random_range(state, -emitter.spread, emitter.spread));
+		__m128 dy = _mm_add_ps(_mm_set1_ps(direction.y), random_range(state, -emitter.spread, emitter.spread));
+		__m128 dz = _mm_add_ps(_mm_set1_ps(direction.z), random_range(state, -emitter.spread, emitter.spread));
+		__m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 speed = _mm_div_ps(random_range(state, emitter.speed_min, emitter.speed_max), _mm_sqrt_ps(_mm_max_ps(length2, _mm_set1_ps(1e-12f))));
+		__m128 lifetime = _mm_max_ps(random_range(state, emitter.lifetime_min, emitter.lifetime_max), _mm_set1_ps(1e-3f));
+		_mm_storeu_ps(&s.position_x[i], x);
+		_mm_storeu_ps(&s.position_y[i], y);
+		_mm_storeu_ps(&s.position_z[i], z);
+		_mm_storeu_ps(&s.velocity_x[i], _mm_mul_ps(dx, speed));
+		_mm_storeu_ps(&s.velocity_y[i], _mm_mul_ps(dy, speed));
+		_mm_storeu_ps(&s.velocity_z[i], _mm_mul_ps(dz, speed));
+		_mm_storeu_ps(&s.life[i], _mm_setzero_ps());
+		_mm_storeu_ps(&s.life_rate[i], _mm_div_ps(one, lifetime));
+		_mm_storeu_si128((__m128i*)&s.emitter[i], emitter_lanes);
+	}
+	_mm_storeu_si128((__m128i*)m_random, state);
+#else
+	for (uint32_t i = first; i < end; i++)
+	{
+		uint32_t& state = m_random[i & 3];
+		auto range = [&](float low, float high) { return low + (high - low) * random_lane(state); };
+		s.position_x[i] = emitter.position.x + range(-emitter.extent.x, emitter.extent.x);
+		s.position_y[i] = emitter.position.y + range(-emitter.extent.y, emitter.extent.y);
+		s.position_z[i] = emitter.position.z + range(-emitter.extent.z, emitter.extent.z);
+		glm::vec3 velocity = direction + glm::vec3(range(-emitter.spread, emitter.spread), range(-emitter.spread, emitter.spread), range(-emitter.spread, emitter.spread));
+		velocity *= range(emitter.speed_min, emitter.speed_max) / std::sqrt(std::max(glm::dot(velocity, velocity), 1e-12f));
+		s.velocity_x[i] = velocity.x;
+		s.velocity_y[i] = velocity.y;
+		s.velocity_z[i] = velocity.z;
+		s.life[i] = 0.0f;
+		s.life_rate[i] = 1.0f / std::max(range(emitter.lifetime_min, emitter.lifetime_max), 1e-3f);
+		s.emitter[i] = emitter_index;
+	}
+#endif
+	m_count = end;
+	m_stats.emitted += emitted;
+	return emitted;
+}
+
+void Particle_System::integrate(float dt)
+{
+	//explicit Euler with the drag folded into one factor, the padding lanes integrate garbage harmlessly
+	float damping = std::max(0.0f, 1.0f - m_drag * dt);
+	glm::vec3 gravity_step = m_gravity * dt;
+	uint32_t padded = round_up4(m_count);
+	Particle_Streams& s = m_streams;
+	Job_System::parallel_for((padded + s_block_size - 1) / s_block_size, [&](uint32_t block)
+	{
+		uint32_t begin = block * s_block_size, end = std::min(begin + s_block_size, padded);
+#ifdef PARTICLE_USE_SSE
+		__m128 step = _mm_set1_ps(dt), factor = _mm_set1_ps(damping);
+		__m128 gx = _mm_set1_ps(gravity_step.x), gy = _mm_set1_ps(gravity_step.y), gz = _mm_set1_ps(gravity_step.z);
+		for (uint32_t i = begin; i < end; i += 4)
+		{
+			__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.velocity_x[i]), factor), gx);
+			__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.velocity_y[i]), factor), gy);
+			__m128 vz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.velocity_z[i]), factor), gz);
+			_mm_storeu_ps(&s.velocity_x[i], vx);
+			_mm_storeu_ps(&s.velocity_y[i], vy);
+			_mm_storeu_ps(&s.velocity_z[i], vz);
+			_mm_storeu_ps(&s.position_x[i], _mm_add_ps(_mm_loadu_ps(&s.position_x[i]), _mm_mul_ps(vx, step)));
+			_mm_storeu_ps(&s.position_y[i], _mm_add_ps(_mm_loadu_ps(&s.position_y[i]), _mm_mul_ps(vy, step)));
+			_mm_storeu_ps(&s.position_z[i], _mm_add_ps(_mm_loadu_ps(&s.position_z[i]), _mm_mul_ps(vz, step)));
+			_mm_storeu_ps(&s.life[i], _mm_add_ps(_mm_loadu_ps(&s.life[i]), _mm_mul_ps(_mm_loadu_ps(&s.life_rate[i]), step)));
+		}
+#else
+		for (uint32_t i = begin; i < end; i++)
+		{
+			s.velocity_x[i] = s.velocity_x[i] * damping + gravity_step.x;
+			s.velocity_y[i] = s.velocity_y[i] * damping + gravity_step.y;
+			s.velocity_z[i] = s.velocity_z[i] * damping + gravity_step.z;
+			s.position_x[i] += s.velocity_x[i] * dt;
+			s.position_y[i] += s.velocity_y[i] * dt;
+			s.position_z[i] += s.velocity_z[i] * dt;
+			s.life[i] += s.life_rate[i] * dt;
+		}
+#endif
+	});
+}
+
+uint32_t Particle_System::kill()
+{
+	//With n live particles, a dead one below n is a hole and a live one at n or above is a filler; there are
+	//as many of each. Every block counts its dead, a prefix sum over the blocks in order ranks the holes and
+	//fillers, every block lists its own at their ranks, and the k-th filler moves into the k-th hole. At most
+	//the killed count of particles move, as with swap-removing, and every pass runs on the workers.
+	Particle_Streams& s = m_streams;
+	uint32_t* offsets = m_block_offsets.data();
+	uint32_t count = m_count;
+	uint32_t blocks = (count + s_block_size - 1) / s_block_size;
+	auto is_dead = [&s](uint32_t i) { return !(s.life[i] < 1.0f); };
+	Job_System::parallel_for(blocks, [&](uint32_t block)
+	{
+		uint32_t begin = block * s_block_size, end = std::min(begin + s_block_size, count);
+		uint32_t dead = 0;
+		uint32_t i = begin;
+#ifdef PARTICLE_USE_SSE
+		//the compare is all ones in a dead lane, subtracting it counts one
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128i lanes = _mm_setzero_si128();
+		for (; i + 4 <= end; i += 4)
+			lanes = _mm_sub_epi32(lanes, _mm_castps_si128(_mm_cmpnlt_ps(_mm_loadu_ps(&s.life[i]), one)));
+		alignas(16) uint32_t sums[4];
+		_mm_store_si128((__m128i*)sums, lanes);
+		dead = sums[0] + sums[1] + sums[2] + sums[3];
+#endif
+		for (; i < end; i++)
+			dead += is_dead(i);
+		offsets[block] = dead;
+	});
+	uint32_t killed = 0;
+	for (uint32_t block = 0; block < blocks; block++)
+	{
+		uint32_t dead = offsets[block];
+		offsets[block] = killed;
+		killed += dead;
+	}
+	if (killed == 0)
+		return 0;
+
+	//the block holding n is the only one with both kinds, its fillers are counted here; a later block's
+	//fillers start after those and every particle of the blocks in between that is not dead
+	uint32_t alive = count - killed;
+	uint32_t split = alive / s_block_size;
+	uint32_t split_end = std::min((split + 1) * s_block_size, count);
+	uint32_t split_fillers = 0;
+	for (uint32_t i = alive; i < split_end; i++)
+		split_fillers += !is_dead(i);
+	//the particles past the split block that are not dead; dead ones at n or above need no hole, so there
+	//are fewer moves than killed particles whenever some die there
+	uint32_t dead_past_split = killed - (split + 1 < blocks ? offsets[split + 1] : killed);
+	uint32_t moves = split_fillers + (count - split_end) - dead_past_split;
+	//the sort scratch is free until write_instances()
+	uint32_t* holes = m_sort_order[0].data();
+	uint32_t* fillers = m_sort_order[1].data();
+	Job_System::parallel_for(blocks, [&](uint32_t block)
+	{
+		uint32_t begin = block * s_block_size, end = std::min(begin + s_block_size, count);
+		if (begin < alive)
+		{
+			uint32_t hole = offsets[block], hole_end = std::min(end, alive);
+			uint32_t i = begin;
+#ifdef PARTICLE_USE_SSE
+			//runs of live particles are skipped four at a time
+			__m128 one = _mm_set1_ps(1.0f);
+			for (; i + 4 <= hole_end; i += 4)
+				if (_mm_movemask_ps(_mm_cmpnlt_ps(_mm_loadu_ps(&s.life[i]), one)) != 0)
+					for (uint32_t lane = i; lane < i + 4; lane++)
+						if (is_dead(lane))
+							holes[hole++] = lane;
+#endif
+			for (; i < hole_end; i++)
+				if (is_dead(i))
+					holes[hole++] = i;
+		}
+		if (end > alive)
+		{
+			uint32_t filler = block == split ? 0 : split_fillers + (begin - split_end) - (offsets[block] - offsets[split + 1]);
+			for (uint32_t i = std::max(begin, alive); i < end; i++)
+				if (!is_dead(i))
+					fillers[filler++] = i;
+		}
+	});
+	Job_System::parallel_for((moves + s_block_size - 1) / s_block_size, [&](uint32_t block)
+	{
+		uint32_t begin = block * s_block_size, end = std::min(begin + s_block_size, moves);
+		for (uint32_t k = begin; k < end; k++)
+		{
+			uint32_t to = holes[k], from = fillers[k];
+			s.position_x[to] = s.position_x[from];
+			s.position_y[to] = s.position_y[from];
+			s.position_z[to] = s.position_z[from];
+			s.velocity_x[to] = s.velocity_x[from];
+			s.velocity_y[to] = s.velocity_y[from];
+			s.velocity_z[to] = s.velocity_z[from];
+			s.life[to] = s.life[from];
+			s.life_rate[to] = s.life_rate[from];
+			s.emitter[to] = s.emitter[from];
+		}
+	});
+	m_count = alive;
+	m_stats.killed += killed;
+	return killed;
+}
+
+void Particle_System::update_gradient(Emitter_State& emitter)
+{
+	const Particle_Emitter& config = emitter.config;
+	for (uint32_t step = 0; step < GRADIENT_STEPS; step++)
+	{
+		float t = step / (float)(GRADIENT_STEPS - 1);
+		emitter.sizes[step] = config.start_size + (config.end_size - config.start_size) * t;
+		emitter.colors[step] = pack_color(glm::mix(config.start_color, config.end_color, t));
+	}
+}
+
+void Particle_System::sort_by_depth(const glm::mat4& view)
+{
+	//view space z as a key that sorts like the float: negatives flipped entirely, positives only in the sign.
+	//ascending keys are ascending z and the camera looks down -z, so the farthest particle comes first.
+	//only the top 16 bits are kept, under 1% of the distance apart is close enough for blending
+	Particle_Streams& s = m_streams;
+	uint16_t* keys = m_sort_keys[0].data();
+	glm::vec4 row(view[0][2], view[1][2], view[2][2], view[3][2]);
+	uint32_t count = m_count;
+	uint32_t blocks = (count + s_block_size - 1) / s_block_size;
+	Job_System::parallel_for(blocks, [&](uint32_t block)
+	{
+		uint32_t begin = block * s_block_size, end = std::min(begin + s_block_size, count);
+		uint32_t i = begin;
+#ifdef PARTICLE_USE_SSE
+		__m128 rx = _mm_set1_ps(row.x), ry = _mm_set1_ps(row.y), rz = _mm_set1_ps(row.z), rw = _mm_set1_ps(row.w);
+		__m128i sign = _mm_set1_epi32((int)0x80000000u);
+		alignas(16) uint32_t lanes[4];
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.position_x[i]), rx), _mm_mul_ps(_mm_loadu_ps(&s.position_y[i]), ry)),
+				_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.position_z[i]), rz), rw));
+			__m128i bits = _mm_castps_si128(depth);
+			__m128i flip = _mm_or_si128(_mm_srai_epi32(bits, 31), sign);
+			_mm_store_si128((__m128i*)lanes, _mm_srli_epi32(_mm_xor_si128(bits, flip), 16));
+			for (uint32_t lane = 0; lane < 4; lane++)
+				keys[i + lane] = (uint16_t)lanes[lane];
+		}
+#endif
+		for (; i < end; i++)
+		{
+			float depth = s.position_x[i] * row.x + s.position_y[i] * row.y + s.position_z[i] * row.z + row.w;
+			uint32_t bits;
+			memcpy(&bits, &depth, sizeof(bits));
+			keys[i] = (uint16_t)((bits ^ ((bits >> 31) ? 0xFFFFFFFFu : 0x80000000u)) >> 16);
+		}
+	});
+
+	//LSD radix sort of (key, particle) pairs, one byte per pass. Every block counts its digits, the
+	//prefix sum runs digit by digit over the blocks in order, so the parallel scatter stays stable.
+	const uint32_t* order = nullptr;
+	uint16_t* next_keys = m_sort_keys[1].data();
+	uint32_t* next_order = m_sort_order[0].data();
+	uint32_t* histograms = m_block_histograms.data();
+	for (uint32_t shift = 0; shift < 16; shift += s_radix_bits)
+	{
+		Job_System::parallel_for(blocks, [&](uint32_t block)
+		{
+			uint32_t* histogram = histograms + block * s_radix_size;
+			std::fill(histogram, histogram + s_radix_size, 0u);
+			uint32_t begin = block * s_block_size, end = std::min(begin + s_block_size, count);
+			for (uint32_t i = begin; i < end; i++)
+				histogram[(keys[i] >> shift) & (s_radix_size - 1)]++;
+		});
+		//a digit every particle shares leaves the order as it is
+		uint32_t first_digit = count ? (keys[0] >> shift) & (s_radix_size - 1) : 0;
+		uint32_t shared = 0;
+		for (uint32_t block = 0; block < blocks; block++)
+			shared += histograms[block * s_radix_size + first_digit];
+		if (shared == count)
+			continue;
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < s_radix_size; digit++)
+		{
+			for (uint32_t block = 0; block < blocks; block++)
+			{
+				uint32_t bucket = histograms[block * s_radix_size + digit];
+				histograms[block * s_radix_size + digit] = offset;
+				offset += bucket;
+			}
+		}
+		Job_System::parallel_for(blocks, [&](uint32_t block)
+		{
+			uint32_t* positions = histograms + block * s_radix_size;
+			uint32_t begin = block * s_block_size, end = std::min(begin + s_block_size, count);
+			for (uint32_t i = begin; i < end; i++)
+			{
+				uint16_t key = keys[i];
+				uint32_t position = positions[(key >> shift) & (s_radix_size - 1)]++;
+				next_keys[position] = key;
+				next_order[position] = order ? order[i] : i;
+			}
+		});
+		std::swap(keys, next_keys);
+		order = next_order;
+		next_order = next_order == m_sort_order[0].data() ? m_sort_order[1].data() : m_sort_order[0].data();
+	}
+	m_order = order;
+}
+
+uint32_t Particle_System::write_instances(const glm::mat4& view, bool sort_back_to_front, Particle_Instance* out)
+{
+	//emitters may have been edited through get_emitter()
+	for (Emitter_State& emitter : m_emitters)
+		update_gradient(emitter);
+	m_order = nullptr;
+	if (sort_back_to_front)
+		sort_by_depth(view);
+
+	const Particle_Streams& s = m_streams;
+	const uint32_t* order = m_order;
+	uint32_t count = m_count;
+	Job_System::parallel_for((count + s_block_size - 1) / s_block_size, [&](uint32_t block)
+	{
+		uint32_t begin = block * s_block_size, end = std::min(begin + s_block_size, count);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			uint32_t p = order ? order[i] : i;
+			const Emitter_State& emitter = m_emitters[s.emitter[p]];
+			uint32_t step = std::min((uint32_t)(s.life[p] * (GRADIENT_STEPS - 1) + 0.5f), GRADIENT_STEPS - 1);
+			Particle_Instance& instance = out[i];
+			instance.position = glm::vec3(s.position_x[p], s.position_y[p], s.position_z[p]);
+			instance.size = emitter.sizes[step];
+			instance.color = emitter.colors[step];
+		}
+	});
+	return count;
+}
+
+Particle_Stats Particle_System::get_stats() const
+{
+	Particle_Stats stats = m_stats;
+	stats.alive = m_count;
+	return stats;
+}
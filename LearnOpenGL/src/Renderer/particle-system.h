@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "vertex-layout.h"
+
+//what the GPU gets per particle, one instance of a camera facing quad
+struct Particle_Instance
+{
+	glm::vec3 position;
+	float size;
+	int color;						//RGBA8, red in the low byte; an int so GL 3.3 can take it as is
+};
+
+template<> struct Vertex_Format<Particle_Instance>
+{
+	static constexpr Vertex_Attribute attributes[] = {
+		VERTEX_ATTRIBUTE(Particle_Instance, position),
+		VERTEX_ATTRIBUTE(Particle_Instance, size),
+		VERTEX_ATTRIBUTE(Particle_Instance, color),
+	};
+};
+
+struct Particle_Emitter
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 extent = glm::vec3(0.0f);		//half size of the box particles are born in
+	glm::vec3 direction = glm::vec3(0.0f, 1.0f, 0.0f);
+	float spread = 0.3f;					//random offset added to the unit direction before normalizing
+	float speed_min = 1.0f, speed_max = 2.0f;
+	float lifetime_min = 1.0f, lifetime_max = 2.0f;
+	float rate = 100.0f;					//particles per second emitted by update()
+	glm::vec4 start_color = glm::vec4(1.0f);
+	glm::vec4 end_color = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+	float start_size = 0.05f, end_size = 0.05f;
+};
+
+//Structure of arrays, one entry per live particle in [0, count). Every array is padded to a multiple
+//of four so the kernels run whole SIMD lanes without a scalar tail.
+struct Particle_Streams
+{
+	std::vector<float> position_x, position_y, position_z;
+	std::vector<float> velocity_x, velocity_y, velocity_z;
+	std::vector<float> life;				//0 at birth, dead at 1
+	std::vector<float> life_rate;			//1 / lifetime
+	std::vector<uint32_t> emitter;
+};
+
+struct Particle_Stats
+{
+	uint32_t alive = 0;
+	uint64_t emitted = 0;
+	uint64_t killed = 0;
+	uint64_t dropped = 0;					//wanted to be emitted while the system was full
+};
+
+//CPU particle simulation. GL-free, the instances it writes are drawn by Particle_Renderer.
+//The kernels work on four particles per SSE2 instruction (scalar loops elsewhere) and integrate(), kill()
+//and write_instances() split the particles over the Job_System workers. Dead particles are replaced by
+//live ones from the end, so the live ones stay packed at the front and their order is not kept. Storage is allocated once for
+//the capacity, a steady-state update() does not touch the heap.
+class Particle_System
+{
+public:
+	explicit Particle_System(uint32_t capacity);
+
+	void set_gravity(const glm::vec3& gravity) { m_gravity = gravity; }
+	//fraction of the velocity lost per second
+	void set_drag(float drag) { m_drag = drag; }
+
+	uint32_t add_emitter(const Particle_Emitter& emitter);
+	Particle_Emitter& get_emitter(uint32_t index) { return m_emitters[index].config; }
+	uint32_t get_emitter_count() const { return (uint32_t)m_emitters.size(); }
+
+	//integrate, kill, then emit what every emitter's rate adds up to over dt
+	void update(float dt);
+
+	//the kernels update() runs, public so they can be driven and checked on their own
+	//appends up to count particles of one emitter, returns how many fit
+	uint32_t emit(uint32_t emitter, uint32_t count);
+	void integrate(float dt);
+	//removes every particle whose life reached 1 by moving live ones from the end into its slot, returns how many
+	uint32_t kill();
+	//drops every particle at once, the emitters keep their settings
+	void clear() { m_count = 0; }
+
+	//one instance per live particle, sized and colored by age; with sort_back_to_front the farthest from
+	//the camera come first, for blending. out holds get_count() instances, returns how many were written
+	uint32_t write_instances(const glm::mat4& view, bool sort_back_to_front, Particle_Instance* out);
+
+	uint32_t get_count() const { return m_count; }
+	uint32_t get_capacity() const { return m_capacity; }
+	const Particle_Streams& get_streams() const { return m_streams; }
+	Particle_Stats get_stats() const;
+
+private:
+	//size and packed color over a particle's life, sampled instead of interpolated per particle
+	static constexpr uint32_t GRADIENT_STEPS = 64;
+	struct Emitter_State
+	{
+		Particle_Emitter config;
+		float pending = 0.0f;				//fraction of a particle carried to the next update
+		float sizes[GRADIENT_STEPS];
+		int colors[GRADIENT_STEPS];
+	};
+
+	//the order write_instances() gathers in, back to front
+	void sort_by_depth(const glm::mat4& view);
+	void update_gradient(Emitter_State& emitter);
+
+private:
+	uint32_t m_capacity;
+	uint32_t m_count = 0;
+	Particle_Streams m_streams;
+	std::vector<Emitter_State> m_emitters;
+	glm::vec3 m_gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+	float m_drag = 0.0f;
+	uint32_t m_random[4];					//one xorshift state per SIMD lane
+	Particle_Stats m_stats;
+
+	//radix sort scratch, allocated with the streams; kill() lists its holes and fillers in m_sort_order
+	std::vector<uint16_t> m_sort_keys[2];
+	std::vector<uint32_t> m_sort_order[2];
+	std::vector<uint32_t> m_block_histograms;	//one digit count per sort block
+	std::vector<uint32_t> m_block_offsets;		//kill(): dead particles per block, then the rank of its first
+	const uint32_t* m_order = nullptr;
+};
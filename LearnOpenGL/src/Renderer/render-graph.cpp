@@ -0,0 +1,355 @@
+#include "render-graph.h"
+
+#include <iostream>
+#include <algorithm>
+
+uint32_t render_format_size(Render_Format format)
+{
+	switch (format)
+	{
+	case Render_Format::R8:					return 1;
+	case Render_Format::RG8:				return 2;
+	case Render_Format::RGBA8:				return 4;
+	case Render_Format::RG16F:				return 4;
+	case Render_Format::RGBA16F:			return 8;
+	case Render_Format::R32F:				return 4;
+	case Render_Format::RGBA32F:			return 16;
+	case Render_Format::Depth24_Stencil8:	return 4;
+	case Render_Format::Depth32F:			return 4;
+	}
+	return 0;
+}
+
+bool render_format_is_depth(Render_Format format)
+{
+	return format == Render_Format::Depth24_Stencil8 || format == Render_Format::Depth32F;
+}
+
+Render_Handle Render_Pass_Builder::create(const std::string& name, const Render_Target_Desc& desc)
+{
+	Render_Graph::Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	m_graph.m_resources.push_back(resource);
+	return m_graph.add_version((uint32_t)m_graph.m_resources.size() - 1, Render_Graph::NO_PASS, INVALID_RENDER_HANDLE);
+}
+
+Render_Handle Render_Pass_Builder::read(Render_Handle handle)
+{
+	Render_Graph::Version& version = m_graph.m_versions[handle];
+	//the pass writing over it was added first, so this read can only run before it and never sees that result
+	if (version.overwritten)
+		std::cout << "Render graph: " << m_graph.m_resources[version.resource].name << " is read in pass " << m_graph.m_passes[m_pass].name
+			<< " after a newer version was written" << std::endl;
+	version.readers.push_back(m_pass);
+	m_graph.m_passes[m_pass].reads.push_back(handle);
+	return handle;
+}
+
+Render_Handle Render_Pass_Builder::write(Render_Handle handle)
+{
+	Render_Graph::Version& version = m_graph.m_versions[handle];
+	//two passes writing the same version would both clobber one physical target in unknown order
+	if (version.overwritten)
+		std::cout << "Render graph: " << m_graph.m_resources[version.resource].name << " is written twice from the same version in pass " << m_graph.m_passes[m_pass].name << std::endl;
+	version.overwritten = true;
+	Render_Handle written = m_graph.add_version(version.resource, m_pass, handle);
+	m_graph.m_passes[m_pass].writes.push_back(written);
+	return written;
+}
+
+uint32_t Render_Pass_Context::get_texture(Render_Handle handle) const
+{
+	return m_graph.m_resources[m_graph.m_versions[handle].resource].texture;
+}
+
+const Render_Target_Desc& Render_Pass_Context::get_desc(Render_Handle handle) const
+{
+	return m_graph.m_resources[m_graph.m_versions[handle].resource].desc;
+}
+
+Render_Handle Render_Graph::add_version(uint32_t resource, uint32_t producer, Render_Handle previous)
+{
+	Version version;
+	version.resource = resource;
+	version.producer = producer;
+	version.previous = previous;
+	version.overwritten = false;
+	m_versions.push_back(version);
+	return (Render_Handle)m_versions.size() - 1;
+}
+
+Render_Handle Render_Graph::import_target(const std::string& name, const Render_Target_Desc& desc, uint32_t texture)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = true;
+	resource.texture = texture;
+	m_resources.push_back(resource);
+	return add_version((uint32_t)m_resources.size() - 1, NO_PASS, INVALID_RENDER_HANDLE);
+}
+
+uint32_t Render_Graph::add_pass(const std::string& name, const Setup_Function& setup, const Execute_Function& execute)
+{
+	uint32_t index = (uint32_t)m_passes.size();
+	m_passes.emplace_back();
+	m_passes.back().name = name;
+	m_passes.back().execute = execute;
+
+	Render_Pass_Builder builder(*this, index);
+	setup(builder);
+	m_passes[index].side_effect = builder.m_side_effect;
+	m_compiled = false;
+	return index;
+}
+
+template<typename F>
+void Render_Graph::for_each_dependency(const Pass& pass, F&& f) const
+{
+	for (Render_Handle handle : pass.reads)
+		if (m_versions[handle].producer != NO_PASS)
+			f(m_versions[handle].producer);
+	for (Render_Handle handle : pass.writes)
+	{
+		Render_Handle previous = m_versions[handle].previous;
+		if (m_versions[previous].producer != NO_PASS)
+			f(m_versions[previous].producer);
+	}
+}
+
+template<typename F>
+void Render_Graph::for_each_order_dependency(uint32_t index, F&& f) const
+{
+	const Pass& pass = m_passes[index];
+	for_each_dependency(pass, f);
+	for (Render_Handle handle : pass.writes)
+		for (uint32_t reader : m_versions[m_versions[handle].previous].readers)
+			if (reader != index && !m_passes[reader].culled)
+				f(reader);
+}
+
+void Render_Graph::cull_passes()
+{
+	//start from the passes that are visible outside the graph and keep whatever feeds them
+	std::vector<uint32_t> stack;
+	for (uint32_t i = 0; i < m_passes.size(); i++)
+	{
+		Pass& pass = m_passes[i];
+		pass.culled = true;
+		bool root = pass.side_effect;
+		for (Render_Handle handle : pass.writes)
+			root |= m_resources[m_versions[handle].resource].imported;
+		if (root)
+		{
+			pass.culled = false;
+			stack.push_back(i);
+		}
+	}
+	while (!stack.empty())
+	{
+		uint32_t index = stack.back();
+		stack.pop_back();
+		for_each_dependency(m_passes[index], [&](uint32_t producer)
+		{
+			if (m_passes[producer].culled)
+			{
+				m_passes[producer].culled = false;
+				stack.push_back(producer);
+			}
+		});
+	}
+}
+
+bool Render_Graph::order_passes()
+{
+	//Kahn's algorithm. Of the passes that are ready, the one whose inputs were produced most recently
+	//runs first, so consumers follow their producers closely and transients are released early.
+	uint32_t pass_count = (uint32_t)m_passes.size();
+	std::vector<uint32_t> waiting(pass_count, 0);
+	std::vector<std::vector<uint32_t>> consumers(pass_count);
+	std::vector<int32_t> position(pass_count, -1);
+	uint32_t live = 0;
+	for (uint32_t i = 0; i < pass_count; i++)
+	{
+		if (m_passes[i].culled)
+			continue;
+		live++;
+		for_each_order_dependency(i, [&](uint32_t producer)
+		{
+			waiting[i]++;
+			consumers[producer].push_back(i);
+		});
+	}
+
+	std::vector<uint32_t> ready;
+	for (uint32_t i = 0; i < pass_count; i++)
+		if (!m_passes[i].culled && waiting[i] == 0)
+			ready.push_back(i);
+
+	m_order.clear();
+	while (!ready.empty())
+	{
+		size_t best = 0;
+		int32_t best_latest = -1;
+		for (size_t r = 0; r < ready.size(); r++)
+		{
+			int32_t latest = -1;
+			for_each_order_dependency(ready[r], [&](uint32_t producer) { latest = std::max(latest, position[producer]); });
+			if (latest > best_latest || (latest == best_latest && ready[r] < ready[best]))
+			{
+				best = r;
+				best_latest = latest;
+			}
+		}
+		uint32_t index = ready[best];
+		ready.erase(ready.begin() + best);
+		position[index] = (int32_t)m_order.size();
+		m_order.push_back(index);
+		for (uint32_t consumer : consumers[index])
+			if (--waiting[consumer] == 0)
+				ready.push_back(consumer);
+	}
+
+	if (m_order.size() != live)
+	{
+		std::cout << "Render graph: dependency cycle, " << live - m_order.size() << " passes left unscheduled" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void Render_Graph::assign_slots()
+{
+	for (Resource& resource : m_resources)
+	{
+		resource.used = false;
+		resource.slot = -1;
+	}
+	for (uint32_t position = 0; position < m_order.size(); position++)
+	{
+		const Pass& pass = m_passes[m_order[position]];
+		auto touch = [&](Render_Handle handle)
+		{
+			Resource& resource = m_resources[m_versions[handle].resource];
+			if (!resource.used)
+				resource.first_use = position;
+			resource.used = true;
+			resource.last_use = position;
+		};
+		for (Render_Handle handle : pass.reads)
+			touch(handle);
+		for (Render_Handle handle : pass.writes)
+			touch(handle);
+	}
+
+	//greedy interval packing in execution order: a transient takes the first free slot with the same
+	//description, otherwise a new one. Slots only change hands between passes, never within one.
+	std::vector<uint32_t> by_first_use;
+	for (uint32_t i = 0; i < m_resources.size(); i++)
+		if (m_resources[i].used && !m_resources[i].imported)
+			by_first_use.push_back(i);
+	std::stable_sort(by_first_use.begin(), by_first_use.end(), [this](uint32_t a, uint32_t b) { return m_resources[a].first_use < m_resources[b].first_use; });
+
+	m_slots.clear();
+	std::vector<uint32_t> slot_busy_until;
+	m_stats.transient_targets = 0;
+	m_stats.transient_bytes = 0;
+	m_stats.peak_transient_bytes = 0;
+	for (uint32_t index : by_first_use)
+	{
+		Resource& resource = m_resources[index];
+		m_stats.transient_targets++;
+		m_stats.transient_bytes += resource.desc.get_size();
+		for (uint32_t slot = 0; slot < m_slots.size(); slot++)
+		{
+			if (slot_busy_until[slot] < resource.first_use && m_slots[slot] == resource.desc)
+			{
+				resource.slot = (int32_t)slot;
+				break;
+			}
+		}
+		if (resource.slot < 0)
+		{
+			resource.slot = (int32_t)m_slots.size();
+			m_slots.push_back(resource.desc);
+			slot_busy_until.push_back(0);
+			m_stats.peak_transient_bytes += resource.desc.get_size();
+		}
+		slot_busy_until[resource.slot] = resource.last_use;
+	}
+	m_stats.physical_targets = (uint32_t)m_slots.size();
+}
+
+bool Render_Graph::compile()
+{
+	for (const Pass& pass : m_passes)
+		for (Render_Handle handle : pass.reads)
+		{
+			const Version& version = m_versions[handle];
+			if (version.producer == NO_PASS && !m_resources[version.resource].imported)
+				std::cout << "Render graph: pass " << pass.name << " reads " << m_resources[version.resource].name << " before anything wrote it" << std::endl;
+		}
+
+	cull_passes();
+	m_compiled = order_passes();
+	assign_slots();
+
+	m_stats.passes = (uint32_t)m_passes.size();
+	m_stats.culled_passes = 0;
+	for (const Pass& pass : m_passes)
+		m_stats.culled_passes += pass.culled ? 1 : 0;
+	return m_compiled;
+}
+
+void Render_Graph::execute(Render_Graph_Backend& backend)
+{
+	if (!m_compiled && !compile())
+		return;
+
+	backend.acquire_targets(m_slots, m_slot_textures);
+	for (Resource& resource : m_resources)
+		if (resource.slot >= 0)
+			resource.texture = m_slot_textures[resource.slot];
+
+	Render_Pass_Context context(*this);
+	std::vector<uint32_t>& color_textures = m_color_textures;
+	for (uint32_t index : m_order)
+	{
+		const Pass& pass = m_passes[index];
+		color_textures.clear();
+		uint32_t depth_texture = 0;
+		uint32_t width = 0, height = 0;
+		for (Render_Handle handle : pass.writes)
+		{
+			const Resource& resource = m_resources[m_versions[handle].resource];
+			if (render_format_is_depth(resource.desc.format))
+				depth_texture = resource.texture;
+			else
+				color_textures.push_back(resource.texture);
+			width = resource.desc.width;
+			height = resource.desc.height;
+		}
+		if (!pass.writes.empty())
+			backend.begin_pass(color_textures, depth_texture, width, height);
+		if (pass.execute)
+			pass.execute(context);
+	}
+	backend.release_targets();
+}
+
+void Render_Graph::reset()
+{
+	m_resources.clear();
+	m_versions.clear();
+	m_passes.clear();
+	m_order.clear();
+	m_slots.clear();
+	m_stats = Render_Graph_Stats();
+	m_compiled = false;
+}
+
+int32_t Render_Graph::get_slot(Render_Handle handle) const
+{
+	return m_resources[m_versions[handle].resource].slot;
+}
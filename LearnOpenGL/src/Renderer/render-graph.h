@@ -0,0 +1,180 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+//kept free of GL types so the graph can be compiled and checked without a context
+enum class Render_Format : uint8_t
+{
+	R8, RG8, RGBA8, RG16F, RGBA16F, R32F, RGBA32F, Depth24_Stencil8, Depth32F
+};
+
+uint32_t render_format_size(Render_Format format);
+bool render_format_is_depth(Render_Format format);
+
+struct Render_Target_Desc
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	Render_Format format = Render_Format::RGBA8;
+
+	uint64_t get_size() const { return (uint64_t)width * height * render_format_size(format); }
+	bool operator==(const Render_Target_Desc& other) const { return width == other.width && height == other.height && format == other.format; }
+	bool operator!=(const Render_Target_Desc& other) const { return !(*this == other); }
+};
+
+//One version of a resource. Every write returns a new handle, so reading a handle names exactly the pass
+//that produced it and the graph edges fall out of the handles themselves.
+typedef uint32_t Render_Handle;
+static const Render_Handle INVALID_RENDER_HANDLE = 0xFFFFFFFF;
+
+class Render_Graph;
+
+class Render_Pass_Builder
+{
+public:
+	//transient target, only lives for the passes between its first write and its last read
+	Render_Handle create(const std::string& name, const Render_Target_Desc& desc);
+	//sampled by this pass
+	Render_Handle read(Render_Handle handle);
+	//attached to this pass' framebuffer, returns the version later passes read
+	Render_Handle write(Render_Handle handle);
+	//keep the pass even if nothing reads what it writes
+	void set_side_effect() { m_side_effect = true; }
+
+private:
+	friend class Render_Graph;
+	Render_Pass_Builder(Render_Graph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+
+	Render_Graph& m_graph;
+	uint32_t m_pass;
+	bool m_side_effect = false;
+};
+
+//What a pass sees when it runs: the targets it declared, resolved to real textures.
+class Render_Pass_Context
+{
+public:
+	uint32_t get_texture(Render_Handle handle) const;
+	const Render_Target_Desc& get_desc(Render_Handle handle) const;
+
+private:
+	friend class Render_Graph;
+	Render_Pass_Context(const Render_Graph& graph) : m_graph(graph) {}
+
+	const Render_Graph& m_graph;
+};
+
+//Backend that turns the compiled schedule into API objects. Render_Target_Pool is the GL one.
+class Render_Graph_Backend
+{
+public:
+	virtual ~Render_Graph_Backend() = default;
+	//one texture per physical slot of the compiled graph, called once before the first pass
+	virtual void acquire_targets(const std::vector<Render_Target_Desc>& slots, std::vector<uint32_t>& textures) = 0;
+	//bind the attachments a pass writes; imported texture 0 is the default framebuffer
+	virtual void begin_pass(const std::vector<uint32_t>& color_textures, uint32_t depth_texture, uint32_t width, uint32_t height) = 0;
+	virtual void release_targets() = 0;
+};
+
+struct Render_Graph_Stats
+{
+	uint32_t passes = 0;
+	uint32_t culled_passes = 0;
+	uint32_t transient_targets = 0;
+	uint32_t physical_targets = 0;		//after aliasing
+	uint64_t transient_bytes = 0;		//what the transients would cost without aliasing
+	uint64_t peak_transient_bytes = 0;	//what the physical targets actually cost
+};
+
+//Per-frame graph of render passes. Passes declare which targets they create, read and write in a setup
+//callback; compile() then
+//  - culls passes whose results never reach an imported target or a pass marked as a side effect,
+//  - orders the survivors, running a pass as soon as possible after the one producing its inputs so
+//    transient lifetimes stay short; a pass writing over a version runs after every pass reading it,
+//  - packs transient targets with the same description and non-overlapping lifetimes into one physical slot.
+//compile() is pure CPU work, only execute() touches the backend.
+class Render_Graph
+{
+public:
+	typedef std::function<void(Render_Pass_Builder&)> Setup_Function;
+	typedef std::function<void(const Render_Pass_Context&)> Execute_Function;
+
+	//existing target owned by someone else, e.g. the default framebuffer (texture 0) or a shadow map
+	Render_Handle import_target(const std::string& name, const Render_Target_Desc& desc, uint32_t texture);
+	uint32_t add_pass(const std::string& name, const Setup_Function& setup, const Execute_Function& execute);
+
+	bool compile();
+	void execute(Render_Graph_Backend& backend);
+	//drops all passes and resources
+	void reset();
+
+	const Render_Graph_Stats& get_stats() const { return m_stats; }
+	//execution order after compile(), as indices from add_pass()
+	const std::vector<uint32_t>& get_order() const { return m_order; }
+	bool is_culled(uint32_t pass) const { return m_passes[pass].culled; }
+	const std::string& get_pass_name(uint32_t pass) const { return m_passes[pass].name; }
+	//physical slot a transient was packed into, -1 for imported or culled resources
+	int32_t get_slot(Render_Handle handle) const;
+	uint32_t get_resource_count() const { return (uint32_t)m_resources.size(); }
+
+private:
+	friend class Render_Pass_Builder;
+	friend class Render_Pass_Context;
+
+	struct Resource
+	{
+		std::string name;
+		Render_Target_Desc desc;
+		bool imported = false;
+		uint32_t texture = 0;			//imported texture, or the slot's texture during execute()
+		int32_t slot = -1;
+		uint32_t first_use = 0;			//positions in m_order
+		uint32_t last_use = 0;
+		bool used = false;
+	};
+
+	struct Version
+	{
+		uint32_t resource;
+		uint32_t producer;				//pass that wrote this version, NO_PASS for the initial one
+		Render_Handle previous;			//version the producer wrote over
+		bool overwritten;				//a pass already wrote a newer version of it
+		std::vector<uint32_t> readers;	//passes that read this version, they run before the one writing over it
+	};
+
+	struct Pass
+	{
+		std::string name;
+		Execute_Function execute;
+		std::vector<Render_Handle> reads;
+		std::vector<Render_Handle> writes;	//the versions this pass produced
+		bool side_effect = false;
+		bool culled = false;
+	};
+
+	static constexpr uint32_t NO_PASS = 0xFFFFFFFF;
+
+	Render_Handle add_version(uint32_t resource, uint32_t producer, Render_Handle previous);
+	//passes whose outputs this pass consumes, through reads or by writing over their version
+	template<typename F>
+	void for_each_dependency(const Pass& pass, F&& f) const;
+	//the above plus the live passes that read a version this pass writes over, which must see it first
+	template<typename F>
+	void for_each_order_dependency(uint32_t pass, F&& f) const;
+	void cull_passes();
+	bool order_passes();
+	void assign_slots();
+
+private:
+	std::vector<Resource> m_resources;
+	std::vector<Version> m_versions;
+	std::vector<Pass> m_passes;
+	std::vector<uint32_t> m_order;
+	std::vector<Render_Target_Desc> m_slots;
+	std::vector<uint32_t> m_slot_textures;
+	std::vector<uint32_t> m_color_textures;
+	Render_Graph_Stats m_stats;
+	bool m_compiled = false;
+};
@@ -0,0 +1,170 @@
+#include "render-target-pool.h"
+
+#include <iostream>
+
+static void get_gl_format(Render_Format format, GLenum& internal_format, GLenum& data_format, GLenum& type)
+{
+	switch (format)
+	{
+	case Render_Format::R8:					internal_format = GL_R8; data_format = GL_RED; type = GL_UNSIGNED_BYTE; return;
+	case Render_Format::RG8:				internal_format = GL_RG8; data_format = GL_RG; type = GL_UNSIGNED_BYTE; return;
+	case Render_Format::RGBA8:				internal_format = GL_RGBA8; data_format = GL_RGBA; type = GL_UNSIGNED_BYTE; return;
+	case Render_Format::RG16F:				internal_format = GL_RG16F; data_format = GL_RG; type = GL_HALF_FLOAT; return;
+	case Render_Format::RGBA16F:			internal_format = GL_RGBA16F; data_format = GL_RGBA; type = GL_HALF_FLOAT; return;
+	case Render_Format::R32F:				internal_format = GL_R32F; data_format = GL_RED; type = GL_FLOAT; return;
+	case Render_Format::RGBA32F:			internal_format = GL_RGBA32F; data_format = GL_RGBA; type = GL_FLOAT; return;
+	case Render_Format::Depth24_Stencil8:	internal_format = GL_DEPTH24_STENCIL8; data_format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; return;
+	case Render_Format::Depth32F:			internal_format = GL_DEPTH_COMPONENT32F; data_format = GL_DEPTH_COMPONENT; type = GL_FLOAT; return;
+	}
+}
+
+Render_Target_Pool::~Render_Target_Pool()
+{
+	clear();
+}
+
+void Render_Target_Pool::clear()
+{
+	for (Pooled_Target& target : m_targets)
+		glDeleteTextures(1, &target.texture);
+	for (Cached_Framebuffer& cached : m_framebuffers)
+		glDeleteFramebuffers(1, &cached.framebuffer);
+	m_targets.clear();
+	m_framebuffers.clear();
+	m_allocated_bytes = 0;
+}
+
+GLuint Render_Target_Pool::create_texture(const Render_Target_Desc& desc)
+{
+	GLenum internal_format = GL_RGBA8, data_format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+	get_gl_format(desc.format, internal_format, data_format, type);
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, desc.width, desc.height, 0, data_format, type, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	m_allocated_bytes += desc.get_size();
+	return texture;
+}
+
+void Render_Target_Pool::acquire_targets(const std::vector<Render_Target_Desc>& slots, std::vector<uint32_t>& textures)
+{
+	m_frame++;
+	textures.resize(slots.size());
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		Pooled_Target* match = nullptr;
+		for (Pooled_Target& target : m_targets)
+		{
+			if (!target.in_use && target.desc == slots[i])
+			{
+				match = &target;
+				break;
+			}
+		}
+		if (!match)
+		{
+			Pooled_Target target;
+			target.desc = slots[i];
+			target.texture = create_texture(slots[i]);
+			m_targets.push_back(target);
+			match = &m_targets.back();
+		}
+		match->in_use = true;
+		match->last_used_frame = m_frame;
+		textures[i] = match->texture;
+	}
+}
+
+void Render_Target_Pool::begin_pass(const std::vector<uint32_t>& color_textures, uint32_t depth_texture, uint32_t width, uint32_t height)
+{
+	glViewport(0, 0, width, height);
+	//the default framebuffer is imported as texture 0
+	if (depth_texture == 0 && (color_textures.empty() || (color_textures.size() == 1 && color_textures[0] == 0)))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return;
+	}
+
+	for (Cached_Framebuffer& cached : m_framebuffers)
+	{
+		if (cached.depth_texture == depth_texture && cached.color_textures == color_textures)
+		{
+			cached.last_used_frame = m_frame;
+			glBindFramebuffer(GL_FRAMEBUFFER, cached.framebuffer);
+			return;
+		}
+	}
+
+	Cached_Framebuffer cached;
+	cached.color_textures = color_textures;
+	cached.depth_texture = depth_texture;
+	cached.last_used_frame = m_frame;
+	glGenFramebuffers(1, &cached.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, cached.framebuffer);
+
+	GLenum draw_buffers[8];
+	GLsizei draw_count = 0;
+	for (size_t i = 0; i < color_textures.size() && i < 8; i++)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, color_textures[i], 0);
+		draw_buffers[draw_count++] = GL_COLOR_ATTACHMENT0 + (GLenum)i;
+	}
+	if (depth_texture)
+	{
+		GLenum attachment = GL_DEPTH_ATTACHMENT;
+		for (const Pooled_Target& target : m_targets)
+			if (target.texture == depth_texture && target.desc.format == Render_Format::Depth24_Stencil8)
+				attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, depth_texture, 0);
+	}
+	if (draw_count)
+		glDrawBuffers(draw_count, draw_buffers);
+	else
+		glDrawBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Render graph framebuffer is not complete!" << std::endl;
+	m_framebuffers.push_back(cached);
+}
+
+void Render_Target_Pool::release_targets()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	for (Pooled_Target& target : m_targets)
+		target.in_use = false;
+	retire_unused();
+}
+
+void Render_Target_Pool::retire_unused()
+{
+	for (size_t i = 0; i < m_framebuffers.size();)
+	{
+		if (m_frame - m_framebuffers[i].last_used_frame > m_retire_frames)
+		{
+			glDeleteFramebuffers(1, &m_framebuffers[i].framebuffer);
+			m_framebuffers[i] = m_framebuffers.back();
+			m_framebuffers.pop_back();
+			continue;
+		}
+		i++;
+	}
+	//a framebuffer is never used later than its textures, so none of the retired textures is still attached
+	for (size_t i = 0; i < m_targets.size();)
+	{
+		if (m_frame - m_targets[i].last_used_frame > m_retire_frames)
+		{
+			m_allocated_bytes -= m_targets[i].desc.get_size();
+			glDeleteTextures(1, &m_targets[i].texture);
+			m_targets[i] = m_targets.back();
+			m_targets.pop_back();
+			continue;
+		}
+		i++;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+
+#include "render-graph.h"
+
+//GL backend for Render_Graph. Textures for the physical slots are kept between frames and handed out
+//again to any graph asking for the same description; ones nobody asked for in a while are deleted.
+//Framebuffers are cached per attachment set.
+class Render_Target_Pool : public Render_Graph_Backend
+{
+public:
+	explicit Render_Target_Pool(uint32_t retire_frames = 8) : m_retire_frames(retire_frames) {}
+	~Render_Target_Pool();
+
+	void acquire_targets(const std::vector<Render_Target_Desc>& slots, std::vector<uint32_t>& textures) override;
+	void begin_pass(const std::vector<uint32_t>& color_textures, uint32_t depth_texture, uint32_t width, uint32_t height) override;
+	void release_targets() override;
+
+	//bytes of every texture the pool owns, in use or waiting to be reused
+	uint64_t get_allocated_bytes() const { return m_allocated_bytes; }
+	uint32_t get_texture_count() const { return (uint32_t)m_targets.size(); }
+	void clear();
+
+private:
+	struct Pooled_Target
+	{
+		Render_Target_Desc desc;
+		GLuint texture = 0;
+		uint64_t last_used_frame = 0;
+		bool in_use = false;
+	};
+
+	struct Cached_Framebuffer
+	{
+		GLuint framebuffer = 0;
+		std::vector<uint32_t> color_textures;
+		uint32_t depth_texture = 0;
+		uint64_t last_used_frame = 0;
+	};
+
+	GLuint create_texture(const Render_Target_Desc& desc);
+	void retire_unused();
+
+private:
+	std::vector<Pooled_Target> m_targets;
+	std::vector<Cached_Framebuffer> m_framebuffers;
+	uint64_t m_frame = 0;
+	uint32_t m_retire_frames;
+	uint64_t m_allocated_bytes = 0;
+};
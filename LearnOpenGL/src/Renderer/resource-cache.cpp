@@ -0,0 +1,167 @@
+#include "resource-cache.h"
+
+#include <iostream>
+
+void Resource_Cache::set_budget(uint64_t cpu_bytes, uint64_t gpu_bytes)
+{
+	m_cpu_budget = cpu_bytes;
+	m_gpu_budget = gpu_bytes;
+	enforce_budget();
+}
+
+uint32_t Resource_Cache::find(const std::string& key)
+{
+	m_stats.loads++;
+	auto found = m_keys.find(key);
+	if (found == m_keys.end())
+		return NONE;
+	m_stats.cache_hits++;
+	return found->second;
+}
+
+uint32_t Resource_Cache::find_resident(const std::string& key) const
+{
+	auto found = m_keys.find(key);
+	return found == m_keys.end() ? NONE : found->second;
+}
+
+uint32_t Resource_Cache::insert(const std::string& key, Resource_Type type, std::shared_ptr<void> object, uint64_t cpu_bytes, uint64_t gpu_bytes)
+{
+	uint32_t index;
+	if (!m_free_slots.empty())
+	{
+		index = m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)m_slots.size();
+		m_slots.emplace_back();
+	}
+	Resource_Slot& slot = m_slots[index];
+	slot.object = std::move(object);
+	slot.key = key;
+	slot.type = type;
+	slot.references = 0;
+	slot.cpu_bytes = cpu_bytes;
+	slot.gpu_bytes = gpu_bytes;
+	m_keys[key] = index;
+	m_stats.resident++;
+	m_stats.cpu_bytes += cpu_bytes;
+	m_stats.gpu_bytes += gpu_bytes;
+
+	link_lru(index);
+	return index;
+}
+
+void* Resource_Cache::get_object(uint32_t index, uint32_t generation, Resource_Type type) const
+{
+	if (index >= m_slots.size())
+		return nullptr;
+	const Resource_Slot& slot = m_slots[index];
+	if (slot.generation != generation || slot.type != type)
+		return nullptr;
+	return slot.object.get();
+}
+
+void Resource_Cache::add_reference(uint32_t index, uint32_t generation)
+{
+	if (index >= m_slots.size() || m_slots[index].generation != generation || !m_slots[index].object)
+		return;
+	Resource_Slot& slot = m_slots[index];
+	if (slot.references++ == 0)
+	{
+		unlink_lru(index);
+		m_stats.referenced++;
+	}
+}
+
+void Resource_Cache::release(uint32_t index, uint32_t generation)
+{
+	if (index >= m_slots.size() || m_slots[index].generation != generation || m_slots[index].references == 0)
+		return;
+	if (--m_slots[index].references > 0)
+		return;
+	m_stats.referenced--;
+	link_lru(index);
+	enforce_budget();
+}
+
+void Resource_Cache::enforce_budget()
+{
+	while (m_lru_head != NONE && (m_stats.cpu_bytes > m_cpu_budget || m_stats.gpu_bytes > m_gpu_budget))
+		evict(m_lru_head);
+}
+
+void Resource_Cache::evict_unused()
+{
+	while (m_lru_head != NONE)
+		evict(m_lru_head);
+}
+
+void Resource_Cache::clear()
+{
+	for (uint32_t i = 0; i < m_slots.size(); i++)
+	{
+		if (!m_slots[i].object)
+			continue;
+		if (m_slots[i].references > 0)
+		{
+			std::cout << "Resource " << m_slots[i].key << " destroyed with " << m_slots[i].references << " references left" << std::endl;
+			m_slots[i].references = 0;
+			m_stats.referenced--;
+		}
+		evict(i);
+	}
+}
+
+void Resource_Cache::link_lru(uint32_t index)
+{
+	Resource_Slot& slot = m_slots[index];
+	if (slot.in_lru)
+		return;
+	slot.lru_previous = m_lru_tail;
+	slot.lru_next = NONE;
+	if (m_lru_tail != NONE)
+		m_slots[m_lru_tail].lru_next = index;
+	else
+		m_lru_head = index;
+	m_lru_tail = index;
+	slot.in_lru = true;
+}
+
+void Resource_Cache::unlink_lru(uint32_t index)
+{
+	Resource_Slot& slot = m_slots[index];
+	if (!slot.in_lru)
+		return;
+	if (slot.lru_previous != NONE)
+		m_slots[slot.lru_previous].lru_next = slot.lru_next;
+	else
+		m_lru_head = slot.lru_next;
+	if (slot.lru_next != NONE)
+		m_slots[slot.lru_next].lru_previous = slot.lru_previous;
+	else
+		m_lru_tail = slot.lru_previous;
+	slot.lru_previous = slot.lru_next = NONE;
+	slot.in_lru = false;
+}
+
+void Resource_Cache::evict(uint32_t index)
+{
+	Resource_Slot& slot = m_slots[index];
+	unlink_lru(index);
+	m_keys.erase(slot.key);
+	m_stats.resident--;
+	m_stats.cpu_bytes -= slot.cpu_bytes;
+	m_stats.gpu_bytes -= slot.gpu_bytes;
+	m_stats.evictions++;
+	//the object's deleter runs here, GL objects included
+	slot.object.reset();
+	slot.key.clear();
+	slot.type = Resource_Type::None;
+	slot.cpu_bytes = slot.gpu_bytes = 0;
+	if (++slot.generation == 0)
+		slot.generation = 1;
+	m_free_slots.push_back(index);
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+enum class Resource_Type : uint8_t { None, Model, Mesh, Texture, Shader };
+
+//Slot index plus the generation of the slot when the handle was made. An evicted resource bumps its
+//slot's generation, so stale handles resolve to nullptr instead of whatever reuses the slot.
+template<typename T>
+struct Resource_Handle
+{
+	uint32_t index = 0;
+	uint32_t generation = 0;			//0 is never handed out
+
+	bool is_valid() const { return generation != 0; }
+	bool operator==(const Resource_Handle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Resource_Handle& other) const { return !(*this == other); }
+};
+
+struct Resource_Stats
+{
+	uint32_t resident = 0;
+	uint32_t referenced = 0;			//the rest is cached, first in line for eviction
+	uint64_t cpu_bytes = 0;
+	uint64_t gpu_bytes = 0;
+	uint64_t loads = 0;
+	uint64_t cache_hits = 0;			//loads answered by a resident resource
+	uint64_t evictions = 0;
+};
+
+//The bookkeeping behind the Resource_Manager: keyed slots with generations and reference counts, and the
+//list of unreferenced slots evicted least recently released first once CPU or GPU bytes exceed the budget.
+//Objects are type-erased and only destroyed here, so it needs no GL itself and can be tested headless;
+//the owner of the objects decides which thread that has to be.
+class Resource_Cache
+{
+public:
+	static const uint32_t NONE = 0xFFFFFFFFu;
+
+	//bytes of resident resources before unreferenced ones are evicted
+	void set_budget(uint64_t cpu_bytes, uint64_t gpu_bytes);
+
+	//resident slot for key, counted as a load and, when found, a cache hit; NONE otherwise
+	uint32_t find(const std::string& key);
+	//the same without touching the stats
+	uint32_t find_resident(const std::string& key) const;
+	//unreferenced and first in line for eviction until add_reference(), so take the reference before the next enforce_budget()
+	uint32_t insert(const std::string& key, Resource_Type type, std::shared_ptr<void> object, uint64_t cpu_bytes, uint64_t gpu_bytes);
+
+	//nullptr for a stale generation or another type
+	void* get_object(uint32_t index, uint32_t generation, Resource_Type type) const;
+	uint32_t get_generation(uint32_t index) const { return m_slots[index].generation; }
+	//stale generations are ignored
+	void add_reference(uint32_t index, uint32_t generation);
+	void release(uint32_t index, uint32_t generation);
+
+	//evicts from the head of the list while over budget
+	void enforce_budget();
+	//evicts every unreferenced resource regardless of the budget
+	void evict_unused();
+	//destroys everything, references still alive turn stale
+	void clear();
+
+	const Resource_Stats& get_stats() const { return m_stats; }
+
+private:
+	struct Resource_Slot
+	{
+		std::shared_ptr<void> object;
+		std::string key;
+		Resource_Type type = Resource_Type::None;
+		uint32_t generation = 1;
+		uint32_t references = 0;
+		uint64_t cpu_bytes = 0;
+		uint64_t gpu_bytes = 0;
+		//unreferenced slots form a list, least recently released at the head
+		uint32_t lru_previous = NONE;
+		uint32_t lru_next = NONE;
+		bool in_lru = false;
+	};
+
+	void link_lru(uint32_t index);
+	void unlink_lru(uint32_t index);
+	void evict(uint32_t index);
+
+private:
+	std::vector<Resource_Slot> m_slots;
+	std::vector<uint32_t> m_free_slots;
+	std::unordered_map<std::string, uint32_t> m_keys;
+	uint32_t m_lru_head = NONE;
+	uint32_t m_lru_tail = NONE;
+	uint64_t m_cpu_budget = 512ull << 20;
+	uint64_t m_gpu_budget = 512ull << 20;
+	Resource_Stats m_stats;
+};
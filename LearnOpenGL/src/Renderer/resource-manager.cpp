@@ -0,0 +1,134 @@
+#include "resource-manager.h"
+
+#include <iostream>
+
+#include "model.h"
+#include "shader-compiler.h"
+
+Managed_Texture::~Managed_Texture()
+{
+	if (id)
+		glDeleteTextures(1, &id);
+}
+
+Resource_Manager::~Resource_Manager()
+{
+	clear();
+}
+
+void Resource_Manager::set_budget(uint64_t cpu_bytes, uint64_t gpu_bytes)
+{
+	m_cache.set_budget(cpu_bytes, gpu_bytes);
+}
+
+static std::string texture_key(const std::string& path, const Texture_Load_Options& options)
+{
+	return "texture:" + path + "|" + std::to_string(options.flip_vertically) + std::to_string(options.mipmaps) + "|"
+		+ std::to_string(options.wrap) + "|" + std::to_string(options.min_filter) + "|" + std::to_string(options.mag_filter);
+}
+
+Resource_Ref<Model> Resource_Manager::load_model(const std::string& path, bool gamma, bool pack_texture_arrays, bool split_vertex_streams)
+{
+	std::string key = "model:" + path + "|" + std::to_string(gamma) + std::to_string(pack_texture_arrays) + std::to_string(split_vertex_streams);
+	uint32_t index = m_cache.find(key);
+	if (index == NONE)
+	{
+		std::shared_ptr<Model> model = std::make_shared<Model>(path, gamma, pack_texture_arrays, split_vertex_streams);
+		if (model->meshes.empty())
+			return Resource_Ref<Model>();
+		index = m_cache.insert(key, Resource_Type::Model, model, model->getCpuBytes() + sizeof(Model), model->getGpuBytes());
+	}
+	Resource_Ref<Model> resource = make_ref<Model>(index);
+	m_cache.enforce_budget();
+	return resource;
+}
+
+Resource_Ref<Managed_Texture> Resource_Manager::load_texture(const std::string& path, const Texture_Load_Options& options)
+{
+	std::vector<Resource_Ref<Managed_Texture>> textures = load_textures({ path }, options);
+	return textures[0];
+}
+
+std::vector<Resource_Ref<Managed_Texture>> Resource_Manager::load_textures(const std::vector<std::string>& paths, const Texture_Load_Options& options)
+{
+	std::vector<std::string> keys(paths.size());
+	std::vector<uint32_t> indices(paths.size(), NONE);
+	std::vector<std::shared_ptr<Managed_Texture>> created(paths.size());
+	Texture_Loader loader;
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		keys[i] = texture_key(paths[i], options);
+		indices[i] = m_cache.find(keys[i]);
+		//a path listed twice is only loaded once
+		for (size_t j = 0; j < i && indices[i] == NONE; j++)
+			if (keys[j] == keys[i] && created[j])
+				created[i] = created[j];
+		if (indices[i] != NONE || created[i])
+			continue;
+		created[i] = std::make_shared<Managed_Texture>();
+		created[i]->id = loader.add(paths[i], options);
+	}
+	loader.load_all();
+
+	std::vector<Resource_Ref<Managed_Texture>> textures;
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		if (indices[i] == NONE)
+			indices[i] = m_cache.find_resident(keys[i]);
+		if (indices[i] == NONE)
+		{
+			//a texture without storage failed to load: it is not cached, so the reference stays empty and the next load retries
+			uint64_t gpu_bytes = Texture_Loader::get_gpu_bytes(created[i]->id);
+			if (gpu_bytes == 0)
+			{
+				textures.emplace_back();
+				continue;
+			}
+			indices[i] = m_cache.insert(keys[i], Resource_Type::Texture, created[i], sizeof(Managed_Texture), gpu_bytes);
+		}
+		textures.push_back(make_ref<Managed_Texture>(indices[i]));
+	}
+	m_cache.enforce_budget();
+	return textures;
+}
+
+Resource_Ref<Shader> Resource_Manager::load_shader(const std::string& vertex_path, const std::string& fragment_path, Shader_Features features)
+{
+	std::string key = "shader:" + vertex_path + "|" + fragment_path + "|" + std::to_string(features);
+	uint32_t index = m_cache.find(key);
+	if (index == NONE)
+	{
+		std::shared_ptr<Shader> shader = m_shader_compiler
+			? m_shader_compiler->load(vertex_path, fragment_path, features)
+			: std::make_shared<Shader>(vertex_path, fragment_path, features);
+		//program binaries live in the driver, only the object is counted
+		index = m_cache.insert(key, Resource_Type::Shader, shader, sizeof(Shader), 0);
+	}
+	Resource_Ref<Shader> resource = make_ref<Shader>(index);
+	m_cache.enforce_budget();
+	return resource;
+}
+
+Resource_Ref<Mesh> Resource_Manager::add_mesh(const std::string& name, Mesh&& mesh)
+{
+	std::string key = "mesh:" + name;
+	uint32_t index = m_cache.find(key);
+	if (index == NONE)
+	{
+		std::shared_ptr<Mesh> managed = std::make_shared<Mesh>(std::move(mesh));
+		index = m_cache.insert(key, Resource_Type::Mesh, managed, managed->getCpuBytes() + sizeof(Mesh), managed->getGpuBytes());
+	}
+	Resource_Ref<Mesh> resource = make_ref<Mesh>(index);
+	m_cache.enforce_budget();
+	return resource;
+}
+
+void Resource_Manager::evict_unused()
+{
+	m_cache.evict_unused();
+}
+
+void Resource_Manager::clear()
+{
+	m_cache.clear();
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "resource-cache.h"
+#include "shader.h"
+#include "texture-loader.h"
+
+class Model;
+class Mesh;
+class Shader_Compiler;
+
+//a texture owned by the Resource_Manager, deleted when it is evicted
+struct Managed_Texture
+{
+	GLuint id = 0;
+	GLenum target = GL_TEXTURE_2D;
+
+	Managed_Texture() = default;
+	Managed_Texture(const Managed_Texture&) = delete;
+	Managed_Texture& operator=(const Managed_Texture&) = delete;
+	~Managed_Texture();
+};
+
+template<typename T> struct Resource_Traits;
+template<> struct Resource_Traits<Model> { static constexpr Resource_Type type = Resource_Type::Model; };
+template<> struct Resource_Traits<Mesh> { static constexpr Resource_Type type = Resource_Type::Mesh; };
+template<> struct Resource_Traits<Managed_Texture> { static constexpr Resource_Type type = Resource_Type::Texture; };
+template<> struct Resource_Traits<Shader> { static constexpr Resource_Type type = Resource_Type::Shader; };
+
+class Resource_Manager;
+
+//Shared ownership of a managed resource: copies add a reference, destruction drops it. The manager
+//must outlive every reference.
+template<typename T>
+class Resource_Ref
+{
+public:
+	Resource_Ref() = default;
+	Resource_Ref(const Resource_Ref& other) : Resource_Ref(other.m_manager, other.m_handle) {}
+	Resource_Ref(Resource_Ref&& other) noexcept : m_manager(other.m_manager), m_handle(other.m_handle) { other.m_manager = nullptr; other.m_handle = Resource_Handle<T>(); }
+	Resource_Ref& operator=(Resource_Ref other) { std::swap(m_manager, other.m_manager); std::swap(m_handle, other.m_handle); return *this; }
+	~Resource_Ref() { reset(); }
+
+	//nullptr when empty or when the load failed
+	T* get() const;
+	T* operator->() const { return get(); }
+	T& operator*() const { return *get(); }
+	explicit operator bool() const { return get() != nullptr; }
+
+	Resource_Handle<T> get_handle() const { return m_handle; }
+	void reset();
+
+private:
+	friend class Resource_Manager;
+	Resource_Ref(Resource_Manager* manager, Resource_Handle<T> handle);
+
+	Resource_Manager* m_manager = nullptr;
+	Resource_Handle<T> m_handle;
+};
+
+//Central owner of models, meshes, textures and shaders. Loads go through a key built from the path and
+//options, so asking twice returns the resource already resident. Resources nobody references stay cached
+//until CPU or GPU usage exceeds the budget, then they are evicted least recently released first; a
+//session that keeps swapping scenes levels off at the budget instead of growing. A load that fails is not
+//cached, its reference is empty. The slots, references and budget are kept by the GL-free Resource_Cache.
+//Evicting frees GL objects, so everything here belongs to the thread that owns the context.
+class Resource_Manager
+{
+public:
+	Resource_Manager() = default;
+	Resource_Manager(const Resource_Manager&) = delete;
+	Resource_Manager& operator=(const Resource_Manager&) = delete;
+	~Resource_Manager();
+
+	//bytes of resident resources before unreferenced ones are evicted
+	void set_budget(uint64_t cpu_bytes, uint64_t gpu_bytes);
+	//shaders then compile in the background behind the compiler's fallback, otherwise they block
+	void set_shader_compiler(Shader_Compiler* compiler) { m_shader_compiler = compiler; }
+
+	Resource_Ref<Model> load_model(const std::string& path, bool gamma = false, bool pack_texture_arrays = false, bool split_vertex_streams = false);
+	Resource_Ref<Managed_Texture> load_texture(const std::string& path, const Texture_Load_Options& options = Texture_Load_Options());
+	//the missing ones are decoded together, like Texture_Loader::load_all
+	std::vector<Resource_Ref<Managed_Texture>> load_textures(const std::vector<std::string>& paths, const Texture_Load_Options& options = Texture_Load_Options());
+	Resource_Ref<Shader> load_shader(const std::string& vertex_path, const std::string& fragment_path, Shader_Features features = SHADER_FEATURE_NONE);
+	//geometry built in code; a resident mesh with the same name is returned instead and mesh is dropped
+	Resource_Ref<Mesh> add_mesh(const std::string& name, Mesh&& mesh);
+
+	//nullptr for an empty or stale handle
+	template<typename T>
+	T* get(Resource_Handle<T> handle) const { return static_cast<T*>(m_cache.get_object(handle.index, handle.generation, Resource_Traits<T>::type)); }
+
+	//evicts every unreferenced resource regardless of the budget, e.g. right after a scene switch
+	void evict_unused();
+	//destroys everything, references still alive turn stale; call before the context goes away
+	void clear();
+
+	const Resource_Stats& get_stats() const { return m_cache.get_stats(); }
+
+private:
+	template<typename T> friend class Resource_Ref;
+
+	static const uint32_t NONE = Resource_Cache::NONE;
+
+	template<typename T>
+	Resource_Ref<T> make_ref(uint32_t index) { return Resource_Ref<T>(this, Resource_Handle<T>{ index, m_cache.get_generation(index) }); }
+
+private:
+	Resource_Cache m_cache;
+	Shader_Compiler* m_shader_compiler = nullptr;
+};
+
+template<typename T>
+Resource_Ref<T>::Resource_Ref(Resource_Manager* manager, Resource_Handle<T> handle)
+	:m_manager(manager), m_handle(handle)
+{
+	if (m_manager && m_handle.is_valid())
+		m_manager->m_cache.add_reference(m_handle.index, m_handle.generation);
+}
+
+template<typename T>
+T* Resource_Ref<T>::get() const
+{
+	return m_manager ? m_manager->get(m_handle) : nullptr;
+}
+
+template<typename T>
+void Resource_Ref<T>::reset()
+{
+	if (m_manager && m_handle.is_valid())
+		m_manager->m_cache.release(m_handle.index, m_handle.generation);
+	m_manager = nullptr;
+	m_handle = Resource_Handle<T>();
+}
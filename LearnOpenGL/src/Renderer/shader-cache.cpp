@@ -0,0 +1,110 @@
+#include "shader-cache.h"
+#include "Core/file-system.h"
+
+#include <sstream>
+#include <cstring>
+#include <iostream>
+
+Shader_Variant_Cache::Shader_Variant_Cache(Shader_Compiler& compiler, const std::string& directory)
+	:m_compiler(compiler), m_directory(directory)
+{
+}
+
+uint64_t Shader_Variant_Cache::make_key(const std::string& program, Shader_Features features)
+{
+	//FNV-1a over the program name followed by the feature bits
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : program)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 1099511628211ull;
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		hash ^= (features >> (i * 8)) & 0xFF;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+//path == directory + program + suffix
+static bool path_matches(const std::string& path, const std::string& directory, const std::string& program, const char* suffix)
+{
+	size_t suffix_length = strlen(suffix);
+	return path.size() == directory.size() + program.size() + suffix_length
+		&& path.compare(0, directory.size(), directory) == 0
+		&& path.compare(directory.size(), program.size(), program) == 0
+		&& path.compare(directory.size() + program.size(), suffix_length, suffix) == 0;
+}
+
+bool Shader_Variant_Cache::matches(const Variant& variant, const std::string& program, Shader_Features features) const
+{
+	return variant.features == features
+		&& path_matches(variant.vertex_path, m_directory, program, "-vert.glsl")
+		&& path_matches(variant.fragment_path, m_directory, program, "-frag.glsl");
+}
+
+const Shader_Variant_Cache::Variant* Shader_Variant_Cache::find(uint64_t key, const std::string& program, Shader_Features features) const
+{
+	auto it = m_variants.find(key);
+	if (it == m_variants.end())
+		return nullptr;
+	for (const Variant& variant : it->second)
+		if (matches(variant, program, features))
+			return &variant;
+	return nullptr;
+}
+
+std::shared_ptr<Shader> Shader_Variant_Cache::get(const std::string& program, Shader_Features features)
+{
+	uint64_t key = make_key(program, features);
+	if (const Variant* variant = find(key, program, features))
+		return variant->shader;
+
+	Variant variant;
+	variant.vertex_path = m_directory + program + "-vert.glsl";
+	variant.fragment_path = m_directory + program + "-frag.glsl";
+	variant.features = features;
+	variant.shader = m_compiler.load(variant.vertex_path, variant.fragment_path, features);
+	m_variants[key].push_back(variant);
+	m_variant_count++;
+	return variant.shader;
+}
+
+size_t Shader_Variant_Cache::preload(const std::string& manifest_path)
+{
+	File_Handle manifest = File_System::read(manifest_path);
+	if (!manifest->is_ready())
+	{
+		std::cout << "Could not open shader manifest " << manifest_path << std::endl;
+		return 0;
+	}
+
+	std::istringstream in(std::string(manifest->get_text(), manifest->get_size()));
+	size_t queued = 0;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream tokens(line);
+		std::string program, define;
+		if (!(tokens >> program))
+			continue;
+
+		Shader_Features features = SHADER_FEATURE_NONE;
+		while (tokens >> define)
+		{
+			Shader_Feature feature = shader_feature_from_define(define);
+			if (feature == SHADER_FEATURE_NONE)
+				std::cout << "Unknown shader feature " << define << " in " << manifest_path << std::endl;
+			features |= feature;
+		}
+
+		if (!find(make_key(program, features), program, features))
+		{
+			get(program, features);
+			queued++;
+		}
+	}
+	return queued;
+}
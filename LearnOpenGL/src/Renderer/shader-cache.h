@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.h"
+#include "shader-compiler.h"
+
+//Hands out feature-specialized variants of a shader program, building each variant the first time
+//it is requested. Programs are named after their files: "textured" means
+//"<directory>textured-vert.glsl" and "<directory>textured-frag.glsl".
+class Shader_Variant_Cache
+{
+public:
+	Shader_Variant_Cache(Shader_Compiler& compiler, const std::string& directory = "Asset/Shader/");
+
+	std::shared_ptr<Shader> get(const std::string& program, Shader_Features features);
+
+	//manifest has one variant per line, "program FEATURE FEATURE ...", '#' starts a comment
+	//returns how many new variants were queued
+	size_t preload(const std::string& manifest_path);
+
+	size_t get_variant_count() const { return m_variant_count; }
+
+	//only picks the bucket, variants whose keys collide are told apart by their paths and features
+	static uint64_t make_key(const std::string& program, Shader_Features features);
+
+private:
+	struct Variant
+	{
+		std::string vertex_path;
+		std::string fragment_path;
+		Shader_Features features;
+		std::shared_ptr<Shader> shader;
+	};
+
+	//compares without building the paths, get() runs every draw and must not allocate
+	bool matches(const Variant& variant, const std::string& program, Shader_Features features) const;
+	const Variant* find(uint64_t key, const std::string& program, Shader_Features features) const;
+
+private:
+	Shader_Compiler& m_compiler;
+	std::string m_directory;
+	std::unordered_map<uint64_t, std::vector<Variant>> m_variants;
+	size_t m_variant_count = 0;
+};
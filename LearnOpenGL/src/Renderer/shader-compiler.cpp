@@ -0,0 +1,332 @@
+#include "shader-compiler.h"
+
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+//GL_KHR_parallel_shader_compile is not part of the glad loader we ship, so fetch it by hand
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFN_GL_MAX_SHADER_COMPILER_THREADS)(GLuint count);
+
+Shader_Compiler::~Shader_Compiler()
+{
+	shutdown();
+}
+
+void Shader_Compiler::init(GLFWwindow* main_window)
+{
+	if (m_initialized)
+		return;
+	m_initialized = true;
+
+	m_parallel_compile = glfwExtensionSupported("GL_KHR_parallel_shader_compile") || glfwExtensionSupported("GL_ARB_parallel_shader_compile");
+	if (m_parallel_compile)
+	{
+		auto max_threads = (PFN_GL_MAX_SHADER_COMPILER_THREADS)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		if (!max_threads)
+			max_threads = (PFN_GL_MAX_SHADER_COMPILER_THREADS)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		//0xFFFFFFFF lets the driver pick as many threads as it likes
+		if (max_threads)
+			max_threads(0xFFFFFFFF);
+		return;
+	}
+
+	//no driver-side parallelism, build programs on a hidden window whose context shares objects with ours
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_worker_window = glfwCreateWindow(1, 1, "Shader Compiler", nullptr, main_window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (m_worker_window == nullptr)
+	{
+		std::cout << "Failed to create shader compile context, shaders will compile on the main thread!" << std::endl;
+		return;
+	}
+	m_worker_exit = false;
+	m_worker = std::thread(&Shader_Compiler::worker_loop, this);
+}
+
+void Shader_Compiler::shutdown()
+{
+	if (m_worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_worker_mutex);
+			m_worker_exit = true;
+		}
+		m_worker_cv.notify_one();
+		m_worker.join();
+	}
+	if (m_worker_window)
+	{
+		glfwDestroyWindow(m_worker_window);
+		m_worker_window = nullptr;
+	}
+	//check_program() already deleted the stages, and the program of a failed build
+	for (auto& job : m_worker_done)
+		if (job.linked)
+			glDeleteProgram(job.program);
+	for (auto& job : m_in_flight)
+	{
+		glDeleteShader(job.vertex_shader);
+		glDeleteShader(job.fragment_shader);
+		glDeleteProgram(job.program);
+	}
+	m_worker_jobs.clear();
+	m_worker_done.clear();
+	m_in_flight.clear();
+	m_queued.clear();
+	m_in_worker = 0;
+	m_initialized = false;
+}
+
+std::shared_ptr<Shader> Shader_Compiler::load(const std::string& vertex_path, const std::string& fragment_path, Shader_Features features, const std::shared_ptr<Shader>& fallback)
+{
+	std::shared_ptr<Shader> shader = std::make_shared<Shader>(vertex_path, fragment_path, features, fallback ? fallback : m_default_fallback);
+	enqueue(shader);
+
+	std::error_code error;
+	Watched_Shader watched;
+	watched.shader = shader;
+	watched.vertex_path = vertex_path;
+	watched.fragment_path = fragment_path;
+	watched.vertex_time = std::filesystem::last_write_time(watched.vertex_path, error);
+	watched.fragment_time = std::filesystem::last_write_time(watched.fragment_path, error);
+	m_watched.push_back(std::move(watched));
+	return shader;
+}
+
+void Shader_Compiler::enqueue(const std::shared_ptr<Shader>& shader)
+{
+	Compile_Job job;
+	job.shader = shader;
+	job.sequence = ++shader->m_build_sequence;
+	std::vector<File_Handle> reads = File_System::read_batch({ shader->get_vertex_path(), shader->get_fragment_path() });
+	job.vertex_file = reads[0];
+	job.fragment_file = reads[1];
+	m_queued.push_back(std::move(job));
+}
+
+void Shader_Compiler::poll()
+{
+	if (m_hot_reload)
+		check_sources();
+	submit_queued();
+	collect_finished();
+}
+
+void Shader_Compiler::wait_idle()
+{
+	while (get_pending_count() > 0)
+	{
+		submit_queued();
+		collect_finished();
+		if (get_pending_count() > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void Shader_Compiler::submit_queued()
+{
+	if (m_queued.empty())
+		return;
+
+	//only jobs whose sources finished reading move on, the rest stay queued for the next poll
+	std::vector<Compile_Job> loading;
+	for (size_t i = 0; i < m_queued.size();)
+	{
+		Compile_Job& job = m_queued[i];
+		if (job.vertex_file && (!job.vertex_file->is_done() || !job.fragment_file->is_done()))
+		{
+			loading.push_back(std::move(job));
+			m_queued[i] = std::move(m_queued.back());
+			m_queued.pop_back();
+			continue;
+		}
+		if (job.vertex_file)
+		{
+			std::shared_ptr<Shader> shader = job.shader.lock();
+			bool loaded = shader && job.vertex_file->is_ready() && job.fragment_file->is_ready();
+			if (loaded)
+			{
+				job.vertex_src = Shader::inject_defines(std::string(job.vertex_file->get_text(), job.vertex_file->get_size()), shader->get_features());
+				job.fragment_src = Shader::inject_defines(std::string(job.fragment_file->get_text(), job.fragment_file->get_size()), shader->get_features());
+			}
+			job.vertex_file.reset();
+			job.fragment_file.reset();
+			if (!loaded)
+			{
+				if (shader && !shader->is_ready())
+					shader->m_status = Shader_Status::Failed;
+				m_queued[i] = std::move(m_queued.back());
+				m_queued.pop_back();
+				continue;
+			}
+		}
+		i++;
+	}
+	if (m_queued.empty())
+	{
+		m_queued = std::move(loading);
+		return;
+	}
+
+	if (m_worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_worker_mutex);
+			for (auto& job : m_queued)
+				m_worker_jobs.push_back(std::move(job));
+		}
+		m_in_worker += m_queued.size();
+		m_queued = std::move(loading);
+		m_worker_cv.notify_one();
+		return;
+	}
+
+	//hand every stage to the driver before touching any status, so the compiles overlap
+	for (auto& job : m_queued)
+	{
+		job.vertex_shader = Shader::create_stage(GL_VERTEX_SHADER, job.vertex_src);
+		job.fragment_shader = Shader::create_stage(GL_FRAGMENT_SHADER, job.fragment_src);
+	}
+	for (auto& job : m_queued)
+	{
+		job.program = Shader::create_program(job.vertex_shader, job.fragment_shader);
+		job.vertex_src.clear();
+		job.fragment_src.clear();
+		m_in_flight.push_back(std::move(job));
+	}
+	m_queued = std::move(loading);
+}
+
+void Shader_Compiler::collect_finished()
+{
+	for (size_t i = 0; i < m_in_flight.size();)
+	{
+		Compile_Job& job = m_in_flight[i];
+		if (m_parallel_compile)
+		{
+			GLint completed = GL_FALSE;
+			glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &completed);
+			if (completed == GL_FALSE)
+			{
+				i++;
+				continue;
+			}
+		}
+		job.linked = Shader::check_program(job.program, job.vertex_shader, job.fragment_shader);
+		release_names(job);
+		finish(job);
+		if (i + 1 != m_in_flight.size())
+			m_in_flight[i] = std::move(m_in_flight.back());
+		m_in_flight.pop_back();
+	}
+
+	if (m_in_worker == 0)
+		return;
+	std::vector<Compile_Job> done;
+	{
+		std::lock_guard<std::mutex> lock(m_worker_mutex);
+		done.swap(m_worker_done);
+	}
+	for (auto& job : done)
+		finish(job);
+	m_in_worker -= done.size();
+}
+
+void Shader_Compiler::release_names(Compile_Job& job)
+{
+	job.vertex_shader = 0;
+	job.fragment_shader = 0;
+	if (!job.linked)
+		job.program = 0;
+}
+
+void Shader_Compiler::finish(Compile_Job& job)
+{
+	std::shared_ptr<Shader> shader = job.shader.lock();
+	//hot reload can queue a shader again while its last build is still compiling, and the worker or the
+	//driver may finish them in any order; a build older than the program in use would undo the newer edit
+	if (!shader || job.sequence < shader->m_applied_sequence)
+	{
+		if (job.linked)
+			glDeleteProgram(job.program);
+		return;
+	}
+
+	if (job.linked)
+	{
+		shader->set_program(job.program);
+		shader->m_applied_sequence = job.sequence;
+		return;
+	}
+	//a broken edit during hot reload keeps the last good program
+	if (!shader->is_ready())
+		shader->m_status = Shader_Status::Failed;
+	std::cout << "Shader build failed: " << shader->get_vertex_path() << " / " << shader->get_fragment_path() << std::endl;
+}
+
+void Shader_Compiler::check_sources()
+{
+	auto now = std::chrono::steady_clock::now();
+	if (std::chrono::duration<float>(now - m_last_reload_check).count() < m_reload_interval)
+		return;
+	m_last_reload_check = now;
+
+	for (size_t i = 0; i < m_watched.size();)
+	{
+		Watched_Shader& watched = m_watched[i];
+		std::shared_ptr<Shader> shader = watched.shader.lock();
+		if (!shader)
+		{
+			m_watched[i] = std::move(m_watched.back());
+			m_watched.pop_back();
+			continue;
+		}
+
+		//one code per call, the second would clear a failure of the first
+		std::error_code vertex_error, fragment_error;
+		auto vertex_time = std::filesystem::last_write_time(watched.vertex_path, vertex_error);
+		auto fragment_time = std::filesystem::last_write_time(watched.fragment_path, fragment_error);
+		if (!vertex_error && !fragment_error && (vertex_time != watched.vertex_time || fragment_time != watched.fragment_time))
+		{
+			watched.vertex_time = vertex_time;
+			watched.fragment_time = fragment_time;
+			std::cout << "Reloading shader: " << shader->get_vertex_path() << " / " << shader->get_fragment_path() << std::endl;
+			enqueue(shader);
+		}
+		i++;
+	}
+}
+
+void Shader_Compiler::worker_loop()
+{
+	glfwMakeContextCurrent(m_worker_window);
+	while (true)
+	{
+		Compile_Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_worker_mutex);
+			m_worker_cv.wait(lock, [this] { return m_worker_exit || !m_worker_jobs.empty(); });
+			if (m_worker_exit)
+				break;
+			job = std::move(m_worker_jobs.front());
+			m_worker_jobs.pop_front();
+		}
+
+		job.vertex_shader = Shader::create_stage(GL_VERTEX_SHADER, job.vertex_src);
+		job.fragment_shader = Shader::create_stage(GL_FRAGMENT_SHADER, job.fragment_src);
+		job.program = Shader::create_program(job.vertex_shader, job.fragment_shader);
+		//blocking here is fine, this thread does nothing else
+		job.linked = Shader::check_program(job.program, job.vertex_shader, job.fragment_shader);
+		release_names(job);
+		//make the finished program visible to the main context before handing it over
+		glFinish();
+
+		job.vertex_src.clear();
+		job.fragment_src.clear();
+		std::lock_guard<std::mutex> lock(m_worker_mutex);
+		m_worker_done.push_back(std::move(job));
+	}
+	glfwMakeContextCurrent(nullptr);
+}
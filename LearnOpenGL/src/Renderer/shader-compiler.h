@@ -0,0 +1,104 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+#include <chrono>
+
+#include "shader.h"
+#include "Core/file-system.h"
+
+struct GLFWwindow;
+
+//Compiles shaders without stalling the render loop.
+//With GL_KHR_parallel_shader_compile every pending program is submitted at once and polled with
+//GL_COMPLETION_STATUS_KHR, otherwise programs are built on a background thread that owns a context
+//shared with the main window. Shaders keep drawing with their fallback program until they are ready.
+class Shader_Compiler
+{
+public:
+	Shader_Compiler() = default;
+	~Shader_Compiler();
+
+	//must be called on the main thread with main_window's context current
+	void init(GLFWwindow* main_window);
+	void shutdown();
+
+	//queue a program, returns immediately with a shader that binds the fallback until it is ready
+	std::shared_ptr<Shader> load(const std::string& vertex_path, const std::string& fragment_path, Shader_Features features = SHADER_FEATURE_NONE, const std::shared_ptr<Shader>& fallback = nullptr);
+	void set_default_fallback(const std::shared_ptr<Shader>& fallback) { m_default_fallback = fallback; }
+
+	//submit everything that is queued, then pick up finished programs and check for source changes
+	void poll();
+	//block until every queued program is resolved, for loading screens
+	void wait_idle();
+
+	void set_hot_reload(bool enabled, float interval_seconds = 0.5f) { m_hot_reload = enabled; m_reload_interval = interval_seconds; }
+
+	bool has_parallel_compile() const { return m_parallel_compile; }
+	size_t get_pending_count() const { return m_queued.size() + m_in_flight.size() + m_in_worker; }
+
+private:
+	struct Compile_Job
+	{
+		std::weak_ptr<Shader> shader;
+		//sources still being read, the job waits in m_queued until both arrived
+		File_Handle vertex_file;
+		File_Handle fragment_file;
+		std::string vertex_src;
+		std::string fragment_src;
+		GLuint vertex_shader = 0;
+		GLuint fragment_shader = 0;
+		GLuint program = 0;
+		bool linked = false;
+		//the shader's m_build_sequence when queued, a build older than the program in use is dropped
+		uint32_t sequence = 0;
+	};
+
+	struct Watched_Shader
+	{
+		std::weak_ptr<Shader> shader;
+		//converted once, a path built from the string on every check allocates
+		std::filesystem::path vertex_path;
+		std::filesystem::path fragment_path;
+		std::filesystem::file_time_type vertex_time;
+		std::filesystem::file_time_type fragment_time;
+	};
+
+	void enqueue(const std::shared_ptr<Shader>& shader);
+	void submit_queued();
+	void collect_finished();
+	//after check_program(): forgets the names it deleted, so only a linked program is left to own
+	static void release_names(Compile_Job& job);
+	void finish(Compile_Job& job);
+	void check_sources();
+	void worker_loop();
+
+private:
+	bool m_initialized = false;
+	bool m_parallel_compile = false;
+	std::shared_ptr<Shader> m_default_fallback;
+
+	std::vector<Compile_Job> m_queued;
+	std::vector<Compile_Job> m_in_flight;	//parallel compile path: submitted to the driver, not complete
+
+	//background context path
+	GLFWwindow* m_worker_window = nullptr;
+	std::thread m_worker;
+	std::mutex m_worker_mutex;
+	std::condition_variable m_worker_cv;
+	std::deque<Compile_Job> m_worker_jobs;
+	std::vector<Compile_Job> m_worker_done;
+	size_t m_in_worker = 0;
+	bool m_worker_exit = false;
+
+	//hot reload
+	bool m_hot_reload = false;
+	float m_reload_interval = 0.5f;
+	std::chrono::steady_clock::time_point m_last_reload_check;
+	std::vector<Watched_Shader> m_watched;
+};
@@ -1,26 +1,68 @@
 #include "shader.h"
-#include <fstream>
+#include "Core/file-system.h"
 #include <iostream>
 #include <vector>
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(const std::string& vertex_shader_path, const std::string& fragment_shader_path)
+static const char* s_feature_defines[SHADER_FEATURE_COUNT] =
 {
-	unsigned int shader_program = glCreateProgram();
-	m_render_ID = shader_program;
-	std::string vertex_shader_src = read_file(vertex_shader_path);
-	std::string fragment_shader_src = read_file(fragment_shader_path);
+	"HAS_DIFFUSE_MAP",
+	"HAS_SPECULAR_MAP",
+	"HAS_NORMAL_MAP",
+	"HAS_HEIGHT_MAP",
+	"ALPHA_TEST",
+	"FLAT_COLOR",
+	"LINEAR_DEPTH",
+	"RECEIVE_SHADOWS",
+	"TEXTURE_ARRAYS",
+	"INDIRECT_INSTANCES"
+};
+
+const char* shader_feature_define(Shader_Feature feature)
+{
+	for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; i++)
+		if (feature == (1u << i))
+			return s_feature_defines[i];
+	return nullptr;
+}
+
+Shader_Feature shader_feature_from_define(const std::string& define)
+{
+	for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; i++)
+		if (define == s_feature_defines[i])
+			return (Shader_Feature)(1u << i);
+	return SHADER_FEATURE_NONE;
+}
+
+Shader::Shader(const std::string& vertex_shader_path, const std::string& fragment_shader_path, Shader_Features features)
+	:m_vertex_path(vertex_shader_path), m_fragment_path(fragment_shader_path), m_features(features)
+{
+	std::string vertex_shader_src = inject_defines(read_file(vertex_shader_path), features);
+	std::string fragment_shader_src = inject_defines(read_file(fragment_shader_path), features);
 	compile(vertex_shader_src, fragment_shader_src);
 }
 
+Shader::Shader(const std::string& vertex_shader_path, const std::string& fragment_shader_path, Shader_Features features, const std::shared_ptr<Shader>& fallback)
+	:m_fallback(fallback), m_vertex_path(vertex_shader_path), m_fragment_path(fragment_shader_path), m_features(features)
+{
+}
+
 Shader::~Shader()
 {
-	glDeleteProgram(m_render_ID);
+	if (m_render_ID)
+		glDeleteProgram(m_render_ID);
+}
+
+GLint Shader::ID() const
+{
+	if (m_status != Shader_Status::Ready && m_fallback)
+		return m_fallback->ID();
+	return m_render_ID;
 }
 
 void Shader::bind() const
 {
-	glUseProgram(m_render_ID);
+	glUseProgram(ID());
 }
 
 void Shader::unbind() const
@@ -30,159 +72,198 @@ void Shader::unbind() const
 
 void Shader::set_float(const std::string& name, float value)
 {
-	GLint location = glGetUniformLocation(m_render_ID, name.c_str());
+	GLint location = glGetUniformLocation(ID(), name.c_str());
 	glUniform1f(location, value);
 }
 
+void Shader::set_vec2(const std::string& name, const glm::vec2 values)
+{
+	GLint location = glGetUniformLocation(ID(), name.c_str());
+	glUniform2f(location, values.x, values.y);
+}
+
 void Shader::set_vec3(const std::string& name, const glm::vec3 values)
 {
-	GLint location = glGetUniformLocation(m_render_ID, name.c_str());
+	GLint location = glGetUniformLocation(ID(), name.c_str());
 	glUniform3f(location, values.x, values.y, values.z);
 }
 
 void Shader::set_vec4(const std::string& name, const glm::vec4 values)
 {
-	GLint location = glGetUniformLocation(m_render_ID, name.c_str());
+	GLint location = glGetUniformLocation(ID(), name.c_str());
 	glUniform4f(location, values.x, values.y, values.z, values.w);
 }
 
 void Shader::set_int(const std::string& name, int value)
 {
-	GLint location = glGetUniformLocation(m_render_ID, name.c_str());
+	GLint location = glGetUniformLocation(ID(), name.c_str());
 	glUniform1i(location, value);
 }
 
 void Shader::set_mat4(const std::string& name, const glm::mat4 values)
 {
-	GLint location = glGetUniformLocation(m_render_ID, name.c_str());
+	GLint location = glGetUniformLocation(ID(), name.c_str());
 	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(values));
 }
 
 std::string Shader::read_file(const std::string& FilePath)
 {
-	std::string ShaderSrc;
-	std::ifstream in(FilePath, std::ios::in, std::ios::binary);
-	if (in)
-	{
-		in.seekg(0, std::ios::end);
-		size_t size = in.tellg();
-		if (size != -1)
-		{
-			ShaderSrc.resize(size);
-			in.seekg(0, std::ios::beg);
-			in.read(&ShaderSrc[0], size);
-			in.close();
-		}
-		else
-			std::cout << "Could not read from file " << FilePath << std::endl;
-	}
-	else
-		std::cout << "Could not open the file! " << std::endl;
-	return ShaderSrc;
+	//File_System reports the failure
+	return File_System::read_text(FilePath);
+}
+
+std::string Shader::inject_defines(const std::string& src, Shader_Features features)
+{
+	if (features == SHADER_FEATURE_NONE || src.empty())
+		return src;
+
+	std::string defines;
+	for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; i++)
+		if (features & (1u << i))
+			defines += std::string("#define ") + s_feature_defines[i] + "\n";
+
+	//#version has to stay the first statement, so the defines go on the line after it
+	size_t version = src.find("#version");
+	if (version == std::string::npos)
+		return defines + src;
+	size_t line_end = src.find('\n', version);
+	if (line_end == std::string::npos)
+		return src + "\n" + defines;
+	return src.substr(0, line_end + 1) + defines + src.substr(line_end + 1);
 }
 
 void Shader::compile(const std::string& vertex_shader_src, const std::string& fragment_shader_src)
 {
 	//--------------Create and Compile Shader-----------------------
-	unsigned int vertex_shader, fragment_shader;
+	GLuint vertex_shader = create_stage(GL_VERTEX_SHADER, vertex_shader_src);
+	GLuint fragment_shader = create_stage(GL_FRAGMENT_SHADER, fragment_shader_src);
+	GLuint program = create_program(vertex_shader, fragment_shader);
 
-	// Create an empty vertex shader handle
-	vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	// Send the vertex shader source code to GL
-	// Note that std::string's .c_str is NULL character terminated.
-	const GLchar* source = vertex_shader_src.c_str();
-	glShaderSource(vertex_shader, 1, &source, 0);
-	// Compile the vertex shader
-	glCompileShader(vertex_shader);
-
-	GLint is_compiled = 0;
-	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &is_compiled);
-	if (is_compiled == GL_FALSE)
-	{
-		GLint max_length = 0;
-		glGetShaderiv(vertex_shader, GL_INFO_LOG_LENGTH, &max_length);
-
-		// The max_length includes the NULL character
-		std::vector<GLchar> infoLog(max_length);
-		glGetShaderInfoLog(vertex_shader, max_length, &max_length, &infoLog[0]);
-
-		// We don't need the shader anymore.
-		glDeleteShader(vertex_shader);
-
-		// Use the infoLog as you see fit.
+	if (check_program(program, vertex_shader, fragment_shader))
+		set_program(program);
+	else
+		m_status = Shader_Status::Failed;
+}
 
-		// In this simple program, we'll just leave
-		std::cout << infoLog.data() << std::endl;
-		std::cout << "VertexShader Compilation failed!" << std::endl;
-		return;
-	}
+void Shader::set_program(GLuint program)
+{
+	if (m_render_ID)
+		glDeleteProgram(m_render_ID);
+	m_render_ID = program;
+	m_program_version++;
+	m_status = Shader_Status::Ready;
+}
 
-	// Create an empty Fragment shader handle
-	fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	// Send the Fragment shader source code to GL
+GLuint Shader::create_stage(GLenum type, const std::string& src)
+{
+	// Create an empty shader handle
+	GLuint shader = glCreateShader(type);
+	// Send the shader source code to GL
 	// Note that std::string's .c_str is NULL character terminated.
-	source = fragment_shader_src.c_str();
-	glShaderSource(fragment_shader, 1, &source, 0);
-	// Compile the Fragment shader
-	glCompileShader(fragment_shader);
+	const GLchar* source = src.c_str();
+	glShaderSource(shader, 1, &source, 0);
+	// Compile the shader, the status is queried later so the driver is free to finish in the background
+	glCompileShader(shader);
+	return shader;
+}
 
-	is_compiled = 0;
-	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &is_compiled);
+GLuint Shader::create_program(GLuint vertex_shader, GLuint fragment_shader)
+{
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+	glLinkProgram(program);
+	return program;
+}
+
+static bool check_stage(GLuint shader, const char* stage_name)
+{
+	GLint is_compiled = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &is_compiled);
 	if (is_compiled == GL_FALSE)
 	{
 		GLint max_length = 0;
-		glGetShaderiv(fragment_shader, GL_INFO_LOG_LENGTH, &max_length);
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_length);
 
 		// The max_length includes the NULL character
-		std::vector<GLchar> infoLog(max_length);
-		glGetShaderInfoLog(fragment_shader, max_length, &max_length, &infoLog[0]);
-
-		// We don't need the shader anymore.
-		glDeleteShader(fragment_shader);
-
-		// Use the infoLog as you see fit.
+		std::vector<GLchar> infoLog(max_length + 1);
+		glGetShaderInfoLog(shader, max_length, &max_length, &infoLog[0]);
 
 		// In this simple program, we'll just leave
 		std::cout << infoLog.data() << std::endl;
-		std::cout << "FragmentShader Compilation failed!" << std::endl;
-		return;
+		std::cout << stage_name << " Compilation failed!" << std::endl;
+		return false;
 	}
+	return true;
+}
 
-	glAttachShader(m_render_ID, vertex_shader);
-	glAttachShader(m_render_ID, fragment_shader);
-	glLinkProgram(m_render_ID);
+bool Shader::check_program(GLuint program, GLuint vertex_shader, GLuint fragment_shader)
+{
+	bool compiled = check_stage(vertex_shader, "VertexShader");
+	compiled = check_stage(fragment_shader, "FragmentShader") && compiled;
 
 	// Note the different functions here: glGetProgram* instead of glGetShader*.
 	GLint isLinked = 0;
-	glGetProgramiv(m_render_ID, GL_LINK_STATUS, (int*)&isLinked);
-	if (isLinked == GL_FALSE)
+	if (compiled)
+		glGetProgramiv(program, GL_LINK_STATUS, (int*)&isLinked);
+	if (compiled && isLinked == GL_FALSE)
 	{
 		GLint maxLength = 0;
-		glGetProgramiv(m_render_ID, GL_INFO_LOG_LENGTH, &maxLength);
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
 
 		// The max_length includes the NULL character
-		std::vector<GLchar> infoLog(maxLength);
-		glGetProgramInfoLog(m_render_ID, maxLength, &maxLength, &infoLog[0]);
-
-		// We don't need the program anymore.
-		glDeleteProgram(m_render_ID);
-		// Don't leak shaders either.
-		glDeleteShader(vertex_shader);
-		glDeleteShader(fragment_shader);
-
-		// Use the infoLog as you see fit.
+		std::vector<GLchar> infoLog(maxLength + 1);
+		glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
 
 		// In this simple program, we'll just leave
 		std::cout << infoLog.data() << std::endl;
 		std::cout << "Shader link failed!" << std::endl;
-
-		return;
 	}
 
-	// Always detach shaders after a successful link.
-	glDetachShader(m_render_ID, vertex_shader);
-	glDetachShader(m_render_ID, fragment_shader);
-
+	// Always detach shaders after link, and don't leak them either.
+	glDetachShader(program, vertex_shader);
+	glDetachShader(program, fragment_shader);
 	glDeleteShader(vertex_shader);
 	glDeleteShader(fragment_shader);
+
+	if (isLinked == GL_FALSE)
+	{
+		// We don't need the program anymore.
+		glDeleteProgram(program);
+		return false;
+	}
+	return true;
+}
+
+GLuint Shader::create_compute_program(const std::string& path, Shader_Features features)
+{
+	std::string src = inject_defines(read_file(path), features);
+	if (src.empty())
+		return 0;
+	GLuint compute_shader = create_stage(GL_COMPUTE_SHADER, src);
+	bool compiled = check_stage(compute_shader, "ComputeShader");
+	GLuint program = 0;
+	if (compiled)
+	{
+		program = glCreateProgram();
+		glAttachShader(program, compute_shader);
+		glLinkProgram(program);
+		GLint is_linked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+		if (is_linked == GL_FALSE)
+		{
+			GLint max_length = 0;
+			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &max_length);
+			std::vector<GLchar> infoLog(max_length + 1);
+			glGetProgramInfoLog(program, max_length, &max_length, &infoLog[0]);
+			std::cout << infoLog.data() << std::endl;
+			std::cout << "Shader link failed! : " << path << std::endl;
+			glDeleteProgram(program);
+			program = 0;
+		}
+		else
+			glDetachShader(program, compute_shader);
+	}
+	glDeleteShader(compute_shader);
+	return program;
 }
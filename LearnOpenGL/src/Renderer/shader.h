@@ -1,32 +1,98 @@
 #pragma once
 #include <glad/glad.h>
 #include <string>
+#include <memory>
 #include <glm/glm.hpp>
 
+enum class Shader_Status
+{
+	Pending = 0, Ready, Failed
+};
+
+//feature flags that select a shader variant, every set bit becomes a #define after #version
+typedef uint32_t Shader_Features;
+enum Shader_Feature : Shader_Features
+{
+	SHADER_FEATURE_NONE				= 0,
+	SHADER_FEATURE_DIFFUSE_MAP		= 1 << 0,
+	SHADER_FEATURE_SPECULAR_MAP		= 1 << 1,
+	SHADER_FEATURE_NORMAL_MAP		= 1 << 2,
+	SHADER_FEATURE_HEIGHT_MAP		= 1 << 3,
+	SHADER_FEATURE_ALPHA_TEST		= 1 << 4,
+	SHADER_FEATURE_FLAT_COLOR		= 1 << 5,
+	SHADER_FEATURE_LINEAR_DEPTH		= 1 << 6,
+	SHADER_FEATURE_RECEIVE_SHADOWS	= 1 << 7,
+	SHADER_FEATURE_TEXTURE_ARRAYS	= 1 << 8,
+	SHADER_FEATURE_INDIRECT_INSTANCES = 1 << 9,
+	SHADER_FEATURE_COUNT			= 10
+};
+
+//"HAS_DIFFUSE_MAP" etc, nullptr for an unknown bit
+const char* shader_feature_define(Shader_Feature feature);
+//parse a define name back into its flag, SHADER_FEATURE_NONE if it is unknown
+Shader_Feature shader_feature_from_define(const std::string& define);
+
 class Shader
 {
 public:
-	Shader(const std::string& VertexShaderPath, const std::string& FragmentShaderPath);
+	//compile and link immediately, blocking until the driver is done
+	Shader(const std::string& VertexShaderPath, const std::string& FragmentShaderPath, Shader_Features features = SHADER_FEATURE_NONE);
+	//create an empty shader whose program is delivered later by Shader_Compiler
+	Shader(const std::string& VertexShaderPath, const std::string& FragmentShaderPath, Shader_Features features, const std::shared_ptr<Shader>& fallback);
 	~Shader();
 
-	//use Program
+	//use Program, or the fallback program while the real one is still compiling
 	void bind() const;
 	void unbind() const;
 
 	//Set Uniform
 	void set_float(const std::string& name, float value);
+	void set_vec2(const std::string& name, const glm::vec2 values);
 	void set_vec3(const std::string& name, const glm::vec3 values);
 	void set_vec4(const std::string& name, const glm::vec4 values);
 	void set_int(const std::string& name, int value);
 	void set_mat4(const std::string& name, const glm::mat4 values);
 
-	GLint ID()const { return m_render_ID; }
+	//program that bind() actually uses
+	GLint ID()const;
+
+	bool is_ready() const { return m_status == Shader_Status::Ready; }
+	Shader_Status get_status() const { return m_status; }
+	void set_fallback(const std::shared_ptr<Shader>& fallback) { m_fallback = fallback; }
 
+	const std::string& get_vertex_path() const { return m_vertex_path; }
+	const std::string& get_fragment_path() const { return m_fragment_path; }
+	Shader_Features get_features() const { return m_features; }
+	//bumped whenever a new program is swapped in, uniform locations cached for an older one are stale
+	uint32_t get_program_version() const { return m_program_version; }
 
+	static std::string read_file(const std::string& FilePath);
+	//insert a #define line for every feature right after the #version directive
+	static std::string inject_defines(const std::string& src, Shader_Features features);
+
+	//helpers shared with Shader_Compiler, they never query status and so never stall
+	static GLuint create_stage(GLenum type, const std::string& src);
+	static GLuint create_program(GLuint vertex_shader, GLuint fragment_shader);
+	//query status and print the info logs, blocks if the driver has not finished yet
+	static bool check_program(GLuint program, GLuint vertex_shader, GLuint fragment_shader);
+	//compile and link a compute shader file (GL 4.3), blocking; 0 and the logs printed on failure
+	static GLuint create_compute_program(const std::string& path, Shader_Features features = SHADER_FEATURE_NONE);
 
 private:
-	std::string read_file(const std::string& FilePath);
+	friend class Shader_Compiler;
+	//swap in a freshly linked program, deleting the one it replaces
+	void set_program(GLuint program);
+
 	void compile(const std::string& VertexShaderSrc, const std::string& FragmentShaderSrc);
 private:
-	GLint m_render_ID;
-};
\ No newline at end of file
+	GLint m_render_ID = 0;
+	Shader_Status m_status = Shader_Status::Pending;
+	std::shared_ptr<Shader> m_fallback;
+	std::string m_vertex_path;
+	std::string m_fragment_path;
+	Shader_Features m_features = SHADER_FEATURE_NONE;
+	//Shader_Compiler's builds of this shader, numbered as they are queued: the last one queued and the one in use
+	uint32_t m_build_sequence = 0;
+	uint32_t m_applied_sequence = 0;
+	uint32_t m_program_version = 0;
+};
@@ -0,0 +1,73 @@
+#include "shadow-cascades.h"
+
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+float shadow_snap_step(const Shadow_Config& config, float radius)
+{
+	float texel = 2.0f * radius / config.resolution;
+	return texel * std::max(config.snap_texels, 1u);
+}
+
+void fit_shadow_cascades(const Shadow_Config& config, const glm::mat4& view, const glm::mat4& projection,
+	const glm::vec3& light_direction, Shadow_Cascade* cascades)
+{
+	//near and far back out of the depth terms of a glm::perspective matrix
+	float near_plane = projection[3][2] / (projection[2][2] - 1.0f);
+	float far_plane = std::min(projection[3][2] / (projection[2][2] + 1.0f), config.shadow_distance);
+
+	//practical split scheme, a blend of logarithmic and linear splits
+	float splits[MAX_SHADOW_CASCADES + 1];
+	splits[0] = near_plane;
+	for (uint32_t i = 1; i <= config.cascade_count; i++)
+	{
+		float t = (float)i / config.cascade_count;
+		float log_split = near_plane * pow(far_plane / near_plane, t);
+		float linear_split = near_plane + (far_plane - near_plane) * t;
+		splits[i] = config.split_lambda * log_split + (1.0f - config.split_lambda) * linear_split;
+	}
+	splits[config.cascade_count] = far_plane;
+
+	//one rotation for every cascade, so snapping happens on the same grid
+	glm::vec3 up = fabs(light_direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 light_rotation = glm::lookAt(glm::vec3(0.0f), light_direction, up);
+
+	for (uint32_t i = 0; i < config.cascade_count; i++)
+	{
+		Shadow_Cascade& cascade = cascades[i];
+		cascade.split_near = splits[i];
+		cascade.split_far = splits[i + 1];
+
+		//bounding sphere of the frustum slice, it does not change when the camera turns
+		glm::mat4 slice_projection = projection;
+		slice_projection[2][2] = -(cascade.split_far + cascade.split_near) / (cascade.split_far - cascade.split_near);
+		slice_projection[3][2] = -2.0f * cascade.split_far * cascade.split_near / (cascade.split_far - cascade.split_near);
+		glm::mat4 inverse_slice = glm::inverse(slice_projection * view);
+		glm::vec3 corners[8];
+		glm::vec3 center(0.0f);
+		for (int c = 0; c < 8; c++)
+		{
+			glm::vec4 corner = inverse_slice * glm::vec4((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f, 1.0f);
+			corners[c] = glm::vec3(corner) / corner.w;
+			center += corners[c] / 8.0f;
+		}
+		float radius = 0.0f;
+		for (int c = 0; c < 8; c++)
+			radius = std::max(radius, glm::length(corners[c] - center));
+		radius = ceil(radius * 16.0f) / 16.0f;
+
+		//pad the sphere so a center snapped to the coarse grid still covers the whole slice
+		float padded_radius = radius / (1.0f - 2.0f * config.snap_texels / config.resolution);
+		float step = shadow_snap_step(config, padded_radius);
+		glm::vec3 light_center = glm::vec3(light_rotation * glm::vec4(center, 1.0f));
+		light_center = glm::floor(light_center / step + 0.5f) * step;
+
+		//whole-texel moves only, which also removes shimmering on camera movement
+		cascade.center = light_center;
+		cascade.radius = padded_radius;
+		cascade.light_view = glm::translate(glm::mat4(1.0f), -light_center) * light_rotation;
+		cascade.light_projection = glm::ortho(-padded_radius, padded_radius, -padded_radius, padded_radius, -(padded_radius + config.caster_margin), padded_radius);
+		cascade.light_view_projection = cascade.light_projection * cascade.light_view;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#define MAX_SHADOW_CASCADES 4
+
+struct Shadow_Config
+{
+	uint32_t cascade_count = 4;
+	uint32_t resolution = 2048;
+	float shadow_distance = 60.0f;		//cascades stop here even if the camera sees further
+	float split_lambda = 0.75f;			//0 = linear splits, 1 = logarithmic splits
+	float caster_margin = 50.0f;		//how far towards the light casters are still captured
+	//cascade centers move in steps of this many texels, so static geometry stays cached while the camera moves
+	uint32_t snap_texels = 64;
+};
+
+struct Shadow_Cascade
+{
+	float split_near = 0.0f;
+	float split_far = 0.0f;
+	glm::mat4 light_view = glm::mat4(1.0f);
+	glm::mat4 light_projection = glm::mat4(1.0f);
+	glm::mat4 light_view_projection = glm::mat4(1.0f);
+	glm::vec3 center = glm::vec3(0.0f);	//snapped, in light space
+	float radius = 0.0f;
+};
+
+//Fits config.cascade_count cascades to a perspective view. Near and far come from the projection,
+//direction is normalized and points from the light into the scene. Pure CPU, no GL, so it can be tested headless.
+void fit_shadow_cascades(const Shadow_Config& config, const glm::mat4& view, const glm::mat4& projection,
+	const glm::vec3& light_direction, Shadow_Cascade* cascades);
+
+//the step cascade centers are snapped to in light space
+float shadow_snap_step(const Shadow_Config& config, float radius);
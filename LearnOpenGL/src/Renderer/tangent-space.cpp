@@ -0,0 +1,154 @@
+#include "tangent-space.h"
+#include "vertex-weld.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+template<typename T>
+static const T& element_at(const T* elements, size_t stride, size_t index)
+{
+	return *(const T*)((const char*)elements + stride * index);
+}
+
+template<typename T>
+static T& element_at(T* elements, size_t stride, size_t index)
+{
+	return *(T*)((char*)elements + stride * index);
+}
+
+//bits of a float with -0 folded into 0, so corners that compare equal also group together
+static uint32_t key_bits(float value)
+{
+	value += 0.0f;
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+//angle between two edges leaving a corner, 0 when one of them is degenerate
+static float corner_angle(const glm::vec3& a, const glm::vec3& b)
+{
+	float lengths_squared = glm::dot(a, a) * glm::dot(b, b);
+	if (lengths_squared <= 0.0f)
+		return 0.0f;
+	return std::acos(glm::clamp(glm::dot(a, b) / std::sqrt(lengths_squared), -1.0f, 1.0f));
+}
+
+//v without its component along the unit normal n
+static glm::vec3 project_to_plane(const glm::vec3& v, const glm::vec3& n)
+{
+	return v - n * glm::dot(n, v);
+}
+
+static glm::vec3 normalize_or_zero(const glm::vec3& v)
+{
+	float length = glm::length(v);
+	return length > 0.0f ? v / length : glm::vec3(0.0f);
+}
+
+void generate_smooth_normals(const glm::vec3* positions, size_t position_stride, glm::vec3* normals, size_t normal_stride,
+	size_t vertex_count, const std::vector<unsigned int>& indices)
+{
+	auto write_key = [&](uint32_t v, uint32_t* key)
+	{
+		const glm::vec3& position = element_at(positions, position_stride, v);
+		for (int c = 0; c < 3; c++)
+			key[c] = key_bits(position[c]);
+	};
+	std::vector<uint32_t> groups;
+	std::vector<glm::vec3> sums(group_equal_keys(3, vertex_count, write_key, groups), glm::vec3(0.0f));
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const glm::vec3 corners[3] = { element_at(positions, position_stride, indices[i]),
+			element_at(positions, position_stride, indices[i + 1]), element_at(positions, position_stride, indices[i + 2]) };
+		glm::vec3 face = normalize_or_zero(glm::cross(corners[1] - corners[0], corners[2] - corners[0]));
+		if (face == glm::vec3(0.0f))
+			continue;
+		for (int c = 0; c < 3; c++)
+		{
+			float angle = corner_angle(corners[(c + 1) % 3] - corners[c], corners[(c + 2) % 3] - corners[c]);
+			sums[groups[indices[i + c]]] += face * angle;
+		}
+	}
+	//vertices no triangle uses end up zero
+	for (size_t v = 0; v < vertex_count; v++)
+		element_at(normals, normal_stride, v) = normalize_or_zero(sums[groups[v]]);
+}
+
+void generate_tangents(const glm::vec3* positions, size_t position_stride, const glm::vec3* normals, const glm::vec2* texcoords,
+	glm::vec3* tangents, glm::vec3* bitangents, size_t attribute_stride, size_t vertex_count, const std::vector<unsigned int>& indices)
+{
+	//corners only share a frame when MikkTSpace would treat them as the same vertex
+	auto write_key = [&](uint32_t v, uint32_t* key)
+	{
+		const glm::vec3& position = element_at(positions, position_stride, v);
+		const glm::vec3& normal = element_at(normals, attribute_stride, v);
+		const glm::vec2& texcoord = element_at(texcoords, attribute_stride, v);
+		for (int c = 0; c < 3; c++)
+		{
+			key[c] = key_bits(position[c]);
+			key[3 + c] = key_bits(normal[c]);
+		}
+		key[6] = key_bits(texcoord.x);
+		key[7] = key_bits(texcoord.y);
+	};
+	std::vector<uint32_t> groups;
+	uint32_t group_count = group_equal_keys(8, vertex_count, write_key, groups);
+	std::vector<glm::vec3> unit_normals(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++)
+		unit_normals[v] = normalize_or_zero(element_at(normals, attribute_stride, v));
+	//per group, [0] for mirrored texture space and [1] for the rest
+	std::vector<std::array<glm::vec3, 2>> sums(group_count, { glm::vec3(0.0f), glm::vec3(0.0f) });
+	std::vector<std::array<float, 2>> weights(group_count, { 0.0f, 0.0f });
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int corner_indices[3] = { indices[i], indices[i + 1], indices[i + 2] };
+		glm::vec3 p[3];
+		glm::vec2 uv[3];
+		for (int c = 0; c < 3; c++)
+		{
+			p[c] = element_at(positions, position_stride, corner_indices[c]);
+			uv[c] = element_at(texcoords, attribute_stride, corner_indices[c]);
+		}
+		glm::vec3 d1 = p[1] - p[0], d2 = p[2] - p[0];
+		glm::vec2 t21 = uv[1] - uv[0], t31 = uv[2] - uv[0];
+		float signed_area = t21.x * t31.y - t21.y * t31.x;
+		//no texture space to follow, the corners take their neighbours' frames
+		if (signed_area == 0.0f)
+			continue;
+		int orientation = signed_area > 0.0f ? 1 : 0;
+		//direction of increasing u, scaled by |signed_area| so mirrored triangles point the same way
+		glm::vec3 direction = (t31.y * d1 - t21.y * d2) * (orientation ? 1.0f : -1.0f);
+
+		for (int c = 0; c < 3; c++)
+		{
+			const glm::vec3& n = unit_normals[corner_indices[c]];
+			glm::vec3 tangent = normalize_or_zero(project_to_plane(direction, n));
+			float angle = corner_angle(project_to_plane(p[(c + 1) % 3] - p[c], n), project_to_plane(p[(c + 2) % 3] - p[c], n));
+			uint32_t group = groups[corner_indices[c]];
+			sums[group][orientation] += tangent * angle;
+			weights[group][orientation] += angle;
+		}
+	}
+
+	for (size_t v = 0; v < vertex_count; v++)
+	{
+		uint32_t group = groups[v];
+		int orientation = weights[group][1] >= weights[group][0] ? 1 : 0;
+		const glm::vec3& n = unit_normals[v];
+		glm::vec3 tangent = normalize_or_zero(project_to_plane(sums[group][orientation], n));
+		//only degenerate texture space around it: any direction in the normal's plane will do
+		if (tangent == glm::vec3(0.0f))
+		{
+			glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			tangent = normalize_or_zero(project_to_plane(axis, n));
+		}
+		element_at(tangents, attribute_stride, v) = tangent;
+		element_at(bitangents, attribute_stride, v) = glm::cross(n, tangent) * (orientation ? 1.0f : -1.0f);
+	}
+}
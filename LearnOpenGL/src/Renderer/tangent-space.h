@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+//Normals and tangent frames computed at import instead of by Assimp's GenSmoothNormals and CalcTangentSpace.
+//GL-free and single threaded per mesh; every sum runs in index order, so the same mesh always gives the same
+//bits and meshes can be generated on any thread in parallel. The strides are byte distances between
+//elements, so the results go straight into interleaved Vertex arrays or the split attribute stream.
+
+//Smooth normals weighted by the angle of each triangle corner. Corners are averaged by position rather
+//than by index, so meshes whose faces do not share vertices still come out smooth.
+void generate_smooth_normals(const glm::vec3* positions, size_t position_stride, glm::vec3* normals, size_t normal_stride,
+	size_t vertex_count, const std::vector<unsigned int>& indices);
+
+//MikkTSpace tangent frames: per corner texture space directions projected into the normal's plane, weighted
+//by corner angle and summed over every corner with the same position, normal and texture coordinate and
+//the same handedness. Bitangents are cross(normal, tangent) times that handedness. A vertex whose corners
+//disagree in handedness keeps the dominant one instead of being split, the index buffer stays as it is.
+void generate_tangents(const glm::vec3* positions, size_t position_stride, const glm::vec3* normals, const glm::vec2* texcoords,
+	glm::vec3* tangents, glm::vec3* bitangents, size_t attribute_stride, size_t vertex_count, const std::vector<unsigned int>& indices);
@@ -0,0 +1,151 @@
+#include "texture-array.h"
+#include "texture-loader.h"
+
+#include <iostream>
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+int32_t Texture_Array_Packer::add(const std::string& path)
+{
+	for (size_t i = 0; i < m_paths.size(); i++)
+		if (m_paths[i] == path)
+			return (int32_t)i;
+	if (m_paths.size() >= MAX_TEXTURE_ARRAY_LAYERS)
+		return -1;
+	m_paths.push_back(path);
+	return (int32_t)m_paths.size() - 1;
+}
+
+Texture_Array Texture_Array_Packer::build(bool mipmaps)
+{
+	Texture_Array array;
+	if (m_paths.empty())
+		return array;
+
+	std::vector<Decoded_Image> images = Image_Decoder::decode_batch(m_paths, false);
+
+	//the size most images already have, ties go to the larger one
+	std::map<std::pair<uint32_t, uint32_t>, uint32_t> size_counts;
+	for (const Decoded_Image& image : images)
+		if (image.pixels)
+			size_counts[{ (uint32_t)image.width, (uint32_t)image.height }]++;
+	uint32_t best_count = 0;
+	for (const auto& size : size_counts)
+	{
+		if (size.second > best_count || (size.second == best_count && size.first.first * size.first.second > array.width * array.height))
+		{
+			array.width = size.first.first;
+			array.height = size.first.second;
+			best_count = size.second;
+		}
+	}
+	if (best_count == 0)
+	{
+		//nothing decoded, a 1x1 white array keeps the layer indices valid
+		array.width = 1;
+		array.height = 1;
+	}
+	array.layers = (uint32_t)images.size();
+
+	uint32_t mip_levels = 1;
+	if (mipmaps)
+		mip_levels = (uint32_t)std::floor(std::log2((double)std::max(array.width, array.height))) + 1;
+
+	glGenTextures(1, &array.id);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+	for (uint32_t level = 0; level < mip_levels; level++)
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(1u, array.width >> level), std::max(1u, array.height >> level), array.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, mip_levels - 1);
+
+	std::vector<unsigned char> rgba;
+	std::vector<unsigned char> resized((size_t)array.width * array.height * 4);
+	for (uint32_t layer = 0; layer < array.layers; layer++)
+	{
+		const Decoded_Image& image = images[layer];
+		const unsigned char* pixels = resized.data();
+		if (!image.pixels)
+		{
+			std::cout << "Failed to load image from : " << image.path << std::endl;
+			std::fill(resized.begin(), resized.end(), (unsigned char)255);
+		}
+		else
+		{
+			uint32_t pixel_count = (uint32_t)image.width * image.height;
+			const unsigned char* source = image.pixels;
+			if (image.channels != 4)
+			{
+				rgba.resize((size_t)pixel_count * 4);
+				expand_to_rgba(image.pixels, pixel_count, image.channels, rgba.data());
+				source = rgba.data();
+			}
+			if ((uint32_t)image.width == array.width && (uint32_t)image.height == array.height)
+				pixels = source;
+			else
+			{
+				resize_rgba(source, image.width, image.height, resized.data(), array.width, array.height);
+				array.resized_layers++;
+			}
+		}
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, array.width, array.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	Image_Decoder::free_images(images);
+
+	if (mipmaps)
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return array;
+}
+
+void Texture_Array_Packer::expand_to_rgba(const unsigned char* source, uint32_t pixel_count, int channels, unsigned char* destination)
+{
+	for (uint32_t i = 0; i < pixel_count; i++)
+	{
+		const unsigned char* in = source + (size_t)i * channels;
+		unsigned char* out = destination + (size_t)i * 4;
+		switch (channels)
+		{
+		case 1: out[0] = out[1] = out[2] = in[0]; out[3] = 255; break;
+		case 2: out[0] = out[1] = out[2] = in[0]; out[3] = in[1]; break;		//grey + alpha
+		case 3: out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = 255; break;
+		default: out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = in[3]; break;
+		}
+	}
+}
+
+void Texture_Array_Packer::resize_rgba(const unsigned char* source, uint32_t source_width, uint32_t source_height, unsigned char* destination, uint32_t width, uint32_t height)
+{
+	//sample at texel centers so both up and down scaling stay aligned
+	float scale_x = (float)source_width / width;
+	float scale_y = (float)source_height / height;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		float source_y = std::max(0.0f, (y + 0.5f) * scale_y - 0.5f);
+		uint32_t y0 = std::min((uint32_t)source_y, source_height - 1);
+		uint32_t y1 = std::min(y0 + 1, source_height - 1);
+		float fy = source_y - y0;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			float source_x = std::max(0.0f, (x + 0.5f) * scale_x - 0.5f);
+			uint32_t x0 = std::min((uint32_t)source_x, source_width - 1);
+			uint32_t x1 = std::min(x0 + 1, source_width - 1);
+			float fx = source_x - x0;
+			const unsigned char* p00 = source + ((size_t)y0 * source_width + x0) * 4;
+			const unsigned char* p10 = source + ((size_t)y0 * source_width + x1) * 4;
+			const unsigned char* p01 = source + ((size_t)y1 * source_width + x0) * 4;
+			const unsigned char* p11 = source + ((size_t)y1 * source_width + x1) * 4;
+			unsigned char* out = destination + ((size_t)y * width + x) * 4;
+			for (int c = 0; c < 4; c++)
+			{
+				float top = p00[c] + (p10[c] - p00[c]) * fx;
+				float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+				out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+			}
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//minimum GL_MAX_ARRAY_TEXTURE_LAYERS every GL 3.3 driver supports, layer indices also fit in a byte
+#define MAX_TEXTURE_ARRAY_LAYERS 256
+
+struct Texture_Array
+{
+	GLuint id = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t layers = 0;
+	uint32_t resized_layers = 0;	//images that did not match the array size and were rescaled
+};
+
+//Packs images into the layers of one RGBA8 GL_TEXTURE_2D_ARRAY so meshes using different images can
+//share a bind. The array takes the most common image size, other images are rescaled to it and
+//1-3 channel images are expanded to RGBA the way stb_image would have.
+class Texture_Array_Packer
+{
+public:
+	//layer the image will occupy, the same path always maps to the same layer. -1 when the array is full
+	int32_t add(const std::string& path);
+	//reads, decodes, rescales and uploads every added image; needs the GL context
+	Texture_Array build(bool mipmaps = true);
+
+	uint32_t get_layer_count() const { return (uint32_t)m_paths.size(); }
+	bool empty() const { return m_paths.empty(); }
+
+	//bilinear rescale of RGBA8 pixels
+	static void resize_rgba(const unsigned char* source, uint32_t source_width, uint32_t source_height, unsigned char* destination, uint32_t width, uint32_t height);
+	static void expand_to_rgba(const unsigned char* source, uint32_t pixel_count, int channels, unsigned char* destination);
+
+private:
+	std::vector<std::string> m_paths;
+};
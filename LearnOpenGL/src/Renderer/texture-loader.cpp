@@ -0,0 +1,109 @@
+#include "texture-loader.h"
+
+#include <iostream>
+
+GLuint Texture_Loader::add(const std::string& path, const Texture_Load_Options& options)
+{
+	Pending_Texture pending;
+	pending.options = options;
+	glGenTextures(1, &pending.texture);
+	m_paths.push_back(path);
+	m_pending.push_back(pending);
+	return pending.texture;
+}
+
+void Texture_Loader::load_all()
+{
+	if (m_pending.empty())
+		return;
+
+	//flipping is per batch, split the textures that want it from the rest
+	for (int flip = 0; flip < 2; flip++)
+	{
+		std::vector<std::string> paths;
+		std::vector<size_t> indices;
+		for (size_t i = 0; i < m_pending.size(); i++)
+		{
+			if (m_pending[i].options.flip_vertically == (flip == 1))
+			{
+				paths.push_back(m_paths[i]);
+				indices.push_back(i);
+			}
+		}
+		if (paths.empty())
+			continue;
+
+		std::vector<Decoded_Image> images = Image_Decoder::decode_batch(paths, flip == 1);
+		for (size_t i = 0; i < images.size(); i++)
+			upload(m_pending[indices[i]], images[i]);
+		Image_Decoder::free_images(images);
+	}
+	m_paths.clear();
+	m_pending.clear();
+}
+
+GLuint Texture_Loader::load(const std::string& path, const Texture_Load_Options& options)
+{
+	Texture_Loader loader;
+	GLuint texture = loader.add(path, options);
+	loader.load_all();
+	return texture;
+}
+
+uint64_t Texture_Loader::get_gpu_bytes(GLuint texture, GLenum target)
+{
+	if (texture == 0)
+		return 0;
+	glBindTexture(target, texture);
+	//cube maps are queried through one face
+	GLenum level_target = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+	GLint bits = 0;
+	const GLenum size_queries[] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE };
+	for (GLenum query : size_queries)
+	{
+		GLint size = 0;
+		glGetTexLevelParameteriv(level_target, 0, query, &size);
+		bits += size;
+	}
+
+	uint64_t bytes = 0;
+	for (GLint level = 0; level < 16; level++)
+	{
+		GLint width = 0, height = 0, depth = 0;
+		glGetTexLevelParameteriv(level_target, level, GL_TEXTURE_WIDTH, &width);
+		if (width == 0)
+			break;
+		glGetTexLevelParameteriv(level_target, level, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(level_target, level, GL_TEXTURE_DEPTH, &depth);
+		bytes += (uint64_t)width * height * depth * bits / 8;
+	}
+	glBindTexture(target, 0);
+	return target == GL_TEXTURE_CUBE_MAP ? bytes * 6 : bytes;
+}
+
+void Texture_Loader::upload(const Pending_Texture& pending, const Decoded_Image& image)
+{
+	glBindTexture(GL_TEXTURE_2D, pending.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, pending.options.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, pending.options.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, pending.options.min_filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pending.options.mag_filter);
+
+	if (!image.pixels)
+	{
+		std::cout << "Failed to load image from : " << image.path << std::endl;
+		return;
+	}
+
+	GLenum format = GL_RGBA;
+	if (image.channels == 1) format = GL_RED;
+	else if (image.channels == 2) format = GL_RG;
+	else if (image.channels == 3) format = GL_RGB;
+
+	//rows of 1 and 3 channel images are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (pending.options.mipmaps)
+		glGenerateMipmap(GL_TEXTURE_2D);
+}
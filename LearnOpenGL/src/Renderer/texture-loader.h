@@ -0,0 +1,45 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image-decoder.h"
+
+struct Texture_Load_Options
+{
+	bool flip_vertically = false;
+	bool mipmaps = true;
+	GLint wrap = GL_REPEAT;
+	GLint min_filter = GL_LINEAR_MIPMAP_LINEAR;
+	GLint mag_filter = GL_LINEAR;
+};
+
+//Loads a set of textures with the disk reads, the image decodes and the uploads overlapped:
+//Image_Decoder reads and decodes the whole batch on the job system and the GL upload happens on the
+//calling thread once everything is decoded.
+class Texture_Loader
+{
+public:
+	//creates the texture object right away so it can be handed out, the image arrives in load_all()
+	GLuint add(const std::string& path, const Texture_Load_Options& options = Texture_Load_Options());
+	//needs the GL context current
+	void load_all();
+
+	//single texture, same path as add() + load_all()
+	static GLuint load(const std::string& path, const Texture_Load_Options& options = Texture_Load_Options());
+	//bytes of every mip level the driver allocated, from the level sizes and component bits it reports; unbinds target
+	static uint64_t get_gpu_bytes(GLuint texture, GLenum target = GL_TEXTURE_2D);
+
+private:
+	struct Pending_Texture
+	{
+		Texture_Load_Options options;
+		GLuint texture = 0;
+	};
+
+	static void upload(const Pending_Texture& pending, const Decoded_Image& image);
+
+	std::vector<std::string> m_paths;
+	std::vector<Pending_Texture> m_pending;
+};
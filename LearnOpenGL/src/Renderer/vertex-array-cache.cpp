@@ -0,0 +1,193 @@
+#include "vertex-array-cache.h"
+#include "vertex-array.h"
+
+#include <GLFW/glfw3.h>
+#include <array>
+#include <map>
+#include <unordered_map>
+#include <iostream>
+
+static bool s_attrib_binding = false;
+//attrib binding path: one VAO per combination of stream layouts, unused streams hash to 0
+typedef std::array<uint64_t, MAX_VERTEX_STREAMS> Layout_Key;
+static std::map<Layout_Key, GLuint> s_shared;
+//fallback path: one VAO per vertex and index buffer pair
+static std::unordered_map<uint64_t, std::shared_ptr<Vertex_Array>> s_baked;
+//fallback path of acquire(), owned by whoever released them
+static uint32_t s_acquired_count = 0;
+//VAOs remember their element buffer, so after switching VAO it is unknown
+static const GLuint UNKNOWN_BUFFER = 0xFFFFFFFF;
+
+void Vertex_Array_Cache::init()
+{
+	s_attrib_binding = GLAD_GL_VERSION_4_3 != 0;
+	if (!s_attrib_binding && glfwExtensionSupported("GL_ARB_vertex_attrib_binding"))
+	{
+		//the extension uses the core names, but our glad only loads them for 4.3 contexts
+		glad_glBindVertexBuffer = (PFNGLBINDVERTEXBUFFERPROC)glfwGetProcAddress("glBindVertexBuffer");
+		glad_glVertexAttribFormat = (PFNGLVERTEXATTRIBFORMATPROC)glfwGetProcAddress("glVertexAttribFormat");
+		glad_glVertexAttribIFormat = (PFNGLVERTEXATTRIBIFORMATPROC)glfwGetProcAddress("glVertexAttribIFormat");
+		glad_glVertexAttribBinding = (PFNGLVERTEXATTRIBBINDINGPROC)glfwGetProcAddress("glVertexAttribBinding");
+		s_attrib_binding = glad_glBindVertexBuffer && glad_glVertexAttribFormat && glad_glVertexAttribIFormat && glad_glVertexAttribBinding;
+	}
+}
+
+void Vertex_Array_Cache::shutdown()
+{
+	for (auto& shared : s_shared)
+		glDeleteVertexArrays(1, &shared.second);
+	s_shared.clear();
+	s_baked.clear();
+}
+
+bool Vertex_Array_Cache::has_attrib_binding()
+{
+	return s_attrib_binding;
+}
+
+uint32_t Vertex_Array_Cache::get_vertex_array_count()
+{
+	return (uint32_t)(s_shared.size() + s_baked.size()) + s_acquired_count;
+}
+
+GLuint Vertex_Array_Cache::create_shared(const Vertex_Layout_View* layouts, uint32_t stream_count)
+{
+	GLuint vertex_array;
+	glGenVertexArrays(1, &vertex_array);
+	glBindVertexArray(vertex_array);
+
+	uint32_t index = 0;
+	for (uint32_t s = 0; s < stream_count; s++)
+	{
+		const Vertex_Layout_View& layout = layouts[s];
+		for (uint32_t a = 0; a < layout.count; a++)
+		{
+			const Vertex_Attribute& attribute = layout.attributes[a];
+			//matrices take one attribute per column
+			uint32_t columns = 1, count = shader_data_type_count(attribute.type);
+			if (attribute.type == Shader_Data_Type::Mat3) { columns = 3; count = 3; }
+			if (attribute.type == Shader_Data_Type::Mat4) { columns = 4; count = 4; }
+			GLenum type = shader_data_type_to_OpenGL_type(attribute.type);
+			for (uint32_t column = 0; column < columns; column++)
+			{
+				glEnableVertexAttribArray(index);
+				if (attribute.integer)
+					glVertexAttribIFormat(index, count, type, attribute.offset + column * count * 4);
+				else
+					glVertexAttribFormat(index, count, type, attribute.normalized ? GL_TRUE : GL_FALSE, attribute.offset + column * count * 4);
+				glVertexAttribBinding(index, s);
+				index++;
+			}
+		}
+	}
+	glBindVertexArray(0);
+	return vertex_array;
+}
+
+Vertex_Binding Vertex_Array_Cache::get(const std::shared_ptr<Vertex_Buffer>& vertex_buffer, const std::shared_ptr<Index_Buffer>& index_buffer)
+{
+	Vertex_Layout_View layout = vertex_buffer->get_layout_view();
+	if (s_attrib_binding)
+	{
+		GLuint buffer = vertex_buffer->get_render_ID();
+		return acquire(&layout, &buffer, 1, index_buffer ? index_buffer->get_render_ID() : 0);
+	}
+
+	uint64_t key = ((uint64_t)vertex_buffer->get_render_ID() << 32) | (index_buffer ? index_buffer->get_render_ID() : 0);
+	auto it = s_baked.find(key);
+	if (it == s_baked.end())
+	{
+		std::shared_ptr<Vertex_Array> vertex_array = std::make_shared<Vertex_Array>();
+		vertex_array->add_vertex_buffer(vertex_buffer);
+		if (index_buffer)
+			vertex_array->set_index_buffer(index_buffer);
+		glBindVertexArray(0);
+		it = s_baked.emplace(key, vertex_array).first;
+	}
+	Vertex_Binding binding;
+	binding.vertex_array = it->second->get_render_ID();
+	return binding;
+}
+
+Vertex_Binding Vertex_Array_Cache::acquire(const Vertex_Layout_View* layouts, const GLuint* vertex_buffers, uint32_t stream_count, GLuint index_buffer)
+{
+	Vertex_Binding binding;
+	if (stream_count == 0 || stream_count > MAX_VERTEX_STREAMS)
+	{
+		std::cout << "Vertex_Array_Cache: " << stream_count << " vertex streams, at most " << MAX_VERTEX_STREAMS << " are supported" << std::endl;
+		return binding;
+	}
+	if (s_attrib_binding)
+	{
+		Layout_Key key = {};
+		for (uint32_t s = 0; s < stream_count; s++)
+			key[s] = layouts[s].hash;
+		auto it = s_shared.find(key);
+		if (it == s_shared.end())
+			it = s_shared.emplace(key, create_shared(layouts, stream_count)).first;
+		binding.vertex_array = it->second;
+		for (uint32_t s = 0; s < stream_count; s++)
+		{
+			binding.vertex_buffers[s] = vertex_buffers[s];
+			binding.strides[s] = layouts[s].stride;
+		}
+		binding.index_buffer = index_buffer;
+		return binding;
+	}
+
+	glGenVertexArrays(1, &binding.vertex_array);
+	glBindVertexArray(binding.vertex_array);
+	uint32_t location = 0;
+	for (uint32_t s = 0; s < stream_count; s++)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[s]);
+		apply_vertex_layout(layouts[s], location);
+		for (uint32_t a = 0; a < layouts[s].count; a++)
+		{
+			Shader_Data_Type type = layouts[s].attributes[a].type;
+			location += type == Shader_Data_Type::Mat4 ? 4 : type == Shader_Data_Type::Mat3 ? 3 : 1;
+		}
+	}
+	if (index_buffer)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	s_acquired_count++;
+	return binding;
+}
+
+void Vertex_Array_Cache::release(Vertex_Binding& binding)
+{
+	//baked ones are the only ones without buffers to attach
+	if (binding.vertex_array && !binding.vertex_buffers[0])
+	{
+		glDeleteVertexArrays(1, &binding.vertex_array);
+		s_acquired_count--;
+	}
+	binding = Vertex_Binding();
+}
+
+void Vertex_Array_Cache::bind(const Vertex_Binding& binding, Vertex_Binding& bound)
+{
+	if (binding.vertex_array != bound.vertex_array)
+	{
+		glBindVertexArray(binding.vertex_array);
+		bound.vertex_array = binding.vertex_array;
+		for (uint32_t s = 0; s < MAX_VERTEX_STREAMS; s++)
+			bound.vertex_buffers[s] = UNKNOWN_BUFFER;
+		bound.index_buffer = UNKNOWN_BUFFER;
+	}
+	for (uint32_t s = 0; s < MAX_VERTEX_STREAMS && binding.vertex_buffers[s]; s++)
+	{
+		if (binding.vertex_buffers[s] == bound.vertex_buffers[s] && binding.strides[s] == bound.strides[s])
+			continue;
+		glBindVertexBuffer(s, binding.vertex_buffers[s], 0, binding.strides[s]);
+		bound.vertex_buffers[s] = binding.vertex_buffers[s];
+		bound.strides[s] = binding.strides[s];
+	}
+	if (binding.index_buffer && binding.index_buffer != bound.index_buffer)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, binding.index_buffer);
+		bound.index_buffer = binding.index_buffer;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <memory>
+
+#include "buffer.h"
+
+//vertex buffers one draw reads at once, e.g. positions, the other attributes and per vertex material layers
+#define MAX_VERTEX_STREAMS 3
+
+//Everything a draw binds for its geometry. With vertex attrib binding, vertex_array is shared by every
+//geometry of the same layouts and the buffers are attached per draw, stream s to binding s; otherwise the
+//buffers are baked into vertex_array and vertex_buffers/index_buffer stay 0.
+struct Vertex_Binding
+{
+	GLuint vertex_array = 0;
+	GLuint vertex_buffers[MAX_VERTEX_STREAMS] = {};
+	uint32_t strides[MAX_VERTEX_STREAMS] = {};
+	GLuint index_buffer = 0;
+};
+
+//Vertex arrays keyed by the layout hashes of their streams. Where ARB_vertex_attrib_binding (core in 4.3)
+//is available the attribute formats live in one VAO per layout combination, so any number of meshes share
+//a handful of them and switching geometry is a glBindVertexBuffer per stream; without it every geometry
+//gets its own vertex array as before. Render thread only.
+class Vertex_Array_Cache
+{
+public:
+	//after the GL loader, with the context current
+	static void init();
+	static void shutdown();
+
+	static Vertex_Binding get(const std::shared_ptr<Vertex_Buffer>& vertex_buffer, const std::shared_ptr<Index_Buffer>& index_buffer = nullptr);
+	//raw buffers with the attribute locations of stream s following those of stream s - 1, for meshes.
+	//pair with release() once the buffers are deleted
+	static Vertex_Binding acquire(const Vertex_Layout_View* layouts, const GLuint* vertex_buffers, uint32_t stream_count, GLuint index_buffer);
+	//deletes the vertex array an acquire() without attrib binding baked, shared ones stay; resets binding
+	static void release(Vertex_Binding& binding);
+	//binds what differs from bound and updates it, start a frame with a default Vertex_Binding
+	static void bind(const Vertex_Binding& binding, Vertex_Binding& bound);
+
+	static bool has_attrib_binding();
+	static uint32_t get_vertex_array_count();
+
+private:
+	static GLuint create_shared(const Vertex_Layout_View* layouts, uint32_t stream_count);
+};
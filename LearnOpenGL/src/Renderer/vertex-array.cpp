@@ -2,7 +2,7 @@
 
 #include <glad/glad.h>
 
-static GLenum shader_data_type_to_OpenGL_type(Shader_Data_Type type)
+uint32_t shader_data_type_to_OpenGL_type(Shader_Data_Type type)
 {
 	switch (type)
 	{
@@ -17,12 +17,36 @@ static GLenum shader_data_type_to_OpenGL_type(Shader_Data_Type type)
 	case Shader_Data_Type::Int3:		return GL_INT;
 	case Shader_Data_Type::Int4:		return GL_INT;
 	case Shader_Data_Type::Bool:		return GL_BOOL;
+	case Shader_Data_Type::UByte4:		return GL_UNSIGNED_BYTE;
 	}
 
 	std::cout << "Unknown ShaderDataType!" <<std::endl;
 	return 0;
 }
 
+void apply_vertex_layout(const Vertex_Layout_View& layout, uint32_t first_location)
+{
+	uint32_t index = first_location;
+	for (uint32_t a = 0; a < layout.count; a++)
+	{
+		const Vertex_Attribute& attribute = layout.attributes[a];
+		uint32_t columns = 1, count = shader_data_type_count(attribute.type);
+		if (attribute.type == Shader_Data_Type::Mat3) { columns = 3; count = 3; }
+		if (attribute.type == Shader_Data_Type::Mat4) { columns = 4; count = 4; }
+		GLenum type = shader_data_type_to_OpenGL_type(attribute.type);
+		for (uint32_t column = 0; column < columns; column++)
+		{
+			const void* offset = (const void*)(uintptr_t)(attribute.offset + column * count * 4);
+			glEnableVertexAttribArray(index);
+			if (attribute.integer)
+				glVertexAttribIPointer(index, count, type, layout.stride, offset);
+			else
+				glVertexAttribPointer(index, count, type, attribute.normalized ? GL_TRUE : GL_FALSE, layout.stride, offset);
+			index++;
+		}
+	}
+}
+
 Vertex_Array::Vertex_Array()
 {
 	glGenVertexArrays(1, &m_render_ID);
@@ -48,20 +72,7 @@ void Vertex_Array::add_vertex_buffer(const std::shared_ptr<Vertex_Buffer>& verte
 	glBindVertexArray(m_render_ID);
 	vertex_buffer->bind();
 
-	//set vertex attribute
-	uint32_t index = 0;
-	const auto& layout = vertex_buffer->get_layout();
-	for (const auto& element : layout)
-	{
-		glEnableVertexAttribArray(index);
-		glVertexAttribPointer(index,
-			element.get_value_count(),
-			shader_data_type_to_OpenGL_type(element.type),
-			element.normalized ? GL_TRUE : GL_FALSE,
-			layout.get_stride(),
-			(const void*)element.offset);
-		index++;
-	}
+	apply_vertex_layout(vertex_buffer->get_layout_view());
 	m_vertex_buffers.push_back(vertex_buffer);
 }
 
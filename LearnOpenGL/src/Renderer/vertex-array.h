@@ -3,6 +3,12 @@
 #include <vector>
 #include "buffer.h"
 
+//GL component type of an attribute, GL_FLOAT for the matrix types
+uint32_t shader_data_type_to_OpenGL_type(Shader_Data_Type type);
+//glVertexAttrib(I)Pointer for every attribute of the layout on the bound VAO and array buffer,
+//matrices take one location per column
+void apply_vertex_layout(const Vertex_Layout_View& layout, uint32_t first_location = 0);
+
 class Vertex_Array
 {
 public:
@@ -17,6 +23,7 @@ public:
 
 	const std::vector<std::shared_ptr<Vertex_Buffer>>& get_vertex_buffers() const { return m_vertex_buffers; }
 	const std::shared_ptr<Index_Buffer>& get_index_buffer() const { return m_index_buffer; }
+	uint32_t get_render_ID() const { return m_render_ID; }
 private:
 	std::vector<std::shared_ptr<Vertex_Buffer>> m_vertex_buffers;
 	std::shared_ptr<Index_Buffer> m_index_buffer;
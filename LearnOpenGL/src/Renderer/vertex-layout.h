@@ -0,0 +1,177 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <glm/glm.hpp>
+#include <glm/ext/vector_uint4_sized.hpp>
+
+enum class Shader_Data_Type
+{
+	None = 0, Float, Float2, Float3, Float4, Int, Int2, Int3, Int4, Bool, Mat3, Mat4, UByte4
+};
+
+constexpr uint32_t shader_data_type_size(Shader_Data_Type type)
+{
+	switch (type)
+	{
+	case Shader_Data_Type::Float:		return 4;
+	case Shader_Data_Type::Float2:		return 4 * 2;
+	case Shader_Data_Type::Float3:		return 4 * 3;
+	case Shader_Data_Type::Float4:		return 4 * 4;
+	case Shader_Data_Type::Mat3:		return 4 * 3 * 3;
+	case Shader_Data_Type::Mat4:		return 4 * 4 * 4;
+	case Shader_Data_Type::Int:			return 4;
+	case Shader_Data_Type::Int2:		return 4 * 2;
+	case Shader_Data_Type::Int3:		return 4 * 3;
+	case Shader_Data_Type::Int4:		return 4 * 4;
+	case Shader_Data_Type::Bool:		return 1;
+	case Shader_Data_Type::UByte4:		return 4;
+	default:							return 0;
+	}
+}
+
+//how many values does this type have
+constexpr uint32_t shader_data_type_count(Shader_Data_Type type)
+{
+	switch (type)
+	{
+	case Shader_Data_Type::Float:		return 1;
+	case Shader_Data_Type::Float2:		return 2;
+	case Shader_Data_Type::Float3:		return 3;
+	case Shader_Data_Type::Float4:		return 4;
+	case Shader_Data_Type::Mat3:		return 3 * 3;
+	case Shader_Data_Type::Mat4:		return 4 * 4;
+	case Shader_Data_Type::Int:			return 1;
+	case Shader_Data_Type::Int2:		return 2;
+	case Shader_Data_Type::Int3:		return 3;
+	case Shader_Data_Type::Int4:		return 4;
+	case Shader_Data_Type::Bool:		return 1;
+	case Shader_Data_Type::UByte4:		return 4;
+	default:							return 0;
+	}
+}
+
+//One attribute of a vertex, a plain value so whole layouts can be constexpr arrays.
+struct Vertex_Attribute
+{
+	Shader_Data_Type type = Shader_Data_Type::None;
+	uint32_t offset = 0;
+	uint32_t alignment = 1;
+	bool integer = false;			//ivec in the shader (glVertexAttribIPointer) instead of converted to float
+	bool normalized = false;
+};
+
+//What the GL setup code consumes: the attributes, the stride and a hash identifying the format.
+//Filled at compile time by vertex_layout_of<V>() or at runtime by Buffer_Layout.
+struct Vertex_Layout_View
+{
+	const Vertex_Attribute* attributes = nullptr;
+	uint32_t count = 0;
+	uint32_t stride = 0;
+	uint64_t hash = 0;
+};
+
+//FNV-1a over type, integer/normalized flags and offset of every attribute, then the stride
+constexpr uint64_t hash_vertex_attributes(const Vertex_Attribute* attributes, uint32_t count, uint32_t stride)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t a = 0; a <= count; a++)
+	{
+		uint32_t words[2] = { stride, 0 };
+		if (a < count)
+		{
+			words[0] = (uint32_t)attributes[a].type | (attributes[a].integer ? 0x100u : 0u) | (attributes[a].normalized ? 0x200u : 0u);
+			words[1] = attributes[a].offset;
+		}
+		for (uint32_t w = 0; w < (a < count ? 2u : 1u); w++)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				hash ^= (words[w] >> (i * 8)) & 0xFF;
+				hash *= 1099511628211ull;
+			}
+		}
+	}
+	return hash;
+}
+
+//Maps the C++ type of a vertex member to its attribute type. Types without a specialization do not compile.
+template<typename T> struct Vertex_Attribute_Type;
+#define VERTEX_ATTRIBUTE_TYPE(cpp_type, data_type, is_integer) \
+	template<> struct Vertex_Attribute_Type<cpp_type> { static constexpr Shader_Data_Type type = data_type; static constexpr bool integer = is_integer; }
+VERTEX_ATTRIBUTE_TYPE(float, Shader_Data_Type::Float, false);
+VERTEX_ATTRIBUTE_TYPE(glm::vec2, Shader_Data_Type::Float2, false);
+VERTEX_ATTRIBUTE_TYPE(glm::vec3, Shader_Data_Type::Float3, false);
+VERTEX_ATTRIBUTE_TYPE(glm::vec4, Shader_Data_Type::Float4, false);
+VERTEX_ATTRIBUTE_TYPE(float[4], Shader_Data_Type::Float4, false);
+VERTEX_ATTRIBUTE_TYPE(glm::mat3, Shader_Data_Type::Mat3, false);
+VERTEX_ATTRIBUTE_TYPE(glm::mat4, Shader_Data_Type::Mat4, false);
+VERTEX_ATTRIBUTE_TYPE(int, Shader_Data_Type::Int, true);
+VERTEX_ATTRIBUTE_TYPE(glm::ivec2, Shader_Data_Type::Int2, true);
+VERTEX_ATTRIBUTE_TYPE(glm::ivec3, Shader_Data_Type::Int3, true);
+VERTEX_ATTRIBUTE_TYPE(glm::ivec4, Shader_Data_Type::Int4, true);
+VERTEX_ATTRIBUTE_TYPE(int[4], Shader_Data_Type::Int4, true);
+VERTEX_ATTRIBUTE_TYPE(glm::u8vec4, Shader_Data_Type::UByte4, true);
+#undef VERTEX_ATTRIBUTE_TYPE
+
+template<typename T>
+constexpr Vertex_Attribute make_vertex_attribute(size_t offset, bool normalized = false)
+{
+	static_assert(sizeof(T) == shader_data_type_size(Vertex_Attribute_Type<T>::type), "vertex member size does not match its attribute type");
+	Vertex_Attribute attribute;
+	attribute.type = Vertex_Attribute_Type<T>::type;
+	attribute.offset = (uint32_t)offset;
+	attribute.alignment = (uint32_t)alignof(T);
+	attribute.integer = Vertex_Attribute_Type<T>::integer;
+	attribute.normalized = normalized;
+	return attribute;
+}
+
+#define VERTEX_ATTRIBUTE(vertex, member) make_vertex_attribute<decltype(vertex::member)>(offsetof(vertex, member))
+#define VERTEX_ATTRIBUTE_NORMALIZED(vertex, member) make_vertex_attribute<decltype(vertex::member)>(offsetof(vertex, member), true)
+
+//Specialized next to each vertex struct, attributes in shader location order:
+//	template<> struct Vertex_Format<My_Vertex>
+//	{
+//		static constexpr Vertex_Attribute attributes[] = { VERTEX_ATTRIBUTE(My_Vertex, position), ... };
+//	};
+template<typename V> struct Vertex_Format;
+
+//every attribute aligned, in offset order, without overlaps or gaps, and the last one ending where the
+//struct does (up to its trailing padding), so a member missing from the format is a compile error
+template<typename V>
+constexpr bool vertex_format_matches_struct()
+{
+	constexpr uint32_t count = sizeof(Vertex_Format<V>::attributes) / sizeof(Vertex_Attribute);
+	uint32_t end = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Vertex_Attribute& attribute = Vertex_Format<V>::attributes[i];
+		if (attribute.offset % attribute.alignment != 0 || attribute.offset != end)
+			return false;
+		end = attribute.offset + shader_data_type_size(attribute.type);
+	}
+	return end <= sizeof(V) && sizeof(V) - end < alignof(V);
+}
+
+template<typename V>
+constexpr Vertex_Layout_View vertex_layout_of()
+{
+	static_assert(std::is_standard_layout<V>::value, "vertex structs need a standard layout for offsetof");
+	static_assert(vertex_format_matches_struct<V>(), "Vertex_Format does not describe the vertex struct member by member");
+	constexpr uint32_t count = sizeof(Vertex_Format<V>::attributes) / sizeof(Vertex_Attribute);
+	Vertex_Layout_View view;
+	view.attributes = Vertex_Format<V>::attributes;
+	view.count = count;
+	view.stride = (uint32_t)sizeof(V);
+	view.hash = hash_vertex_attributes(Vertex_Format<V>::attributes, count, (uint32_t)sizeof(V));
+	return view;
+}
+
+//the first count attributes of a layout at its full stride, e.g. only the positions of interleaved vertices
+constexpr Vertex_Layout_View vertex_layout_prefix(Vertex_Layout_View layout, uint32_t count)
+{
+	layout.count = count < layout.count ? count : layout.count;
+	layout.hash = hash_vertex_attributes(layout.attributes, layout.count, layout.stride);
+	return layout;
+}
@@ -0,0 +1,83 @@
+#include "vertex-weld.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+//two key words per float: its step on a grid of 1 / inverse_epsilon as a 64 bit integer, or with inverse_epsilon 0,
+//a step past 2^62 or inf and nan, its bits (-0 folded into 0) under a high word no step has
+static const uint32_t s_words_per_float = 2;
+static void quantize(float value, double inverse_epsilon, uint32_t* key)
+{
+	if (inverse_epsilon > 0.0)
+	{
+		double step = std::floor(value * inverse_epsilon + 0.5);
+		if (std::abs(step) < 4611686018427387904.0)
+		{
+			uint64_t bits = (uint64_t)(int64_t)step;
+			key[0] = (uint32_t)bits;
+			key[1] = (uint32_t)(bits >> 32);
+			return;
+		}
+	}
+	value += 0.0f;
+	memcpy(&key[0], &value, sizeof(value));
+	key[1] = 0x80000000u;
+}
+
+uint32_t build_weld_remap(const Weld_Stream* streams, uint32_t stream_count, size_t vertex_count, float epsilon, std::vector<uint32_t>& remap)
+{
+	//the attributes of every stream in layout order, flattened once instead of walked per vertex
+	struct Key_Field
+	{
+		const char* data;
+		size_t stride;
+		uint32_t components;			//floats, or whole key words for integers
+		uint32_t bytes;
+		bool quantized;
+	};
+	std::vector<Key_Field> fields;
+	size_t key_words = 0;
+	for (uint32_t s = 0; s < stream_count; s++)
+	{
+		const Vertex_Layout_View& layout = streams[s].layout;
+		for (uint32_t a = 0; a < layout.count; a++)
+		{
+			//integers are compared as raw bytes, padded to whole words (UByte4 and Bool are smaller than their count of words)
+			const Vertex_Attribute& attribute = layout.attributes[a];
+			uint32_t bytes = shader_data_type_size(attribute.type);
+			Key_Field field = { (const char*)streams[s].data + attribute.offset, layout.stride,
+				attribute.integer ? (bytes + 3) / 4 : shader_data_type_count(attribute.type), bytes, !attribute.integer };
+			key_words += field.quantized ? field.components * s_words_per_float : field.components;
+			fields.push_back(field);
+		}
+	}
+
+	double inverse_epsilon = epsilon > 0.0f ? 1.0 / epsilon : 0.0;
+	auto write_key = [&](uint32_t v, uint32_t* key)
+	{
+		for (const Key_Field& field : fields)
+		{
+			const char* value = field.data + v * field.stride;
+			if (field.quantized)
+			{
+				for (uint32_t c = 0; c < field.components; c++)
+					quantize(((const float*)value)[c], inverse_epsilon, key + c * s_words_per_float);
+				key += field.components * s_words_per_float;
+			}
+			else
+			{
+				key[field.components - 1] = 0;
+				memcpy(key, value, field.bytes);
+				key += field.components;
+			}
+		}
+	};
+	return group_equal_keys(key_words, vertex_count, write_key, remap);
+}
+
+void remap_indices(std::vector<unsigned int>& indices, const std::vector<uint32_t>& remap)
+{
+	for (unsigned int& index : indices)
+		index = remap[index];
+}
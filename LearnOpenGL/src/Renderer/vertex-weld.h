@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "vertex-layout.h"
+
+//Merges vertices whose attributes all match, so importers that emit one vertex per face corner (OBJ does)
+//share them again. GL-free, runs on any thread.
+
+struct Weld_Stats
+{
+	uint64_t vertices_before = 0;
+	uint64_t vertices_after = 0;
+	uint64_t bytes_before = 0;			//of the vertex streams, indices keep their size
+	uint64_t bytes_after = 0;
+
+	void add(const Weld_Stats& other)
+	{
+		vertices_before += other.vertices_before;
+		vertices_after += other.vertices_after;
+		bytes_before += other.bytes_before;
+		bytes_after += other.bytes_after;
+	}
+};
+
+//one array of vertices with the layout describing it
+struct Weld_Stream
+{
+	const void* data = nullptr;
+	Vertex_Layout_View layout;
+};
+
+//The same group for every element whose key_words words match, numbered in order of first appearance.
+//write_key(i, words) writes the key of element i, once per element; only the first key of every group is
+//kept to compare against. Open addressing over a table at least twice the element count. Returns the group count.
+template<typename Key_Function>
+uint32_t group_equal_keys(size_t key_words, size_t count, const Key_Function& write_key, std::vector<uint32_t>& groups)
+{
+	struct Table_Slot
+	{
+		uint32_t hash;
+		uint32_t group;
+	};
+	static const uint32_t EMPTY = 0xFFFFFFFFu;
+	size_t capacity = 16;
+	while (capacity < count * 2)
+		capacity <<= 1;
+	std::vector<Table_Slot> table(capacity, Table_Slot{ 0, EMPTY });
+	std::vector<uint32_t> group_keys;
+	std::vector<uint32_t> key(key_words);
+	groups.resize(count);
+	uint32_t group_count = 0;
+	for (uint32_t i = 0; i < (uint32_t)count; i++)
+	{
+		write_key(i, key.data());
+		//two words per multiply, the final fold lets the low bits the table uses depend on all of them
+		uint64_t wide = 0x9E3779B97F4A7C15ull;
+		size_t w = 0;
+		for (; w + 1 < key_words; w += 2)
+			wide = (wide ^ (key[w] | (uint64_t)key[w + 1] << 32)) * 0xFF51AFD7ED558CCDull;
+		if (w < key_words)
+			wide = (wide ^ key[w]) * 0xFF51AFD7ED558CCDull;
+		uint32_t hash = (uint32_t)(wide >> 32) ^ (uint32_t)wide;
+
+		size_t slot = hash & (capacity - 1);
+		while (table[slot].group != EMPTY
+			&& (table[slot].hash != hash || !std::equal(key.begin(), key.end(), group_keys.begin() + table[slot].group * key_words)))
+			slot = (slot + 1) & (capacity - 1);
+		if (table[slot].group == EMPTY)
+		{
+			table[slot] = Table_Slot{ hash, group_count++ };
+			group_keys.insert(group_keys.end(), key.begin(), key.end());
+		}
+		groups[i] = table[slot].group;
+	}
+	return group_count;
+}
+
+//Welded index of every vertex; welded vertices keep the order of their first appearance.
+//Float components are quantized to multiples of epsilon before comparing (0 compares them exactly), so
+//values closer than epsilon usually, but not always, fall into the same step; values too large for a 64 bit
+//step count compare exactly. Integer components must match exactly. All streams describe the same vertex_count vertices. Returns the welded vertex count.
+uint32_t build_weld_remap(const Weld_Stream* streams, uint32_t stream_count, size_t vertex_count, float epsilon, std::vector<uint32_t>& remap);
+
+//compacts vertices in place, every welded vertex keeps the values of the first one merged into it
+template<typename T>
+void apply_weld_remap(std::vector<T>& vertices, const std::vector<uint32_t>& remap, uint32_t welded_count)
+{
+	//groups are numbered by first appearance, so the first vertex of the next group is the next one mapped to it
+	uint32_t next = 0;
+	for (size_t v = 0; v < vertices.size() && next < welded_count; v++)
+		if (remap[v] == next)
+			vertices[next++] = vertices[v];
+	//meshes keep their vertex arrays for as long as they live, the unwelded capacity would stay with them
+	vertices.resize(welded_count);
+	vertices.shrink_to_fit();
+}
+
+void remap_indices(std::vector<unsigned int>& indices, const std::vector<uint32_t>& remap);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <Renderer/vertex-layout.h>
+
+// kept free of GL so the mesh import can run headless
+#define MAX_BONE_INFLUENCE 4
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+    //bone indexes which will influence this vertex
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    //weights from each bone
+    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// attribute locations 0-6 of the model shaders, checked against the struct at compile time
+template<> struct Vertex_Format<Vertex>
+{
+    static constexpr Vertex_Attribute attributes[] = {
+        VERTEX_ATTRIBUTE(Vertex, Position),
+        VERTEX_ATTRIBUTE(Vertex, Normal),
+        VERTEX_ATTRIBUTE(Vertex, TexCoords),
+        VERTEX_ATTRIBUTE(Vertex, Tangent),
+        VERTEX_ATTRIBUTE(Vertex, Bitangent),
+        VERTEX_ATTRIBUTE(Vertex, m_BoneIDs),
+        VERTEX_ATTRIBUTE(Vertex, m_Weights),
+    };
+};
+
+// the position stream of a split mesh (location 0): all a depth, shadow or picking pass fetches
+struct Vertex_Position {
+    glm::vec3 Position;
+};
+
+template<> struct Vertex_Format<Vertex_Position>
+{
+    static constexpr Vertex_Attribute attributes[] = {
+        VERTEX_ATTRIBUTE(Vertex_Position, Position),
+    };
+};
+
+// everything else of a Vertex, the second stream of a split mesh (locations 1-6)
+struct Vertex_Attributes {
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+template<> struct Vertex_Format<Vertex_Attributes>
+{
+    static constexpr Vertex_Attribute attributes[] = {
+        VERTEX_ATTRIBUTE(Vertex_Attributes, Normal),
+        VERTEX_ATTRIBUTE(Vertex_Attributes, TexCoords),
+        VERTEX_ATTRIBUTE(Vertex_Attributes, Tangent),
+        VERTEX_ATTRIBUTE(Vertex_Attributes, Bitangent),
+        VERTEX_ATTRIBUTE(Vertex_Attributes, m_BoneIDs),
+        VERTEX_ATTRIBUTE(Vertex_Attributes, m_Weights),
+    };
+};
+
+// texture array layer of each material map, a third stream on batched models (location 7, after either of the above)
+struct Vertex_Material_Layers {
+    glm::u8vec4 Layers;
+};
+
+template<> struct Vertex_Format<Vertex_Material_Layers>
+{
+    static constexpr Vertex_Attribute attributes[] = {
+        VERTEX_ATTRIBUTE(Vertex_Material_Layers, Layers),
+    };
+};
@@ -1,43 +1,175 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 #include <vector>
+#include <memory>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <stb_image.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "Core/job-system.h"
+#include "Core/file-system.h"
+#include "Core/fixed-timestep.h"
+#include "Core/allocators.h"
+#include "Core/memory-tracker.h"
 #include "Renderer/shader.h"
+#include "Renderer/shader-compiler.h"
+#include "Renderer/shader-cache.h"
 #include "Renderer/buffer.h"
 #include "Renderer/vertex-array.h"
+#include "Renderer/vertex-array-cache.h"
 #include "Renderer/camera.h"
 #include "Renderer/model.h"
+#include "Renderer/texture-loader.h"
+#include "Renderer/resource-manager.h"
+#include "Renderer/occlusion-culler.h"
+#include "Renderer/frame-pipeline.h"
+#include "Renderer/render-graph.h"
+#include "Renderer/render-target-pool.h"
+#include "Renderer/frame-capture.h"
+#include "Renderer/gl-instrumentation.h"
+#include "Renderer/dynamic-resolution.h"
+#include "Renderer/particle-system.h"
+#include "Renderer/particle-renderer.h"
+#include "Renderer/cascaded-shadow-map.h"
+#include "Renderer/clustered-lighting.h"
 
 static bool first_mouse = true;
+//initial window size, everything after creation follows the framebuffer size instead
 static const unsigned int screen_width = 800, screen_height = 600;
 static float last_x = (float)screen_width / 2.0f, last_y = (float)screen_height / 2.0f;
+static uint32_t framebuffer_width = screen_width, framebuffer_height = screen_height;
+//false records and submits on the main thread, handy when debugging GL
+static const bool use_render_thread = true;
+//one GPU frame in flight and a late-latched camera, trades some throughput for input latency
+static const bool low_latency_mode = true;
 
 Perspective_Camera camera(glm::vec3(2.0f, 5.0f, 5.0f), glm::vec3(-20.0f, -110.0, 0.0f));
 
-//delta time
-static float delta_time = 0.0f;
-static float last_frame = 0.0f;
+//simulation runs at a fixed rate, rendering interpolates between the last two camera positions
+static Fixed_Timestep fixed_timestep(1.0 / 120.0);
+static glm::vec3 previous_camera_position;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double x_pos, double y_pos);
 void scroll_callback(GLFWwindow* window, double x_offset, double y_offset);
-void process_input(GLFWwindow* window);
-unsigned int load_texture(const std::string& path);
-
-
+void process_input(GLFWwindow* window, float delta_time);
+void submit_frame(const Frame_Packet& packet);
+void build_render_graph(uint32_t width, uint32_t height, bool scaled);
+//width and height of the viewport the scene is drawn into
+void draw_scene(const Frame_Packet& packet, uint32_t width, uint32_t height);
+
+//layout of the cube, plane and window vertex arrays below, the order mesh and clustered shaders read
+struct Textured_Vertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texcoord;
+};
 
-int main()
+template<> struct Vertex_Format<Textured_Vertex>
+{
+	static constexpr Vertex_Attribute attributes[] = {
+		VERTEX_ATTRIBUTE(Textured_Vertex, position),
+		VERTEX_ATTRIBUTE(Textured_Vertex, normal),
+		VERTEX_ATTRIBUTE(Textured_Vertex, texcoord),
+	};
+};
+
+//render thread only: the graph is rebuilt when the viewport changes, its passes read the packet being submitted
+static Render_Graph render_graph;
+static Render_Target_Pool render_targets;
+static const Frame_Packet* submitting_packet = nullptr;
+//render thread only: scales the scene passes to hold a GPU budget, --dynamic-resolution [ms] or F3 turn it on
+static Dynamic_Resolution dynamic_resolution;
+static Render_Handle scaled_scene_color = INVALID_RENDER_HANDLE;
+//render thread only: streams the particles the main thread simulated into one instanced draw
+static Particle_Renderer particle_renderer;
+//render thread only: cascaded shadows of the cubes, rendered at the start of the scene pass
+static std::unique_ptr<Cascaded_Shadow_Map> shadow_map;
+static std::vector<Shadow_Caster> shadow_casters;
+static Shader* shadow_depth_shader = nullptr;
+static const glm::vec3 sun_direction(-0.8f, -1.0f, -0.4f);
+//render thread only: point and spot lights of the floor and cubes, assigned to clusters every frame
+static std::unique_ptr<Clustered_Lighting> clustered_lighting;
+static std::vector<Cluster_Light> scene_lights;
+static Shader* lit_shader = nullptr;
+
+//readback of the back buffer: every frame with --capture <dir>, the fixed shots below with --check <dir>
+static Frame_Capture frame_capture;
+static std::string capture_directory;
+
+//what a frame draws, a shot isolates the feature it is named after
+enum class Shot_Content
+{
+	Scene,		//everything, lit by the sun, its cascaded shadows and the clustered lights
+	Blending,	//the alpha tested grass alone, unlit and unshadowed
+	Depth,		//floor and cubes as linear depth between the near and far plane
+};
+
+//--check renders each shot from a fixed camera and compares it with <dir>/<name>.png, --update-references writes them instead
+//the references are committed in Asset/reference
+struct Capture_Shot
+{
+	const char* name;
+	glm::vec3 position;
+	glm::vec3 target;
+	Shot_Content content;
+	float far_plane;
+};
+static const Capture_Shot capture_shots[] =
+{
+	{ "blending", glm::vec3(0.2f, 0.2f, 2.2f), glm::vec3(-0.2f, 0.0f, -1.0f), Shot_Content::Blending, 100.0f },
+	{ "depth", glm::vec3(2.5f, 2.0f, 3.0f), glm::vec3(-0.5f, -0.3f, -0.5f), Shot_Content::Depth, 8.0f },
+	{ "scene", glm::vec3(2.5f, 2.0f, 3.0f), glm::vec3(-0.5f, -0.3f, -0.5f), Shot_Content::Scene, 100.0f },
+};
+static const uint32_t shot_count = sizeof(capture_shots) / sizeof(capture_shots[0]);
+//frames rendered per shot before its capture, lets the frames in flight drain
+static const uint32_t shot_settle_frames = 3;
+//before the shots --check renders the scene for the warm-up, then fails if any of the steady frames allocates
+static const uint32_t check_warmup_frames = 30;
+//a second at 60 Hz, long enough to include periodic work such as the shader reload check
+static const uint32_t check_steady_frames = 60;
+static Capture_Request shot_requests[shot_count];
+
+
+
+int main(int argc, char** argv)
 {
 	//Init
 	//-----------------------------------------------------------------------
+	bool check_mode = false, update_references = false, use_dynamic_resolution = false;
+	std::string reference_directory;
+	Dynamic_Resolution_Config resolution_config;
+	uint32_t particle_count = 20000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			capture_directory = argv[++i];
+		else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc)
+		{
+			check_mode = true;
+			reference_directory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--update-references") == 0)
+			update_references = true;
+		else if (strcmp(argv[i], "--dynamic-resolution") == 0)
+		{
+			use_dynamic_resolution = true;
+			if (i + 1 < argc && atof(argv[i + 1]) > 0.0)
+				resolution_config.target_ms = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+			particle_count = (uint32_t)strtoul(argv[++i], nullptr, 10);
+	}
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -46,6 +178,9 @@ int main()
 	#ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	#endif
+	// regression checks need no window on screen
+	if (check_mode)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 	//------------------------------------------------------------------------
 
 	// glfw window creation
@@ -58,6 +193,10 @@ int main()
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+	// the framebuffer can differ from the window size (high DPI), the callback keeps both in sync from here on
+	int initial_width = 0, initial_height = 0;
+	glfwGetFramebufferSize(window, &initial_width, &initial_height);
+	framebuffer_size_callback(window, initial_width, initial_height);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
@@ -74,71 +213,96 @@ int main()
 	// set up vertex data (and buffer(s)) and configure vertex attributes
 	// ------------------------------------------------------------------
 	float cubeVertices[] = {
-		// positions          // texture Coords
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-		-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f
+		// positions          // normals            // texture Coords
+		-0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+		 0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+		 0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+		 0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+		-0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+		-0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+
+		-0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+		 0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+		 0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+		 0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+		-0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+		-0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+
+		-0.5f,  0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f,  0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+		-0.5f, -0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		-0.5f, -0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		-0.5f, -0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f,  0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+		 0.5f,  0.5f,  0.5f,   1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+		 0.5f,  0.5f, -0.5f,   1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, -0.5f, -0.5f,   1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, -0.5f, -0.5f,   1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, -0.5f,  0.5f,   1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+		 0.5f,  0.5f,  0.5f,   1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+		-0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+		 0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+
+		-0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+		 0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,  0.0f, 1.0f
 	};
 	float planeVertices[] = {
-		// positions          // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
-		 5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
-		-5.0f, -0.5f,  5.0f,  0.0f, 0.0f,
-		-5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
-
-		 5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
-		-5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
-		 5.0f, -0.5f, -5.0f,  2.0f, 2.0f
+		// positions          // normals            // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
+		 5.0f, -0.5f,  5.0f,   0.0f,  1.0f,  0.0f,  2.0f, 0.0f,
+		-5.0f, -0.5f,  5.0f,   0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
+		-5.0f, -0.5f, -5.0f,   0.0f,  1.0f,  0.0f,  0.0f, 2.0f,
+
+		 5.0f, -0.5f,  5.0f,   0.0f,  1.0f,  0.0f,  2.0f, 0.0f,
+		-5.0f, -0.5f, -5.0f,   0.0f,  1.0f,  0.0f,  0.0f, 2.0f,
+		 5.0f, -0.5f, -5.0f,   0.0f,  1.0f,  0.0f,  2.0f, 2.0f
 	};
 	float transparentVertices[] = {
-		// positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
-		0.0f,  0.5f,  0.0f,  0.0f,  1.0f,
-		0.0f, -0.5f,  0.0f,  0.0f,  0.0f,
-		1.0f, -0.5f,  0.0f,  1.0f,  0.0f,
-
-		0.0f,  0.5f,  0.0f,  0.0f,  1.0f,
-		1.0f, -0.5f,  0.0f,  1.0f,  0.0f,
-		1.0f,  0.5f,  0.0f,  1.0f,  1.0f
+		// positions          // normals            // texture Coords (swapped y coordinates because texture is flipped upside down)
+		 0.0f,  0.5f,  0.0f,   0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+		 0.0f, -0.5f,  0.0f,   0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+		 1.0f, -0.5f,  0.0f,   0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+
+		 0.0f,  0.5f,  0.0f,   0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+		 1.0f, -0.5f,  0.0f,   0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+		 1.0f,  0.5f,  0.0f,   0.0f,  0.0f,  1.0f,  1.0f, 1.0f
 	};
 
-	Shader shader("Asset/Shader/blending-vert.glsl", "Asset/Shader/blending-frag.glsl");
+	// worker threads for culling and other CPU work, this thread takes part as job thread 0
+	Job_System::init();
+	// asset reads are queued to the kernel (or reader threads) and overlap with decoding and compiling
+	File_System::init();
+
+	// shaders build in the background, the cheap fallback is compiled up front and drawn until they are ready
+	Shader_Compiler shader_compiler;
+	shader_compiler.init(window);
+	shader_compiler.set_hot_reload(true);
+	shader_compiler.set_default_fallback(std::make_shared<Shader>("Asset/Shader/fallback-vert.glsl", "Asset/Shader/fallback-frag.glsl"));
+	// every variant listed in the manifest is submitted at once, the rest are built on first use
+	Shader_Variant_Cache shader_variants(shader_compiler);
+	shader_variants.preload("Asset/Shader/variants.txt");
+	std::shared_ptr<Shader> shader = shader_variants.get("textured", SHADER_FEATURE_ALPHA_TEST | SHADER_FEATURE_RECEIVE_SHADOWS);
+	std::shared_ptr<Shader> clustered_shader = shader_variants.get("clustered", SHADER_FEATURE_RECEIVE_SHADOWS);
+	lit_shader = clustered_shader.get();
+	std::shared_ptr<Shader> particle_shader = shader_variants.get("particle", SHADER_FEATURE_NONE);
+	std::shared_ptr<Shader> shadow_shader = shader_variants.get("shadow-depth", SHADER_FEATURE_NONE);
+	// only the reference shots draw with these
+	std::shared_ptr<Shader> unlit_shader = shader_variants.get("textured", SHADER_FEATURE_ALPHA_TEST);
+	std::shared_ptr<Shader> depth_shader = shader_variants.get("textured", SHADER_FEATURE_LINEAR_DEPTH);
+	shadow_depth_shader = shadow_shader.get();
+	shader_compiler.poll();
+	// captures must not see the fallback shader
+	if (check_mode)
+		shader_compiler.wait_idle();
 	
 
 	// configure global opengl state
@@ -147,29 +311,42 @@ int main()
 	glDepthFunc(GL_LESS); // always pass the depth test (same effect as glDisable(GL_DEPTH_TEST))
 
 
-	Buffer_Layout layout = {
-		{Shader_Data_Type::Float3, "a_Position"},
-		{Shader_Data_Type::Float2, "a_texcoord"}
-	};
+	constexpr Vertex_Layout_View layout = vertex_layout_of<Textured_Vertex>();
+	static_assert(sizeof(cubeVertices) % layout.stride == 0 && sizeof(planeVertices) % layout.stride == 0
+		&& sizeof(transparentVertices) % layout.stride == 0, "vertex data does not match Textured_Vertex");
 
-	std::shared_ptr<Vertex_Array> cube_VAO = std::make_shared<Vertex_Array>();
-	std::shared_ptr<Vertex_Buffer> cube_VBO = std::make_shared<Vertex_Buffer>(cubeVertices, sizeof(cubeVertices));
+	// all three share one VAO for the layout when vertex attrib binding is available
+	Vertex_Array_Cache::init();
+	std::shared_ptr<Vertex_Buffer> cube_VBO = make_pooled<Vertex_Buffer>(cubeVertices, sizeof(cubeVertices));
 	cube_VBO->set_layout(layout);
-	cube_VAO->add_vertex_buffer(cube_VBO);
+	Vertex_Binding cube_geometry = Vertex_Array_Cache::get(cube_VBO);
 
-	std::shared_ptr<Vertex_Array> plane_VAO = std::make_shared<Vertex_Array>();
-	std::shared_ptr<Vertex_Buffer> plane_VBO = std::make_shared<Vertex_Buffer>(planeVertices, sizeof(planeVertices));
+	std::shared_ptr<Vertex_Buffer> plane_VBO = make_pooled<Vertex_Buffer>(planeVertices, sizeof(planeVertices));
 	plane_VBO->set_layout(layout);
-	plane_VAO->add_vertex_buffer(plane_VBO);
+	Vertex_Binding plane_geometry = Vertex_Array_Cache::get(plane_VBO);
 
-	std::shared_ptr<Vertex_Array> transparent_VAO = std::make_shared<Vertex_Array>();
-	std::shared_ptr<Vertex_Buffer> transparent_VBO = std::make_shared<Vertex_Buffer>(transparentVertices, sizeof(transparentVertices));
+	std::shared_ptr<Vertex_Buffer> transparent_VBO = make_pooled<Vertex_Buffer>(transparentVertices, sizeof(transparentVertices));
 	transparent_VBO->set_layout(layout);
-	transparent_VAO->add_vertex_buffer(transparent_VBO);
-
-	unsigned int cubeTexture = load_texture("Asset/texture/leidian.jpg");
-	unsigned int floorTexture = load_texture("Asset/texture/wall.jpg");
-	unsigned int transparentTexture = load_texture("Asset/texture/grass.png");
+	Vertex_Binding transparent_geometry = Vertex_Array_Cache::get(transparent_VBO);
+
+	// the three images are read in one batch and decoded in parallel; the manager owns and frees them
+	Resource_Manager resources;
+	resources.set_shader_compiler(&shader_compiler);
+	Texture_Load_Options texture_options;
+	texture_options.flip_vertically = true;
+	texture_options.min_filter = GL_LINEAR;
+	std::vector<Resource_Ref<Managed_Texture>> scene_textures = resources.load_textures(
+		{ "Asset/texture/leidian.jpg", "Asset/texture/wall.jpg", "Asset/texture/grass.png" }, texture_options);
+	// a failed load comes back empty, texture 0 then samples black
+	auto texture_id = [](const Resource_Ref<Managed_Texture>& texture) { return texture ? texture->id : 0u; };
+	unsigned int cubeTexture = texture_id(scene_textures[0]);
+	unsigned int floorTexture = texture_id(scene_textures[1]);
+	unsigned int transparentTexture = texture_id(scene_textures[2]);
+	// repeating would blend the bottom row of the grass into the top edge of its quad
+	glBindTexture(GL_TEXTURE_2D, transparentTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
 
 	// transparent vegetation locations
 	// --------------------------------
@@ -182,75 +359,302 @@ int main()
 		glm::vec3(0.5f, 0.0f, -0.6f)
 	};
 
-	shader.bind();
-	shader.set_int("texture1", 0);
+	// particle fountain behind the grass, about particle_count alive at once (--particles <count>)
+	// random particles would break the reference shots, checks run without them
+	// --------------------------------
+	if (check_mode)
+		particle_count = 0;
+	Particle_System particles(particle_count);
+	if (particle_count > 0)
+	{
+		Particle_Emitter fountain;
+		fountain.position = glm::vec3(0.5f, -0.45f, -1.6f);
+		fountain.extent = glm::vec3(0.05f, 0.0f, 0.05f);
+		fountain.spread = 0.25f;
+		fountain.speed_min = 4.0f;
+		fountain.speed_max = 5.0f;
+		fountain.lifetime_min = 0.8f;
+		fountain.lifetime_max = 1.0f;
+		fountain.rate = particle_count / 0.9f;
+		fountain.start_color = glm::vec4(1.0f, 0.85f, 0.4f, 1.0f);
+		fountain.end_color = glm::vec4(1.0f, 0.3f, 0.1f, 0.0f);
+		fountain.start_size = 0.03f;
+		fountain.end_size = 0.01f;
+		particles.add_emitter(fountain);
+	}
+
+	// the cubes double as low-poly occluders for the CPU occlusion culler
+	// --------------------------------
+	Occlusion_Culler occlusion_culler;
+	vector<glm::vec3> cube_occluder_positions;
+	vector<uint32_t> cube_occluder_indices;
+	for (uint32_t i = 0; i < 36; i++)
+	{
+		cube_occluder_positions.push_back(glm::vec3(cubeVertices[i * 8], cubeVertices[i * 8 + 1], cubeVertices[i * 8 + 2]));
+		cube_occluder_indices.push_back(i);
+	}
+	glm::mat4 cube_models[2] =
+	{
+		glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, 0.0f, -1.0f)),
+		glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f))
+	};
+	// the cubes cast shadows, the floor and the grass only receive them
+	for (const glm::mat4& cube_model : cube_models)
+	{
+		Shadow_Caster caster;
+		caster.geometry = cube_geometry;
+		caster.count = 36;
+		caster.model = cube_model;
+		caster.bounds_min = glm::vec3(-0.5f);
+		caster.bounds_max = glm::vec3(0.5f);
+		shadow_casters.push_back(caster);
+	}
+
 
+	if (check_mode || !capture_directory.empty())
+		frame_capture.init();
+	for (uint32_t i = 0; i < shot_count; i++)
+	{
+		shot_requests[i].name = capture_shots[i].name;
+		shot_requests[i].path = reference_directory + "/" + capture_shots[i].name + ".png";
+		shot_requests[i].mode = update_references ? Capture_Mode::Write_Png : Capture_Mode::Compare;
+		shot_requests[i].difference_path = reference_directory + "/" + capture_shots[i].name + "-difference.png";
+	}
+	uint32_t check_frame = 0;
+	uint64_t steady_state_allocations = 0;
+
+	// reference shots are compared at native resolution, so checks never scale
+	bool dynamic_resolution_available = dynamic_resolution.init(resolution_config) && !check_mode;
+	use_dynamic_resolution = use_dynamic_resolution && dynamic_resolution_available;
+	particle_renderer.init();
+	// the whole scene fits in a few units, three small cascades are plenty
+	Shadow_Config shadow_config;
+	shadow_config.cascade_count = 3;
+	shadow_config.resolution = 1024;
+	shadow_config.shadow_distance = 20.0f;
+	shadow_config.caster_margin = 10.0f;
+	shadow_map = std::make_unique<Cascaded_Shadow_Map>(shadow_config);
+	// warm lights around the cubes and a wide spot over the middle, its cone reaches past the hemisphere
+	clustered_lighting = std::make_unique<Clustered_Lighting>();
+	scene_lights.push_back(Cluster_Light::point(glm::vec3(-1.8f, 0.2f, -0.2f), 3.0f, glm::vec3(1.0f, 0.5f, 0.2f), 4.0f));
+	scene_lights.push_back(Cluster_Light::point(glm::vec3(2.8f, 0.3f, 0.9f), 3.0f, glm::vec3(0.3f, 0.6f, 1.0f), 4.0f));
+	scene_lights.push_back(Cluster_Light::point(glm::vec3(0.0f, 0.4f, -3.5f), 4.0f, glm::vec3(0.4f, 1.0f, 0.4f), 4.0f));
+	scene_lights.push_back(Cluster_Light::spot(glm::vec3(0.5f, 1.2f, 0.5f), glm::vec3(0.0f, -1.0f, 0.0f), 3.0f, 60.0f, 100.0f, glm::vec3(1.0f, 0.9f, 0.7f), 3.0f));
+
+	// counting wrappers for the GL calls, instrumented builds only; last so extension pointers loaded above are wrapped too
+	Gl_Instrumentation::install();
+
+	// the render thread owns the context from here on, GL objects above must already exist.
+	// this thread only simulates and records frame packets, it must not touch GL until stop()
+	Frame_Pipeline frame_pipeline(window, use_render_thread);
+	frame_pipeline.set_max_gpu_frames(low_latency_mode ? 1 : 2);
+	// a shot must be drawn with its own camera, not the next one latched while it waits
+	frame_pipeline.set_late_latch(low_latency_mode && !check_mode);
+	frame_pipeline.start([&](const Frame_Packet& packet)
+	{
+		Gl_Instrumentation::end_frame();
+		shader_compiler.poll();
+		submit_frame(packet);
+	});
 
-	
+	previous_camera_position = camera.get_position();
+	double last_title_time = 0.0;
+	bool summary_key_down = false;
+	bool resolution_key_down = false;
 
 	//render loop
 	while(!glfwWindowShouldClose(window))
 	{
-		//update delta time
-		float current_frame = (float)glfwGetTime();
-		delta_time = current_frame - last_frame;
-		last_frame = current_frame;
+		// every heap allocation of this iteration, on any thread, steady state should be zero
+		Allocation_Scope frame_allocations;
 
-		process_input(window);
-
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		shader.bind();
-		glm::mat4 model = glm::mat4(1.0f);
-		glm::mat4 view = camera.get_view_matrix();
-		glm::mat4 projection = glm::perspective(glm::radians(camera.get_zoom()), (float)screen_width / (float)screen_height, 0.1f, 100.0f);
-		shader.set_mat4("view", view);
-		shader.set_mat4("projection", projection);
+		// wait for a free packet first so the input below is as fresh as possible when it is recorded
+		Frame_Packet& packet = frame_pipeline.begin_packet();
 
+		//glfw: poll IO events(keys pressed / released, mouse moved etc.), must stay on the main thread
+		glfwPollEvents();
+		double input_time = glfwGetTime();
+		// F2 prints the GL calls of the last submitted frame
+		bool summary_key = glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS;
+		if (Gl_Instrumentation::enabled && summary_key && !summary_key_down)
+			std::cout << Gl_Instrumentation::format_summary(Gl_Instrumentation::get_last_frame());
+		summary_key_down = summary_key;
+		// F3 toggles dynamic resolution
+		bool resolution_key = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+		if (dynamic_resolution_available && resolution_key && !resolution_key_down)
+			use_dynamic_resolution = !use_dynamic_resolution;
+		resolution_key_down = resolution_key;
+		uint32_t steps = fixed_timestep.advance(input_time);
+		for (uint32_t i = 0; i < steps; i++)
+		{
+			previous_camera_position = camera.get_position();
+			process_input(window, (float)fixed_timestep.get_step());
+		}
+		// one particle update covers all the steps, a step each would cost the kernels several times over
+		particles.update((float)(steps * fixed_timestep.get_step()));
+
+		// mouse look is applied as it arrives, only the simulated position is interpolated
+		Camera_Latch latch;
+		latch.input_time = input_time;
+		latch.camera_position = glm::mix(previous_camera_position, camera.get_position(), fixed_timestep.get_alpha());
+		latch.view = camera.get_view_matrix_at(latch.camera_position);
+		latch.projection = glm::perspective(glm::radians(camera.get_zoom()), camera.get_aspect_ratio(), 0.1f, 100.0f);
+		Shot_Content content = Shot_Content::Scene;
+		// the shots start once the steady frames are counted, captures allocate on the workers
+		bool steady_frame = check_mode && check_frame >= check_warmup_frames && check_frame < check_warmup_frames + check_steady_frames;
+		uint32_t shot_frame = check_frame - check_warmup_frames - check_steady_frames;
+		if (check_mode && check_frame >= check_warmup_frames + check_steady_frames)
+		{
+			const Capture_Shot& shot = capture_shots[shot_frame / shot_settle_frames];
+			latch.camera_position = shot.position;
+			latch.view = glm::lookAt(shot.position, shot.target, glm::vec3(0.0f, 1.0f, 0.0f));
+			latch.projection = glm::perspective(glm::radians(45.0f), camera.get_aspect_ratio(), 0.1f, shot.far_plane);
+			content = shot.content;
+			if (shot_frame % shot_settle_frames == shot_settle_frames - 1)
+				packet.capture = &shot_requests[shot_frame / shot_settle_frames];
+			if (shot_frame + 1 == shot_count * shot_settle_frames)
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+		}
+		if (check_mode)
+			check_frame++;
+		frame_pipeline.latch_camera(latch);
+
+		packet.input_time = latch.input_time;
+		packet.viewport_width = framebuffer_width;
+		packet.viewport_height = framebuffer_height;
+		packet.dynamic_resolution = use_dynamic_resolution;
+		packet.view = latch.view;
+		packet.projection = latch.projection;
+		packet.camera_position = latch.camera_position;
+
+		bool draw_opaque = content != Shot_Content::Blending;
+		bool draw_vegetation = content != Shot_Content::Depth;
+
+		// occlusion: rasterize the cubes on the CPU, then test everything else before recording it
+		occlusion_culler.begin_frame(packet.projection * packet.view);
+		for (const glm::mat4& cube_model : cube_models)
+			if (draw_opaque)
+				occlusion_culler.add_occluder(cube_occluder_positions.data(), cube_occluder_indices.data(), (uint32_t)cube_occluder_indices.size(), cube_model);
+		occlusion_culler.rasterize();
+
+		Draw_Item draw;
+		draw.shader = content == Shot_Content::Depth ? depth_shader.get() : clustered_shader.get();
 		// floor
-		plane_VAO->bind();
-		glBindTexture(GL_TEXTURE_2D, floorTexture);
-		shader.set_mat4("model", glm::mat4(1.0f));
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glBindVertexArray(0);
+		draw.geometry = plane_geometry;
+		draw.texture = floorTexture;
+		draw.count = 6;
+		draw.model = glm::mat4(1.0f);
+		if (draw_opaque)
+			packet.draws.push_back(draw);
 		// cubes
-		cube_VAO->bind();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, cubeTexture);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-		shader.set_mat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-		shader.set_mat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
+		draw.geometry = cube_geometry;
+		draw.texture = cubeTexture;
+		draw.count = 36;
+		for (const glm::mat4& cube_model : cube_models)
+		{
+			draw.model = cube_model;
+			if (draw_opaque)
+				packet.draws.push_back(draw);
+		}
 		// vegetation
-		transparent_VAO->bind();
-		glBindTexture(GL_TEXTURE_2D, transparentTexture);
-		for (unsigned int i = 0; i < vegetation.size(); i++)
+		draw.shader = content == Shot_Content::Blending ? unlit_shader.get() : shader.get();
+		draw.geometry = transparent_geometry;
+		draw.texture = transparentTexture;
+		draw.count = 6;
+		for (unsigned int i = 0; draw_vegetation && i < vegetation.size(); i++)
 		{
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, vegetation[i]);
-			shader.set_mat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 6);
+			draw.model = glm::translate(glm::mat4(1.0f), vegetation[i]);
+			if (!occlusion_culler.is_visible(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(1.0f, 0.5f, 0.0f), draw.model))
+				continue;
+			packet.draws.push_back(draw);
+		}
+		// particles, sorted back to front for blending with the camera the packet was built with
+		if (particles.get_count() > 0)
+		{
+			Particle_Instance* instances = packet.arena.allocate_array<Particle_Instance>(particles.get_count());
+			packet.particles.shader = particle_shader.get();
+			packet.particles.instances = instances;
+			packet.particles.count = particles.write_instances(packet.view, true, instances);
+		}
+
+		frame_pipeline.end_packet();
+		uint64_t allocations = frame_allocations.count();
+		if (steady_frame)
+			steady_state_allocations += allocations;
+
+		// latency of the last submitted frame in the title, once a second
+		if (input_time - last_title_time > 1.0)
+		{
+			last_title_time = input_time;
+			Frame_Pipeline_Stats stats = frame_pipeline.get_stats();
+			char title[384];
+			snprintf(title, sizeof(title), "OPenGL | input->submit %.2f ms | submit->present %.2f ms | gpu wait %.2f ms | %llu allocs/frame",
+				stats.input_to_submit_ms, stats.submit_to_present_ms, stats.gpu_wait_ms, (unsigned long long)allocations);
+			if (Gl_Instrumentation::enabled)
+			{
+				Gl_Frame_Stats gl_stats = Gl_Instrumentation::get_last_frame();
+				size_t length = strlen(title);
+				snprintf(title + length, sizeof(title) - length, " | %llu draws, %llu GL calls, %llu redundant, %.1f KB uploaded",
+					(unsigned long long)gl_stats.category_calls[GL_CALL_CATEGORY_DRAW], (unsigned long long)gl_stats.total_calls,
+					(unsigned long long)gl_stats.total_redundant, (gl_stats.buffer_upload_bytes + gl_stats.texture_upload_bytes) / 1024.0);
+			}
+			if (use_dynamic_resolution)
+			{
+				Dynamic_Resolution_Stats resolution_stats = dynamic_resolution.get_stats();
+				size_t length = strlen(title);
+				snprintf(title + length, sizeof(title) - length, " | scene %ux%u (%.0f%%) %.2f ms gpu",
+					resolution_stats.render_width, resolution_stats.render_height, resolution_stats.scale * 100.0f, resolution_stats.gpu_ms);
+			}
+			if (particles.get_capacity() > 0)
+			{
+				size_t length = strlen(title);
+				snprintf(title + length, sizeof(title) - length, " | %u particles", particles.get_count());
+			}
+			glfwSetWindowTitle(window, title);
 		}
-		
-		//glfw: swap buffersand poll IO events(keys pressed / released, mouse moved etc.)
-		glfwSwapBuffers(window);
-		glfwPollEvents();
 	}
 
-	
-	
+	// drains the queued packets and hands the context back for cleanup
+	frame_pipeline.stop();
+	int exit_code = 0;
+	if (check_mode || !capture_directory.empty())
+	{
+		frame_capture.flush();
+		for (const Capture_Result& result : frame_capture.take_results())
+		{
+			if (result.passed)
+				continue;
+			std::cout << "Capture " << result.name << " failed: " << result.message << std::endl;
+			exit_code = 1;
+		}
+		Capture_Stats capture_stats = frame_capture.get_stats();
+		std::cout << "Captures: " << capture_stats.completed << " done, " << capture_stats.failed << " failed, "
+			<< capture_stats.dropped << " dropped" << std::endl;
+		frame_capture.shutdown();
+	}
+	if (check_mode)
+	{
+		std::cout << "Steady state: " << steady_state_allocations << " allocations in " << check_steady_frames << " frames" << std::endl;
+		if (steady_state_allocations > 0)
+			exit_code = 1;
+	}
+	render_targets.clear();
+	dynamic_resolution.shutdown();
+	particle_renderer.shutdown();
+	shadow_map.reset();
+	clustered_lighting.reset();
+	Vertex_Array_Cache::shutdown();
+	scene_textures.clear();
+	resources.clear();
+
+	shader_compiler.shutdown();
+	File_System::shutdown();
+	Job_System::shutdown();
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
    // ------------------------------------------------------------------
 	glfwTerminate();
-	return 0;
+	return exit_code;
 
 }
 
@@ -258,7 +662,164 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	// make sure the viewport matches the new window dimensions; note that width and 
 	// height will be significantly larger than specified on retina displays.
-	glViewport(0, 0, width, height);
+	// the context lives on the render thread, the size reaches glViewport through the next packet
+	framebuffer_width = (uint32_t)width;
+	framebuffer_height = (uint32_t)height;
+	if (width > 0 && height > 0)
+		camera.set_aspect_ratio((float)width / (float)height);
+}
+
+// runs on the render thread, the only place GL is called once the frame pipeline has started
+// ---------------------------------------------------------------------------------------------------------
+void submit_frame(const Frame_Packet& packet)
+{
+	static uint32_t graph_width = 0, graph_height = 0;
+	static bool graph_scaled = false;
+	//the scale changes inside the scene target, only a resize or the toggle rebuild the graph
+	if (packet.viewport_width != graph_width || packet.viewport_height != graph_height || packet.dynamic_resolution != graph_scaled)
+	{
+		graph_width = packet.viewport_width;
+		graph_height = packet.viewport_height;
+		graph_scaled = packet.dynamic_resolution;
+		build_render_graph(graph_width, graph_height, graph_scaled);
+	}
+	// minimized, nothing to draw into
+	if (graph_width > 0 && graph_height > 0)
+	{
+		if (graph_scaled)
+			dynamic_resolution.begin_frame(graph_width, graph_height);
+		submitting_packet = &packet;
+		render_graph.execute(render_targets);
+		submitting_packet = nullptr;
+	}
+
+	// queued before the swap, read back a few frames later without stalling
+	frame_capture.update();
+	if (packet.capture)
+		frame_capture.capture(packet.viewport_width, packet.viewport_height, *packet.capture);
+	else if (!capture_directory.empty())
+	{
+		Capture_Request request;
+		char name[32];
+		snprintf(name, sizeof(name), "frame-%06llu.png", (unsigned long long)packet.frame_index);
+		request.name = name;
+		request.path = capture_directory + "/" + name;
+		frame_capture.capture(packet.viewport_width, packet.viewport_height, request);
+	}
+}
+
+void build_render_graph(uint32_t width, uint32_t height, bool scaled)
+{
+	render_graph.reset();
+	Render_Target_Desc backbuffer_desc;
+	backbuffer_desc.width = width;
+	backbuffer_desc.height = height;
+	Render_Handle backbuffer = render_graph.import_target("backbuffer", backbuffer_desc, 0);
+
+	// post effects and shadow passes slot in here, reading and writing transients from the pool
+	if (!scaled)
+	{
+		render_graph.add_pass("scene", [&](Render_Pass_Builder& builder)
+		{
+			backbuffer = builder.write(backbuffer);
+		},
+		[](const Render_Pass_Context&)
+		{
+			draw_scene(*submitting_packet, submitting_packet->viewport_width, submitting_packet->viewport_height);
+		});
+	}
+	else
+	{
+		// native sized targets, the scene only covers the corner Dynamic_Resolution picked this frame
+		Render_Target_Desc depth_desc = backbuffer_desc;
+		depth_desc.format = Render_Format::Depth24_Stencil8;
+		render_graph.add_pass("scene", [&](Render_Pass_Builder& builder)
+		{
+			scaled_scene_color = builder.write(builder.create("scene color", backbuffer_desc));
+			builder.write(builder.create("scene depth", depth_desc));
+		},
+		[](const Render_Pass_Context&)
+		{
+			glViewport(0, 0, dynamic_resolution.get_render_width(), dynamic_resolution.get_render_height());
+			dynamic_resolution.begin_timing();
+			draw_scene(*submitting_packet, dynamic_resolution.get_render_width(), dynamic_resolution.get_render_height());
+			dynamic_resolution.end_timing();
+		});
+		render_graph.add_pass("upscale", [&](Render_Pass_Builder& builder)
+		{
+			builder.read(scaled_scene_color);
+			backbuffer = builder.write(backbuffer);
+		},
+		[](const Render_Pass_Context& context)
+		{
+			const Render_Target_Desc& desc = context.get_desc(scaled_scene_color);
+			dynamic_resolution.upscale(context.get_texture(scaled_scene_color), desc.width, desc.height);
+		});
+	}
+	// UI and debug overlays go after this point, writing the backbuffer at native resolution
+	render_graph.compile();
+}
+
+void draw_scene(const Frame_Packet& packet, uint32_t width, uint32_t height)
+{
+	// shadows first, render() puts the pass's target and viewport back; nothing is drawn with the fallback shader
+	if (shadow_depth_shader->is_ready())
+	{
+		shadow_map->update(packet.view, packet.projection, sun_direction);
+		shadow_map->render(*shadow_depth_shader, shadow_casters);
+	}
+	// a handful of lights, cheap enough to assign here with the camera the frame is drawn with
+	clustered_lighting->update(packet.view, packet.projection, scene_lights);
+
+	glClearColor(packet.clear_color.r, packet.clear_color.g, packet.clear_color.b, packet.clear_color.a);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glActiveTexture(GL_TEXTURE0);
+	Shader* bound_shader = nullptr;
+	Vertex_Binding bound_geometry;
+	GLuint bound_texture = 0;
+	for (const Draw_Item& draw : packet.draws)
+	{
+		if (draw.shader != bound_shader)
+		{
+			bound_shader = draw.shader;
+			bound_shader->bind();
+			bound_shader->set_int("texture1", 0);
+			bound_shader->set_mat4("view", packet.view);
+			bound_shader->set_mat4("projection", packet.projection);
+			if (bound_shader->get_features() & SHADER_FEATURE_RECEIVE_SHADOWS)
+				shadow_map->bind(*bound_shader, 1);
+			if (bound_shader->get_features() & SHADER_FEATURE_LINEAR_DEPTH)
+			{
+				// the planes of the projection, read back from its depth terms
+				bound_shader->set_float("near", packet.projection[3][2] / (packet.projection[2][2] - 1.0f));
+				bound_shader->set_float("far", packet.projection[3][2] / (packet.projection[2][2] + 1.0f));
+			}
+			if (bound_shader == lit_shader)
+			{
+				bound_shader->set_vec3("view_pos", packet.camera_position);
+				bound_shader->set_vec3("light_direction", sun_direction);
+				clustered_lighting->bind(*bound_shader, 2, width, height);
+			}
+		}
+		Vertex_Array_Cache::bind(draw.geometry, bound_geometry);
+		if (draw.texture != bound_texture)
+		{
+			bound_texture = draw.texture;
+			glBindTexture(GL_TEXTURE_2D, bound_texture);
+		}
+		bound_shader->set_mat4("model", draw.model);
+		if (draw.indexed)
+			glDrawElements(GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, nullptr);
+		else
+			glDrawArrays(GL_TRIANGLES, 0, draw.count);
+	}
+	glBindVertexArray(0);
+
+	// blended, so after everything opaque
+	const Particle_Draw& particles = packet.particles;
+	if (particles.count > 0)
+		particle_renderer.draw(*particles.shader, particles.instances, particles.count, packet.view, packet.projection);
 }
 
 void mouse_callback(GLFWwindow* window, double x_pos, double y_pos)
@@ -286,7 +847,7 @@ void scroll_callback(GLFWwindow* window, double x_offset, double y_offset)
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void process_input(GLFWwindow* window)
+void process_input(GLFWwindow* window, float delta_time)
 {
 	//close
 	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
@@ -305,38 +866,3 @@ void process_input(GLFWwindow* window)
 	
 
 }
-
-unsigned int load_texture(const std::string& path)
-{
-	unsigned int render_ID;
-	glGenTextures(1, &render_ID);
-	glBindTexture(GL_TEXTURE_2D, render_ID);
-	//GL_REPEAT GL_MIRRORED_REPEAT GL_CLAMP_TO_EDGE GL_CLAMP_TO_BORDER
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	//float borderColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
-	//glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-	
-	//GL_LINEAR GL_NEAREST
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	//load image
-	int width, height, channels;
-	stbi_set_flip_vertically_on_load(1);
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
-	GLenum format = 0;
-	if (channels == 1) format = GL_RED;
-	else if (channels == 3) format = GL_RGB;
-	else if (channels == 4) format = GL_RGBA;
-
-	if (data)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
-		std::cout << "Failed to load image from : " << path << std::endl;
-	stbi_image_free(data);
-	return render_ID;
-}
\ No newline at end of file
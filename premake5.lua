@@ -10,6 +10,13 @@ workspace "LearnOpenGL"
 	}
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
+--counts GL calls per frame, see src/Renderer/gl-instrumentation.h
+newoption
+{
+	trigger = "gl-instrumentation",
+	description = "Wrap the glad function pointers to count GL calls, state changes and uploads per frame"
+}
+
 --Include directories
 IncludeDir = {}
 IncludeDir["GLFW"] = "LearnOpenGL/vendor/GLFW/include"
@@ -70,6 +77,9 @@ project "LearnOpenGL"
 		
 	}
 
+	filter "options:gl-instrumentation"
+		defines "GL_INSTRUMENTATION"
+
 	filter "system:windows"
 		systemversion "latest"
 
@@ -79,4 +89,150 @@ project "LearnOpenGL"
 
     filter "configurations:Release"
         runtime "Release"
-        optimize "on"
\ No newline at end of file
+        optimize "on"
+
+project "Benchmark"
+	location "Benchmark"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	--GL-free engine code only, runs headless
+	files
+	{
+		"%{prj.name}/src/**.h",
+		"%{prj.name}/src/**.cpp",
+		"LearnOpenGL/src/Core/**.h",
+		"LearnOpenGL/src/Core/**.cpp",
+		"LearnOpenGL/src/Renderer/render-graph.h",
+		"LearnOpenGL/src/Renderer/render-graph.cpp",
+		"LearnOpenGL/src/Renderer/resource-cache.h",
+		"LearnOpenGL/src/Renderer/resource-cache.cpp",
+		"LearnOpenGL/src/Renderer/buffer.h",
+		"LearnOpenGL/src/Renderer/vertex-layout.h",
+		"LearnOpenGL/src/Renderer/vertex.h",
+		"LearnOpenGL/src/Renderer/mesh-import.h",
+		"LearnOpenGL/src/Renderer/mesh-import.cpp",
+		"LearnOpenGL/src/Renderer/tangent-space.h",
+		"LearnOpenGL/src/Renderer/tangent-space.cpp",
+		"LearnOpenGL/src/Renderer/vertex-weld.h",
+		"LearnOpenGL/src/Renderer/vertex-weld.cpp",
+		"LearnOpenGL/src/Renderer/image-decoder.h",
+		"LearnOpenGL/src/Renderer/image-decoder.cpp",
+		"LearnOpenGL/src/Renderer/camera.h",
+		"LearnOpenGL/src/Renderer/camera.cpp",
+		"LearnOpenGL/src/Renderer/light-clusters.h",
+		"LearnOpenGL/src/Renderer/light-clusters.cpp",
+		"LearnOpenGL/src/Renderer/shadow-cascades.h",
+		"LearnOpenGL/src/Renderer/shadow-cascades.cpp",
+		"LearnOpenGL/src/Renderer/meshlets.h",
+		"LearnOpenGL/src/Renderer/meshlets.cpp",
+		"LearnOpenGL/src/Renderer/occlusion-culler.h",
+		"LearnOpenGL/src/Renderer/occlusion-culler.cpp",
+		"LearnOpenGL/src/Renderer/particle-system.h",
+		"LearnOpenGL/src/Renderer/particle-system.cpp",
+		"LearnOpenGL/vendor/stb_image/**.cpp"
+	}
+
+	defines
+	{
+		"_CRT_SECURE_NO_WARNINGS"
+	}
+
+	includedirs
+	{
+		"%{prj.name}/src",
+		"LearnOpenGL/src",
+		"%{IncludeDir.glm}",
+		"%{IncludeDir.stb_image}",
+		"%{IncludeDir.assimp}"
+	}
+
+	links
+	{
+		"assimp"
+	}
+
+	--same working directory as the app, so the asset paths match
+	debugdir "LearnOpenGL"
+	debugargs { "--json", "benchmark-results.json" }
+
+	filter "system:windows"
+		systemversion "latest"
+
+	filter "configurations:Debug"
+		runtime "Debug"
+		symbols "on"
+
+	filter "configurations:Release"
+		runtime "Release"
+		optimize "on"
+
+project "GpuBenchmark"
+	location "Benchmark"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	--GPU culling checks on a hidden GL 4.5 window, skipped where there is none
+	files
+	{
+		"Benchmark/gpu/**.cpp",
+		"Benchmark/src/benchmark.h",
+		"Benchmark/src/benchmark.cpp",
+		"LearnOpenGL/src/Core/**.h",
+		"LearnOpenGL/src/Core/**.cpp",
+		"LearnOpenGL/src/Renderer/buffer.h",
+		"LearnOpenGL/src/Renderer/buffer.cpp",
+		"LearnOpenGL/src/Renderer/vertex-layout.h",
+		"LearnOpenGL/src/Renderer/vertex.h",
+		"LearnOpenGL/src/Renderer/vertex-array.h",
+		"LearnOpenGL/src/Renderer/vertex-array.cpp",
+		"LearnOpenGL/src/Renderer/shader.h",
+		"LearnOpenGL/src/Renderer/shader.cpp",
+		"LearnOpenGL/src/Renderer/gpu-culling.h",
+		"LearnOpenGL/src/Renderer/gpu-culling.cpp"
+	}
+
+	defines
+	{
+		"_CRT_SECURE_NO_WARNINGS"
+	}
+
+	includedirs
+	{
+		"Benchmark/src",
+		"LearnOpenGL/src",
+		"%{IncludeDir.GLFW}",
+		"%{IncludeDir.Glad}",
+		"%{IncludeDir.glm}"
+	}
+
+	links
+	{
+		"GLFW",
+		"Glad"
+	}
+
+	debugdir "LearnOpenGL"
+	debugargs { "--json", "gpu-benchmark-results.json" }
+
+	filter "system:windows"
+		systemversion "latest"
+		links "opengl32.lib"
+
+	filter "configurations:Debug"
+		runtime "Debug"
+		symbols "on"
+
+	filter "configurations:Release"
+		runtime "Release"
+		optimize "on"